@@ -0,0 +1,246 @@
+#!/usr/bin/env python
+"""Rebuild binary USB descriptors from an `lsusb -v` dump.
+
+The output is the device descriptor followed by the first configuration
+descriptor and everything in its wTotalLength, the layout of a Linux sysfs
+"descriptors" file. uvc_virtual_set_config() accepts it directly, so the dumps
+in this directory can be replayed through the descriptor parser without the
+cameras themselves.
+
+lsusb prints each descriptor as a list of named fields. Field widths follow
+from the name's prefix (b, w, dw, bcd, guid, ...), with the few exceptions
+listed below, and each descriptor is then cut or padded to its bLength so the
+fields lsusb prints past the end of a short descriptor are dropped again.
+lsusb also leaves out the class-specific interrupt endpoint descriptor that
+follows a UVC status endpoint; it is rebuilt from the endpoint's
+wMaxPacketSize.
+"""
+from __future__ import print_function
+import getopt
+import io
+import os
+import re
+import struct
+import sys
+
+FIELD_RE = re.compile(r'^\s+([a-z]+[A-Z][A-Za-z0-9]*|MaxPower)'
+                      r'(?:\(\s*\d+\)|\[\s*\d+\])?\s+(0x\s*[0-9a-fA-F]+|\S+)')
+UNRECOGNIZED_RE = re.compile(r'^\s+\*\* UNRECOGNIZED:\s+((?:[0-9a-f]{2}\s*)+)$')
+
+# Fields whose width isn't given by their prefix
+FIXED_WIDTHS = {
+    'bmAttributes': 1,
+    'bmCapabilities': 1,
+    'bmInfo': 1,
+    'bmInterlaceFlags': 1,
+    'bmVideoStandards': 1,
+    'MaxPower': 1,
+}
+
+PREFIX_WIDTHS = [
+    ('guid', 16),
+    ('bcd', 2),
+    ('dw', 4),
+    ('id', 2),
+    ('ba', 1),
+    ('w', 2),
+    ('b', 1),
+    ('i', 1),
+    ('t', 3),
+]
+
+
+class Descriptor(object):
+    def __init__(self):
+        self.data = bytearray()
+        self.length = None
+        self.control_size = 1
+
+    def finish(self):
+        if self.length is None:
+            return bytes(self.data)
+        data = self.data[:self.length]
+        return bytes(data + bytearray(self.length - len(data)))
+
+
+def field_width(name, index, desc):
+    if name in FIXED_WIDTHS:
+        return FIXED_WIDTHS[name]
+    if name == 'bmaControls' or (name == 'bmControls' and index is None):
+        # Sized by the descriptor's bControlSize
+        return desc.control_size
+    if name == 'bmControls':
+        # Extension units print their bitmap one byte at a time
+        return 1
+    for prefix, width in PREFIX_WIDTHS:
+        if name.startswith(prefix):
+            return width
+    raise ValueError('no width for field ' + name)
+
+
+def field_value(name, text):
+    if name.startswith('guid'):
+        return bytearray.fromhex(text.strip('{}').replace('-', ''))
+    if name.startswith('bcd'):
+        major, minor = text.split('.')
+        return int(major, 16) << 8 | int(minor, 16)
+    if name == 'MaxPower':
+        # High-speed devices count in units of 2 mA
+        return int(text.rstrip('mA')) // 2
+    if name == 'dwClockFrequency':
+        return int(round(float(text.rstrip('MHz')) * 1e6))
+    return int(text, 0)
+
+
+def encode(value, width):
+    if isinstance(value, bytearray):
+        if len(value) != width:
+            raise ValueError('bad GUID')
+        return value
+    return bytearray(struct.pack('<Q', value & ((1 << 64) - 1))[:width])
+
+
+def interrupt_ep_descriptor(max_transfer):
+    """Class-specific VideoControl interrupt endpoint descriptor"""
+    return bytes(bytearray([5, 0x25, 3]) + encode(max_transfer, 2))
+
+
+def convert(lines):
+    descriptors = []
+    desc = None
+    in_config = False
+    video_control = False
+    status_ep = None
+
+    def finish(desc):
+        data = desc.finish()
+        descriptors.append(data)
+        data = bytearray(data)
+        if data[1] == 4 and len(data) >= 9:
+            return data[5] == 14 and data[6] == 1, None
+        if data[1] == 5 and len(data) >= 7 and video_control and data[3] & 3 == 3:
+            return video_control, data[4] | data[5] << 8
+        return video_control, None
+
+    for line in lines:
+        header = line.strip()
+        if header.endswith('Descriptor:') or header.startswith('** UNRECOGNIZED'):
+            # lsusb doesn't print the descriptor that UVC puts after the
+            # status endpoint, so put it back if it's missing
+            if desc:
+                video_control, status_ep = finish(desc)
+                desc = None
+            if status_ep is not None and header != 'VideoControl Endpoint Descriptor:':
+                descriptors.append(interrupt_ep_descriptor(status_ep))
+            status_ep = None
+
+        match = UNRECOGNIZED_RE.match(line)
+        if match:
+            descriptors.append(bytes(bytearray.fromhex(match.group(1))))
+            continue
+
+        match = FIELD_RE.match(line)
+        if not match:
+            if header == 'Configuration Descriptor:':
+                if in_config:
+                    break  # Only the first configuration
+                in_config = True
+            elif line.startswith('Device Qualifier') or line.startswith('Device Status'):
+                break  # Not part of the descriptors read from the device
+            continue
+
+        name, text = match.groups()
+        # lsusb pads some hex values after the 0x
+        text = text.replace(' ', '')
+        index = re.search(r'[\(\[]\s*(\d+)', line[:match.start(2)])
+        index = int(index.group(1)) if index else None
+
+        if name == 'bLength':
+            if desc:
+                video_control, status_ep = finish(desc)
+            desc = Descriptor()
+            desc.length = int(text)
+        elif desc is None:
+            continue
+
+        width = field_width(name, index, desc)
+        value = field_value(name, text)
+        desc.data += encode(value, width)
+
+        if name == 'bControlSize':
+            desc.control_size = value
+
+    if desc:
+        video_control, status_ep = finish(desc)
+    if status_ep is not None:
+        descriptors.append(interrupt_ep_descriptor(status_ep))
+
+    if not descriptors or bytearray(descriptors[0])[1] != 1:
+        raise ValueError('no device descriptor')
+    return b''.join(descriptors)
+
+
+def check(blob):
+    """Check that the configuration's wTotalLength matches what was rebuilt"""
+    data = bytearray(blob)
+    config = data[data[0]:]
+    if len(config) < 9 or config[1] != 2:
+        raise ValueError('no configuration descriptor')
+    total = config[2] | config[3] << 8
+    if total != len(config):
+        raise ValueError('wTotalLength is %d but %d bytes were rebuilt' % (total, len(config)))
+
+
+def usage():
+    print('%s [-o outfile] dump.txt' % sys.argv[0], file=sys.stderr)
+    print('%s -d outdir dump.txt...' % sys.argv[0], file=sys.stderr)
+    sys.exit(1)
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'o:d:')
+    except getopt.GetoptError:
+        usage()
+
+    outfile = None
+    outdir = None
+    for opt, val in opts:
+        if opt == '-o':
+            outfile = val
+        elif opt == '-d':
+            outdir = val
+
+    if not args or (outfile and len(args) != 1):
+        usage()
+
+    status = 0
+    for path in args:
+        # Dumps carry vendor strings in whatever encoding the device used
+        with io.open(path, encoding='latin-1') as f:
+            lines = f.readlines()
+        try:
+            blob = convert(lines)
+            check(blob)
+        except ValueError as e:
+            print('%s: %s' % (path, e), file=sys.stderr)
+            status = 1
+            continue
+
+        if outdir:
+            name = os.path.splitext(os.path.basename(path))[0] + '.desc'
+            target = os.path.join(outdir, name)
+        else:
+            target = outfile
+
+        if target:
+            with open(target, 'wb') as f:
+                f.write(blob)
+        else:
+            getattr(sys.stdout, 'buffer', sys.stdout).write(blob)
+
+    sys.exit(status)
+
+
+if __name__ == '__main__':
+    main()
@@ -404,6 +404,10 @@ enum uvc_status_class {
   UVC_STATUS_CLASS_CONTROL = 0x10,
   UVC_STATUS_CLASS_CONTROL_CAMERA = 0x11,
   UVC_STATUS_CLASS_CONTROL_PROCESSING = 0x12,
+  UVC_STATUS_CLASS_CONTROL_SELECTOR = 0x13,
+  UVC_STATUS_CLASS_CONTROL_EXTENSION = 0x14,
+  UVC_STATUS_CLASS_STREAMING_BUTTON = 0x21,
+  UVC_STATUS_CLASS_STREAMING_ERROR = 0x22,
 };
 
 enum uvc_status_attribute {
@@ -430,6 +434,377 @@ typedef void(uvc_button_callback_t)(int button,
                                     int state,
                                     void *user_ptr);
 
+/** Error codes reported by VS_STREAM_ERROR_CODE_CONTROL (4.3.1.7) */
+enum uvc_stream_error_code {
+  UVC_STREAM_ERROR_NONE = 0x00,
+  UVC_STREAM_ERROR_PROTOCOL_UNDERFLOW = 0x01,
+  UVC_STREAM_ERROR_PROTOCOL_OVERFLOW = 0x02,
+  UVC_STREAM_ERROR_FORMAT_CHANGE = 0x03,
+  /** The device couldn't be queried for the error code */
+  UVC_STREAM_ERROR_UNKNOWN = -1
+};
+
+/** A decoded status interrupt packet (2.4.2.2)
+ * @ingroup device
+ */
+typedef struct uvc_status_event {
+  enum uvc_status_class status_class;
+  /** Terminal/unit ID, 0 for the VideoControl interface itself, or the
+   * VideoStreaming interface number for streaming events */
+  uint8_t originator;
+  /** bEvent: 0 for control changes and button presses, else an error event */
+  uint8_t event;
+  /** Control selector (VideoControl events only) */
+  uint8_t selector;
+  enum uvc_status_attribute attribute;
+  /** Button state for UVC_STATUS_CLASS_STREAMING_BUTTON */
+  int button_state;
+  /** Result of the VS_STREAM_ERROR_CODE_CONTROL query for
+   * UVC_STATUS_CLASS_STREAMING_ERROR (a uvc_stream_error_code) */
+  int stream_error_code;
+  /** Packet contents following the header; only valid during the callback */
+  const uint8_t *data;
+  size_t data_len;
+} uvc_status_event_t;
+
+/** A callback function to accept decoded status events
+ * @ingroup device
+ */
+typedef void(uvc_status_event_callback_t)(const uvc_status_event_t *event,
+                                          void *user_ptr);
+
+/** Status event counters of a stream
+ * @ingroup streaming
+ */
+typedef struct uvc_stream_status_stats {
+  /** Stream error events reported by the device */
+  uint32_t stream_errors;
+  /** Button events reported on the stream's interface */
+  uint32_t button_events;
+  /** Code of the most recent stream error, a uvc_stream_error_code */
+  int last_stream_error_code;
+  /** Status packets of the whole device dropped because the status thread
+   * fell behind */
+  uint32_t status_dropped;
+} uvc_stream_status_stats_t;
+
+/** Transfer health counters of a stream
+ * @ingroup streaming
+ */
+typedef struct uvc_stream_transfer_stats {
+  /** Transfers submitted when the stream started */
+  uint32_t target_in_flight;
+  /** Transfers currently submitted */
+  uint32_t in_flight;
+  /** Transfers that completed with LIBUSB_TRANSFER_ERROR */
+  uint32_t transfer_errors;
+  /** Failed calls to libusb_submit_transfer while streaming */
+  uint32_t submit_failures;
+  /** Failed transfers that were successfully submitted again */
+  uint32_t resubmits;
+  /** Failed transfers that were replaced by a freshly allocated one */
+  uint32_t reallocations;
+  /** Transfers given up on because the device went away */
+  uint32_t lost;
+} uvc_stream_transfer_stats_t;
+
+/** Options for uvc_set_buffer_arena
+ * @ingroup init
+ */
+enum uvc_arena_flags {
+  /** Back the arena with 2 MB pages, or transparent huge pages */
+  UVC_ARENA_HUGEPAGES = 1 << 0,
+  /** Lock the arena in RAM */
+  UVC_ARENA_MLOCK = 1 << 1
+};
+
+/** Usage of a context's buffer arena
+ * @ingroup init
+ */
+typedef struct uvc_arena_stats {
+  /** Size of the arena */
+  size_t size;
+  /** Bytes currently handed out, block headers included */
+  size_t used;
+  /** Most bytes handed out at once */
+  size_t high_water;
+  /** Allocations that did not fit and came from the heap instead */
+  uint32_t fallbacks;
+  /** Whether the arena got explicit 2 MB pages rather than THP or none */
+  uint8_t hugepages;
+  /** Whether the arena is locked in RAM */
+  uint8_t locked;
+} uvc_arena_stats_t;
+
+/** Frame buffer usage of a stream
+ * @ingroup streaming
+ */
+typedef struct uvc_stream_buffer_stats {
+  /** Size of each of the two frame assembly buffers */
+  size_t buffer_size;
+  /** dwMaxVideoFrameSize of the negotiated mode */
+  size_t max_frame_size;
+  /** Largest frame received so far */
+  size_t high_water;
+  /** Times a buffer had to grow while streaming */
+  uint32_t grows;
+  /** Payloads cut short because a buffer could not grow */
+  uint32_t truncated;
+} uvc_stream_buffer_stats_t;
+
+/** Bus usage of a negotiated mode and the transfers uvc_stream_start() would
+ * set up for it
+ * @ingroup streaming
+ */
+typedef struct uvc_stream_bandwidth {
+  /** Whether the stream uses an isochronous endpoint rather than bulk */
+  uint8_t isochronous;
+  /** Altsetting selected for isochronous streaming; 0 for bulk */
+  uint8_t bAlternateSetting;
+  /** Bytes the altsetting reserves per service interval, or the size of a
+   * bulk payload */
+  uint32_t bytes_per_packet;
+  /** Service intervals per second of the isochronous endpoint */
+  uint32_t packets_per_second;
+  /** Packets in each isochronous transfer */
+  uint32_t packets_per_transfer;
+  /** Size of each transfer buffer */
+  uint32_t transfer_size;
+  /** Transfers kept in flight */
+  uint32_t num_transfers;
+  /** Memory held by the transfer buffers */
+  size_t transfer_memory;
+  /** Bus bandwidth the altsetting reserves in bytes per second; 0 for bulk */
+  uint64_t reserved_bytes_per_second;
+  /** Largest frame times the frame rate: the most image data the mode
+   * produces per second */
+  uint64_t frame_bytes_per_second;
+} uvc_stream_bandwidth_t;
+
+/** Options for uvc_stream_replay
+ * @ingroup streaming
+ */
+enum uvc_replay_flags {
+  /** Feed transfers at the pace they were recorded. By default they are fed
+   * as fast as the callback takes the frames, and no frame is dropped. */
+  UVC_REPLAY_REALTIME = 1,
+};
+
+/** Summary of a transfer trace
+ * @ingroup streaming
+ */
+typedef struct uvc_trace_info {
+  /** Format and size of the recorded stream */
+  enum uvc_frame_format frame_format;
+  uint16_t width;
+  uint16_t height;
+  /** Negotiated frame interval, in 100ns units */
+  uint32_t frame_interval;
+  uint32_t max_frame_size;
+  uint32_t max_payload_size;
+  /** Whether the stream used isochronous transfers */
+  uint8_t isochronous;
+  /** Transfers recorded */
+  uint64_t transfers;
+  /** Time from the first to the last transfer, in nanoseconds */
+  uint64_t duration_ns;
+} uvc_trace_info_t;
+
+/** Writer of a frame recording
+ * @ingroup streaming
+ *
+ * Create one with uvc_recorder_create() and finish it with
+ * uvc_recorder_close().
+ */
+struct uvc_recorder;
+typedef struct uvc_recorder uvc_recorder_t;
+
+/** Options for uvc_recorder_create
+ * @ingroup streaming
+ */
+enum uvc_recorder_flags {
+  /** Write with O_DIRECT, keeping the recording out of the page cache */
+  UVC_RECORDER_DIRECT = 1,
+};
+
+/** Counters of a recorder
+ * @ingroup streaming
+ */
+typedef struct uvc_recorder_stats {
+  /** Frames recorded */
+  uint64_t frames;
+  /** Image and metadata bytes recorded */
+  uint64_t bytes;
+  /** Bytes written to the file so far */
+  uint64_t bytes_written;
+  /** Frames that didn't fit in the recording */
+  uint64_t dropped;
+  /** Times a frame had to wait for the disk */
+  uint64_t stalls;
+} uvc_recorder_stats_t;
+
+/** Summary of a frame recording
+ * @ingroup streaming
+ */
+typedef struct uvc_recording_info {
+  /** Frames recorded */
+  uint64_t frames;
+  /** Image and metadata bytes recorded */
+  uint64_t bytes;
+  /** Time from the first frame to the last, in nanoseconds */
+  uint64_t duration_ns;
+  /** Format and size of the first frame */
+  enum uvc_frame_format frame_format;
+  uint32_t width;
+  uint32_t height;
+} uvc_recording_info_t;
+
+/** Options for uvc_stream_start_playback
+ * @ingroup streaming
+ */
+enum uvc_playback_flags {
+  /** Hand frames over at the pace they were recorded. By default each is
+   * handed over once the last has been taken, and no frame is dropped. */
+  UVC_PLAYBACK_REALTIME = 1,
+  /** Start over at the end of the recording, until the stream is stopped */
+  UVC_PLAYBACK_LOOP = 2,
+};
+
+/** Publisher of a shared-memory frame ring
+ * @ingroup shm
+ *
+ * Create one with uvc_shm_publisher_create() and free it with
+ * uvc_shm_publisher_destroy().
+ */
+struct uvc_shm_publisher;
+typedef struct uvc_shm_publisher uvc_shm_publisher_t;
+
+/** Reader of a shared-memory frame ring, in this or another process
+ * @ingroup shm
+ */
+struct uvc_shm_reader;
+typedef struct uvc_shm_reader uvc_shm_reader_t;
+
+/** Which frame a ring reader takes next
+ * @ingroup shm
+ */
+enum uvc_shm_read_policy {
+  /** Every frame in order. Frames overwritten before the reader got to
+   * them are skipped and counted as dropped. */
+  UVC_SHM_READ_ALL = 0,
+  /** Always the newest frame, skipping any the reader fell behind on */
+  UVC_SHM_READ_LATEST = 1,
+};
+
+/** A frame read in place from a shared-memory ring
+ * @ingroup shm
+ */
+typedef struct uvc_shm_frame {
+  /** Image data inside the ring; valid until uvc_shm_reader_release() */
+  const void *data;
+  size_t data_bytes;
+  uint32_t width;
+  uint32_t height;
+  enum uvc_frame_format frame_format;
+  size_t step;
+  /** Sequence number and timestamps of the published uvc_frame_t */
+  uint32_t sequence;
+  struct timeval capture_time;
+  struct timespec capture_time_finished;
+  uint32_t pts;
+  uint32_t scr;
+  /** Position in the ring's publication order, from 0 */
+  uint64_t index;
+} uvc_shm_frame_t;
+
+/** Counters of a shared-memory ring reader
+ * @ingroup shm
+ */
+typedef struct uvc_shm_reader_stats {
+  /** Frames read and released intact */
+  uint64_t frames;
+  /** Frames published but skipped, by policy or because they were
+   * overwritten first */
+  uint64_t dropped;
+  /** Frames overwritten while the reader held them */
+  uint64_t torn;
+} uvc_shm_reader_stats_t;
+
+/** Recovery actions tried, in order, when a stream stalls
+ * @ingroup streaming
+ */
+enum uvc_watchdog_step {
+  UVC_WATCHDOG_STEP_NONE = 0,
+  /** Stop the transfers, commit the negotiated control block again, restart */
+  UVC_WATCHDOG_STEP_RECOMMIT,
+  /** As above, after switching the interface to altsetting 0 */
+  UVC_WATCHDOG_STEP_ALTSETTING,
+  /** As above, after clearing a halt on the video endpoint */
+  UVC_WATCHDOG_STEP_CLEAR_HALT,
+  /** As above, after a USB port reset */
+  UVC_WATCHDOG_STEP_RESET
+};
+
+enum uvc_watchdog_event_type {
+  /** No frame arrived for the configured number of frame intervals */
+  UVC_WATCHDOG_STALL,
+  /** A recovery step was run; see result and duration_us */
+  UVC_WATCHDOG_STEP_DONE,
+  /** Frames are flowing again */
+  UVC_WATCHDOG_RECOVERED,
+  /** Every allowed step was tried without frames coming back */
+  UVC_WATCHDOG_FAILED
+};
+
+/** Event reported by the stream watchdog
+ * @ingroup streaming
+ */
+typedef struct uvc_watchdog_event {
+  enum uvc_watchdog_event_type type;
+  /** Step that was run (STEP_DONE) or the last one tried */
+  enum uvc_watchdog_step step;
+  /** Result of the step's USB requests. For FAILED, that of the last step,
+   * or UVC_ERROR_NOT_FOUND if it succeeded but no frame followed */
+  uvc_error_t result;
+  /** Time spent in the step's USB requests */
+  uint64_t duration_us;
+  /** Time from the stall being detected until this event */
+  uint64_t elapsed_us;
+  /** Frame intervals without a frame when the stall was detected */
+  uint32_t missed_intervals;
+} uvc_watchdog_event_t;
+
+typedef void(uvc_watchdog_callback_t)(uvc_stream_handle_t *strmh,
+                                      const uvc_watchdog_event_t *event,
+                                      void *user_ptr);
+
+/** Stream watchdog settings
+ * @ingroup streaming
+ */
+typedef struct uvc_watchdog_config {
+  /** Missed frame intervals that count as a stall (0: default of 10) */
+  uint32_t missed_intervals;
+  /** Last recovery step to try; UVC_WATCHDOG_STEP_NONE only reports stalls */
+  enum uvc_watchdog_step max_step;
+  /** How long to wait for a frame after each step (0: default of 2000ms) */
+  uint32_t step_timeout_ms;
+  uvc_watchdog_callback_t *cb;
+  void *user_ptr;
+} uvc_watchdog_config_t;
+
+/** Stream watchdog counters
+ * @ingroup streaming
+ */
+typedef struct uvc_watchdog_stats {
+  uint32_t stalls;
+  uint32_t recoveries;
+  uint32_t failures;
+  /** Recovery steps run, indexed by uvc_watchdog_step */
+  uint32_t steps_run[UVC_WATCHDOG_STEP_RESET + 1];
+  /** Stall-to-first-frame time of the last successful recovery */
+  uint64_t last_recovery_us;
+} uvc_watchdog_stats_t;
+
 /** Structure representing a UVC device descriptor.
  *
  * (This isn't a standard structure.)
@@ -485,13 +860,148 @@ typedef struct uvc_frame {
   void *metadata;
   /** Size of metadata buffer */
   size_t metadata_bytes;
+  /** Set by the library when data came from the frame buffer pool, which
+   * it then returns to; leave zero when supplying data yourself */
+  uint8_t data_pooled;
+  /** Presentation time stamp: the device clock when capture started, in
+   * units of uvc_stream_ctrl_t::dwClockFrequency; zero if not sent */
+  uint32_t pts;
+  /** Source clock (SCR) of the last payload of the frame that carried one,
+   * in the same units, so scr - pts is the device's own latency; zero if
+   * not sent */
+  uint32_t scr;
 } uvc_frame_t;
 
+/** Counters of the frame buffer pool
+ * @ingroup frame
+ */
+typedef struct uvc_frame_pool_stats {
+  /** Buffers handed out from the pool */
+  uint64_t hits;
+  /** Buffers that had to be allocated on the heap */
+  uint64_t misses;
+  /** Free buffers held by the pool, threads' caches included */
+  uint32_t cached_buffers;
+  /** Bytes held in those buffers */
+  size_t cached_bytes;
+} uvc_frame_pool_stats_t;
+
 /** A callback function to handle incoming assembled UVC frames
  * @ingroup streaming
  */
 typedef void(uvc_frame_callback_t)(struct uvc_frame *frame, void *user_ptr);
 
+/** A band of rows of a frame that is still being received
+ * @ingroup streaming
+ */
+typedef struct uvc_frame_slice {
+  /** Start of the buffer the frame is being assembled in. Rows before
+   * end_row are complete; the buffer is only valid during the callback */
+  const void *data;
+  /** Bytes per row (of the luma plane, for planar formats) */
+  size_t step;
+  /** Width of the image in pixels */
+  uint32_t width;
+  /** Height of the image in pixels */
+  uint32_t height;
+  /** Pixel data format */
+  enum uvc_frame_format frame_format;
+  /** First row that is new in this slice */
+  uint32_t first_row;
+  /** One past the last complete row */
+  uint32_t end_row;
+  /** Sequence number the finished frame will carry */
+  uint32_t sequence;
+  /** Set on the last slice of a frame */
+  uint8_t last;
+} uvc_frame_slice_t;
+
+/** A callback function to handle newly completed rows of a frame
+ * @ingroup streaming
+ */
+typedef void(uvc_slice_callback_t)(const uvc_frame_slice_t *slice, void *user_ptr);
+
+/** Metadata item identifiers of the Microsoft UVC 1.5 extensions
+ * (KSCAMERA_METADATA_*). IDs from UVC_METADATA_ID_CUSTOM_START up are
+ * vendor-defined, e.g. face ROIs.
+ * @ingroup frame
+ */
+enum uvc_metadata_id {
+  UVC_METADATA_ID_PHOTO_CONFIRMATION = 1,
+  UVC_METADATA_ID_USB_VIDEO_HEADER = 2,
+  UVC_METADATA_ID_CAPTURE_STATS = 3,
+  UVC_METADATA_ID_CAMERA_EXTRINSICS = 4,
+  UVC_METADATA_ID_CAMERA_INTRINSICS = 5,
+  UVC_METADATA_ID_FRAME_ILLUMINATION = 6,
+  UVC_METADATA_ID_CUSTOM_START = 0x80000000
+};
+
+/** A metadata item: a view into uvc_frame_t::metadata, valid as long as the
+ * frame's metadata is
+ * @ingroup frame
+ */
+typedef struct uvc_metadata_item {
+  /** Item identifier, a uvc_metadata_id or a custom ID */
+  uint32_t id;
+  /** Item contents following the 8-byte item header */
+  const uint8_t *data;
+  size_t data_len;
+} uvc_metadata_item_t;
+
+/** Fields of a UVC_METADATA_ID_USB_VIDEO_HEADER item
+ * @ingroup frame
+ */
+typedef struct uvc_metadata_video_header {
+  /** bmHeaderInfo of the payload header */
+  uint8_t header_info;
+  /** dwPresentationTime, if header_info has the PTS bit */
+  uint32_t pts;
+  /** Source time clock and SOF counter, if header_info has the SCR bit */
+  uint32_t scr_stc;
+  uint16_t scr_sof;
+} uvc_metadata_video_header_t;
+
+/** Capture statistics flags: which fields of uvc_metadata_capture_stats_t
+ * are valid */
+#define UVC_CAPTURE_STATS_EXPOSURE_TIME         (1 << 0)
+#define UVC_CAPTURE_STATS_EXPOSURE_COMPENSATION (1 << 1)
+#define UVC_CAPTURE_STATS_ISO_SPEED             (1 << 2)
+#define UVC_CAPTURE_STATS_FOCUS_STATE           (1 << 3)
+#define UVC_CAPTURE_STATS_LENS_POSITION         (1 << 4)
+#define UVC_CAPTURE_STATS_WHITE_BALANCE         (1 << 5)
+#define UVC_CAPTURE_STATS_FLASH                 (1 << 6)
+#define UVC_CAPTURE_STATS_FLASH_POWER           (1 << 7)
+#define UVC_CAPTURE_STATS_ZOOM_FACTOR           (1 << 8)
+#define UVC_CAPTURE_STATS_SCENE_MODE            (1 << 9)
+#define UVC_CAPTURE_STATS_SENSOR_FRAMERATE      (1 << 10)
+
+/** Fields of a UVC_METADATA_ID_CAPTURE_STATS item (per-frame exposure,
+ * gain, focus, ...)
+ * @ingroup frame
+ */
+typedef struct uvc_metadata_capture_stats {
+  /** UVC_CAPTURE_STATS_* bits of the fields that are valid */
+  uint32_t flags;
+  /** Exposure time in 100ns units */
+  uint64_t exposure_time;
+  uint64_t exposure_compensation_flags;
+  int32_t exposure_compensation_value;
+  /** Sensor gain as ISO speed */
+  uint32_t iso_speed;
+  uint32_t focus_state;
+  uint32_t lens_position;
+  /** White balance in Kelvin */
+  uint32_t white_balance;
+  uint32_t flash;
+  uint32_t flash_power;
+  /** Zoom factor in Q16 fixed point */
+  uint32_t zoom_factor;
+  uint64_t scene_mode;
+  /** Sensor frame rate, numerator in the high 32 bits and denominator in
+   * the low 32 bits */
+  uint64_t sensor_framerate;
+} uvc_metadata_capture_stats_t;
+
 /** Streaming mode, includes all information needed to select stream
  * @ingroup streaming
  */
@@ -529,9 +1039,68 @@ typedef struct uvc_still_ctrl {
   uint8_t bInterfaceNumber;
 } uvc_still_ctrl_t;
 
+/** Frame processing pipeline attached to a stream.
+ * @ingroup pipeline
+ *
+ * Create one with uvc_pipeline_create() and free it with uvc_pipeline_destroy().
+ */
+struct uvc_pipeline;
+typedef struct uvc_pipeline uvc_pipeline_t;
+
+/** Built-in pipeline stages
+ * @ingroup pipeline
+ */
+enum uvc_pipeline_stage_type {
+  /** Drop truncated uncompressed frames and MJPEG frames without SOI/EOI */
+  UVC_PIPELINE_STAGE_INTEGRITY,
+  /** Decode MJPEG into RGB (or GRAY8); other formats pass through */
+  UVC_PIPELINE_STAGE_MJPEG_DECODE,
+  /** Convert into RGB, BGR or GRAY8 */
+  UVC_PIPELINE_STAGE_CONVERT,
+  /** Nearest-neighbour resize (GRAY8, GRAY16, RGB, BGR, YUYV, UYVY) */
+  UVC_PIPELINE_STAGE_SCALE,
+  /** Hand each frame to a user callback */
+  UVC_PIPELINE_STAGE_SINK
+};
+
+/** Parameters of a pipeline stage
+ * @ingroup pipeline
+ */
+typedef struct uvc_pipeline_stage_config {
+  enum uvc_pipeline_stage_type type;
+  /** Number of worker threads (0 means one) */
+  int num_threads;
+  /** Frames that may wait in front of the stage (0 means default) */
+  int queue_depth;
+  /** Output format of MJPEG_DECODE and CONVERT stages */
+  enum uvc_frame_format format;
+  /** Output size of SCALE stages */
+  uint32_t width;
+  uint32_t height;
+  /** Callback of SINK stages. The frame is only valid during the call. */
+  uvc_frame_callback_t *cb;
+  void *user_ptr;
+} uvc_pipeline_stage_config_t;
+
+/** Counters of a pipeline stage
+ * @ingroup pipeline
+ */
+typedef struct uvc_pipeline_stage_stats {
+  /** Frames the stage handled successfully */
+  uint64_t frames_processed;
+  /** Frames dropped for integrity, queue overflow or buffer exhaustion */
+  uint64_t frames_dropped;
+  /** Frames the stage failed to decode, convert or scale */
+  uint64_t frames_failed;
+} uvc_pipeline_stage_stats_t;
+
 uvc_error_t uvc_init(uvc_context_t **ctx, struct libusb_context *usb_ctx);
 void uvc_exit(uvc_context_t *ctx);
 
+uvc_error_t uvc_set_buffer_arena(uvc_context_t *ctx, size_t size, int flags);
+uvc_error_t uvc_get_buffer_arena_stats(uvc_context_t *ctx,
+                                       uvc_arena_stats_t *stats);
+
 uvc_error_t uvc_get_device_list(
     uvc_context_t *ctx,
     uvc_device_t ***list);
@@ -582,6 +1151,10 @@ void uvc_set_button_callback(uvc_device_handle_t *devh,
                              uvc_button_callback_t cb,
                              void *user_ptr);
 
+void uvc_set_status_event_callback(uvc_device_handle_t *devh,
+                                   uvc_status_event_callback_t cb,
+                                   void *user_ptr);
+
 const uvc_input_terminal_t *uvc_get_camera_terminal(uvc_device_handle_t *devh);
 const uvc_input_terminal_t *uvc_get_input_terminals(uvc_device_handle_t *devh);
 const uvc_output_terminal_t *uvc_get_output_terminals(uvc_device_handle_t *devh);
@@ -597,6 +1170,17 @@ uvc_error_t uvc_get_stream_ctrl_format_size(
     int fps
     );
 
+uvc_error_t uvc_get_stream_ctrl_frame(
+    uvc_device_handle_t *devh,
+    uvc_stream_ctrl_t *ctrl,
+    const uvc_frame_desc_t *frame,
+    uint32_t interval);
+
+uvc_error_t uvc_get_stream_bandwidth(
+    uvc_device_handle_t *devh,
+    const uvc_stream_ctrl_t *ctrl,
+    uvc_stream_bandwidth_t *bandwidth);
+
 uvc_error_t uvc_get_still_ctrl_format_size(
     uvc_device_handle_t *devh,
     uvc_stream_ctrl_t *ctrl,
@@ -606,6 +1190,11 @@ uvc_error_t uvc_get_still_ctrl_format_size(
 uvc_error_t uvc_trigger_still(
     uvc_device_handle_t *devh,
     uvc_still_ctrl_t *still_ctrl);
+uvc_error_t uvc_trigger_still_burst(
+    uvc_device_handle_t *devh,
+    uvc_still_ctrl_t *still_ctrl,
+    int count,
+    int32_t timeout_us);
 
 const uvc_format_desc_t *uvc_get_format_descs(uvc_device_handle_t* );
 
@@ -646,9 +1235,103 @@ uvc_error_t uvc_stream_get_frame(
     uvc_frame_t **frame,
     int32_t timeout_us
 );
+uvc_error_t uvc_stream_set_image_interval(
+    uvc_stream_handle_t *strmh,
+    uint32_t interval);
+uvc_error_t uvc_stream_set_frame_decimation(
+    uvc_stream_handle_t *strmh,
+    uint32_t every_n,
+    uint32_t min_frame_interval);
+uvc_error_t uvc_stream_set_slice_callback(
+    uvc_stream_handle_t *strmh,
+    uvc_slice_callback_t *cb,
+    uint32_t rows_per_slice,
+    void *user_ptr);
+uvc_error_t uvc_stream_set_roi(
+    uvc_stream_handle_t *strmh,
+    uint32_t x, uint32_t y,
+    uint32_t width, uint32_t height);
+uvc_error_t uvc_stream_set_still_callback(
+    uvc_stream_handle_t *strmh,
+    uvc_frame_callback_t *cb,
+    void *user_ptr);
+uvc_error_t uvc_stream_get_still(
+    uvc_stream_handle_t *strmh,
+    uvc_frame_t **frame,
+    int32_t timeout_us);
 uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh);
+uvc_error_t uvc_stream_get_status_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_stream_status_stats_t *stats);
+uvc_error_t uvc_stream_get_buffer_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_stream_buffer_stats_t *stats);
+uvc_error_t uvc_stream_get_transfer_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_stream_transfer_stats_t *stats);
+uvc_error_t uvc_stream_set_watchdog(
+    uvc_stream_handle_t *strmh,
+    const uvc_watchdog_config_t *config);
+uvc_error_t uvc_stream_get_watchdog_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_watchdog_stats_t *stats);
+uvc_error_t uvc_stream_start_trace(
+    uvc_stream_handle_t *strmh,
+    const char *path);
+uvc_error_t uvc_stream_stop_trace(uvc_stream_handle_t *strmh);
+uvc_error_t uvc_trace_get_info(const char *path, uvc_trace_info_t *info);
+uvc_error_t uvc_stream_replay(
+    uvc_stream_handle_t *strmh,
+    const char *path,
+    uvc_frame_callback_t *cb,
+    void *user_ptr,
+    uint8_t flags);
+uvc_error_t uvc_stream_start_playback(
+    uvc_stream_handle_t *strmh,
+    const char *path,
+    uvc_frame_callback_t *cb,
+    void *user_ptr,
+    uint8_t flags);
+uvc_error_t uvc_stream_wait_playback(uvc_stream_handle_t *strmh, int32_t timeout_us);
 void uvc_stream_close(uvc_stream_handle_t *strmh);
 
+uvc_error_t uvc_recorder_create(
+    uvc_recorder_t **rec,
+    const char *path,
+    uint64_t capacity,
+    uint32_t max_frames,
+    uint8_t flags);
+uvc_error_t uvc_recorder_write(uvc_recorder_t *rec, const uvc_frame_t *frame);
+void uvc_recorder_callback(uvc_frame_t *frame, void *rec);
+void uvc_recorder_get_stats(uvc_recorder_t *rec, uvc_recorder_stats_t *stats);
+uvc_error_t uvc_recorder_close(uvc_recorder_t *rec);
+uvc_error_t uvc_recording_get_info(const char *path, uvc_recording_info_t *info);
+
+uvc_error_t uvc_shm_publisher_create(
+    uvc_shm_publisher_t **pub,
+    const char *name,
+    uint32_t num_slots,
+    size_t slot_bytes);
+int uvc_shm_publisher_get_fd(uvc_shm_publisher_t *pub);
+uvc_error_t uvc_shm_publish(uvc_shm_publisher_t *pub, const uvc_frame_t *frame);
+void uvc_shm_publish_callback(uvc_frame_t *frame, void *pub);
+void uvc_shm_publisher_destroy(uvc_shm_publisher_t *pub);
+uvc_error_t uvc_shm_reader_open(
+    uvc_shm_reader_t **reader,
+    const char *name,
+    enum uvc_shm_read_policy policy);
+uvc_error_t uvc_shm_reader_open_fd(
+    uvc_shm_reader_t **reader,
+    int fd,
+    enum uvc_shm_read_policy policy);
+uvc_error_t uvc_shm_reader_acquire(
+    uvc_shm_reader_t *reader,
+    uvc_shm_frame_t *frame,
+    int32_t timeout_us);
+uvc_error_t uvc_shm_reader_release(uvc_shm_reader_t *reader, uvc_shm_frame_t *frame);
+void uvc_shm_reader_get_stats(uvc_shm_reader_t *reader, uvc_shm_reader_stats_t *stats);
+void uvc_shm_reader_close(uvc_shm_reader_t *reader);
+
 int uvc_get_ctrl_len(uvc_device_handle_t *devh, uint8_t unit, uint8_t ctrl);
 int uvc_get_ctrl(uvc_device_handle_t *devh, uint8_t unit, uint8_t ctrl, void *data, int len, enum uvc_req_code req_code);
 int uvc_set_ctrl(uvc_device_handle_t *devh, uint8_t unit, uint8_t ctrl, void *data, int len);
@@ -781,13 +1464,29 @@ uvc_error_t uvc_set_input_select(uvc_device_handle_t *devh, uint8_t selector);
 void uvc_perror(uvc_error_t err, const char *msg);
 const char* uvc_strerror(uvc_error_t err);
 void uvc_print_diag(uvc_device_handle_t *devh, FILE *stream);
+uvc_error_t uvc_print_diag_json(uvc_device_handle_t *devh, FILE *stream);
 void uvc_print_stream_ctrl(uvc_stream_ctrl_t *ctrl, FILE *stream);
 
 uvc_frame_t *uvc_allocate_frame(size_t data_bytes);
+uvc_frame_t *uvc_allocate_frame_aligned(size_t data_bytes, size_t alignment);
 void uvc_free_frame(uvc_frame_t *frame);
 
+uvc_error_t uvc_frame_pool_prewarm(size_t data_bytes, size_t alignment,
+                                   unsigned int count);
+void uvc_frame_pool_trim(void);
+void uvc_frame_pool_get_stats(uvc_frame_pool_stats_t *stats);
+
 uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out);
 
+uvc_error_t uvc_frame_next_metadata_item(const uvc_frame_t *frame,
+    size_t *offset, uvc_metadata_item_t *item);
+uvc_error_t uvc_frame_find_metadata_item(const uvc_frame_t *frame,
+    uint32_t id, uvc_metadata_item_t *item);
+uvc_error_t uvc_frame_get_video_header(const uvc_frame_t *frame,
+    uvc_metadata_video_header_t *header);
+uvc_error_t uvc_frame_get_capture_stats(const uvc_frame_t *frame,
+    uvc_metadata_capture_stats_t *stats);
+
 uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_any2rgb(uvc_frame_t *in, uvc_frame_t *out);
@@ -804,6 +1503,20 @@ uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out);
 uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out);
 #endif
 
+uvc_error_t uvc_scale_frame(uvc_frame_t *in, uvc_frame_t *out,
+    uint32_t width, uint32_t height);
+
+uvc_error_t uvc_pipeline_create(uvc_pipeline_t **pipe);
+uvc_error_t uvc_pipeline_add_stage(uvc_pipeline_t *pipe,
+    const uvc_pipeline_stage_config_t *config);
+uvc_error_t uvc_stream_start_pipeline(uvc_stream_handle_t *strmh,
+    uvc_pipeline_t *pipe,
+    uint8_t flags);
+uvc_error_t uvc_pipeline_get_stage_stats(uvc_pipeline_t *pipe, int stage_idx,
+    uvc_pipeline_stage_stats_t *stats);
+void uvc_pipeline_stop(uvc_pipeline_t *pipe);
+void uvc_pipeline_destroy(uvc_pipeline_t *pipe);
+
 #ifdef __cplusplus
 }
 #endif
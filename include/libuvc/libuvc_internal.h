@@ -69,6 +69,17 @@
 #define UVC_EXIT(code)
 #endif
 
+/* Acquire/release accessors for unsigned int indices shared between the USB
+ * event thread and other threads without a lock (MSVC gives volatile
+ * accesses acquire/release semantics) */
+#ifdef _MSC_VER
+#define UVC_ATOMIC_LOAD(p) (*(volatile unsigned int *)(p))
+#define UVC_ATOMIC_STORE(p, v) (*(volatile unsigned int *)(p) = (v))
+#else
+#define UVC_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define UVC_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
 /* http://stackoverflow.com/questions/19452971/array-size-macro-that-rejects-pointers */
 #define IS_INDEXABLE(arg) (sizeof(arg[0]))
 #define IS_ARRAY(arg) (IS_INDEXABLE(arg) && (((void *) &arg) == ((void *) arg)))
@@ -231,7 +242,51 @@ typedef struct uvc_device_info {
 #endif
 #endif
 
+/* A failed stream transfer is retried after 1ms, doubling up to
+ * 1ms << LIBUVC_TRANSFER_MAX_BACKOFF_SHIFT, and replaced by a newly allocated
+ * transfer after every LIBUVC_TRANSFER_REALLOC_AFTER consecutive failures. */
+#define LIBUVC_TRANSFER_MAX_BACKOFF_SHIFT 8
+#define LIBUVC_TRANSFER_REALLOC_AFTER 4
+
+/* Smallest metadata buffer; streams size theirs from the negotiated mode */
 #define LIBUVC_XFER_META_BUF_SIZE ( 4 * 1024 )
+/* Most metadata one payload header can carry (bHeaderLength minus the
+ * two mandatory bytes) */
+#define LIBUVC_META_MAX_PER_PAYLOAD ( 255 - 2 )
+
+/* Frame buffers of compressed streams start at the larger of this and a
+ * fraction of dwMaxVideoFrameSize, or just above the largest frame seen so
+ * far, and grow on demand */
+#define LIBUVC_FRAME_BUF_MIN_SIZE ( 64 * 1024 )
+#define LIBUVC_FRAME_BUF_DIVISOR 8
+
+/* Default alignment of pooled frame data */
+#define LIBUVC_FRAME_POOL_DEFAULT_ALIGN 64
+
+/* Bulk transfers kept queued on a method 3 still endpoint, so a still image
+ * can be received as soon as it is triggered */
+#define LIBUVC_NUM_STILL_XFERS 2
+/* Size of those transfers when the still commit has no dwMaxPayloadTransferSize */
+#define LIBUVC_STILL_XFER_SIZE ( 64 * 1024 )
+
+/* Interrupt transfers kept queued on the status endpoint, so that the
+ * endpoint is still being read while a completed one is resubmitted. */
+#ifndef LIBUVC_NUM_STATUS_XFERS
+#define LIBUVC_NUM_STATUS_XFERS 4
+#endif
+
+#define LIBUVC_STATUS_BUF_SIZE 32
+
+/* Status packets that may wait for the status thread; must be a power of two */
+#ifndef LIBUVC_STATUS_QUEUE_LEN
+#define LIBUVC_STATUS_QUEUE_LEN 64
+#endif
+
+/** Status packet copied out of an interrupt transfer */
+struct uvc_status_packet {
+  uint8_t data[LIBUVC_STATUS_BUF_SIZE];
+  int len;
+};
 
 struct uvc_stream_handle {
   struct uvc_device_handle *devh;
@@ -251,6 +306,10 @@ struct uvc_stream_handle {
   uint32_t last_scr, hold_last_scr;
   size_t got_bytes, hold_bytes;
   uint8_t *outbuf, *holdbuf;
+  /* allocated sizes, swapped along with the buffers; frame.data, of
+   * frame_buf_size, joins the rotation when a frame is delivered */
+  size_t outbuf_size, holdbuf_size, frame_buf_size;
+  uvc_stream_buffer_stats_t buffer_stats;
   pthread_mutex_t cb_mutex;
   pthread_cond_t cb_cond;
   pthread_t cb_thread;
@@ -259,6 +318,16 @@ struct uvc_stream_handle {
   void *user_ptr;
   struct libusb_transfer *transfers[LIBUVC_NUM_TRANSFER_BUFS];
   uint8_t *transfer_bufs[LIBUVC_NUM_TRANSFER_BUFS];
+  /* Transfers that failed while streaming are parked here until the
+   * resubmit thread retries them; guarded by cb_mutex */
+  uint8_t transfer_parked[LIBUVC_NUM_TRANSFER_BUFS];
+  uint8_t transfer_failures[LIBUVC_NUM_TRANSFER_BUFS];
+  struct timespec transfer_retry_at[LIBUVC_NUM_TRANSFER_BUFS];
+  /** Slots with a non-zero failure count, so completions can skip the reset */
+  uint32_t transfer_failing;
+  pthread_t resubmit_thread;
+  pthread_cond_t resubmit_cond;
+  uvc_stream_transfer_stats_t transfer_stats;
   struct uvc_frame frame;
   enum uvc_frame_format frame_format;
   struct timespec capture_time_finished;
@@ -266,6 +335,93 @@ struct uvc_stream_handle {
   /* raw metadata buffer if available */
   uint8_t *meta_outbuf, *meta_holdbuf;
   size_t meta_got_bytes, meta_hold_bytes;
+  /** Capacity of meta_outbuf, meta_holdbuf and frame.metadata, which rotate */
+  size_t meta_buf_size;
+
+  /* status events for this interface; protected by devh->status_mutex */
+  uint32_t status_stream_errors;
+  uint32_t status_button_events;
+  int last_stream_error_code;
+
+  /* sampling: image data is kept for one frame in image_interval (none if
+   * 0, accessed with UVC_ATOMIC_*); the frame being assembled skips its
+   * image if skip_image is set */
+  uint32_t image_interval;
+  uint8_t skip_image, hold_has_image;
+  /* decimation: only one frame in decimate_n, or at most one per
+   * decimate_interval (100ns units), is delivered; both are accessed with
+   * UVC_ATOMIC_*; skip_frame drops the frame being assembled entirely */
+  uint32_t decimate_n;
+  uint32_t decimate_interval;
+  uint64_t decimate_due_ns;
+  uint8_t skip_frame;
+  /* every completed frame, delivered or not; guarded by cb_mutex */
+  uint32_t frames_assembled;
+  /* row layout of the negotiated format, set up at start; row_step is 0 when
+   * the format has no fixed row layout */
+  size_t row_step;
+  uint32_t row_width, row_height;
+  /* row slices of the frame being assembled, reported from the event thread */
+  uvc_slice_callback_t *slice_cb;
+  void *slice_user_ptr;
+  uint32_t slice_rows;
+  uint32_t slice_row;
+  /* region of interest: frames with roi_frame set only assemble its bytes,
+   * packed at roi_step per row; roi_step is 0 when no ROI is in use */
+  uint32_t roi_x, roi_y, roi_w, roi_h;
+  size_t roi_offset, roi_step;
+  size_t roi_got_bytes;
+  uint8_t roi_frame, hold_roi;
+
+  /* method 2 still images, delivered apart from the video frames; the
+   * buffers are sized from the still commit and guarded by still_mutex */
+  uvc_still_ctrl_t still_ctrl;
+  uint16_t still_width, still_height;
+  enum uvc_frame_format still_format;
+  uint8_t *still_outbuf, *still_holdbuf;
+  size_t still_buf_size, still_got_bytes, still_hold_bytes;
+  uint8_t still_fid;
+  uint32_t still_hold_seq, still_last_polled_seq;
+  struct timespec still_capture_time;
+  /** STI payloads that arrived with no still buffer set up */
+  uint32_t still_dropped;
+  /** Method 1: number of upcoming video frames to also deliver as stills;
+   * written under still_mutex, read with UVC_ATOMIC_LOAD at frame starts */
+  uint32_t still_frame_pending;
+  /** Method 1: the frame being assembled started with a still pending */
+  uint8_t frame_is_still;
+  /** Last still the still callback has returned from */
+  uint32_t still_consumed_seq;
+  /** Method 3: transfers pending on the dedicated still endpoint */
+  struct libusb_transfer *still_transfers[LIBUVC_NUM_STILL_XFERS];
+  struct uvc_frame still_frame;
+  uvc_frame_callback_t *still_cb;
+  void *still_user_ptr;
+  pthread_t still_thread;
+  pthread_mutex_t still_mutex;
+  pthread_cond_t still_cond;
+  uint8_t still_thread_running, kill_still_thread;
+
+  /* flags passed to uvc_stream_start, reused when the watchdog restarts it */
+  uint8_t start_flags;
+
+  /* stall watchdog (see watchdog.c); config and stats guarded by wd_mutex */
+  uvc_watchdog_config_t wd_config;
+  uvc_watchdog_stats_t wd_stats;
+  uint8_t wd_enabled, wd_running, wd_kill;
+  pthread_t wd_thread;
+  pthread_mutex_t wd_mutex;
+  pthread_cond_t wd_cond;
+
+  /* transfer recorder (see trace.c); trace_mutex keeps the recorder alive
+   * while the event thread writes to it */
+  struct uvc_trace *trace;
+  pthread_mutex_t trace_mutex;
+  /** Last hold_seq taken by the callback thread; guarded by cb_mutex */
+  uint32_t user_seq;
+  /* recording the stream runs from instead of the device (see
+   * recording.c), from uvc_stream_start_playback() to uvc_stream_stop() */
+  struct uvc_playback *playback;
 };
 
 /** Handle on an open UVC device
@@ -278,11 +434,31 @@ struct uvc_device_handle {
   /** Underlying USB device handle */
   libusb_device_handle *usb_devh;
   struct uvc_device_info *info;
-  struct libusb_transfer *status_xfer;
-  uint8_t status_buf[32];
+  struct libusb_transfer *status_xfers[LIBUVC_NUM_STATUS_XFERS];
+  uint8_t status_bufs[LIBUVC_NUM_STATUS_XFERS][LIBUVC_STATUS_BUF_SIZE];
+  /** Status transfers submitted and not yet given up on by their callback;
+   * protected by status_mutex */
+  int status_xfers_active;
+  /** Set while status_xfers_active is zero, for libusb_handle_events_completed */
+  int status_xfers_idle;
+  /** Single-producer (USB event thread), single-consumer (status thread) ring.
+   * The event thread only advances status_head, the status thread only
+   * advances status_tail. */
+  struct uvc_status_packet status_queue[LIBUVC_STATUS_QUEUE_LEN];
+  unsigned int status_head, status_tail;
+  /** Packets lost because the status thread fell behind */
+  uint32_t status_dropped;
+  pthread_t status_thread;
+  pthread_mutex_t status_mutex;
+  pthread_cond_t status_cond;
+  uint8_t status_thread_running;
+  uint8_t kill_status_thread;
   /** Function to call when we receive status updates from the camera */
   uvc_status_callback_t *status_cb;
   void *status_user_ptr;
+  /** Function to call with every decoded status event */
+  uvc_status_event_callback_t *status_event_cb;
+  void *status_event_user_ptr;
   /** Function to call when we receive button events from the camera */
   uvc_button_callback_t *button_cb;
   void *button_user_ptr;
@@ -303,6 +479,8 @@ struct uvc_context {
   uvc_device_handle_t *open_devices;
   pthread_t handler_thread;
   int kill_handler_thread;
+  /** Memory for streaming buffers, if uvc_set_buffer_arena was called */
+  struct uvc_arena *arena;
 };
 
 uvc_error_t uvc_query_stream_ctrl(
@@ -315,6 +493,33 @@ void uvc_start_handler_thread(uvc_context_t *ctx);
 uvc_error_t uvc_claim_if(uvc_device_handle_t *devh, int idx);
 uvc_error_t uvc_release_if(uvc_device_handle_t *devh, int idx);
 
+uvc_error_t _uvc_stream_start(uvc_stream_handle_t *strmh,
+    uvc_frame_callback_t *cb, void *user_ptr, uint8_t flags);
+uvc_error_t _uvc_stream_stop(uvc_stream_handle_t *strmh);
+uvc_error_t _uvc_stream_prepare(uvc_stream_handle_t *strmh, uint8_t flags);
+void _uvc_stream_reset_counters(uvc_stream_handle_t *strmh);
+void _uvc_size_meta_bufs(uvc_stream_handle_t *strmh, size_t payload_size);
+uvc_error_t _uvc_grow_meta_bufs(uvc_stream_handle_t *strmh, size_t size);
+void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t payload_len);
+void *_uvc_user_caller(void *arg);
+void _uvc_trace_record(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer);
+void _uvc_playback_populate_frame(uvc_stream_handle_t *strmh);
+uvc_error_t _uvc_playback_stop(uvc_stream_handle_t *strmh);
+void _uvc_watchdog_start(uvc_stream_handle_t *strmh);
+void _uvc_watchdog_stop(uvc_stream_handle_t *strmh);
+
+void *_uvc_buf_alloc(uvc_context_t *ctx, size_t size);
+void *_uvc_buf_realloc(uvc_context_t *ctx, void *ptr, size_t size);
+void _uvc_buf_free(uvc_context_t *ctx, void *ptr);
+void _uvc_arena_destroy(uvc_context_t *ctx);
+
+void *_uvc_pool_alloc(size_t bytes, size_t alignment);
+void _uvc_pool_free(void *data);
+size_t _uvc_pool_capacity(void *data);
+size_t _uvc_pool_alignment(void *data);
+uvc_frame_t *_uvc_pool_alloc_frame(void);
+void _uvc_pool_free_frame(uvc_frame_t *frame);
+
 #endif // !def(LIBUVC_INTERNAL_H)
 /** @endcond */
 
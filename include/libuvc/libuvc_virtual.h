@@ -0,0 +1,84 @@
+#ifndef LIBUVC_VIRTUAL_H
+#define LIBUVC_VIRTUAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libuvc/libuvc.h>
+
+/** Transfer type used by the simulated camera's streaming endpoint
+ * @ingroup virtual
+ */
+enum uvc_virtual_transport {
+  /** Isochronous endpoint on altsetting 1 */
+  UVC_VIRTUAL_ISOCHRONOUS = 0,
+  /** Single-altsetting bulk endpoint */
+  UVC_VIRTUAL_BULK = 1,
+};
+
+/** Description of the simulated camera
+ * @ingroup virtual
+ *
+ * The simulated camera exposes one format with one frame size and one frame
+ * rate, so any negotiation for that mode succeeds.
+ */
+typedef struct uvc_virtual_config {
+  /** USB vendor and product IDs */
+  uint16_t vendor_id;
+  uint16_t product_id;
+  /** UVC_FRAME_FORMAT_YUYV, _NV12, _GRAY8 or _MJPEG */
+  enum uvc_frame_format format;
+  uint16_t width;
+  uint16_t height;
+  /** Frames per second */
+  uint32_t fps;
+  enum uvc_virtual_transport transport;
+  /** Bytes per isochronous interval or per bulk payload, header included.
+   * Zero picks a size that suits the mode. Isochronous sizes above 3072
+   * bytes are advertised through a SuperSpeed companion descriptor. */
+  uint32_t payload_size;
+  /** Device clock for PTS and SCR, in Hz */
+  uint32_t clock_frequency;
+  /** Fraction of payloads lost in [0, 1]. A lost isochronous packet
+   * completes with an error status; a lost bulk payload is never delivered. */
+  double loss_rate;
+  /** Seed for the loss pattern and compressed frame sizes */
+  uint32_t seed;
+  /** Produce frames as fast as transfers are submitted, instead of at the
+   * configured frame rate */
+  int unpaced;
+  /** Descriptors of a real camera to present instead of generated ones: a
+   * device descriptor followed by a configuration descriptor, as in a Linux
+   * sysfs "descriptors" file. The device descriptor may be left out. Such a
+   * camera can be opened and probed but doesn't stream. The bytes are
+   * copied; NULL generates descriptors from the fields above. */
+  const uint8_t *descriptors;
+  size_t descriptors_length;
+} uvc_virtual_config_t;
+
+/** Counters kept by the simulated camera
+ * @ingroup virtual
+ */
+typedef struct uvc_virtual_stats {
+  /** Frames whose payloads were all generated */
+  uint64_t frames_sent;
+  /** Payloads generated, lost ones included */
+  uint64_t payloads_sent;
+  /** Payloads dropped by the loss model */
+  uint64_t payloads_lost;
+  /** Image bytes in delivered payloads */
+  uint64_t bytes_sent;
+} uvc_virtual_stats_t;
+
+void uvc_virtual_default_config(uvc_virtual_config_t *config);
+uvc_error_t uvc_virtual_set_config(const uvc_virtual_config_t *config);
+void uvc_virtual_get_stats(uvc_virtual_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !def(LIBUVC_VIRTUAL_H)
@@ -0,0 +1,393 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @ingroup init
+ * @brief Buffer arena for streaming memory
+ *
+ * Transfer and frame buffers can be carved from one region per context,
+ * mapped with 2 MB pages where the system allows it and optionally locked in
+ * RAM, so the streaming path does not suffer TLB misses or page faults.
+ * Allocations the arena cannot satisfy fall back to the heap.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#define LIBUVC_HUGEPAGE_SIZE ( 2 * 1024 * 1024 )
+/* allocations are cache line aligned; each block starts with one line of
+ * header */
+#define LIBUVC_ARENA_ALIGN 64
+
+/** @internal
+ * @brief Header in front of every block, free or allocated
+ */
+struct uvc_arena_block {
+  /** Size of the block, header included */
+  size_t size;
+  /** Next free block by address; only used while the block is free */
+  struct uvc_arena_block *next;
+};
+
+#define BLOCK_DATA(block) ((void *) ((uint8_t *) (block) + LIBUVC_ARENA_ALIGN))
+#define DATA_BLOCK(ptr) ((struct uvc_arena_block *) ((uint8_t *) (ptr) - LIBUVC_ARENA_ALIGN))
+
+struct uvc_arena {
+  uint8_t *base;
+  size_t size;
+  pthread_mutex_t mutex;
+  /** Free blocks in address order */
+  struct uvc_arena_block *free_list;
+  uvc_arena_stats_t stats;
+};
+
+#ifndef _WIN32
+/** @internal
+ * @brief Map the arena's memory
+ *
+ * Tries explicit 2 MB pages first, then a 2 MB aligned mapping advised for
+ * transparent huge pages, then plain pages.
+ */
+static uint8_t *_uvc_arena_map(size_t size, int flags, uint8_t *hugepages) {
+  uint8_t *mem;
+  int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  *hugepages = 0;
+
+#ifdef MAP_POPULATE
+  map_flags |= MAP_POPULATE;
+#endif
+
+#ifdef MAP_HUGETLB
+  if (flags & UVC_ARENA_HUGEPAGES) {
+    int huge_flags = map_flags | MAP_HUGETLB;
+#ifdef MAP_HUGE_2MB
+    huge_flags |= MAP_HUGE_2MB;
+#endif
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, huge_flags, -1, 0);
+    if (mem != MAP_FAILED) {
+      *hugepages = 1;
+      return mem;
+    }
+    UVC_DEBUG("no 2 MB pages available, falling back to THP");
+  }
+#endif
+
+  if (flags & UVC_ARENA_HUGEPAGES) {
+    uint8_t *aligned;
+    size_t head, tail;
+
+    /* over-allocate so the arena can start on a 2 MB boundary */
+    mem = mmap(NULL, size + LIBUVC_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+               map_flags, -1, 0);
+    if (mem == MAP_FAILED)
+      return NULL;
+
+    aligned = (uint8_t *) (((uintptr_t) mem + LIBUVC_HUGEPAGE_SIZE - 1) &
+                           ~((uintptr_t) LIBUVC_HUGEPAGE_SIZE - 1));
+    head = aligned - mem;
+    tail = LIBUVC_HUGEPAGE_SIZE - head;
+    if (head)
+      munmap(mem, head);
+    if (tail)
+      munmap(aligned + size, tail);
+
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+  }
+
+  mem = mmap(NULL, size, PROT_READ | PROT_WRITE, map_flags, -1, 0);
+
+  return mem == MAP_FAILED ? NULL : mem;
+}
+#endif
+
+/** @brief Carve streaming buffers from a dedicated memory arena
+ * @ingroup init
+ *
+ * The streaming buffers of every stream opened in @p ctx afterwards come
+ * from one region of @p size bytes: transfer buffers, the frame assembly
+ * buffers and the delivered frame's image data, which rotate, the metadata
+ * buffers, and the still image buffers. With
+ * UVC_ARENA_HUGEPAGES, the region is mapped with 2 MB pages, or failing that
+ * aligned and advised for transparent huge pages. With UVC_ARENA_MLOCK it is
+ * locked in RAM. Buffers that do not fit fall back to the heap.
+ *
+ * Must be called before any device of the context is opened.
+ *
+ * @param ctx UVC context
+ * @param size Arena size in bytes, rounded up to 2 MB
+ * @param flags Bitwise OR of enum uvc_arena_flags
+ * @return UVC_ERROR_BUSY if the context already has an arena or open devices,
+ *   UVC_ERROR_NOT_SUPPORTED where memory mapping is unavailable,
+ *   UVC_ERROR_NO_MEM if the region could not be mapped, or UVC_ERROR_ACCESS
+ *   if it could not be locked
+ */
+uvc_error_t uvc_set_buffer_arena(uvc_context_t *ctx, size_t size, int flags) {
+#ifdef _WIN32
+  (void) ctx;
+  (void) size;
+  (void) flags;
+  return UVC_ERROR_NOT_SUPPORTED;
+#else
+  struct uvc_arena *arena;
+  struct uvc_arena_block *block;
+  uint8_t hugepages;
+
+  if (ctx->arena || ctx->open_devices)
+    return UVC_ERROR_BUSY;
+
+  if (size == 0)
+    return UVC_ERROR_INVALID_PARAM;
+
+  size = (size + LIBUVC_HUGEPAGE_SIZE - 1) & ~((size_t) LIBUVC_HUGEPAGE_SIZE - 1);
+
+  arena = calloc(1, sizeof(*arena));
+  if (!arena)
+    return UVC_ERROR_NO_MEM;
+
+  arena->base = _uvc_arena_map(size, flags, &hugepages);
+  if (!arena->base) {
+    free(arena);
+    return UVC_ERROR_NO_MEM;
+  }
+
+  if ((flags & UVC_ARENA_MLOCK) && mlock(arena->base, size)) {
+    UVC_DEBUG("mlock failed; check RLIMIT_MEMLOCK");
+    munmap(arena->base, size);
+    free(arena);
+    return UVC_ERROR_ACCESS;
+  }
+
+  arena->size = size;
+  pthread_mutex_init(&arena->mutex, NULL);
+
+  block = (struct uvc_arena_block *) arena->base;
+  block->size = size;
+  block->next = NULL;
+  arena->free_list = block;
+
+  arena->stats.size = size;
+  arena->stats.hugepages = hugepages;
+  arena->stats.locked = (flags & UVC_ARENA_MLOCK) != 0;
+
+  ctx->arena = arena;
+
+  return UVC_SUCCESS;
+#endif
+}
+
+/** @brief Get the usage of a context's buffer arena
+ * @ingroup init
+ *
+ * @param ctx UVC context
+ * @param[out] stats Arena usage
+ * @return UVC_ERROR_NOT_FOUND if the context has no arena
+ */
+uvc_error_t uvc_get_buffer_arena_stats(uvc_context_t *ctx,
+                                       uvc_arena_stats_t *stats) {
+  struct uvc_arena *arena = ctx->arena;
+
+  if (!stats)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (!arena)
+    return UVC_ERROR_NOT_FOUND;
+
+  pthread_mutex_lock(&arena->mutex);
+  *stats = arena->stats;
+  pthread_mutex_unlock(&arena->mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Release a context's arena
+ * @note All buffers carved from it must have been freed
+ */
+void _uvc_arena_destroy(uvc_context_t *ctx) {
+  struct uvc_arena *arena = ctx->arena;
+
+  if (!arena)
+    return;
+
+#ifndef _WIN32
+  if (arena->stats.locked)
+    munlock(arena->base, arena->size);
+  munmap(arena->base, arena->size);
+#endif
+  pthread_mutex_destroy(&arena->mutex);
+  free(arena);
+  ctx->arena = NULL;
+}
+
+static int _uvc_arena_owns(struct uvc_arena *arena, void *ptr) {
+  return arena && (uint8_t *) ptr >= arena->base &&
+         (uint8_t *) ptr < arena->base + arena->size;
+}
+
+/** @internal
+ * @brief First-fit allocation from the arena
+ * @note Must be called with the arena's mutex held
+ */
+static void *_uvc_arena_alloc(struct uvc_arena *arena, size_t size) {
+  struct uvc_arena_block **link, *block;
+  size_t need;
+
+  need = LIBUVC_ARENA_ALIGN +
+         ((size + LIBUVC_ARENA_ALIGN - 1) & ~((size_t) LIBUVC_ARENA_ALIGN - 1));
+
+  for (link = &arena->free_list; *link; link = &(*link)->next) {
+    block = *link;
+    if (block->size < need)
+      continue;
+
+    if (block->size - need >= 2 * LIBUVC_ARENA_ALIGN) {
+      /* split, leaving the remainder on the free list */
+      struct uvc_arena_block *rest =
+          (struct uvc_arena_block *) ((uint8_t *) block + need);
+      rest->size = block->size - need;
+      rest->next = block->next;
+      *link = rest;
+      block->size = need;
+    } else {
+      *link = block->next;
+    }
+
+    arena->stats.used += block->size;
+    if (arena->stats.used > arena->stats.high_water)
+      arena->stats.high_water = arena->stats.used;
+
+    return BLOCK_DATA(block);
+  }
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Return a block to the arena, merging it with free neighbours
+ * @note Must be called with the arena's mutex held
+ */
+static void _uvc_arena_free(struct uvc_arena *arena, void *ptr) {
+  struct uvc_arena_block *block = DATA_BLOCK(ptr);
+  struct uvc_arena_block **link, *prev = NULL;
+
+  arena->stats.used -= block->size;
+
+  for (link = &arena->free_list; *link && *link < block; link = &(*link)->next)
+    prev = *link;
+
+  block->next = *link;
+  *link = block;
+
+  if (block->next &&
+      (uint8_t *) block + block->size == (uint8_t *) block->next) {
+    block->size += block->next->size;
+    block->next = block->next->next;
+  }
+
+  if (prev && (uint8_t *) prev + prev->size == (uint8_t *) block) {
+    prev->size += block->size;
+    prev->next = block->next;
+  }
+}
+
+/** @internal
+ * @brief Allocate a streaming buffer, from the arena if there is one
+ */
+void *_uvc_buf_alloc(uvc_context_t *ctx, size_t size) {
+  struct uvc_arena *arena = ctx->arena;
+  void *ptr = NULL;
+
+  if (arena) {
+    pthread_mutex_lock(&arena->mutex);
+    ptr = _uvc_arena_alloc(arena, size);
+    if (!ptr)
+      arena->stats.fallbacks++;
+    pthread_mutex_unlock(&arena->mutex);
+  }
+
+  return ptr ? ptr : malloc(size);
+}
+
+/** @internal
+ * @brief Resize a buffer from _uvc_buf_alloc, keeping its contents
+ */
+void *_uvc_buf_realloc(uvc_context_t *ctx, void *ptr, size_t size) {
+  struct uvc_arena *arena = ctx->arena;
+  struct uvc_arena_block *block;
+  size_t old_size;
+  void *new_ptr;
+
+  if (!ptr)
+    return _uvc_buf_alloc(ctx, size);
+
+  if (!_uvc_arena_owns(arena, ptr))
+    return realloc(ptr, size);
+
+  block = DATA_BLOCK(ptr);
+  old_size = block->size - LIBUVC_ARENA_ALIGN;
+  if (size <= old_size)
+    return ptr;
+
+  new_ptr = _uvc_buf_alloc(ctx, size);
+  if (!new_ptr)
+    return NULL;
+
+  memcpy(new_ptr, ptr, old_size);
+  _uvc_buf_free(ctx, ptr);
+
+  return new_ptr;
+}
+
+/** @internal
+ * @brief Free a buffer from _uvc_buf_alloc or _uvc_buf_realloc
+ */
+void _uvc_buf_free(uvc_context_t *ctx, void *ptr) {
+  struct uvc_arena *arena = ctx->arena;
+
+  if (!_uvc_arena_owns(arena, ptr)) {
+    free(ptr);
+    return;
+  }
+
+  pthread_mutex_lock(&arena->mutex);
+  _uvc_arena_free(arena, ptr);
+  pthread_mutex_unlock(&arena->mutex);
+}
@@ -0,0 +1,397 @@
+/* Frame conversion benchmark.
+ *
+ * Times the converters in frame.c, MJPEG decoding and uvc_duplicate_frame
+ * on synthetic frames of common sizes, or on a recorded MJPEG frame, and
+ * prints one CSV row per converter and size: time per pixel, throughput
+ * (bytes read plus bytes written) and the spread of per-call times. No
+ * camera is needed.
+ */
+#include "libuvc/libuvc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef LIBUVC_HAS_JPEG
+#include <jpeglib.h>
+#endif
+
+#define MAX_SIZES 16
+
+struct bench_case {
+  const char *name;
+  enum uvc_frame_format in_format;
+  uvc_error_t (*convert)(uvc_frame_t *in, uvc_frame_t *out);
+};
+
+static const struct bench_case cases[] = {
+  { "duplicate_yuyv", UVC_FRAME_FORMAT_YUYV, uvc_duplicate_frame },
+  { "yuyv2rgb", UVC_FRAME_FORMAT_YUYV, uvc_yuyv2rgb },
+  { "yuyv2bgr", UVC_FRAME_FORMAT_YUYV, uvc_yuyv2bgr },
+  { "yuyv2y", UVC_FRAME_FORMAT_YUYV, uvc_yuyv2y },
+  { "yuyv2uv", UVC_FRAME_FORMAT_YUYV, uvc_yuyv2uv },
+  { "uyvy2rgb", UVC_FRAME_FORMAT_UYVY, uvc_uyvy2rgb },
+  { "uyvy2bgr", UVC_FRAME_FORMAT_UYVY, uvc_uyvy2bgr },
+#ifdef LIBUVC_HAS_JPEG
+  { "duplicate_mjpeg", UVC_FRAME_FORMAT_MJPEG, uvc_duplicate_frame },
+  { "mjpeg2rgb", UVC_FRAME_FORMAT_MJPEG, uvc_mjpeg2rgb },
+  { "mjpeg2gray", UVC_FRAME_FORMAT_MJPEG, uvc_mjpeg2gray },
+#endif
+};
+
+struct frame_size {
+  unsigned width;
+  unsigned height;
+};
+
+static const struct frame_size default_sizes[] = {
+  { 640, 480 },
+  { 1280, 720 },
+  { 1920, 1080 },
+  { 3840, 2160 },
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint64_t *sorted, int count, int pct) {
+  return sorted[(size_t) (count - 1) * pct / 100] / 1e3;
+}
+
+/* Picture content: a diagonal gradient with some texture, so that MJPEG
+ * frames compress about as well as a camera's would */
+static uint8_t sample(unsigned x, unsigned y, unsigned channel, uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return (uint8_t) ((x + y + channel * 64) / 8 + (*state & 15));
+}
+
+static uvc_frame_t *make_packed_yuv(enum uvc_frame_format format, unsigned width,
+                                    unsigned height) {
+  uvc_frame_t *frame = uvc_allocate_frame((size_t) width * height * 2);
+  /* Byte order of Y, U and V in each pixel pair */
+  int yuyv = format == UVC_FRAME_FORMAT_YUYV;
+  uint32_t state = 1;
+  unsigned x, y;
+
+  if (!frame)
+    return NULL;
+
+  frame->width = width;
+  frame->height = height;
+  frame->frame_format = format;
+  frame->step = width * 2;
+
+  for (y = 0; y < height; y++) {
+    uint8_t *p = (uint8_t *) frame->data + (size_t) y * frame->step;
+
+    for (x = 0; x < width; x += 2, p += 4) {
+      uint8_t y0 = sample(x, y, 0, &state), y1 = sample(x + 1, y, 0, &state);
+      uint8_t u = sample(x, y, 1, &state), v = sample(x, y, 2, &state);
+
+      p[0] = yuyv ? y0 : u;
+      p[1] = yuyv ? u : y0;
+      p[2] = yuyv ? y1 : v;
+      p[3] = yuyv ? v : y1;
+    }
+  }
+
+  return frame;
+}
+
+#ifdef LIBUVC_HAS_JPEG
+/* Encode a synthetic picture the way webcams do: 4:2:2 chroma, without
+ * restart markers */
+static uvc_frame_t *make_mjpeg(unsigned width, unsigned height) {
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  unsigned char *jpeg = NULL;
+  unsigned long jpeg_bytes = 0;
+  uint8_t *row;
+  uint32_t state = 1;
+  uvc_frame_t *frame;
+  unsigned x;
+
+  row = malloc((size_t) width * 3);
+  if (!row)
+    return NULL;
+
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &jpeg, &jpeg_bytes);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 85, TRUE);
+  cinfo.comp_info[0].h_samp_factor = 2;
+  cinfo.comp_info[0].v_samp_factor = 1;
+  jpeg_start_compress(&cinfo, TRUE);
+
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW rows[1] = { row };
+
+    for (x = 0; x < width * 3; x++)
+      row[x] = sample(x / 3, cinfo.next_scanline, x % 3, &state);
+    jpeg_write_scanlines(&cinfo, rows, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  free(row);
+
+  frame = uvc_allocate_frame(jpeg_bytes);
+  if (frame) {
+    memcpy(frame->data, jpeg, jpeg_bytes);
+    frame->width = width;
+    frame->height = height;
+    frame->frame_format = UVC_FRAME_FORMAT_MJPEG;
+  }
+  free(jpeg);
+  return frame;
+}
+
+/* Load a recorded MJPEG frame, taking its size from the JPEG header */
+static uvc_frame_t *load_mjpeg(const char *path) {
+  struct jpeg_decompress_struct dinfo;
+  struct jpeg_error_mgr jerr;
+  uvc_frame_t *frame = NULL;
+  FILE *f;
+  long size;
+
+  f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return NULL;
+  }
+
+  if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+    frame = uvc_allocate_frame(size);
+    if (frame && fread(frame->data, 1, size, f) != (size_t) size) {
+      uvc_free_frame(frame);
+      frame = NULL;
+    }
+  }
+  fclose(f);
+
+  if (!frame) {
+    fprintf(stderr, "%s: can't read frame\n", path);
+    return NULL;
+  }
+
+  dinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&dinfo);
+  jpeg_mem_src(&dinfo, frame->data, frame->data_bytes);
+  jpeg_read_header(&dinfo, TRUE);
+  frame->width = dinfo.image_width;
+  frame->height = dinfo.image_height;
+  frame->frame_format = UVC_FRAME_FORMAT_MJPEG;
+  jpeg_destroy_decompress(&dinfo);
+
+  return frame;
+}
+#endif
+
+static uvc_frame_t *make_input(enum uvc_frame_format format, unsigned width,
+                               unsigned height) {
+  switch (format) {
+#ifdef LIBUVC_HAS_JPEG
+  case UVC_FRAME_FORMAT_MJPEG:
+    return make_mjpeg(width, height);
+#endif
+  case UVC_FRAME_FORMAT_YUYV:
+  case UVC_FRAME_FORMAT_UYVY:
+    return make_packed_yuv(format, width, height);
+  default:
+    return NULL;
+  }
+}
+
+/* Time one converter on one frame. With a fixed iteration count of zero,
+ * runs for at least min_seconds. */
+static int run_case(const struct bench_case *bc, uvc_frame_t *in, int iterations,
+                    double min_seconds) {
+  uvc_frame_t *out;
+  uint64_t *samples, start, sum = 0;
+  double median_ns;
+  uvc_error_t res;
+  int i;
+
+  out = uvc_allocate_frame(0);
+  if (!out)
+    return -1;
+
+  /* The first call sizes the output buffer and warms the caches */
+  start = now_ns();
+  res = bc->convert(in, out);
+  if (res < 0) {
+    fprintf(stderr, "%s %ux%u: %s\n", bc->name, in->width, in->height, uvc_strerror(res));
+    uvc_free_frame(out);
+    return -1;
+  }
+
+  if (!iterations) {
+    uint64_t first = now_ns() - start;
+    double wanted = min_seconds * 1e9 / (first ? first : 1);
+
+    iterations = wanted < 10 ? 10 : wanted > 100000 ? 100000 : (int) wanted;
+  }
+
+  samples = malloc(sizeof(*samples) * iterations);
+  if (!samples) {
+    uvc_free_frame(out);
+    return -1;
+  }
+
+  for (i = 0; i < iterations; i++) {
+    start = now_ns();
+    bc->convert(in, out);
+    samples[i] = now_ns() - start;
+    sum += samples[i];
+  }
+
+  qsort(samples, iterations, sizeof(*samples), compare_u64);
+  median_ns = samples[(iterations - 1) / 2];
+
+  printf("%s,%u,%u,%zu,%zu,%d,%.4f,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+         bc->name, in->width, in->height, in->data_bytes, out->data_bytes, iterations,
+         median_ns / ((double) in->width * in->height),
+         (in->data_bytes + out->data_bytes) / median_ns,
+         sum / 1e3 / iterations,
+         samples[0] / 1e3,
+         percentile_us(samples, iterations, 50),
+         percentile_us(samples, iterations, 90),
+         percentile_us(samples, iterations, 99),
+         samples[iterations - 1] / 1e3);
+  fflush(stdout);
+
+  free(samples);
+  uvc_free_frame(out);
+  return 0;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-s WIDTHxHEIGHT]... [-c converter] [-n iterations] [-t seconds]\n"
+          "          [-m recorded.jpg] [-l]\n"
+          "  -s  frame size; may be repeated (default 640x480 to 3840x2160)\n"
+          "  -c  only run converters whose name contains this string\n"
+          "  -n  fixed number of timed calls per converter and size\n"
+          "  -t  otherwise, run each for at least this long (default 0.2)\n"
+          "  -m  decode this MJPEG frame instead of synthetic ones\n"
+          "  -l  list the converters\n"
+          "Output is CSV; throughput counts bytes read plus bytes written and,\n"
+          "like ns_per_pixel, is taken from the median call.\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  struct frame_size sizes[MAX_SIZES];
+  int num_sizes = 0, iterations = 0, status = 0, opt;
+  double min_seconds = 0.2;
+  const char *filter = NULL, *recorded_path = NULL;
+  uvc_frame_t *recorded = NULL;
+  size_t c;
+  int s;
+
+  while ((opt = getopt(argc, argv, "s:c:n:t:m:l")) != -1) {
+    switch (opt) {
+    case 's':
+      if (num_sizes == MAX_SIZES ||
+          sscanf(optarg, "%ux%u", &sizes[num_sizes].width, &sizes[num_sizes].height) != 2 ||
+          !sizes[num_sizes].width || !sizes[num_sizes].height ||
+          sizes[num_sizes].width % 2) {
+        fprintf(stderr, "bad frame size %s\n", optarg);
+        return 1;
+      }
+      num_sizes++;
+      break;
+    case 'c':
+      filter = optarg;
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      if (iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 't':
+      min_seconds = atof(optarg);
+      break;
+    case 'm':
+      recorded_path = optarg;
+      break;
+    case 'l':
+      for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        printf("%s\n", cases[c].name);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!num_sizes) {
+    num_sizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+  }
+
+  if (recorded_path) {
+#ifdef LIBUVC_HAS_JPEG
+    recorded = load_mjpeg(recorded_path);
+    if (!recorded)
+      return 1;
+#else
+    fprintf(stderr, "libuvc was built without JPEG support\n");
+    return 1;
+#endif
+  }
+
+  printf("converter,width,height,in_bytes,out_bytes,iterations,ns_per_pixel,gb_per_s,"
+         "mean_us,min_us,p50_us,p90_us,p99_us,max_us\n");
+
+  for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    const struct bench_case *bc = &cases[c];
+
+    if (filter && !strstr(bc->name, filter))
+      continue;
+
+    if (recorded && bc->in_format == UVC_FRAME_FORMAT_MJPEG) {
+      if (run_case(bc, recorded, iterations, min_seconds) < 0)
+        status = 1;
+      continue;
+    }
+
+    for (s = 0; s < num_sizes; s++) {
+      uvc_frame_t *in = make_input(bc->in_format, sizes[s].width, sizes[s].height);
+
+      if (!in) {
+        fprintf(stderr, "%s %ux%u: can't make an input frame\n",
+                bc->name, sizes[s].width, sizes[s].height);
+        status = 1;
+        continue;
+      }
+      if (run_case(bc, in, iterations, min_seconds) < 0)
+        status = 1;
+      uvc_free_frame(in);
+    }
+  }
+
+  if (recorded)
+    uvc_free_frame(recorded);
+
+  return status;
+}
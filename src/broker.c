@@ -0,0 +1,878 @@
+/* Camera broker daemon.
+ *
+ * Opens every camera on the host and shares them with local clients over a
+ * Unix SOCK_SEQPACKET socket, one text command per packet and one reply per
+ * packet ("OK ..." or "ERR ..."):
+ *
+ *   LIST                         cameras, their modes in use and clients
+ *   INFO cam                     the device model, as uvc_print_diag_json()
+ *   MODES cam                    format, width, height and fps of every mode
+ *   STREAM cam fmt w h fps [ow oh]
+ *                                subscribe to frames; the reply carries the
+ *                                descriptor of a shared-memory ring
+ *                                (SCM_RIGHTS) to open with
+ *                                uvc_shm_reader_open_fd()
+ *   RELEASE cam output           unsubscribe
+ *   GET cam unit selector len    GET_CUR of a control, as hex
+ *   SET cam unit selector hex    SET_CUR of a control
+ *
+ * Each camera streams once however many clients it has. A client gets the
+ * camera's own frames, or with ow x oh, frames decoded to RGB once per frame
+ * and scaled down for every distinct size asked for. The first client picks
+ * the mode. Later clients share it if it is at least as large and fast as
+ * they need; otherwise the mode is raised if no client takes the camera's
+ * own frames, which would change under it, and refused if one does.
+ * Subscriptions end when the client releases them or disconnects. If
+ * raising the mode fails and the camera can't go back to the old one, its
+ * rings are closed, which their readers see as UVC_ERROR_NO_DEVICE.
+ *
+ * uvc_virtual_broker serves the simulated camera in virtual_usb.c instead.
+ */
+/* accept4 */
+#define _GNU_SOURCE
+#include "libuvc/libuvc.h"
+#ifdef UVC_BROKER_VIRTUAL
+#include "libuvc/libuvc_virtual.h"
+#endif
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_CAMERAS 16
+#define MAX_OUTPUTS 8
+#define MAX_CLIENTS 64
+#define MAX_SUBSCRIPTIONS 16
+#define RING_SLOTS 8
+#define MAX_PACKET 65536
+
+struct output {
+  int used;
+  /* The camera's own frames, or RGB scaled to width x height */
+  int native;
+  uint32_t width;
+  uint32_t height;
+  uint32_t fps;
+  int refs;
+  uvc_shm_publisher_t *pub;
+  uvc_frame_t *scaled;
+};
+
+struct camera {
+  char name[96];
+  uvc_device_t *dev;
+  uvc_device_handle_t *devh;
+  uvc_stream_handle_t *strmh;
+  enum uvc_frame_format format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t fps;
+  size_t max_frame_size;
+
+  /* Outputs, shared with the stream's callback thread */
+  pthread_mutex_t mutex;
+  struct output outputs[MAX_OUTPUTS];
+  uvc_frame_t *rgb;
+  uint64_t frames;
+  uint64_t failed;
+};
+
+struct subscription {
+  int camera;
+  int output;
+};
+
+struct client {
+  int fd;
+  int num_subs;
+  struct subscription subs[MAX_SUBSCRIPTIONS];
+};
+
+static struct camera cameras[MAX_CAMERAS];
+static int num_cameras;
+static struct client clients[MAX_CLIENTS];
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+  (void) sig;
+  stop_requested = 1;
+}
+
+static const struct {
+  const char *name;
+  enum uvc_frame_format format;
+} format_names[] = {
+  { "any", UVC_FRAME_FORMAT_ANY },
+  { "yuyv", UVC_FRAME_FORMAT_YUYV },
+  { "uyvy", UVC_FRAME_FORMAT_UYVY },
+  { "mjpeg", UVC_FRAME_FORMAT_MJPEG },
+  { "nv12", UVC_FRAME_FORMAT_NV12 },
+  { "gray8", UVC_FRAME_FORMAT_GRAY8 },
+  { "rgb", UVC_FRAME_FORMAT_RGB },
+};
+
+static const char *format_name(enum uvc_frame_format format) {
+  size_t i;
+
+  for (i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++)
+    if (format_names[i].format == format)
+      return format_names[i].name;
+  return "unknown";
+}
+
+static int parse_format(const char *name, enum uvc_frame_format *format) {
+  size_t i;
+
+  for (i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++) {
+    if (!strcmp(format_names[i].name, name)) {
+      *format = format_names[i].format;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* Frame format of a format descriptor, as far as the broker can tell */
+static enum uvc_frame_format descriptor_format(const uvc_format_desc_t *format) {
+  static const struct {
+    char fourcc[4];
+    enum uvc_frame_format format;
+  } fourccs[] = {
+    { { 'Y', 'U', 'Y', '2' }, UVC_FRAME_FORMAT_YUYV },
+    { { 'U', 'Y', 'V', 'Y' }, UVC_FRAME_FORMAT_UYVY },
+    { { 'N', 'V', '1', '2' }, UVC_FRAME_FORMAT_NV12 },
+    { { 'Y', '8', '0', '0' }, UVC_FRAME_FORMAT_GRAY8 },
+  };
+  size_t i;
+
+  if (format->bDescriptorSubtype == UVC_VS_FORMAT_MJPEG)
+    return UVC_FRAME_FORMAT_MJPEG;
+
+  for (i = 0; i < sizeof(fourccs) / sizeof(fourccs[0]); i++)
+    if (!memcmp(format->fourccFormat, fourccs[i].fourcc, 4))
+      return fourccs[i].format;
+
+  return UVC_FRAME_FORMAT_UNKNOWN;
+}
+
+/* Stream callback: hand the frame to every output of the camera */
+static void camera_frame(uvc_frame_t *frame, void *ptr) {
+  struct camera *cam = ptr;
+  int i, decoded = 0;
+
+  pthread_mutex_lock(&cam->mutex);
+  cam->frames++;
+
+  for (i = 0; i < MAX_OUTPUTS; i++) {
+    struct output *out = &cam->outputs[i];
+
+    if (!out->used)
+      continue;
+
+    if (out->native) {
+      uvc_shm_publish(out->pub, frame);
+      continue;
+    }
+
+    /* One decode serves every scaled output */
+    if (!decoded)
+      decoded = uvc_any2rgb(frame, cam->rgb) == UVC_SUCCESS ? 1 : -1;
+    if (decoded < 0) {
+      cam->failed++;
+      break;
+    }
+
+    if (out->width == cam->rgb->width && out->height == cam->rgb->height)
+      uvc_shm_publish(out->pub, cam->rgb);
+    else if (uvc_scale_frame(cam->rgb, out->scaled, out->width, out->height) == UVC_SUCCESS)
+      uvc_shm_publish(out->pub, out->scaled);
+    else
+      cam->failed++;
+  }
+
+  pthread_mutex_unlock(&cam->mutex);
+}
+
+static void stop_camera(struct camera *cam) {
+  if (!cam->strmh)
+    return;
+
+  uvc_stream_close(cam->strmh);
+  cam->strmh = NULL;
+  cam->width = cam->height = cam->fps = 0;
+}
+
+static uvc_error_t start_camera(struct camera *cam, enum uvc_frame_format format,
+                                uint32_t width, uint32_t height, uint32_t fps) {
+  const uvc_format_desc_t *desc;
+  uvc_stream_ctrl_t ctrl;
+  uvc_error_t res;
+
+  res = uvc_get_stream_ctrl_format_size(cam->devh, &ctrl, format, width, height, fps);
+  if (res < 0)
+    return res;
+
+  res = uvc_stream_open_ctrl(cam->devh, &cam->strmh, &ctrl);
+  if (res < 0) {
+    cam->strmh = NULL;
+    return res;
+  }
+
+  cam->format = format;
+  if (format == UVC_FRAME_FORMAT_ANY) {
+    for (desc = uvc_get_format_descs(cam->devh); desc; desc = desc->next)
+      if (desc->bFormatIndex == ctrl.bFormatIndex)
+        cam->format = descriptor_format(desc);
+  }
+  cam->width = width;
+  cam->height = height;
+  cam->fps = fps;
+  cam->max_frame_size = ctrl.dwMaxVideoFrameSize;
+
+  res = uvc_stream_start(cam->strmh, camera_frame, cam, 0);
+  if (res < 0)
+    stop_camera(cam);
+  return res;
+}
+
+static int camera_has_native(struct camera *cam) {
+  int i;
+
+  for (i = 0; i < MAX_OUTPUTS; i++)
+    if (cam->outputs[i].used && cam->outputs[i].native)
+      return 1;
+  return 0;
+}
+
+/* Whether the mode being streamed serves every scaled output, plus a new
+ * need of width x height at fps */
+static int mode_covers(struct camera *cam, uint32_t width, uint32_t height, uint32_t fps) {
+  int i;
+
+  if (width > cam->width || height > cam->height || fps > cam->fps)
+    return 0;
+
+  for (i = 0; i < MAX_OUTPUTS; i++) {
+    const struct output *out = &cam->outputs[i];
+
+    if (out->used && !out->native &&
+        (out->width > cam->width || out->height > cam->height || out->fps > cam->fps))
+      return 0;
+  }
+  return 1;
+}
+
+/* The camera stopped streaming for good: close every ring, so readers see
+ * UVC_ERROR_NO_DEVICE, and forget the subscriptions to it */
+static void close_outputs(struct camera *cam) {
+  int id = cam - cameras;
+  int i, j;
+
+  fprintf(stderr, "camera %d: stream lost, closing its subscriptions\n", id);
+
+  for (i = 0; i < MAX_OUTPUTS; i++) {
+    struct output *out = &cam->outputs[i];
+
+    if (!out->used)
+      continue;
+
+    pthread_mutex_lock(&cam->mutex);
+    out->used = 0;
+    pthread_mutex_unlock(&cam->mutex);
+
+    uvc_shm_publisher_destroy(out->pub);
+    if (out->scaled)
+      uvc_free_frame(out->scaled);
+    memset(out, 0, sizeof(*out));
+  }
+
+  for (i = 0; i < MAX_CLIENTS; i++) {
+    struct client *client = &clients[i];
+
+    for (j = 0; j < client->num_subs;) {
+      if (client->subs[j].camera == id)
+        client->subs[j] = client->subs[--client->num_subs];
+      else
+        j++;
+    }
+  }
+
+  stop_camera(cam);
+}
+
+/* Find or create the output serving a request; returns its index, or a
+ * uvc_error_t with *why saying what went wrong */
+static int subscribe(struct camera *cam, enum uvc_frame_format format, uint32_t width,
+                     uint32_t height, uint32_t fps, uint32_t out_width, uint32_t out_height,
+                     const char **why) {
+  int native = !out_width;
+  int i, free_idx = -1;
+  uvc_error_t res;
+
+  if (!native && (out_width > width || out_height > height)) {
+    *why = "scaled size must not exceed the capture size";
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  if (cam->strmh) {
+    int same = cam->width == width && cam->height == height && cam->fps == fps &&
+      (format == UVC_FRAME_FORMAT_ANY || format == cam->format);
+
+    if (native ? !same : !mode_covers(cam, out_width, out_height, fps)) {
+      uint32_t old_width = cam->width, old_height = cam->height, old_fps = cam->fps;
+      enum uvc_frame_format old_format = cam->format;
+
+      /* Raise the mode, if the clients there are can follow */
+      if (camera_has_native(cam) || width < cam->width || height < cam->height ||
+          fps < cam->fps) {
+        *why = "camera is streaming another mode";
+        return UVC_ERROR_BUSY;
+      }
+
+      stop_camera(cam);
+      res = start_camera(cam, format, width, height, fps);
+      if (res < 0) {
+        *why = uvc_strerror(res);
+        if (start_camera(cam, old_format, old_width, old_height, old_fps) < 0) {
+          close_outputs(cam);
+          *why = "camera failed to stream the new mode and the old one; "
+                 "its subscriptions were closed";
+        }
+        return res;
+      }
+    }
+  } else {
+    res = start_camera(cam, format, width, height, fps);
+    if (res < 0) {
+      *why = uvc_strerror(res);
+      return res;
+    }
+  }
+
+  for (i = 0; i < MAX_OUTPUTS; i++) {
+    struct output *out = &cam->outputs[i];
+
+    if (!out->used) {
+      if (free_idx < 0)
+        free_idx = i;
+      continue;
+    }
+    if (native ? out->native :
+        (!out->native && out->width == out_width && out->height == out_height)) {
+      out->refs++;
+      if (fps > out->fps)
+        out->fps = fps;
+      return i;
+    }
+  }
+
+  if (free_idx < 0) {
+    *why = "too many outputs on this camera";
+    return UVC_ERROR_NO_MEM;
+  }
+
+  {
+    struct output *out = &cam->outputs[free_idx];
+    uvc_shm_publisher_t *pub;
+    uvc_frame_t *scaled = NULL;
+    size_t slot_bytes = native ? cam->max_frame_size : (size_t) out_width * out_height * 3;
+
+    res = uvc_shm_publisher_create(&pub, NULL, RING_SLOTS, slot_bytes);
+    if (res == UVC_SUCCESS && !native && !(scaled = uvc_allocate_frame(slot_bytes))) {
+      uvc_shm_publisher_destroy(pub);
+      res = UVC_ERROR_NO_MEM;
+    }
+    if (res < 0) {
+      *why = uvc_strerror(res);
+      return res;
+    }
+
+    pthread_mutex_lock(&cam->mutex);
+    out->native = native;
+    out->width = native ? cam->width : out_width;
+    out->height = native ? cam->height : out_height;
+    out->fps = fps;
+    out->refs = 1;
+    out->pub = pub;
+    out->scaled = scaled;
+    out->used = 1;
+    pthread_mutex_unlock(&cam->mutex);
+  }
+
+  return free_idx;
+}
+
+static void unsubscribe(struct camera *cam, int idx) {
+  struct output *out = &cam->outputs[idx];
+  int i;
+
+  if (!out->used || --out->refs > 0)
+    return;
+
+  pthread_mutex_lock(&cam->mutex);
+  out->used = 0;
+  pthread_mutex_unlock(&cam->mutex);
+
+  uvc_shm_publisher_destroy(out->pub);
+  if (out->scaled)
+    uvc_free_frame(out->scaled);
+  memset(out, 0, sizeof(*out));
+
+  for (i = 0; i < MAX_OUTPUTS; i++)
+    if (cam->outputs[i].used)
+      return;
+  stop_camera(cam);
+}
+
+static void send_reply(int sock, const char *reply, int fd) {
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct iovec iov;
+  struct msghdr msg;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = (void *) reply;
+  iov.iov_len = strlen(reply);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  if (fd >= 0) {
+    struct cmsghdr *cmsg;
+
+    memset(&control, 0, sizeof(control));
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  sendmsg(sock, &msg, MSG_NOSIGNAL);
+}
+
+static struct camera *lookup_camera(int id, char *reply) {
+  if (id < 0 || id >= num_cameras) {
+    snprintf(reply, MAX_PACKET, "ERR no camera %d\n", id);
+    return NULL;
+  }
+  return &cameras[id];
+}
+
+static void cmd_list(char *reply) {
+  size_t len;
+  int i, j;
+
+  len = snprintf(reply, MAX_PACKET, "OK %d\n", num_cameras);
+  for (i = 0; i < num_cameras && len < MAX_PACKET; i++) {
+    struct camera *cam = &cameras[i];
+    int subscribers = 0;
+
+    for (j = 0; j < MAX_OUTPUTS; j++)
+      if (cam->outputs[j].used)
+        subscribers += cam->outputs[j].refs;
+
+    if (cam->strmh)
+      len += snprintf(reply + len, MAX_PACKET - len, "%d %s %s %ux%u %u clients %d frames %llu\n",
+                      i, cam->name, format_name(cam->format), cam->width, cam->height,
+                      cam->fps, subscribers, (unsigned long long) cam->frames);
+    else
+      len += snprintf(reply + len, MAX_PACKET - len, "%d %s idle\n", i, cam->name);
+  }
+}
+
+static void cmd_modes(struct camera *cam, char *reply) {
+  static char lines[MAX_PACKET - 16];
+  const uvc_format_desc_t *format;
+  const uvc_frame_desc_t *frame;
+  size_t len = 0;
+  int count = 0;
+
+  lines[0] = '\0';
+  for (format = uvc_get_format_descs(cam->devh); format; format = format->next) {
+    const char *name = format_name(descriptor_format(format));
+
+    for (frame = format->frame_descs; frame; frame = frame->next) {
+      const uint32_t *interval;
+
+      if (frame->intervals) {
+        for (interval = frame->intervals; *interval && len < sizeof(lines) - 64; interval++, count++)
+          len += snprintf(lines + len, sizeof(lines) - len, "%s %u %u %u\n", name,
+                          frame->wWidth, frame->wHeight, 10000000 / *interval);
+      } else if (frame->dwMinFrameInterval && len < sizeof(lines) - 64) {
+        len += snprintf(lines + len, sizeof(lines) - len, "%s %u %u %u\n", name,
+                        frame->wWidth, frame->wHeight, 10000000 / frame->dwMinFrameInterval);
+        count++;
+      }
+    }
+  }
+
+  snprintf(reply, MAX_PACKET, "OK %d\n%s", count, lines);
+}
+
+static void cmd_info(struct camera *cam, char *reply) {
+  char *json = NULL;
+  size_t json_len = 0;
+  FILE *stream = open_memstream(&json, &json_len);
+  uvc_error_t res;
+
+  if (!stream) {
+    snprintf(reply, MAX_PACKET, "ERR %s\n", strerror(errno));
+    return;
+  }
+
+  res = uvc_print_diag_json(cam->devh, stream);
+  fclose(stream);
+  if (res < 0)
+    snprintf(reply, MAX_PACKET, "ERR %s\n", uvc_strerror(res));
+  else if (json_len + 4 > MAX_PACKET)
+    snprintf(reply, MAX_PACKET, "ERR device model too large\n");
+  else
+    snprintf(reply, MAX_PACKET, "OK %s", json);
+  free(json);
+}
+
+static void handle_command(struct client *client, char *line) {
+  static char reply[MAX_PACKET];
+  char cmd[16], arg[256];
+  int id, n, fd = -1;
+  struct camera *cam;
+
+  reply[0] = '\0';
+  if (sscanf(line, "%15s %d%n", cmd, &id, &n) < 1) {
+    send_reply(client->fd, "ERR empty command\n", -1);
+    return;
+  }
+
+  if (!strcmp(cmd, "LIST")) {
+    cmd_list(reply);
+  } else if (sscanf(line, "%15s %d", cmd, &id) != 2) {
+    snprintf(reply, sizeof(reply), "ERR usage: %s camera ...\n", cmd);
+  } else if (!(cam = lookup_camera(id, reply))) {
+    /* reply set */
+  } else if (!strcmp(cmd, "INFO")) {
+    cmd_info(cam, reply);
+  } else if (!strcmp(cmd, "MODES")) {
+    cmd_modes(cam, reply);
+  } else if (!strcmp(cmd, "STREAM")) {
+    unsigned width, height, fps, out_width = 0, out_height = 0;
+    enum uvc_frame_format format;
+    const char *why = NULL;
+    int args = sscanf(line + n, "%255s %u %u %u %u %u", arg, &width, &height, &fps,
+                      &out_width, &out_height);
+
+    if ((args != 4 && args != 6) || parse_format(arg, &format) < 0 ||
+        format == UVC_FRAME_FORMAT_RGB || !fps || (args == 6 && (!out_width || !out_height))) {
+      snprintf(reply, sizeof(reply),
+               "ERR usage: STREAM camera any|yuyv|uyvy|mjpeg|nv12|gray8 width height fps "
+               "[scaled_width scaled_height]\n");
+    } else if (client->num_subs == MAX_SUBSCRIPTIONS) {
+      snprintf(reply, sizeof(reply), "ERR too many subscriptions\n");
+    } else {
+      int out = subscribe(cam, format, width, height, fps, out_width, out_height, &why);
+
+      if (out < 0) {
+        if (out == UVC_ERROR_BUSY)
+          snprintf(reply, sizeof(reply), "ERR %s: %s %ux%u %u\n", why,
+                   format_name(cam->format), cam->width, cam->height, cam->fps);
+        else
+          snprintf(reply, sizeof(reply), "ERR %s\n", why);
+      } else {
+        struct output *o = &cam->outputs[out];
+
+        client->subs[client->num_subs].camera = id;
+        client->subs[client->num_subs].output = out;
+        client->num_subs++;
+        fd = uvc_shm_publisher_get_fd(o->pub);
+        snprintf(reply, sizeof(reply), "OK %d %s %u %u %u\n", out,
+                 o->native ? format_name(cam->format) : "rgb", o->width, o->height, cam->fps);
+      }
+    }
+  } else if (!strcmp(cmd, "RELEASE")) {
+    int out, i;
+
+    if (sscanf(line + n, "%d", &out) != 1) {
+      snprintf(reply, sizeof(reply), "ERR usage: RELEASE camera output\n");
+    } else {
+      for (i = 0; i < client->num_subs; i++)
+        if (client->subs[i].camera == id && client->subs[i].output == out)
+          break;
+      if (i == client->num_subs) {
+        snprintf(reply, sizeof(reply), "ERR not subscribed\n");
+      } else {
+        unsubscribe(cam, out);
+        client->subs[i] = client->subs[--client->num_subs];
+        snprintf(reply, sizeof(reply), "OK\n");
+      }
+    }
+  } else if (!strcmp(cmd, "GET")) {
+    unsigned unit, selector, len;
+    uint8_t data[256];
+    int res, i;
+
+    if (sscanf(line + n, "%u %u %u", &unit, &selector, &len) != 3 || !len ||
+        len > sizeof(data)) {
+      snprintf(reply, sizeof(reply), "ERR usage: GET camera unit selector length\n");
+    } else if ((res = uvc_get_ctrl(cam->devh, unit, selector, data, len, UVC_GET_CUR)) < 0) {
+      snprintf(reply, sizeof(reply), "ERR %s\n", uvc_strerror(res));
+    } else {
+      size_t at = snprintf(reply, sizeof(reply), "OK ");
+      for (i = 0; i < res; i++)
+        at += snprintf(reply + at, sizeof(reply) - at, "%02x", data[i]);
+      snprintf(reply + at, sizeof(reply) - at, "\n");
+    }
+  } else if (!strcmp(cmd, "SET")) {
+    unsigned unit, selector, byte;
+    uint8_t data[256];
+    int len = 0, res;
+    const char *hex;
+
+    if (sscanf(line + n, "%u %u %255s", &unit, &selector, arg) != 3) {
+      snprintf(reply, sizeof(reply), "ERR usage: SET camera unit selector hex\n");
+    } else {
+      for (hex = arg; hex[0] && hex[1] && len < (int) sizeof(data) &&
+           sscanf(hex, "%2x", &byte) == 1; hex += 2)
+        data[len++] = byte;
+
+      if (!len || *hex)
+        snprintf(reply, sizeof(reply), "ERR bad hex value\n");
+      else if ((res = uvc_set_ctrl(cam->devh, unit, selector, data, len)) < 0)
+        snprintf(reply, sizeof(reply), "ERR %s\n", uvc_strerror(res));
+      else
+        snprintf(reply, sizeof(reply), "OK\n");
+    }
+  } else {
+    snprintf(reply, sizeof(reply), "ERR unknown command %s\n", cmd);
+  }
+
+  send_reply(client->fd, reply, fd);
+}
+
+static void drop_client(struct client *client) {
+  int i;
+
+  for (i = 0; i < client->num_subs; i++)
+    unsubscribe(&cameras[client->subs[i].camera], client->subs[i].output);
+
+  close(client->fd);
+  memset(client, 0, sizeof(*client));
+  client->fd = -1;
+}
+
+static int open_cameras(uvc_context_t *ctx) {
+  uvc_device_t **list;
+  uvc_error_t res;
+  int i;
+
+  res = uvc_get_device_list(ctx, &list);
+  if (res < 0) {
+    uvc_perror(res, "uvc_get_device_list");
+    return -1;
+  }
+
+  for (i = 0; list[i] && num_cameras < MAX_CAMERAS; i++) {
+    struct camera *cam = &cameras[num_cameras];
+    uvc_device_descriptor_t *desc;
+
+    snprintf(cam->name, sizeof(cam->name), "%03u-%03u", uvc_get_bus_number(list[i]),
+             uvc_get_device_address(list[i]));
+    if (uvc_get_device_descriptor(list[i], &desc) == UVC_SUCCESS) {
+      snprintf(cam->name, sizeof(cam->name), "%03u-%03u %04x:%04x %s",
+               uvc_get_bus_number(list[i]), uvc_get_device_address(list[i]),
+               desc->idVendor, desc->idProduct,
+               desc->serialNumber ? desc->serialNumber : "-");
+      uvc_free_device_descriptor(desc);
+    }
+
+    res = uvc_open(list[i], &cam->devh);
+    if (res < 0) {
+      uvc_perror(res, cam->name);
+      continue;
+    }
+
+    cam->rgb = uvc_allocate_frame(0);
+    pthread_mutex_init(&cam->mutex, NULL);
+    cam->dev = list[i];
+    uvc_ref_device(cam->dev);
+    fprintf(stderr, "camera %d: %s\n", num_cameras, cam->name);
+    num_cameras++;
+  }
+
+  uvc_free_device_list(list, 1);
+  return num_cameras ? 0 : -1;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-s socket_path]"
+#ifdef UVC_BROKER_VIRTUAL
+          " [-f yuyv|mjpeg|nv12|gray8] [-w width] [-h height] [-r fps]"
+#endif
+          "\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  const char *path = "/tmp/uvc_broker.sock";
+  static char packet[MAX_PACKET];
+  struct pollfd fds[MAX_CLIENTS + 1];
+  struct sockaddr_un addr;
+  uvc_context_t *ctx;
+  uvc_error_t res;
+  int listener, opt, i;
+#ifdef UVC_BROKER_VIRTUAL
+  uvc_virtual_config_t config;
+
+  uvc_virtual_default_config(&config);
+#endif
+
+  while ((opt = getopt(argc, argv, "s:f:w:h:r:")) != -1) {
+    switch (opt) {
+    case 's':
+      path = optarg;
+      break;
+#ifdef UVC_BROKER_VIRTUAL
+    case 'f':
+      if (parse_format(optarg, &config.format) < 0 || config.format == UVC_FRAME_FORMAT_ANY) {
+        usage(argv[0]);
+        return 2;
+      }
+      break;
+    case 'w':
+      config.width = atoi(optarg);
+      break;
+    case 'h':
+      config.height = atoi(optarg);
+      break;
+    case 'r':
+      config.fps = atoi(optarg);
+      break;
+#endif
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return 2;
+  }
+
+#ifdef UVC_BROKER_VIRTUAL
+  res = uvc_virtual_set_config(&config);
+  if (res < 0) {
+    uvc_perror(res, "uvc_virtual_set_config");
+    return 2;
+  }
+#endif
+
+  res = uvc_init(&ctx, NULL);
+  if (res < 0) {
+    uvc_perror(res, "uvc_init");
+    return 2;
+  }
+
+  if (open_cameras(ctx) < 0) {
+    fprintf(stderr, "no cameras\n");
+    uvc_exit(ctx);
+    return 2;
+  }
+
+  listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (listener < 0 || bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      chmod(path, 0660) < 0 || listen(listener, 16) < 0) {
+    perror(path);
+    uvc_exit(ctx);
+    return 2;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (i = 0; i < MAX_CLIENTS; i++)
+    clients[i].fd = -1;
+
+  fprintf(stderr, "listening on %s\n", path);
+
+  while (!stop_requested) {
+    int nfds = 1;
+
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    for (i = 0; i < MAX_CLIENTS; i++) {
+      fds[i + 1].fd = clients[i].fd;
+      fds[i + 1].events = POLLIN;
+      fds[i + 1].revents = 0;
+      if (clients[i].fd >= 0)
+        nfds = i + 2;
+    }
+
+    if (poll(fds, nfds, 500) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("poll");
+      break;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+
+      for (i = 0; fd >= 0 && i < MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+          clients[i].fd = fd;
+          break;
+        }
+      }
+      if (fd >= 0 && i == MAX_CLIENTS) {
+        send_reply(fd, "ERR too many clients\n", -1);
+        close(fd);
+      }
+    }
+
+    for (i = 0; i < nfds - 1; i++) {
+      ssize_t len;
+
+      if (clients[i].fd < 0 || !(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+
+      len = recv(clients[i].fd, packet, sizeof(packet) - 1, 0);
+      if (len <= 0) {
+        drop_client(&clients[i]);
+        continue;
+      }
+      packet[len] = '\0';
+      handle_command(&clients[i], packet);
+    }
+  }
+
+  for (i = 0; i < MAX_CLIENTS; i++)
+    if (clients[i].fd >= 0)
+      drop_client(&clients[i]);
+  close(listener);
+  unlink(path);
+
+  for (i = 0; i < num_cameras; i++) {
+    stop_camera(&cameras[i]);
+    uvc_close(cameras[i].devh);
+    uvc_unref_device(cameras[i].dev);
+    uvc_free_frame(cameras[i].rgb);
+    pthread_mutex_destroy(&cameras[i].mutex);
+  }
+  uvc_exit(ctx);
+  return 0;
+}
@@ -0,0 +1,173 @@
+/* Camera broker client.
+ *
+ * Sends one command to uvc_broker and prints the reply. For STREAM, opens
+ * the ring that comes with the reply and reads frames from it for a while,
+ * printing the frame rate and what was dropped or torn:
+ *
+ *   uvc_broker_client LIST
+ *   uvc_broker_client -t 10 STREAM 0 mjpeg 1280 720 30 320 180
+ */
+#include "libuvc/libuvc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PACKET 65536
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Receive one reply, and the descriptor passed with it if any */
+static ssize_t recv_reply(int sock, char *reply, size_t size, int *fd) {
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  struct msghdr msg;
+  ssize_t len;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = reply;
+  iov.iov_len = size - 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  *fd = -1;
+  len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (len < 0)
+    return len;
+  reply[len] = '\0';
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+
+  return len;
+}
+
+static int read_frames(int fd, enum uvc_shm_read_policy policy, double seconds) {
+  uvc_shm_reader_stats_t stats;
+  uvc_shm_reader_t *reader;
+  uvc_shm_frame_t frame;
+  double start, last;
+  uint64_t frames = 0, last_frames = 0;
+  uvc_error_t res;
+
+  res = uvc_shm_reader_open_fd(&reader, fd, policy);
+  if (res < 0) {
+    uvc_perror(res, "uvc_shm_reader_open_fd");
+    return -1;
+  }
+
+  start = last = now();
+  while (now() - start < seconds) {
+    res = uvc_shm_reader_acquire(reader, &frame, 100000);
+    if (res == UVC_ERROR_TIMEOUT)
+      continue;
+    if (res < 0) {
+      uvc_perror(res, "uvc_shm_reader_acquire");
+      break;
+    }
+
+    if (!frames)
+      printf("first frame: %ux%u format %d, %zu bytes\n", frame.width, frame.height,
+             frame.frame_format, frame.data_bytes);
+    if (uvc_shm_reader_release(reader, &frame) == UVC_SUCCESS)
+      frames++;
+
+    if (now() - last >= 1.0) {
+      printf("%.1f fps\n", (frames - last_frames) / (now() - last));
+      last = now();
+      last_frames = frames;
+    }
+  }
+
+  uvc_shm_reader_get_stats(reader, &stats);
+  printf("%llu frames, %llu dropped, %llu torn\n", (unsigned long long) stats.frames,
+         (unsigned long long) stats.dropped, (unsigned long long) stats.torn);
+  uvc_shm_reader_close(reader);
+  return 0;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-s socket_path] [-t seconds] [-l] command [args...]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  const char *path = "/tmp/uvc_broker.sock";
+  enum uvc_shm_read_policy policy = UVC_SHM_READ_ALL;
+  static char packet[MAX_PACKET];
+  struct sockaddr_un addr;
+  double seconds = 5;
+  size_t len = 0;
+  int sock, fd, opt, i;
+
+  while ((opt = getopt(argc, argv, "+s:t:l")) != -1) {
+    switch (opt) {
+    case 's':
+      path = optarg;
+      break;
+    case 't':
+      seconds = atof(optarg);
+      break;
+    case 'l':
+      policy = UVC_SHM_READ_LATEST;
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (optind == argc || strlen(path) >= sizeof(addr.sun_path)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  for (i = optind; i < argc && len < sizeof(packet) - 2; i++)
+    len += snprintf(packet + len, sizeof(packet) - len, "%s%s", i > optind ? " " : "", argv[i]);
+  len += snprintf(packet + len, sizeof(packet) - len, "\n");
+
+  sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if (sock < 0 || connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    perror(path);
+    return 1;
+  }
+
+  if (send(sock, packet, len, MSG_NOSIGNAL) < 0 ||
+      recv_reply(sock, packet, sizeof(packet), &fd) <= 0) {
+    perror("broker");
+    close(sock);
+    return 1;
+  }
+
+  fputs(packet, stdout);
+  if (strncmp(packet, "OK", 2)) {
+    close(sock);
+    return 1;
+  }
+
+  /* The subscription lasts as long as the connection */
+  if (fd >= 0) {
+    read_frames(fd, policy, seconds);
+    close(fd);
+  }
+
+  close(sock);
+  return 0;
+}
@@ -0,0 +1,222 @@
+/* Descriptor parsing benchmark against the simulated camera in virtual_usb.c.
+ *
+ * Presents the raw descriptors of real cameras (see cameras/descriptors) and
+ * repeatedly enumerates, opens and closes each one, negotiating every frame
+ * size it lists in between. Opening runs the full descriptor scan, so its
+ * time and the heap it leaves allocated are what the parser costs. Exits
+ * non-zero if a camera can't be opened or a listed mode can't be negotiated.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_virtual.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+struct timing {
+  uint64_t sum_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t heap_in_use(void) {
+#ifdef HAVE_MALLINFO2
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+static void add_timing(struct timing *t, uint64_t ns) {
+  t->sum_ns += ns;
+  if (!t->min_ns || ns < t->min_ns)
+    t->min_ns = ns;
+  if (ns > t->max_ns)
+    t->max_ns = ns;
+}
+
+static void print_timing(const char *name, const struct timing *t, int count) {
+  printf("  %-10s avg %9.1f us  min %9.1f us  max %9.1f us\n", name,
+         count ? t->sum_ns / 1e3 / count : 0.0, t->min_ns / 1e3, t->max_ns / 1e3);
+}
+
+static uint8_t *read_file(const char *path, size_t *length) {
+  FILE *f = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long size;
+
+  if (!f)
+    return NULL;
+
+  if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+    data = malloc(size);
+    if (data && fread(data, 1, size, f) != (size_t) size) {
+      free(data);
+      data = NULL;
+    }
+    *length = size;
+  }
+
+  fclose(f);
+  return data;
+}
+
+/* Negotiate every frame size the camera lists; returns the number of modes
+ * that failed with anything but "no such mode" */
+static int select_modes(uvc_device_handle_t *devh, int *modes, int *unsupported) {
+  const uvc_format_desc_t *format;
+  const uvc_frame_desc_t *frame;
+  uvc_stream_ctrl_t ctrl;
+  uvc_error_t res;
+  int failed = 0;
+
+  *modes = *unsupported = 0;
+
+  for (format = uvc_get_format_descs(devh); format; format = format->next) {
+    for (frame = format->frame_descs; frame; frame = frame->next) {
+      uint32_t interval = frame->intervals ? frame->intervals[0] : frame->dwMinFrameInterval;
+      int fps = interval ? 10000000 / interval : 0;
+
+      (*modes)++;
+      res = uvc_get_stream_ctrl_format_size(devh, &ctrl, UVC_FRAME_FORMAT_ANY,
+                                            frame->wWidth, frame->wHeight, fps);
+      if (res == UVC_ERROR_INVALID_MODE)
+        (*unsupported)++;
+      else if (res < 0)
+        failed++;
+    }
+  }
+
+  return failed;
+}
+
+static int bench_camera(const char *path, int iterations) {
+  uvc_virtual_config_t config;
+  struct timing t_init = {0}, t_open = {0}, t_select = {0}, t_close = {0};
+  size_t length, heap = 0;
+  uint8_t *data;
+  uvc_error_t res;
+  int i, runs = 0, modes = 0, unsupported = 0, failed = 0;
+
+  data = read_file(path, &length);
+  if (!data) {
+    perror(path);
+    return 1;
+  }
+
+  uvc_virtual_default_config(&config);
+  config.descriptors = data;
+  config.descriptors_length = length;
+  res = uvc_virtual_set_config(&config);
+  free(data);
+  if (res < 0) {
+    uvc_perror(res, path);
+    return 1;
+  }
+
+  for (i = 0; i < iterations; i++) {
+    uvc_context_t *ctx;
+    uvc_device_t *dev;
+    uvc_device_handle_t *devh;
+    uint64_t start, opened, selected;
+    size_t before;
+
+    start = now_ns();
+    res = uvc_init(&ctx, NULL);
+    if (res < 0) {
+      uvc_perror(res, "uvc_init");
+      return 1;
+    }
+    res = uvc_find_device(ctx, &dev, 0, 0, NULL);
+    if (res < 0) {
+      uvc_perror(res, path);
+      uvc_exit(ctx);
+      return 1;
+    }
+    add_timing(&t_init, now_ns() - start);
+
+    before = heap_in_use();
+    start = now_ns();
+    res = uvc_open(dev, &devh);
+    opened = now_ns();
+    if (res < 0) {
+      uvc_perror(res, path);
+      uvc_unref_device(dev);
+      uvc_exit(ctx);
+      return 1;
+    }
+    add_timing(&t_open, opened - start);
+    heap = heap_in_use() - before;
+
+    failed = select_modes(devh, &modes, &unsupported);
+    selected = now_ns();
+    add_timing(&t_select, selected - opened);
+
+    uvc_close(devh);
+    uvc_unref_device(dev);
+    uvc_exit(ctx);
+    add_timing(&t_close, now_ns() - selected);
+    runs++;
+
+    if (failed)
+      break;
+  }
+
+  printf("%s: %zu bytes of descriptors, %d modes (%d without a known format)\n",
+         path, length, modes, unsupported);
+  print_timing("enumerate", &t_init, runs);
+  print_timing("open", &t_open, runs);
+  print_timing("modes", &t_select, runs);
+  print_timing("close", &t_close, runs);
+#ifdef HAVE_MALLINFO2
+  printf("  heap held by the open device: %zu bytes\n", heap);
+#endif
+
+  if (failed) {
+    fprintf(stderr, "%s: %d modes failed to negotiate\n", path, failed);
+    return 1;
+  }
+  return 0;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-n iterations] descriptors...\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  int iterations = 1000, opt, i, status = 0;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind >= argc || iterations <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  for (i = optind; i < argc; i++)
+    status |= bench_camera(argv[i], iterations);
+
+  return status;
+}
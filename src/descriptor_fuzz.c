@@ -0,0 +1,53 @@
+/* libFuzzer harness for descriptor parsing.
+ *
+ * Each input is presented as the raw descriptors of the simulated camera in
+ * virtual_usb.c, which is then enumerated, opened and asked to negotiate
+ * every frame size it lists. Seed it with cameras/descriptors:
+ *
+ *   mkdir corpus && ./uvc_descriptor_fuzz corpus ../cameras/descriptors
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_virtual.h"
+#include <stddef.h>
+#include <stdint.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  uvc_virtual_config_t config;
+  uvc_context_t *ctx;
+  uvc_device_t *dev;
+  uvc_device_handle_t *devh;
+  const uvc_format_desc_t *format;
+  const uvc_frame_desc_t *frame;
+  uvc_stream_ctrl_t ctrl;
+
+  if (!size)
+    return 0;
+
+  uvc_virtual_default_config(&config);
+  config.descriptors = data;
+  config.descriptors_length = size;
+  if (uvc_virtual_set_config(&config) < 0)
+    return 0;
+
+  if (uvc_init(&ctx, NULL) < 0)
+    return 0;
+
+  if (uvc_find_device(ctx, &dev, 0, 0, NULL) == UVC_SUCCESS) {
+    if (uvc_open(dev, &devh) == UVC_SUCCESS) {
+      for (format = uvc_get_format_descs(devh); format; format = format->next) {
+        for (frame = format->frame_descs; frame; frame = frame->next) {
+          uint32_t interval = frame->intervals ? frame->intervals[0] : frame->dwMinFrameInterval;
+
+          uvc_get_stream_ctrl_format_size(devh, &ctrl, UVC_FRAME_FORMAT_ANY,
+                                          frame->wWidth, frame->wHeight,
+                                          interval ? 10000000 / interval : 0);
+        }
+      }
+      uvc_close(devh);
+    }
+    uvc_unref_device(dev);
+  }
+
+  uvc_exit(ctx);
+  return 0;
+}
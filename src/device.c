@@ -95,6 +95,7 @@ uvc_error_t uvc_parse_vs_input_header(uvc_streaming_interface_t *stream_if,
 				      size_t block_size);
 
 void LIBUSB_CALL _uvc_status_callback(struct libusb_transfer *transfer);
+void *_uvc_status_thread(void *arg);
 
 /** @internal
  * @brief Test whether the specified USB device has been opened as a UVC device
@@ -334,6 +335,30 @@ uvc_error_t uvc_open(
   return ret;
 }
 
+/** @internal
+ * @brief Cancel the submitted status transfers and wait for their callbacks
+ *
+ * Handles events itself, as the event thread may not be running yet; if it
+ * is, libusb lets both threads wait for the same completions.
+ */
+static void _uvc_cancel_status_xfers(uvc_device_handle_t *devh) {
+  int i;
+
+  for (i = 0; i < LIBUVC_NUM_STATUS_XFERS; i++) {
+    if (devh->status_xfers[i])
+      libusb_cancel_transfer(devh->status_xfers[i]);
+  }
+
+  for (;;) {
+    pthread_mutex_lock(&devh->status_mutex);
+    i = devh->status_xfers_idle;
+    pthread_mutex_unlock(&devh->status_mutex);
+    if (i)
+      break;
+    libusb_handle_events_completed(devh->dev->ctx->usb_ctx, &devh->status_xfers_idle);
+  }
+}
+
 static uvc_error_t uvc_open_internal(
     uvc_device_t *dev,
     struct libusb_device_handle *usb_devh,
@@ -349,6 +374,9 @@ static uvc_error_t uvc_open_internal(
   internal_devh = calloc(1, sizeof(*internal_devh));
   internal_devh->dev = dev;
   internal_devh->usb_devh = usb_devh;
+  pthread_mutex_init(&internal_devh->status_mutex, NULL);
+  pthread_cond_init(&internal_devh->status_cond, NULL);
+  internal_devh->status_xfers_idle = 1;
 
   ret = uvc_get_device_info(internal_devh, &(internal_devh->info));
 
@@ -364,28 +392,47 @@ static uvc_error_t uvc_open_internal(
   internal_devh->is_isight = (desc.idVendor == 0x05ac && desc.idProduct == 0x8501);
 
   if (internal_devh->info->ctrl_if.bEndpointAddress) {
-    internal_devh->status_xfer = libusb_alloc_transfer(0);
-    if (!internal_devh->status_xfer) {
-      ret = UVC_ERROR_NO_MEM;
-      goto fail;
+    int i;
+
+    /* Keep several interrupt transfers queued so that bursts of status
+     * packets aren't lost while one of them is being resubmitted */
+    for (i = 0; i < LIBUVC_NUM_STATUS_XFERS; i++) {
+      internal_devh->status_xfers[i] = libusb_alloc_transfer(0);
+      if (!internal_devh->status_xfers[i]) {
+        ret = UVC_ERROR_NO_MEM;
+        goto fail;
+      }
+
+      libusb_fill_interrupt_transfer(internal_devh->status_xfers[i],
+                                     usb_devh,
+                                     internal_devh->info->ctrl_if.bEndpointAddress,
+                                     internal_devh->status_bufs[i],
+                                     LIBUVC_STATUS_BUF_SIZE,
+                                     _uvc_status_callback,
+                                     internal_devh,
+                                     0);
+      pthread_mutex_lock(&internal_devh->status_mutex);
+      ret = libusb_submit_transfer(internal_devh->status_xfers[i]);
+      UVC_DEBUG("libusb_submit_transfer() = %d", ret);
+      if (!ret) {
+        internal_devh->status_xfers_active++;
+        internal_devh->status_xfers_idle = 0;
+      }
+      pthread_mutex_unlock(&internal_devh->status_mutex);
+
+      if (ret) {
+        fprintf(stderr,
+                "uvc: device has a status interrupt endpoint, but unable to read from it\n");
+        goto fail;
+      }
     }
 
-    libusb_fill_interrupt_transfer(internal_devh->status_xfer,
-                                   usb_devh,
-                                   internal_devh->info->ctrl_if.bEndpointAddress,
-                                   internal_devh->status_buf,
-                                   sizeof(internal_devh->status_buf),
-                                   _uvc_status_callback,
-                                   internal_devh,
-                                   0);
-    ret = libusb_submit_transfer(internal_devh->status_xfer);
-    UVC_DEBUG("libusb_submit_transfer() = %d", ret);
-
-    if (ret) {
-      fprintf(stderr,
-              "uvc: device has a status interrupt endpoint, but unable to read from it\n");
+    if (pthread_create(&internal_devh->status_thread, NULL,
+                       _uvc_status_thread, (void*) internal_devh)) {
+      ret = UVC_ERROR_OTHER;
       goto fail;
     }
+    internal_devh->status_thread_running = 1;
   }
 
   if (dev->ctx->own_usb_ctx && dev->ctx->open_devices == NULL) {
@@ -401,6 +448,9 @@ static uvc_error_t uvc_open_internal(
   return ret;
 
  fail:
+  /* The transfers already queued must be finished with before they are
+   * freed and the device is closed */
+  _uvc_cancel_status_xfers(internal_devh);
   if ( internal_devh->info ) {
     uvc_release_if(internal_devh, internal_devh->info->ctrl_if.bInterfaceNumber);
   }
@@ -466,6 +516,7 @@ uvc_error_t uvc_get_device_info(uvc_device_handle_t *devh,
 void uvc_free_device_info(uvc_device_info_t *info) {
   uvc_input_terminal_t *input_term, *input_term_tmp;
   uvc_processing_unit_t *proc_unit, *proc_unit_tmp;
+  uvc_selector_unit_t *sel_unit, *sel_unit_tmp;
   uvc_extension_unit_t *ext_unit, *ext_unit_tmp;
 
   uvc_streaming_interface_t *stream_if, *stream_if_tmp;
@@ -486,6 +537,11 @@ void uvc_free_device_info(uvc_device_info_t *info) {
     free(proc_unit);
   }
 
+  DL_FOREACH_SAFE(info->ctrl_if.selector_unit_descs, sel_unit, sel_unit_tmp) {
+    DL_DELETE(info->ctrl_if.selector_unit_descs, sel_unit);
+    free(sel_unit);
+  }
+
   DL_FOREACH_SAFE(info->ctrl_if.extension_unit_descs, ext_unit, ext_unit_tmp) {
     DL_DELETE(info->ctrl_if.extension_unit_descs, ext_unit);
     free(ext_unit);
@@ -975,7 +1031,13 @@ uvc_error_t uvc_claim_if(uvc_device_handle_t *devh, int idx) {
 
   UVC_ENTER();
 
-  if ( devh->claimed & ( 1 << idx )) {
+  /* The claimed interfaces are tracked in a 32-bit mask */
+  if (idx < 0 || idx >= 32) {
+    UVC_EXIT(UVC_ERROR_INVALID_PARAM);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  if ( devh->claimed & ( 1U << idx )) {
     UVC_DEBUG("attempt to claim already-claimed interface %d\n", idx );
     UVC_EXIT(ret);
     return ret;
@@ -988,7 +1050,7 @@ uvc_error_t uvc_claim_if(uvc_device_handle_t *devh, int idx) {
   if (ret == UVC_SUCCESS || ret == LIBUSB_ERROR_NOT_FOUND || ret == LIBUSB_ERROR_NOT_SUPPORTED) {
     UVC_DEBUG("claiming interface %d", idx);
     if (!( ret = libusb_claim_interface(devh->usb_devh, idx))) {
-      devh->claimed |= ( 1 << idx );
+      devh->claimed |= ( 1U << idx );
     }
   } else {
     UVC_DEBUG("not claiming interface %d: unable to detach kernel driver (%s)",
@@ -1011,7 +1073,7 @@ uvc_error_t uvc_release_if(uvc_device_handle_t *devh, int idx) {
 
   UVC_ENTER();
   UVC_DEBUG("releasing interface %d", idx);
-  if (!( devh->claimed & ( 1 << idx ))) {
+  if (idx < 0 || idx >= 32 || !( devh->claimed & ( 1U << idx ))) {
     UVC_DEBUG("attempt to release unclaimed interface %d\n", idx );
     UVC_EXIT(ret);
     return ret;
@@ -1024,7 +1086,7 @@ uvc_error_t uvc_release_if(uvc_device_handle_t *devh, int idx) {
   ret = libusb_release_interface(devh->usb_devh, idx);
 
   if (UVC_SUCCESS == ret) {
-    devh->claimed &= ~( 1 << idx );
+    devh->claimed &= ~( 1U << idx );
     /* Reattach any kernel drivers that were disabled when we claimed this interface */
     ret = libusb_attach_kernel_driver(devh->usb_devh, idx);
 
@@ -1094,6 +1156,9 @@ uvc_error_t uvc_scan_control(uvc_device_handle_t *devh, uvc_device_info_t *info)
 
   while (buffer_left >= 3) { // parseX needs to see buf[0,2] = length,type
     block_size = buffer[0];
+    /* A descriptor can't be shorter than its header or run past the end */
+    if (block_size < 3 || block_size > buffer_left)
+      break;
     parse_ret = uvc_parse_vc(devh->dev, info, buffer, block_size);
 
     if (parse_ret != UVC_SUCCESS) {
@@ -1121,6 +1186,11 @@ uvc_error_t uvc_parse_vc_header(uvc_device_t *dev,
 
   UVC_ENTER();
 
+  if (block_size < 12) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   /*
   int uvc_version;
   uvc_version = (block[4] >> 4) * 1000 + (block[4] & 0x0f) * 100
@@ -1163,12 +1233,12 @@ uvc_error_t uvc_parse_vc_input_terminal(uvc_device_t *dev,
 					uvc_device_info_t *info,
 					const unsigned char *block, size_t block_size) {
   uvc_input_terminal_t *term;
-  size_t i;
+  size_t i, controls_end;
 
   UVC_ENTER();
 
   /* only supporting camera-type input terminals */
-  if (SW_TO_SHORT(&block[4]) != UVC_ITT_CAMERA) {
+  if (block_size < 15 || SW_TO_SHORT(&block[4]) != UVC_ITT_CAMERA) {
     UVC_EXIT(UVC_SUCCESS);
     return UVC_SUCCESS;
   }
@@ -1181,7 +1251,10 @@ uvc_error_t uvc_parse_vc_input_terminal(uvc_device_t *dev,
   term->wObjectiveFocalLengthMax = SW_TO_SHORT(&block[10]);
   term->wOcularFocalLength = SW_TO_SHORT(&block[12]);
 
-  for (i = 14 + block[14]; i >= 15; --i)
+  controls_end = 14 + block[14];
+  if (controls_end >= block_size)
+    controls_end = block_size - 1;
+  for (i = controls_end; i >= 15; --i)
     term->bmControls = block[i] + (term->bmControls << 8);
 
   DL_APPEND(info->ctrl_if.input_term_descs, term);
@@ -1198,15 +1271,23 @@ uvc_error_t uvc_parse_vc_processing_unit(uvc_device_t *dev,
 					 uvc_device_info_t *info,
 					 const unsigned char *block, size_t block_size) {
   uvc_processing_unit_t *unit;
-  size_t i;
+  size_t i, controls_end;
 
   UVC_ENTER();
 
+  if (block_size < 8) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   unit = calloc(1, sizeof(*unit));
   unit->bUnitID = block[3];
   unit->bSourceID = block[4];
 
-  for (i = 7 + block[7]; i >= 8; --i)
+  controls_end = 7 + block[7];
+  if (controls_end >= block_size)
+    controls_end = block_size - 1;
+  for (i = controls_end; i >= 8; --i)
     unit->bmControls = block[i] + (unit->bmControls << 8);
 
   DL_APPEND(info->ctrl_if.processing_unit_descs, unit);
@@ -1226,6 +1307,11 @@ uvc_error_t uvc_parse_vc_selector_unit(uvc_device_t *dev,
 
   UVC_ENTER();
 
+  if (block_size < 4) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   unit = calloc(1, sizeof(*unit));
   unit->bUnitID = block[3];
 
@@ -1242,19 +1328,27 @@ uvc_error_t uvc_parse_vc_selector_unit(uvc_device_t *dev,
 uvc_error_t uvc_parse_vc_extension_unit(uvc_device_t *dev,
 					uvc_device_info_t *info,
 					const unsigned char *block, size_t block_size) {
-  uvc_extension_unit_t *unit = calloc(1, sizeof(*unit));
+  uvc_extension_unit_t *unit;
   const uint8_t *start_of_controls;
   int size_of_controls, num_in_pins;
   int i;
 
   UVC_ENTER();
 
+  if (block_size < 23 || block_size < 23 + (size_t) block[21]) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
+  unit = calloc(1, sizeof(*unit));
   unit->bUnitID = block[3];
   memcpy(unit->guidExtensionCode, &block[4], 16);
 
   num_in_pins = block[21];
   size_of_controls = block[22 + num_in_pins];
   start_of_controls = &block[23 + num_in_pins];
+  if (size_of_controls > (int) block_size - 23 - num_in_pins)
+    size_of_controls = block_size - 23 - num_in_pins;
 
   for (i = size_of_controls - 1; i >= 0; --i)
     unit->bmControls = start_of_controls[i] + (unit->bmControls << 8);
@@ -1328,6 +1422,12 @@ uvc_error_t uvc_scan_streaming(uvc_device_t *dev,
 
   ret = UVC_SUCCESS;
 
+  /* The VideoControl header names the streaming interfaces */
+  if (interface_idx >= info->config->bNumInterfaces) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   if_desc = &(info->config->interface[interface_idx].altsetting[0]);
   buffer = if_desc->extra;
   buffer_left = if_desc->extra_length;
@@ -1339,6 +1439,8 @@ uvc_error_t uvc_scan_streaming(uvc_device_t *dev,
 
   while (buffer_left >= 3) {
     block_size = buffer[0];
+    if (block_size < 3 || block_size > buffer_left)
+      break;
     parse_ret = uvc_parse_vs(dev, info, stream_if, buffer, block_size);
 
     if (parse_ret != UVC_SUCCESS) {
@@ -1363,6 +1465,11 @@ uvc_error_t uvc_parse_vs_input_header(uvc_streaming_interface_t *stream_if,
 				      size_t block_size) {
   UVC_ENTER();
 
+  if (block_size < 10) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   stream_if->bEndpointAddress = block[6] & 0x8f;
   stream_if->bTerminalLink = block[8];
   stream_if->bStillCaptureMethod = block[9];
@@ -1380,6 +1487,11 @@ uvc_error_t uvc_parse_vs_format_uncompressed(uvc_streaming_interface_t *stream_i
 					     size_t block_size) {
   UVC_ENTER();
 
+  if (block_size < 27) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   uvc_format_desc_t *format = calloc(1, sizeof(*format));
 
   format->parent = stream_if;
@@ -1410,6 +1522,11 @@ uvc_error_t uvc_parse_vs_frame_format(uvc_streaming_interface_t *stream_if,
 					     size_t block_size) {
   UVC_ENTER();
 
+  if (block_size < 28) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   uvc_format_desc_t *format = calloc(1, sizeof(*format));
 
   format->parent = stream_if;
@@ -1440,6 +1557,11 @@ uvc_error_t uvc_parse_vs_format_mjpeg(uvc_streaming_interface_t *stream_if,
 					     size_t block_size) {
   UVC_ENTER();
 
+  if (block_size < 11) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   uvc_format_desc_t *format = calloc(1, sizeof(*format));
 
   format->parent = stream_if;
@@ -1471,10 +1593,17 @@ uvc_error_t uvc_parse_vs_frame_frame(uvc_streaming_interface_t *stream_if,
   uvc_frame_desc_t *frame;
 
   const unsigned char *p;
-  int i;
+  int i, num_intervals;
 
   UVC_ENTER();
 
+  /* Frames belong to the format before them */
+  if (block_size < 26 || !stream_if->format_descs ||
+      (block[21] == 0 && block_size < 38)) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   format = stream_if->format_descs->prev;
   frame = calloc(1, sizeof(*frame));
 
@@ -1496,14 +1625,20 @@ uvc_error_t uvc_parse_vs_frame_frame(uvc_streaming_interface_t *stream_if,
     frame->dwMaxFrameInterval = DW_TO_INT(&block[30]);
     frame->dwFrameIntervalStep = DW_TO_INT(&block[34]);
   } else {
-    frame->intervals = calloc(block[21] + 1, sizeof(frame->intervals[0]));
+    /* Only as many intervals as the descriptor holds */
+    num_intervals = block[21];
+    if (num_intervals > (int) (block_size - 26) / 4)
+      num_intervals = (block_size - 26) / 4;
+    frame->bFrameIntervalType = num_intervals;
+
+    frame->intervals = calloc(num_intervals + 1, sizeof(frame->intervals[0]));
     p = &block[26];
 
-    for (i = 0; i < block[21]; ++i) {
+    for (i = 0; i < num_intervals; ++i) {
       frame->intervals[i] = DW_TO_INT(p);
       p += 4;
     }
-    frame->intervals[block[21]] = 0;
+    frame->intervals[num_intervals] = 0;
   }
 
   DL_APPEND(format->frame_descs, frame);
@@ -1523,10 +1658,17 @@ uvc_error_t uvc_parse_vs_frame_uncompressed(uvc_streaming_interface_t *stream_if
   uvc_frame_desc_t *frame;
 
   const unsigned char *p;
-  int i;
+  int i, num_intervals;
 
   UVC_ENTER();
 
+  /* Frames belong to the format before them */
+  if (block_size < 26 || !stream_if->format_descs ||
+      (block[25] == 0 && block_size < 38)) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   format = stream_if->format_descs->prev;
   frame = calloc(1, sizeof(*frame));
 
@@ -1548,14 +1690,20 @@ uvc_error_t uvc_parse_vs_frame_uncompressed(uvc_streaming_interface_t *stream_if
     frame->dwMaxFrameInterval = DW_TO_INT(&block[30]);
     frame->dwFrameIntervalStep = DW_TO_INT(&block[34]);
   } else {
-    frame->intervals = calloc(block[25] + 1, sizeof(frame->intervals[0]));
+    /* Only as many intervals as the descriptor holds */
+    num_intervals = block[25];
+    if (num_intervals > (int) (block_size - 26) / 4)
+      num_intervals = (block_size - 26) / 4;
+    frame->bFrameIntervalType = num_intervals;
+
+    frame->intervals = calloc(num_intervals + 1, sizeof(frame->intervals[0]));
     p = &block[26];
 
-    for (i = 0; i < block[25]; ++i) {
+    for (i = 0; i < num_intervals; ++i) {
       frame->intervals[i] = DW_TO_INT(p);
       p += 4;
     }
-    frame->intervals[block[25]] = 0;
+    frame->intervals[num_intervals] = 0;
   }
 
   DL_APPEND(format->frame_descs, frame);
@@ -1580,6 +1728,13 @@ uvc_error_t uvc_parse_vs_still_image_frame(uvc_streaming_interface_t *stream_if,
 
   UVC_ENTER();
 
+  /* The size patterns and the compression pattern count are mandatory */
+  if (block_size < 6 || block_size < 6 + 4 * (size_t) block[4] ||
+      !stream_if->format_descs) {
+    UVC_EXIT(UVC_SUCCESS);
+    return UVC_SUCCESS;
+  }
+
   format = stream_if->format_descs->prev;
   frame = calloc(1, sizeof(*frame));
 
@@ -1606,6 +1761,8 @@ uvc_error_t uvc_parse_vs_still_image_frame(uvc_streaming_interface_t *stream_if,
 
   p = &block[5+4*numImageSizePatterns];
   frame->bNumCompressionPattern = *p;
+  if (frame->bNumCompressionPattern > block_size - 6 - 4 * numImageSizePatterns)
+    frame->bNumCompressionPattern = block_size - 6 - 4 * numImageSizePatterns;
 
   if(frame->bNumCompressionPattern)
   {
@@ -1697,13 +1854,20 @@ uvc_error_t uvc_parse_vs(
  * @pre Streaming must be stopped, and threads must have died
  */
 void uvc_free_devh(uvc_device_handle_t *devh) {
+  int i;
+
   UVC_ENTER();
 
   if (devh->info)
     uvc_free_device_info(devh->info);
 
-  if (devh->status_xfer)
-    libusb_free_transfer(devh->status_xfer);
+  for (i = 0; i < LIBUVC_NUM_STATUS_XFERS; i++) {
+    if (devh->status_xfers[i])
+      libusb_free_transfer(devh->status_xfers[i]);
+  }
+
+  pthread_cond_destroy(&devh->status_cond);
+  pthread_mutex_destroy(&devh->status_mutex);
 
   free(devh);
 
@@ -1725,6 +1889,18 @@ void uvc_close(uvc_device_handle_t *devh) {
   if (devh->streams)
     uvc_stop_streaming(devh);
 
+  /* The transfers are freed with the handle, so none may still be in flight */
+  _uvc_cancel_status_xfers(devh);
+
+  if (devh->status_thread_running) {
+    pthread_mutex_lock(&devh->status_mutex);
+    devh->kill_status_thread = 1;
+    pthread_cond_broadcast(&devh->status_cond);
+    pthread_mutex_unlock(&devh->status_mutex);
+    pthread_join(devh->status_thread, NULL);
+    devh->status_thread_running = 0;
+  }
+
   uvc_release_if(devh, devh->info->ctrl_if.bInterfaceNumber);
 
   /* If we are managing the libusb context and this is the last open device,
@@ -1766,15 +1942,23 @@ size_t uvc_num_devices(uvc_context_t *ctx) {
   return count;
 }
 
+/** @internal
+ * @brief Hand a decoded status event to the user's event callback
+ */
+static void _uvc_dispatch_status_event(uvc_device_handle_t *devh,
+                                       const uvc_status_event_t *event) {
+  if (devh->status_event_cb) {
+    UVC_DEBUG("Running user-supplied status event callback");
+    devh->status_event_cb(event, devh->status_event_user_ptr);
+  }
+}
+
 void uvc_process_control_status(uvc_device_handle_t *devh, unsigned char *data, int len) {
-  enum uvc_status_class status_class;
-  uint8_t originator = 0, selector = 0, event = 0;
-  enum uvc_status_attribute attribute = UVC_STATUS_ATTRIBUTE_UNKNOWN;
-  void *content = NULL;
-  size_t content_len = 0;
-  int found_entity = 0;
+  uvc_status_event_t event;
   struct uvc_input_terminal *input_terminal;
+  struct uvc_selector_unit *selector_unit;
   struct uvc_processing_unit *processing_unit;
+  struct uvc_extension_unit *extension_unit;
 
   UVC_ENTER();
 
@@ -1784,70 +1968,107 @@ void uvc_process_control_status(uvc_device_handle_t *devh, unsigned char *data,
     return;
   }
 
-  originator = data[1];
-  event = data[2];
-  selector = data[3];
-
-  if (originator == 0) {
-    UVC_DEBUG("Unhandled update from VC interface");
-    UVC_EXIT_VOID();
-    return;  /* @todo VideoControl virtual entity interface updates */
-  }
-
-  if (event != 0) {
-    UVC_DEBUG("Unhandled VC event %d", (int) event);
-    UVC_EXIT_VOID();
-    return;
+  memset(&event, 0, sizeof(event));
+  event.status_class = UVC_STATUS_CLASS_CONTROL;
+  event.originator = data[1];
+  event.event = data[2];
+  event.selector = data[3];
+  event.attribute = data[4];
+  event.stream_error_code = UVC_STREAM_ERROR_NONE;
+  event.data = data + 5;
+  event.data_len = len - 5;
+
+  /* bOriginator 0 is the VideoControl interface itself; anything we can't
+   * match to a unit is reported with the generic control class */
+  if (event.originator != 0) {
+    DL_FOREACH(devh->info->ctrl_if.input_term_descs, input_terminal) {
+      if (input_terminal->bTerminalID == event.originator) {
+        event.status_class = UVC_STATUS_CLASS_CONTROL_CAMERA;
+        break;
+      }
+    }
   }
 
-  /* printf("bSelector: %d\n", selector); */
-
-  DL_FOREACH(devh->info->ctrl_if.input_term_descs, input_terminal) {
-    if (input_terminal->bTerminalID == originator) {
-      status_class = UVC_STATUS_CLASS_CONTROL_CAMERA;
-      found_entity = 1;
-      break;
+  if (event.originator != 0 && event.status_class == UVC_STATUS_CLASS_CONTROL) {
+    DL_FOREACH(devh->info->ctrl_if.processing_unit_descs, processing_unit) {
+      if (processing_unit->bUnitID == event.originator) {
+        event.status_class = UVC_STATUS_CLASS_CONTROL_PROCESSING;
+        break;
+      }
     }
   }
 
-  if (!found_entity) {
-    DL_FOREACH(devh->info->ctrl_if.processing_unit_descs, processing_unit) {
-      if (processing_unit->bUnitID == originator) {
-        status_class = UVC_STATUS_CLASS_CONTROL_PROCESSING;
-        found_entity = 1;
+  if (event.originator != 0 && event.status_class == UVC_STATUS_CLASS_CONTROL) {
+    DL_FOREACH(devh->info->ctrl_if.selector_unit_descs, selector_unit) {
+      if (selector_unit->bUnitID == event.originator) {
+        event.status_class = UVC_STATUS_CLASS_CONTROL_SELECTOR;
         break;
       }
     }
   }
 
-  if (!found_entity) {
-    UVC_DEBUG("Got status update for unknown VideoControl entity %d",
-  (int) originator);
-    UVC_EXIT_VOID();
-    return;
+  if (event.originator != 0 && event.status_class == UVC_STATUS_CLASS_CONTROL) {
+    DL_FOREACH(devh->info->ctrl_if.extension_unit_descs, extension_unit) {
+      if (extension_unit->bUnitID == event.originator) {
+        event.status_class = UVC_STATUS_CLASS_CONTROL_EXTENSION;
+        break;
+      }
+    }
   }
 
-  attribute = data[4];
-  content = data + 5;
-  content_len = len - 5;
+  UVC_DEBUG("Event: class=%d, originator=%d, event=%d, selector=%d, attribute=%d, content_len=%zd",
+    event.status_class, event.originator, event.event, event.selector,
+    event.attribute, event.data_len);
 
-  UVC_DEBUG("Event: class=%d, event=%d, selector=%d, attribute=%d, content_len=%zd",
-    status_class, event, selector, attribute, content_len);
+  _uvc_dispatch_status_event(devh, &event);
 
-  if(devh->status_cb) {
+  /* The legacy callback only ever saw control changes on camera terminals
+   * and processing units */
+  if (devh->status_cb && event.event == 0 &&
+      (event.status_class == UVC_STATUS_CLASS_CONTROL_CAMERA ||
+       event.status_class == UVC_STATUS_CLASS_CONTROL_PROCESSING)) {
     UVC_DEBUG("Running user-supplied status callback");
-    devh->status_cb(status_class,
-                    event,
-                    selector,
-                    attribute,
-                    content, content_len,
+    devh->status_cb(event.status_class,
+                    event.event,
+                    event.selector,
+                    event.attribute,
+                    (void *) event.data, event.data_len,
                     devh->status_user_ptr);
   }
   
   UVC_EXIT_VOID();
 }
 
+/** @internal
+ * @brief Read VS_STREAM_ERROR_CODE_CONTROL after a stream error event
+ *
+ * Runs on the status thread, so the control transfer never blocks the USB
+ * event thread that is delivering video.
+ */
+static int _uvc_query_stream_error_code(uvc_device_handle_t *devh,
+                                        uint8_t interface_number) {
+  uint8_t code;
+  int ret;
+
+  ret = libusb_control_transfer(
+      devh->usb_devh,
+      0xA1,
+      UVC_GET_CUR,
+      UVC_VS_STREAM_ERROR_CODE_CONTROL << 8,
+      interface_number,
+      &code, 1, 0);
+
+  if (ret != 1) {
+    UVC_DEBUG("VS_STREAM_ERROR_CODE_CONTROL query failed: %d", ret);
+    return UVC_STREAM_ERROR_UNKNOWN;
+  }
+
+  return code;
+}
+
 void uvc_process_streaming_status(uvc_device_handle_t *devh, unsigned char *data, int len) {
+  uvc_status_event_t event;
+  uvc_stream_handle_t *strmh;
   
   UVC_ENTER();
 
@@ -1857,40 +2078,68 @@ void uvc_process_streaming_status(uvc_device_handle_t *devh, unsigned char *data
     return;
   }
 
-  if (data[2] == 0) {
+  memset(&event, 0, sizeof(event));
+  event.originator = data[1];
+  event.event = data[2];
+  event.attribute = UVC_STATUS_ATTRIBUTE_UNKNOWN;
+  event.stream_error_code = UVC_STREAM_ERROR_NONE;
+  event.data = data + 3;
+  event.data_len = len - 3;
+
+  if (event.event == 0) {
     if (len < 4) {
       UVC_DEBUG("Short read of status update (%d bytes)", len);
       UVC_EXIT_VOID();
       return;
     }
     UVC_DEBUG("Button (intf %u) %s len %d\n", data[1], data[3] ? "pressed" : "released", len);
-    
-    if(devh->button_cb) {
-      UVC_DEBUG("Running user-supplied button callback");
-      devh->button_cb(data[1],
-                      data[3],
-                      devh->button_user_ptr);
-    }
+
+    event.status_class = UVC_STATUS_CLASS_STREAMING_BUTTON;
+    event.button_state = data[3];
   } else {
-    UVC_DEBUG("Stream %u error event %02x %02x len %d.\n", data[1], data[2], data[3], len);
+    UVC_DEBUG("Stream %u error event %02x len %d.\n", data[1], data[2], len);
+
+    event.status_class = UVC_STATUS_CLASS_STREAMING_ERROR;
+    event.stream_error_code = _uvc_query_stream_error_code(devh, event.originator);
+  }
+
+  pthread_mutex_lock(&devh->status_mutex);
+  DL_FOREACH(devh->streams, strmh) {
+    if (strmh->stream_if->bInterfaceNumber == event.originator) {
+      if (event.status_class == UVC_STATUS_CLASS_STREAMING_BUTTON) {
+        strmh->status_button_events++;
+      } else {
+        strmh->status_stream_errors++;
+        strmh->last_stream_error_code = event.stream_error_code;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&devh->status_mutex);
+
+  _uvc_dispatch_status_event(devh, &event);
+
+  if (event.status_class == UVC_STATUS_CLASS_STREAMING_BUTTON && devh->button_cb) {
+    UVC_DEBUG("Running user-supplied button callback");
+    devh->button_cb(data[1],
+                    data[3],
+                    devh->button_user_ptr);
   }
 
   UVC_EXIT_VOID();
 }
 
-void uvc_process_status_xfer(uvc_device_handle_t *devh, struct libusb_transfer *transfer) {
+void uvc_process_status_packet(uvc_device_handle_t *devh, uint8_t *data, int len) {
   
   UVC_ENTER();
 
-  /* printf("Got transfer of aLen = %d\n", transfer->actual_length); */
-
-  if (transfer->actual_length > 0) {
-    switch (transfer->buffer[0] & 0x0f) {
+  if (len > 0) {
+    switch (data[0] & 0x0f) {
     case 1: /* VideoControl interface */
-      uvc_process_control_status(devh, transfer->buffer, transfer->actual_length);
+      uvc_process_control_status(devh, data, len);
       break;
     case 2:  /* VideoStreaming interface */
-      uvc_process_streaming_status(devh, transfer->buffer, transfer->actual_length);
+      uvc_process_streaming_status(devh, data, len);
       break;
     }
   }
@@ -1898,6 +2147,81 @@ void uvc_process_status_xfer(uvc_device_handle_t *devh, struct libusb_transfer *
   UVC_EXIT_VOID();
 }
 
+/** @internal
+ * @brief Queue a completed status packet for the status thread
+ *
+ * Runs on the USB event thread, which is the only producer; the ring indices
+ * are published with release stores so no lock is needed on this path. The
+ * mutex is only taken briefly to wake the status thread.
+ */
+static void _uvc_queue_status_packet(uvc_device_handle_t *devh,
+                                     struct libusb_transfer *transfer) {
+  unsigned int head = devh->status_head;
+  struct uvc_status_packet *pkt;
+  int len;
+
+  if (head - UVC_ATOMIC_LOAD(&devh->status_tail) >= LIBUVC_STATUS_QUEUE_LEN) {
+    devh->status_dropped++;
+    UVC_DEBUG("status queue full, dropped %u packets", devh->status_dropped);
+    return;
+  }
+
+  len = transfer->actual_length;
+  if (len > LIBUVC_STATUS_BUF_SIZE)
+    len = LIBUVC_STATUS_BUF_SIZE;
+
+  pkt = &devh->status_queue[head & (LIBUVC_STATUS_QUEUE_LEN - 1)];
+  memcpy(pkt->data, transfer->buffer, len);
+  pkt->len = len;
+
+  UVC_ATOMIC_STORE(&devh->status_head, head + 1);
+
+  pthread_mutex_lock(&devh->status_mutex);
+  pthread_cond_signal(&devh->status_cond);
+  pthread_mutex_unlock(&devh->status_mutex);
+}
+
+/** @internal
+ * @brief Delivers queued status packets to the user's callbacks
+ *
+ * Keeps slow status/button callbacks off the USB event thread.
+ */
+void *_uvc_status_thread(void *arg) {
+  uvc_device_handle_t *devh = (uvc_device_handle_t *) arg;
+  unsigned int tail = devh->status_tail;
+
+  for (;;) {
+    struct uvc_status_packet *pkt;
+
+    pthread_mutex_lock(&devh->status_mutex);
+    while (!devh->kill_status_thread &&
+           UVC_ATOMIC_LOAD(&devh->status_head) == tail)
+      pthread_cond_wait(&devh->status_cond, &devh->status_mutex);
+    pthread_mutex_unlock(&devh->status_mutex);
+
+    if (devh->kill_status_thread)
+      break;
+
+    pkt = &devh->status_queue[tail & (LIBUVC_STATUS_QUEUE_LEN - 1)];
+    uvc_process_status_packet(devh, pkt->data, pkt->len);
+
+    tail++;
+    UVC_ATOMIC_STORE(&devh->status_tail, tail);
+  }
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Note that a status transfer won't be resubmitted
+ */
+static void _uvc_status_xfer_finished(uvc_device_handle_t *devh) {
+  pthread_mutex_lock(&devh->status_mutex);
+  if (--devh->status_xfers_active == 0)
+    devh->status_xfers_idle = 1;
+  pthread_mutex_unlock(&devh->status_mutex);
+}
+
 /** @internal
  * @brief Process asynchronous status updates from the device.
  */
@@ -1905,16 +2229,19 @@ void LIBUSB_CALL _uvc_status_callback(struct libusb_transfer *transfer) {
   UVC_ENTER();
 
   uvc_device_handle_t *devh = (uvc_device_handle_t *) transfer->user_data;
+  int ret;
 
   switch (transfer->status) {
   case LIBUSB_TRANSFER_ERROR:
   case LIBUSB_TRANSFER_CANCELLED:
   case LIBUSB_TRANSFER_NO_DEVICE:
     UVC_DEBUG("not processing/resubmitting, status = %d", transfer->status);
+    _uvc_status_xfer_finished(devh);
     UVC_EXIT_VOID();
     return;
   case LIBUSB_TRANSFER_COMPLETED:
-    uvc_process_status_xfer(devh, transfer);
+    if (transfer->actual_length > 0)
+      _uvc_queue_status_packet(devh, transfer);
     break;
   case LIBUSB_TRANSFER_TIMED_OUT:
   case LIBUSB_TRANSFER_STALL:
@@ -1923,11 +2250,10 @@ void LIBUSB_CALL _uvc_status_callback(struct libusb_transfer *transfer) {
     break;
   }
 
-#ifdef UVC_DEBUGGING
-  uvc_error_t ret =
-#endif
-      libusb_submit_transfer(transfer);
+  ret = libusb_submit_transfer(transfer);
   UVC_DEBUG("libusb_submit_transfer() = %d", ret);
+  if (ret)
+    _uvc_status_xfer_finished(devh);
 
   UVC_EXIT_VOID();
 }
@@ -1947,6 +2273,26 @@ void uvc_set_status_callback(uvc_device_handle_t *devh,
   UVC_EXIT_VOID();
 }
 
+/** @brief Set a callback function to receive every decoded status event
+ *
+ * Unlike the status and button callbacks, this also reports VideoControl
+ * interface updates, non-zero events and stream errors. For stream errors
+ * the device's VS_STREAM_ERROR_CODE_CONTROL has already been read. The
+ * callback runs on the device's status thread.
+ *
+ * @ingroup device
+ */
+void uvc_set_status_event_callback(uvc_device_handle_t *devh,
+                                   uvc_status_event_callback_t cb,
+                                   void *user_ptr) {
+  UVC_ENTER();
+
+  devh->status_event_cb = cb;
+  devh->status_event_user_ptr = user_ptr;
+
+  UVC_EXIT_VOID();
+}
+
 /** @brief Set a callback function to receive button events
  *
  * @ingroup device
@@ -1970,6 +2316,6 @@ void uvc_set_button_callback(uvc_device_handle_t *devh,
  * @param devh Device handle to an open UVC device
  */
 const uvc_format_desc_t *uvc_get_format_descs(uvc_device_handle_t *devh) {
-  return devh->info->stream_ifs->format_descs;
+  return devh->info->stream_ifs ? devh->info->stream_ifs->format_descs : NULL;
 }
 
@@ -374,3 +374,423 @@ void uvc_print_frameformats(uvc_device_handle_t *devh) {
     printf("uvc_print_frameformats: Device not configured!\n");
   }
 }
+
+/** @internal
+ * A control advertised in a bmControls bitmap. Standard controls have the
+ * lengths the spec gives them; extension unit controls report their own.
+ */
+typedef struct _uvc_diag_ctrl {
+  uint8_t unit;
+  uint8_t selector;
+  uint8_t info;
+  uint16_t len;
+  int res;
+  uint8_t cur[64];
+} _uvc_diag_ctrl_t;
+
+typedef struct _uvc_std_ctrl {
+  uint8_t selector;
+  uint8_t len;
+} _uvc_std_ctrl_t;
+
+/* Camera terminal controls by bmControls bit (UVC 1.5: 3.7.2.3) */
+static const _uvc_std_ctrl_t _uvc_ct_ctrls[] = {
+  { UVC_CT_SCANNING_MODE_CONTROL, 1 },
+  { UVC_CT_AE_MODE_CONTROL, 1 },
+  { UVC_CT_AE_PRIORITY_CONTROL, 1 },
+  { UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, 4 },
+  { UVC_CT_EXPOSURE_TIME_RELATIVE_CONTROL, 1 },
+  { UVC_CT_FOCUS_ABSOLUTE_CONTROL, 2 },
+  { UVC_CT_FOCUS_RELATIVE_CONTROL, 2 },
+  { UVC_CT_IRIS_ABSOLUTE_CONTROL, 2 },
+  { UVC_CT_IRIS_RELATIVE_CONTROL, 1 },
+  { UVC_CT_ZOOM_ABSOLUTE_CONTROL, 2 },
+  { UVC_CT_ZOOM_RELATIVE_CONTROL, 3 },
+  { UVC_CT_PANTILT_ABSOLUTE_CONTROL, 8 },
+  { UVC_CT_PANTILT_RELATIVE_CONTROL, 4 },
+  { UVC_CT_ROLL_ABSOLUTE_CONTROL, 2 },
+  { UVC_CT_ROLL_RELATIVE_CONTROL, 2 },
+  { 0, 0 },
+  { 0, 0 },
+  { UVC_CT_FOCUS_AUTO_CONTROL, 1 },
+  { UVC_CT_PRIVACY_CONTROL, 1 },
+  { UVC_CT_FOCUS_SIMPLE_CONTROL, 1 },
+  { UVC_CT_DIGITAL_WINDOW_CONTROL, 12 },
+  { UVC_CT_REGION_OF_INTEREST_CONTROL, 10 },
+};
+
+/* Processing unit controls by bmControls bit (UVC 1.5: 3.7.2.5) */
+static const _uvc_std_ctrl_t _uvc_pu_ctrls[] = {
+  { UVC_PU_BRIGHTNESS_CONTROL, 2 },
+  { UVC_PU_CONTRAST_CONTROL, 2 },
+  { UVC_PU_HUE_CONTROL, 2 },
+  { UVC_PU_SATURATION_CONTROL, 2 },
+  { UVC_PU_SHARPNESS_CONTROL, 2 },
+  { UVC_PU_GAMMA_CONTROL, 2 },
+  { UVC_PU_WHITE_BALANCE_TEMPERATURE_CONTROL, 2 },
+  { UVC_PU_WHITE_BALANCE_COMPONENT_CONTROL, 4 },
+  { UVC_PU_BACKLIGHT_COMPENSATION_CONTROL, 2 },
+  { UVC_PU_GAIN_CONTROL, 2 },
+  { UVC_PU_POWER_LINE_FREQUENCY_CONTROL, 1 },
+  { UVC_PU_HUE_AUTO_CONTROL, 1 },
+  { UVC_PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL, 1 },
+  { UVC_PU_WHITE_BALANCE_COMPONENT_AUTO_CONTROL, 1 },
+  { UVC_PU_DIGITAL_MULTIPLIER_CONTROL, 2 },
+  { UVC_PU_DIGITAL_MULTIPLIER_LIMIT_CONTROL, 2 },
+  { UVC_PU_ANALOG_VIDEO_STANDARD_CONTROL, 1 },
+  { UVC_PU_ANALOG_LOCK_STATUS_CONTROL, 1 },
+  { UVC_PU_CONTRAST_AUTO_CONTROL, 1 },
+};
+
+#define _UVC_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/** @internal
+ * @brief Append the controls set in a bmControls bitmap to the list
+ *
+ * @param std Standard controls by bit, or NULL for an extension unit
+ */
+static uvc_error_t _uvc_diag_add_ctrls(_uvc_diag_ctrl_t **ctrls, int *count, uint8_t unit,
+                                       uint64_t bmControls, const _uvc_std_ctrl_t *std,
+                                       size_t num_std) {
+  int bit;
+
+  for (bit = 0; bit < 64; ++bit) {
+    _uvc_diag_ctrl_t *ctrl, *grown;
+
+    if (!(bmControls & (1ULL << bit)))
+      continue;
+    if (std && (bit >= (int) num_std || !std[bit].selector))
+      continue;
+
+    grown = realloc(*ctrls, (*count + 1) * sizeof(**ctrls));
+    if (!grown)
+      return UVC_ERROR_NO_MEM;
+    *ctrls = grown;
+
+    ctrl = &(*ctrls)[(*count)++];
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->unit = unit;
+    ctrl->selector = std ? std[bit].selector : bit + 1;
+    ctrl->len = std ? std[bit].len : 0;
+  }
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Read the capabilities and current value of a control
+ */
+static void _uvc_diag_read_ctrl(uvc_device_handle_t *devh, _uvc_diag_ctrl_t *ctrl) {
+  int ret;
+
+  ret = uvc_get_ctrl(devh, ctrl->unit, ctrl->selector, &ctrl->info, 1, UVC_GET_INFO);
+  if (ret < 0) {
+    ctrl->res = ret;
+    return;
+  }
+
+  if (!ctrl->len) {
+    ret = uvc_get_ctrl_len(devh, ctrl->unit, ctrl->selector);
+    if (ret < 0) {
+      ctrl->res = ret;
+      return;
+    }
+    ctrl->len = ret;
+  }
+
+  /* Write-only controls, and controls too large to summarize */
+  if (!(ctrl->info & UVC_CONTROL_CAP_GET) || ctrl->len > sizeof(ctrl->cur))
+    return;
+
+  ret = uvc_get_ctrl(devh, ctrl->unit, ctrl->selector, ctrl->cur, ctrl->len, UVC_GET_CUR);
+  ctrl->res = ret < 0 ? ret : UVC_SUCCESS;
+  if (ret >= 0)
+    ctrl->len = ret;
+}
+
+/** @internal
+ * @brief Write a JSON string, escaping as needed; null for NULL
+ */
+static void _uvc_json_string(FILE *stream, const char *str) {
+  if (!str) {
+    fputs("null", stream);
+    return;
+  }
+
+  fputc('"', stream);
+  for (; *str; ++str) {
+    unsigned char c = *str;
+
+    if (c == '"' || c == '\\')
+      fprintf(stream, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(stream, "\\u%04x", c);
+    else
+      fputc(c, stream);
+  }
+  fputc('"', stream);
+}
+
+static void _uvc_json_hex(FILE *stream, const uint8_t *data, size_t len) {
+  size_t i;
+
+  fputc('"', stream);
+  for (i = 0; i < len; ++i)
+    fprintf(stream, "%02x", data[i]);
+  fputc('"', stream);
+}
+
+/** @internal
+ * @brief Write the controls of one terminal or unit as a JSON array
+ */
+static void _uvc_json_ctrls(FILE *stream, const _uvc_diag_ctrl_t *ctrls, int count,
+                            uint8_t unit) {
+  int i, first = 1;
+
+  fputs("\"controls\":[", stream);
+  for (i = 0; i < count; ++i) {
+    const _uvc_diag_ctrl_t *ctrl = &ctrls[i];
+
+    if (ctrl->unit != unit)
+      continue;
+
+    fprintf(stream, "%s{\"selector\":%u,", first ? "" : ",", ctrl->selector);
+    first = 0;
+
+    if (ctrl->res < 0) {
+      fputs("\"error\":", stream);
+      _uvc_json_string(stream, uvc_strerror(ctrl->res));
+      fputc('}', stream);
+      continue;
+    }
+
+    fprintf(stream, "\"info\":%u,\"len\":%u,\"cur\":", ctrl->info, ctrl->len);
+    if ((ctrl->info & UVC_CONTROL_CAP_GET) && ctrl->len <= sizeof(ctrl->cur))
+      _uvc_json_hex(stream, ctrl->cur, ctrl->len);
+    else
+      fputs("null", stream);
+    fputc('}', stream);
+  }
+  fputc(']', stream);
+}
+
+static void _uvc_json_format(FILE *stream, const uvc_format_desc_t *fmt_desc) {
+  uvc_frame_desc_t *frame_desc;
+  uvc_still_frame_desc_t *still_frame_desc;
+  int first_frame = 1, first_still = 1;
+
+  fprintf(stream, "{\"bFormatIndex\":%u,\"bDescriptorSubtype\":%u,\"type\":",
+          fmt_desc->bFormatIndex, fmt_desc->bDescriptorSubtype);
+  _uvc_json_string(stream, _uvc_name_for_format_subtype(fmt_desc->bDescriptorSubtype));
+  fputs(",\"guidFormat\":", stream);
+  _uvc_json_hex(stream, fmt_desc->guidFormat, 16);
+  fprintf(stream,
+          ",\"bBitsPerPixel\":%u,\"bDefaultFrameIndex\":%u,"
+          "\"bAspectRatioX\":%u,\"bAspectRatioY\":%u,"
+          "\"bmInterlaceFlags\":%u,\"bCopyProtect\":%u,\"frames\":[",
+          fmt_desc->bBitsPerPixel, fmt_desc->bDefaultFrameIndex,
+          fmt_desc->bAspectRatioX, fmt_desc->bAspectRatioY,
+          fmt_desc->bmInterlaceFlags, fmt_desc->bCopyProtect);
+
+  DL_FOREACH(fmt_desc->frame_descs, frame_desc) {
+    fprintf(stream,
+            "%s{\"bFrameIndex\":%u,\"bmCapabilities\":%u,\"wWidth\":%u,\"wHeight\":%u,"
+            "\"dwMinBitRate\":%u,\"dwMaxBitRate\":%u,\"dwMaxVideoFrameBufferSize\":%u,"
+            "\"dwDefaultFrameInterval\":%u,",
+            first_frame ? "" : ",",
+            frame_desc->bFrameIndex, frame_desc->bmCapabilities,
+            frame_desc->wWidth, frame_desc->wHeight,
+            frame_desc->dwMinBitRate, frame_desc->dwMaxBitRate,
+            frame_desc->dwMaxVideoFrameBufferSize,
+            frame_desc->dwDefaultFrameInterval);
+    first_frame = 0;
+
+    if (frame_desc->intervals) {
+      uint32_t *interval_ptr;
+
+      fputs("\"intervals\":[", stream);
+      for (interval_ptr = frame_desc->intervals; *interval_ptr; ++interval_ptr)
+        fprintf(stream, "%s%u", interval_ptr == frame_desc->intervals ? "" : ",",
+                *interval_ptr);
+      fputs("]}", stream);
+    } else {
+      fprintf(stream,
+              "\"dwMinFrameInterval\":%u,\"dwMaxFrameInterval\":%u,"
+              "\"dwFrameIntervalStep\":%u}",
+              frame_desc->dwMinFrameInterval, frame_desc->dwMaxFrameInterval,
+              frame_desc->dwFrameIntervalStep);
+    }
+  }
+
+  fputs("],\"stills\":[", stream);
+  DL_FOREACH(fmt_desc->still_frame_desc, still_frame_desc) {
+    uvc_still_frame_res_t *imageSizePattern;
+    int first_size = 1, i;
+
+    fprintf(stream, "%s{\"bEndpointAddress\":%u,\"sizes\":[",
+            first_still ? "" : ",", still_frame_desc->bEndPointAddress);
+    first_still = 0;
+
+    DL_FOREACH(still_frame_desc->imageSizePatterns, imageSizePattern) {
+      fprintf(stream, "%s{\"wWidth\":%u,\"wHeight\":%u}", first_size ? "" : ",",
+              imageSizePattern->wWidth, imageSizePattern->wHeight);
+      first_size = 0;
+    }
+
+    fputs("],\"bCompression\":[", stream);
+    for (i = 0; i < still_frame_desc->bNumCompressionPattern; ++i)
+      fprintf(stream, "%s%u", i ? "," : "", still_frame_desc->bCompression[i]);
+    fputs("]}", stream);
+  }
+
+  fputs("]}", stream);
+}
+
+/** @brief Write the device model as one line of JSON.
+ * @ingroup diag
+ *
+ * Covers the device descriptor, the camera terminals, processing, selector
+ * and extension units with their bmControls, every format, frame, interval
+ * and still image size, and the capabilities (GET_INFO) and current value
+ * (GET_CUR, as hex bytes) of each control the device advertises. Controls
+ * are all read before anything is written, so a slow or stalling device
+ * doesn't leave a partial document behind; a control that fails to read
+ * gets an "error" in place of its value.
+ *
+ * Intended for inventory tools; uvc_print_diag() gives the same model for
+ * people.
+ *
+ * @param devh UVC device
+ * @param stream Output stream (stdout if NULL)
+ * @return UVC_ERROR_INVALID_DEVICE if the device isn't configured,
+ * UVC_ERROR_NO_MEM if the controls couldn't be gathered
+ */
+uvc_error_t uvc_print_diag_json(uvc_device_handle_t *devh, FILE *stream) {
+  uvc_control_interface_t *ctrl_if = &devh->info->ctrl_if;
+  uvc_input_terminal_t *term;
+  uvc_processing_unit_t *pu;
+  uvc_selector_unit_t *su;
+  uvc_extension_unit_t *xu;
+  uvc_streaming_interface_t *stream_if;
+  uvc_device_descriptor_t *desc = NULL;
+  _uvc_diag_ctrl_t *ctrls = NULL;
+  int num_ctrls = 0, i, first;
+  uvc_error_t ret = UVC_SUCCESS;
+
+  if (stream == NULL)
+    stream = stdout;
+
+  if (!ctrl_if->bcdUVC)
+    return UVC_ERROR_INVALID_DEVICE;
+
+  /* Gather every control first */
+  DL_FOREACH(ctrl_if->input_term_descs, term) {
+    ret = _uvc_diag_add_ctrls(&ctrls, &num_ctrls, term->bTerminalID, term->bmControls,
+                              _uvc_ct_ctrls, _UVC_ARRAY_SIZE(_uvc_ct_ctrls));
+    if (ret != UVC_SUCCESS)
+      goto fail;
+  }
+  DL_FOREACH(ctrl_if->processing_unit_descs, pu) {
+    ret = _uvc_diag_add_ctrls(&ctrls, &num_ctrls, pu->bUnitID, pu->bmControls,
+                              _uvc_pu_ctrls, _UVC_ARRAY_SIZE(_uvc_pu_ctrls));
+    if (ret != UVC_SUCCESS)
+      goto fail;
+  }
+  DL_FOREACH(ctrl_if->extension_unit_descs, xu) {
+    ret = _uvc_diag_add_ctrls(&ctrls, &num_ctrls, xu->bUnitID, xu->bmControls, NULL, 0);
+    if (ret != UVC_SUCCESS)
+      goto fail;
+  }
+
+  for (i = 0; i < num_ctrls; ++i)
+    _uvc_diag_read_ctrl(devh, &ctrls[i]);
+
+  uvc_get_device_descriptor(devh->dev, &desc);
+
+  fputs("{\"device\":{", stream);
+  if (desc) {
+    fprintf(stream, "\"idVendor\":%u,\"idProduct\":%u,\"serialNumber\":",
+            desc->idVendor, desc->idProduct);
+    _uvc_json_string(stream, desc->serialNumber);
+    fputs(",\"manufacturer\":", stream);
+    _uvc_json_string(stream, desc->manufacturer);
+    fputs(",\"product\":", stream);
+    _uvc_json_string(stream, desc->product);
+    fputc(',', stream);
+    uvc_free_device_descriptor(desc);
+  }
+  fprintf(stream, "\"bus\":%u,\"address\":%u,\"bcdUVC\":%u,\"dwClockFrequency\":%u,"
+          "\"streaming\":%s},",
+          uvc_get_bus_number(devh->dev), uvc_get_device_address(devh->dev),
+          ctrl_if->bcdUVC, ctrl_if->dwClockFrequency, devh->streams ? "true" : "false");
+
+  fputs("\"terminals\":[", stream);
+  first = 1;
+  DL_FOREACH(ctrl_if->input_term_descs, term) {
+    fprintf(stream,
+            "%s{\"bTerminalID\":%u,\"wTerminalType\":%u,"
+            "\"wObjectiveFocalLengthMin\":%u,\"wObjectiveFocalLengthMax\":%u,"
+            "\"wOcularFocalLength\":%u,\"bmControls\":%llu,",
+            first ? "" : ",", term->bTerminalID, term->wTerminalType,
+            term->wObjectiveFocalLengthMin, term->wObjectiveFocalLengthMax,
+            term->wOcularFocalLength, (unsigned long long) term->bmControls);
+    _uvc_json_ctrls(stream, ctrls, num_ctrls, term->bTerminalID);
+    fputc('}', stream);
+    first = 0;
+  }
+
+  fputs("],\"processing_units\":[", stream);
+  first = 1;
+  DL_FOREACH(ctrl_if->processing_unit_descs, pu) {
+    fprintf(stream, "%s{\"bUnitID\":%u,\"bSourceID\":%u,\"bmControls\":%llu,",
+            first ? "" : ",", pu->bUnitID, pu->bSourceID,
+            (unsigned long long) pu->bmControls);
+    _uvc_json_ctrls(stream, ctrls, num_ctrls, pu->bUnitID);
+    fputc('}', stream);
+    first = 0;
+  }
+
+  fputs("],\"selector_units\":[", stream);
+  first = 1;
+  DL_FOREACH(ctrl_if->selector_unit_descs, su) {
+    fprintf(stream, "%s{\"bUnitID\":%u}", first ? "" : ",", su->bUnitID);
+    first = 0;
+  }
+
+  fputs("],\"extension_units\":[", stream);
+  first = 1;
+  DL_FOREACH(ctrl_if->extension_unit_descs, xu) {
+    fprintf(stream, "%s{\"bUnitID\":%u,\"guidExtensionCode\":",
+            first ? "" : ",", xu->bUnitID);
+    _uvc_json_hex(stream, xu->guidExtensionCode, 16);
+    fprintf(stream, ",\"bmControls\":%llu,", (unsigned long long) xu->bmControls);
+    _uvc_json_ctrls(stream, ctrls, num_ctrls, xu->bUnitID);
+    fputc('}', stream);
+    first = 0;
+  }
+
+  fputs("],\"streaming_interfaces\":[", stream);
+  first = 1;
+  DL_FOREACH(devh->info->stream_ifs, stream_if) {
+    uvc_format_desc_t *fmt_desc;
+    int first_format = 1;
+
+    fprintf(stream, "%s{\"bInterfaceNumber\":%u,\"bEndpointAddress\":%u,\"formats\":[",
+            first ? "" : ",", stream_if->bInterfaceNumber, stream_if->bEndpointAddress);
+    first = 0;
+
+    DL_FOREACH(stream_if->format_descs, fmt_desc) {
+      if (!first_format)
+        fputc(',', stream);
+      _uvc_json_format(stream, fmt_desc);
+      first_format = 0;
+    }
+    fputs("]}", stream);
+  }
+
+  fputs("]}\n", stream);
+
+fail:
+  free(ctrls);
+  return ret;
+}
@@ -191,6 +191,8 @@ uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   return uvc_mjpeg_convert(in, out);
@@ -216,6 +218,8 @@ uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   return uvc_mjpeg_convert(in, out);
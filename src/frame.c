@@ -38,15 +38,32 @@
 #include "libuvc/libuvc.h"
 #include "libuvc/libuvc_internal.h"
 
-/** @internal */
+/** @internal
+ * Library-owned frame data comes from the frame buffer pool. A buffer that is
+ * already big enough is kept, even if the frame shrinks.
+ */
 uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes) {
   if (frame->library_owns_data) {
-    if (!frame->data || frame->data_bytes != need_bytes) {
+    if (frame->data_pooled && frame->data &&
+        _uvc_pool_capacity(frame->data) >= need_bytes) {
+      frame->data_bytes = need_bytes;
+      return UVC_SUCCESS;
+    }
+    if (!frame->data || frame->data_pooled || frame->data_bytes != need_bytes) {
+      size_t alignment = frame->data_pooled && frame->data ?
+                         _uvc_pool_alignment(frame->data) : 0;
+      void *data = _uvc_pool_alloc(need_bytes, alignment);
+
+      if (!data)
+        return UVC_ERROR_NO_MEM;
+      if (frame->data_pooled)
+        _uvc_pool_free(frame->data);
+      else
+        free(frame->data);
+      frame->data = data;
+      frame->data_pooled = 1;
       frame->data_bytes = need_bytes;
-      frame->data = realloc(frame->data, frame->data_bytes);
     }
-    if (!frame->data)
-      return UVC_ERROR_NO_MEM;
     return UVC_SUCCESS;
   } else {
     if (!frame->data || frame->data_bytes < need_bytes)
@@ -62,23 +79,39 @@ uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes) {
  * @return New frame, or NULL on error
  */
 uvc_frame_t *uvc_allocate_frame(size_t data_bytes) {
-  uvc_frame_t *frame = malloc(sizeof(*frame));
+  return uvc_allocate_frame_aligned(data_bytes, 0);
+}
 
-  if (!frame)
+/** @brief Allocate a frame structure with aligned data
+ * @ingroup frame
+ *
+ * The frame and its data come from the frame buffer pool.
+ *
+ * @param data_bytes Number of bytes to allocate, or zero
+ * @param alignment Alignment of the data, a power of two; 0 for the default
+ * @return New frame, or NULL on error
+ */
+uvc_frame_t *uvc_allocate_frame_aligned(size_t data_bytes, size_t alignment) {
+  uvc_frame_t *frame;
+
+  if (alignment & (alignment - 1))
     return NULL;
 
-  memset(frame, 0, sizeof(*frame));
+  frame = _uvc_pool_alloc_frame();
+  if (!frame)
+    return NULL;
 
   frame->library_owns_data = 1;
 
   if (data_bytes > 0) {
     frame->data_bytes = data_bytes;
-    frame->data = malloc(data_bytes);
+    frame->data = _uvc_pool_alloc(data_bytes, alignment);
 
     if (!frame->data) {
-      free(frame);
+      _uvc_pool_free_frame(frame);
       return NULL;
     }
+    frame->data_pooled = 1;
   }
 
   return frame;
@@ -87,18 +120,163 @@ uvc_frame_t *uvc_allocate_frame(size_t data_bytes) {
 /** @brief Free a frame structure
  * @ingroup frame
  *
+ * Pooled data and the structure itself go back to the frame buffer pool.
+ *
  * @param frame Frame to destroy
  */
 void uvc_free_frame(uvc_frame_t *frame) {
   if (frame->library_owns_data)
   {
-    if (frame->data_bytes > 0)
+    if (frame->data_pooled)
+      _uvc_pool_free(frame->data);
+    else if (frame->data_bytes > 0)
       free(frame->data);
     if (frame->metadata_bytes > 0)
       free(frame->metadata);
   }
 
-  free(frame);
+  _uvc_pool_free_frame(frame);
+}
+
+/** Size of KSCAMERA_METADATA_ITEMHEADER: MetadataId and Size, both 32-bit */
+#define UVC_METADATA_ITEM_HEADER_SIZE 8
+
+#define QW_TO_LONG(p) ((uint64_t) DW_TO_INT(p) | ((uint64_t) DW_TO_INT((p) + 4) << 32))
+
+/** @brief Step through the metadata items of a frame
+ * @ingroup frame
+ *
+ * Parses the Microsoft UVC 1.5 metadata layout, a sequence of
+ * KSCAMERA_METADATA_ITEMHEADER records, that the device sends in the
+ * payload headers. Nothing is copied: @p item points into the frame.
+ *
+ * @param frame Frame with metadata
+ * @param[in,out] offset Position in the metadata; start at 0
+ * @param[out] item Next item
+ * @return UVC_ERROR_NOT_FOUND after the last item, UVC_ERROR_INVALID_MODE
+ *   on a malformed item
+ */
+uvc_error_t uvc_frame_next_metadata_item(const uvc_frame_t *frame,
+    size_t *offset, uvc_metadata_item_t *item) {
+  const uint8_t *p;
+  size_t left;
+  uint32_t size;
+
+  if (!frame->metadata || *offset >= frame->metadata_bytes)
+    return UVC_ERROR_NOT_FOUND;
+
+  p = (const uint8_t *) frame->metadata + *offset;
+  left = frame->metadata_bytes - *offset;
+
+  if (left < UVC_METADATA_ITEM_HEADER_SIZE)
+    return UVC_ERROR_INVALID_MODE;
+
+  size = DW_TO_INT(p + 4);
+  if (size < UVC_METADATA_ITEM_HEADER_SIZE || size > left)
+    return UVC_ERROR_INVALID_MODE;
+
+  item->id = DW_TO_INT(p);
+  item->data = p + UVC_METADATA_ITEM_HEADER_SIZE;
+  item->data_len = size - UVC_METADATA_ITEM_HEADER_SIZE;
+
+  *offset += size;
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Find the first metadata item with a given ID
+ * @ingroup frame
+ *
+ * @param frame Frame with metadata
+ * @param id uvc_metadata_id or custom item ID
+ * @param[out] item View of the item
+ */
+uvc_error_t uvc_frame_find_metadata_item(const uvc_frame_t *frame,
+    uint32_t id, uvc_metadata_item_t *item) {
+  size_t offset = 0;
+  uvc_error_t ret;
+
+  while ((ret = uvc_frame_next_metadata_item(frame, &offset, item)) == UVC_SUCCESS) {
+    if (item->id == id)
+      return UVC_SUCCESS;
+  }
+
+  return ret;
+}
+
+/** @brief Decode the frame's UVC_METADATA_ID_USB_VIDEO_HEADER item
+ * @ingroup frame
+ */
+uvc_error_t uvc_frame_get_video_header(const uvc_frame_t *frame,
+    uvc_metadata_video_header_t *header) {
+  uvc_metadata_item_t item;
+  uvc_error_t ret;
+  size_t offset = 2;
+
+  ret = uvc_frame_find_metadata_item(frame, UVC_METADATA_ID_USB_VIDEO_HEADER, &item);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  /* bHeaderLength, bmHeaderInfo[, dwPresentationTime][, scrSourceClock] */
+  if (item.data_len < 2)
+    return UVC_ERROR_INVALID_MODE;
+
+  memset(header, 0, sizeof(*header));
+  header->header_info = item.data[1];
+
+  if (header->header_info & (1 << 2)) {
+    if (item.data_len < offset + 4)
+      return UVC_ERROR_INVALID_MODE;
+    header->pts = DW_TO_INT(item.data + offset);
+    offset += 4;
+  }
+
+  if (header->header_info & (1 << 3)) {
+    if (item.data_len < offset + 6)
+      return UVC_ERROR_INVALID_MODE;
+    header->scr_stc = DW_TO_INT(item.data + offset);
+    header->scr_sof = SW_TO_SHORT(item.data + offset + 4);
+  }
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Decode the frame's UVC_METADATA_ID_CAPTURE_STATS item
+ * @ingroup frame
+ *
+ * Only the fields named in @p stats->flags are meaningful.
+ */
+uvc_error_t uvc_frame_get_capture_stats(const uvc_frame_t *frame,
+    uvc_metadata_capture_stats_t *stats) {
+  uvc_metadata_item_t item;
+  uvc_error_t ret;
+  const uint8_t *p;
+
+  ret = uvc_frame_find_metadata_item(frame, UVC_METADATA_ID_CAPTURE_STATS, &item);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  /* KSCAMERA_METADATA_CAPTURESTATS without its item header */
+  if (item.data_len < 72)
+    return UVC_ERROR_INVALID_MODE;
+
+  p = item.data;
+  stats->flags = DW_TO_INT(p);
+  /* p + 4: Reserved */
+  stats->exposure_time = QW_TO_LONG(p + 8);
+  stats->exposure_compensation_flags = QW_TO_LONG(p + 16);
+  stats->exposure_compensation_value = (int32_t) DW_TO_INT(p + 24);
+  stats->iso_speed = DW_TO_INT(p + 28);
+  stats->focus_state = DW_TO_INT(p + 32);
+  stats->lens_position = DW_TO_INT(p + 36);
+  stats->white_balance = DW_TO_INT(p + 40);
+  stats->flash = DW_TO_INT(p + 44);
+  stats->flash_power = DW_TO_INT(p + 48);
+  stats->zoom_factor = DW_TO_INT(p + 52);
+  stats->scene_mode = QW_TO_LONG(p + 56);
+  stats->sensor_framerate = QW_TO_LONG(p + 64);
+
+  return UVC_SUCCESS;
 }
 
 static inline unsigned char sat(int i) {
@@ -122,6 +300,8 @@ uvc_error_t uvc_duplicate_frame(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   memcpy(out->data, in->data, in->data_bytes);
@@ -185,6 +365,8 @@ uvc_error_t uvc_yuyv2rgb(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -236,6 +418,8 @@ uvc_error_t uvc_yuyv2bgr(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -276,6 +460,8 @@ uvc_error_t uvc_yuyv2y(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -316,6 +502,8 @@ uvc_error_t uvc_yuyv2uv(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -366,6 +554,8 @@ uvc_error_t uvc_uyvy2rgb(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -416,6 +606,8 @@ uvc_error_t uvc_uyvy2bgr(uvc_frame_t *in, uvc_frame_t *out) {
   out->sequence = in->sequence;
   out->capture_time = in->capture_time;
   out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
   out->source = in->source;
 
   uint8_t *pyuv = in->data;
@@ -0,0 +1,507 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @ingroup frame
+ * @brief Recycling allocator for frame buffers
+ *
+ * Frame data handed out by uvc_allocate_frame and grown by the conversion
+ * functions comes from slabs keyed by size (rounded up to a page) and
+ * alignment. Freed buffers go to a small per-thread cache first, then to a
+ * bounded free list of their slab, so a stream that allocates and frees a
+ * frame per callback stops touching the heap once the pool has warmed up.
+ * A thread served from its own cache takes no lock. Frame structures are
+ * recycled through the slabs' lock.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+/* buffer sizes are rounded up to this, so frames of one mode share a slab */
+#define LIBUVC_FRAME_POOL_GRANULE 4096
+#define LIBUVC_FRAME_POOL_MAX_SLABS 16
+/* free buffers each slab keeps unless prewarmed with more */
+#define LIBUVC_FRAME_POOL_SLAB_DEPTH 8
+#define LIBUVC_FRAME_POOL_TLS_SLOTS 4
+/* bytes a thread's cache may hold; larger frames go to the shared slabs */
+#define LIBUVC_FRAME_POOL_TLS_MAX_BYTES (32 * 1024 * 1024)
+#define LIBUVC_FRAME_POOL_MAX_FRAMES 32
+
+/** @internal
+ * @brief Kept just below the data of every pooled buffer
+ */
+struct uvc_pool_header {
+  void *base;
+  size_t capacity;
+  size_t alignment;
+};
+
+/** @internal Free buffers of one size and alignment */
+struct uvc_pool_slab {
+  size_t capacity;
+  size_t alignment;
+  void **free;
+  unsigned int num_free;
+  unsigned int depth;
+};
+
+/** @internal Buffers cached by one thread
+ *
+ * Only the owning thread touches the slots. The counters are also read by
+ * uvc_frame_pool_get_stats without synchronization, which is fine for
+ * statistics.
+ */
+struct uvc_pool_tls {
+  /* list of every thread's cache, guarded by pool_mutex */
+  struct uvc_pool_tls *prev, *next;
+  void *slots[LIBUVC_FRAME_POOL_TLS_SLOTS];
+  volatile uint64_t hits;
+  volatile uint32_t cached_buffers;
+  volatile size_t cached_bytes;
+  /* pool_trim_gen as of the last time the cache was emptied for a trim */
+  unsigned int trim_gen;
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct uvc_pool_slab pool_slabs[LIBUVC_FRAME_POOL_MAX_SLABS];
+static unsigned int pool_num_slabs;
+static uvc_frame_t *pool_frames[LIBUVC_FRAME_POOL_MAX_FRAMES];
+static unsigned int pool_num_frames;
+/* the shared slabs' counters, and hits of caches whose threads have exited */
+static uvc_frame_pool_stats_t pool_stats;
+static pthread_once_t pool_tls_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_tls_key;
+static struct uvc_pool_tls *pool_tls_list;
+/* bumped by uvc_frame_pool_trim so that every thread empties its cache */
+static unsigned int pool_trim_gen;
+
+static struct uvc_pool_header *_uvc_pool_header(void *data) {
+  return (struct uvc_pool_header *) data - 1;
+}
+
+static size_t _uvc_pool_round(size_t bytes) {
+  return (bytes + LIBUVC_FRAME_POOL_GRANULE - 1) &
+         ~((size_t) LIBUVC_FRAME_POOL_GRANULE - 1);
+}
+
+/** @internal
+ * @brief Allocate a buffer on the heap, with room for its header
+ */
+static void *_uvc_pool_heap_alloc(size_t capacity, size_t alignment) {
+  size_t offset;
+  void *base;
+  struct uvc_pool_header *hdr;
+
+  /* the data stays aligned with the header in front of it */
+  offset = (sizeof(struct uvc_pool_header) + alignment - 1) & ~(alignment - 1);
+
+#ifdef _WIN32
+  base = _aligned_malloc(offset + capacity, alignment);
+#else
+  if (posix_memalign(&base, alignment, offset + capacity))
+    base = NULL;
+#endif
+  if (!base)
+    return NULL;
+
+  hdr = _uvc_pool_header((uint8_t *) base + offset);
+  hdr->base = base;
+  hdr->capacity = capacity;
+  hdr->alignment = alignment;
+
+  return (uint8_t *) base + offset;
+}
+
+static void _uvc_pool_heap_free(void *data) {
+#ifdef _WIN32
+  _aligned_free(_uvc_pool_header(data)->base);
+#else
+  free(_uvc_pool_header(data)->base);
+#endif
+}
+
+/** @internal
+ * @brief Find the slab for a size and alignment, creating it if there is room
+ * @note Must be called with pool_mutex held
+ */
+static struct uvc_pool_slab *_uvc_pool_slab(size_t capacity, size_t alignment,
+                                            int create) {
+  struct uvc_pool_slab *slab;
+  unsigned int i;
+
+  for (i = 0; i < pool_num_slabs; i++) {
+    slab = &pool_slabs[i];
+    if (slab->capacity == capacity && slab->alignment == alignment)
+      return slab;
+  }
+
+  if (!create || pool_num_slabs == LIBUVC_FRAME_POOL_MAX_SLABS)
+    return NULL;
+
+  slab = &pool_slabs[pool_num_slabs];
+  slab->free = calloc(LIBUVC_FRAME_POOL_SLAB_DEPTH, sizeof(*slab->free));
+  if (!slab->free)
+    return NULL;
+  slab->capacity = capacity;
+  slab->alignment = alignment;
+  slab->num_free = 0;
+  slab->depth = LIBUVC_FRAME_POOL_SLAB_DEPTH;
+  pool_num_slabs++;
+
+  return slab;
+}
+
+/** @internal
+ * @brief Hand a buffer to its slab, or back to the heap if the slab is full
+ */
+static void _uvc_pool_put(void *data) {
+  struct uvc_pool_header *hdr = _uvc_pool_header(data);
+  struct uvc_pool_slab *slab;
+
+  pthread_mutex_lock(&pool_mutex);
+  slab = _uvc_pool_slab(hdr->capacity, hdr->alignment, 1);
+  if (slab && slab->num_free < slab->depth) {
+    slab->free[slab->num_free++] = data;
+    pool_stats.cached_buffers++;
+    pool_stats.cached_bytes += hdr->capacity;
+    data = NULL;
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  if (data)
+    _uvc_pool_heap_free(data);
+}
+
+/** @internal
+ * @brief Empty a thread's cache into the slabs, or onto the heap
+ * @note Must be called by the thread owning @p tls
+ */
+static void _uvc_pool_tls_empty(struct uvc_pool_tls *tls, int to_heap) {
+  int i;
+
+  for (i = 0; i < LIBUVC_FRAME_POOL_TLS_SLOTS; i++) {
+    if (!tls->slots[i])
+      continue;
+    if (to_heap)
+      _uvc_pool_heap_free(tls->slots[i]);
+    else
+      _uvc_pool_put(tls->slots[i]);
+    tls->slots[i] = NULL;
+  }
+
+  tls->cached_buffers = 0;
+  tls->cached_bytes = 0;
+}
+
+/** @internal
+ * @brief Thread exit: hand the thread's cache back to the slabs, or to the
+ * heap if the pool was trimmed since the thread last used it
+ */
+static void _uvc_pool_tls_flush(void *arg) {
+  struct uvc_pool_tls *tls = arg;
+
+  _uvc_pool_tls_empty(tls, tls->trim_gen != UVC_ATOMIC_LOAD(&pool_trim_gen));
+
+  pthread_mutex_lock(&pool_mutex);
+  DL_DELETE(pool_tls_list, tls);
+  pool_stats.hits += tls->hits;
+  pthread_mutex_unlock(&pool_mutex);
+
+  free(tls);
+}
+
+static void _uvc_pool_tls_init(void) {
+  pthread_key_create(&pool_tls_key, _uvc_pool_tls_flush);
+}
+
+static struct uvc_pool_tls *_uvc_pool_tls(void) {
+  struct uvc_pool_tls *tls;
+
+  pthread_once(&pool_tls_once, _uvc_pool_tls_init);
+
+  tls = pthread_getspecific(pool_tls_key);
+  if (!tls) {
+    tls = calloc(1, sizeof(*tls));
+    if (!tls)
+      return NULL;
+    if (pthread_setspecific(pool_tls_key, tls)) {
+      free(tls);
+      return NULL;
+    }
+    pthread_mutex_lock(&pool_mutex);
+    tls->trim_gen = pool_trim_gen;
+    DL_APPEND(pool_tls_list, tls);
+    pthread_mutex_unlock(&pool_mutex);
+  } else if (tls->trim_gen != UVC_ATOMIC_LOAD(&pool_trim_gen)) {
+    /* another thread trimmed the pool since this one last used it */
+    tls->trim_gen = UVC_ATOMIC_LOAD(&pool_trim_gen);
+    _uvc_pool_tls_empty(tls, 1);
+  }
+
+  return tls;
+}
+
+/** @internal
+ * @brief Get a buffer of at least @p bytes from the pool
+ * @param alignment Power of two, or 0 for the default
+ */
+void *_uvc_pool_alloc(size_t bytes, size_t alignment) {
+  struct uvc_pool_tls *tls = _uvc_pool_tls();
+  struct uvc_pool_slab *slab;
+  size_t capacity = _uvc_pool_round(bytes);
+  void *data = NULL;
+  int i;
+
+  if (alignment < LIBUVC_FRAME_POOL_DEFAULT_ALIGN)
+    alignment = LIBUVC_FRAME_POOL_DEFAULT_ALIGN;
+
+  if (tls) {
+    for (i = 0; i < LIBUVC_FRAME_POOL_TLS_SLOTS; i++) {
+      struct uvc_pool_header *hdr;
+
+      if (!tls->slots[i])
+        continue;
+      hdr = _uvc_pool_header(tls->slots[i]);
+      if (hdr->capacity == capacity && hdr->alignment == alignment) {
+        data = tls->slots[i];
+        tls->slots[i] = NULL;
+        tls->cached_buffers--;
+        tls->cached_bytes -= capacity;
+        tls->hits++;
+        return data;
+      }
+    }
+  }
+
+  pthread_mutex_lock(&pool_mutex);
+  slab = _uvc_pool_slab(capacity, alignment, 0);
+  if (slab && slab->num_free > 0) {
+    data = slab->free[--slab->num_free];
+    pool_stats.cached_buffers--;
+    pool_stats.cached_bytes -= capacity;
+    pool_stats.hits++;
+  } else {
+    pool_stats.misses++;
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  if (!data)
+    data = _uvc_pool_heap_alloc(capacity, alignment);
+
+  return data;
+}
+
+/** @internal
+ * @brief Return a buffer from _uvc_pool_alloc
+ */
+void _uvc_pool_free(void *data) {
+  struct uvc_pool_tls *tls;
+  size_t capacity;
+  int i;
+
+  if (!data)
+    return;
+
+  tls = _uvc_pool_tls();
+  capacity = _uvc_pool_header(data)->capacity;
+  if (tls && tls->cached_bytes + capacity <= LIBUVC_FRAME_POOL_TLS_MAX_BYTES) {
+    for (i = 0; i < LIBUVC_FRAME_POOL_TLS_SLOTS; i++) {
+      if (!tls->slots[i]) {
+        tls->slots[i] = data;
+        tls->cached_buffers++;
+        tls->cached_bytes += capacity;
+        return;
+      }
+    }
+  }
+
+  _uvc_pool_put(data);
+}
+
+/** @internal
+ * @brief Usable size of a buffer from _uvc_pool_alloc
+ */
+size_t _uvc_pool_capacity(void *data) {
+  return _uvc_pool_header(data)->capacity;
+}
+
+/** @internal
+ * @brief Alignment of a buffer from _uvc_pool_alloc
+ */
+size_t _uvc_pool_alignment(void *data) {
+  return _uvc_pool_header(data)->alignment;
+}
+
+/** @internal
+ * @brief Get a zeroed frame structure, recycled if possible
+ */
+uvc_frame_t *_uvc_pool_alloc_frame(void) {
+  uvc_frame_t *frame = NULL;
+
+  pthread_mutex_lock(&pool_mutex);
+  if (pool_num_frames > 0)
+    frame = pool_frames[--pool_num_frames];
+  pthread_mutex_unlock(&pool_mutex);
+
+  if (!frame)
+    frame = malloc(sizeof(*frame));
+
+  if (frame)
+    memset(frame, 0, sizeof(*frame));
+
+  return frame;
+}
+
+/** @internal
+ * @brief Return a frame structure from _uvc_pool_alloc_frame
+ */
+void _uvc_pool_free_frame(uvc_frame_t *frame) {
+  pthread_mutex_lock(&pool_mutex);
+  if (pool_num_frames < LIBUVC_FRAME_POOL_MAX_FRAMES) {
+    pool_frames[pool_num_frames++] = frame;
+    frame = NULL;
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  free(frame);
+}
+
+/** @brief Fill the frame buffer pool ahead of streaming
+ * @ingroup frame
+ *
+ * Allocates @p count buffers for frames of @p data_bytes, so even the first
+ * frames of a stream come from the pool. The slab keeps up to @p count free
+ * buffers from then on.
+ *
+ * @param data_bytes Size of the frames' data
+ * @param alignment Alignment of the data, a power of two; 0 for the default
+ * @param count Number of buffers
+ */
+uvc_error_t uvc_frame_pool_prewarm(size_t data_bytes, size_t alignment,
+                                   unsigned int count) {
+  struct uvc_pool_slab *slab;
+  size_t capacity = _uvc_pool_round(data_bytes);
+  uvc_error_t ret = UVC_SUCCESS;
+
+  if (alignment & (alignment - 1))
+    return UVC_ERROR_INVALID_PARAM;
+  if (alignment < LIBUVC_FRAME_POOL_DEFAULT_ALIGN)
+    alignment = LIBUVC_FRAME_POOL_DEFAULT_ALIGN;
+
+  pthread_mutex_lock(&pool_mutex);
+
+  slab = _uvc_pool_slab(capacity, alignment, 1);
+  if (!slab) {
+    ret = UVC_ERROR_NO_MEM;
+    goto done;
+  }
+
+  if (count > slab->depth) {
+    void **free_list = realloc(slab->free, count * sizeof(*free_list));
+    if (!free_list) {
+      ret = UVC_ERROR_NO_MEM;
+      goto done;
+    }
+    slab->free = free_list;
+    slab->depth = count;
+  }
+
+  while (slab->num_free < count) {
+    void *data = _uvc_pool_heap_alloc(capacity, alignment);
+    if (!data) {
+      ret = UVC_ERROR_NO_MEM;
+      break;
+    }
+    slab->free[slab->num_free++] = data;
+    pool_stats.cached_buffers++;
+    pool_stats.cached_bytes += capacity;
+  }
+
+done:
+  pthread_mutex_unlock(&pool_mutex);
+
+  return ret;
+}
+
+/** @brief Release the free buffers the frame buffer pool holds
+ * @ingroup frame
+ *
+ * Releases the shared buffers and those cached by the calling thread at
+ * once. Other threads release theirs the next time they allocate or free a
+ * frame, or when they exit.
+ */
+void uvc_frame_pool_trim(void) {
+  struct uvc_pool_tls *tls = _uvc_pool_tls();
+  unsigned int i;
+
+  if (tls)
+    _uvc_pool_tls_empty(tls, 1);
+
+  pthread_mutex_lock(&pool_mutex);
+
+  UVC_ATOMIC_STORE(&pool_trim_gen, pool_trim_gen + 1);
+  if (tls)
+    tls->trim_gen = pool_trim_gen;
+
+  for (i = 0; i < pool_num_slabs; i++) {
+    while (pool_slabs[i].num_free > 0)
+      _uvc_pool_heap_free(pool_slabs[i].free[--pool_slabs[i].num_free]);
+    free(pool_slabs[i].free);
+  }
+  pool_num_slabs = 0;
+
+  while (pool_num_frames > 0)
+    free(pool_frames[--pool_num_frames]);
+
+  pool_stats.cached_buffers = 0;
+  pool_stats.cached_bytes = 0;
+
+  pthread_mutex_unlock(&pool_mutex);
+}
+
+/** @brief Get the frame buffer pool's counters
+ * @ingroup frame
+ *
+ * @param[out] stats Counters
+ */
+void uvc_frame_pool_get_stats(uvc_frame_pool_stats_t *stats) {
+  struct uvc_pool_tls *tls;
+
+  pthread_mutex_lock(&pool_mutex);
+  *stats = pool_stats;
+  DL_FOREACH(pool_tls_list, tls) {
+    stats->hits += tls->hits;
+    stats->cached_buffers += tls->cached_buffers;
+    stats->cached_bytes += tls->cached_bytes;
+  }
+  pthread_mutex_unlock(&pool_mutex);
+}
@@ -145,6 +145,8 @@ void uvc_exit(uvc_context_t *ctx) {
   if (ctx->own_usb_ctx)
     libusb_exit(ctx->usb_ctx);
 
+  _uvc_arena_destroy(ctx);
+
   free(ctx);
 }
 
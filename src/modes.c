@@ -0,0 +1,488 @@
+/* Mode bandwidth calculator.
+ *
+ * Lists every format, frame size and frame interval of each camera with the
+ * bus bandwidth it needs: the isochronous altsetting uvc_stream_start() would
+ * select, the bandwidth that altsetting reserves and the memory its
+ * transfers take. Then picks one mode per camera so that the given number of
+ * copies of every camera fit on one bus together, downgrading the camera
+ * that reserves the most until they do.
+ *
+ * uvc_modes asks the cameras that are plugged in; uvc_virtual_modes takes
+ * descriptor dumps (see cameras/descriptors) and works offline.
+ *
+ * The bus model is deliberately simple: isochronous streams cost what their
+ * altsetting reserves, bulk streams what their frames need, and together they
+ * may use the share of the bus the host controller allots to periodic
+ * transfers. Hubs, other devices and controller quirks are not modelled.
+ */
+#include "libuvc/libuvc.h"
+#ifdef UVC_MODES_VIRTUAL
+#include "libuvc/libuvc_virtual.h"
+#endif
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define MAX_CAMERAS 16
+#define MAX_MODES 1024
+
+/* Largest isochronous payload per microframe below SuperSpeed */
+#define HS_ISO_MAX 3072
+
+struct mode {
+  char format[5];
+  uint16_t width;
+  uint16_t height;
+  uint32_t interval;
+  uint32_t frame_bytes;
+  uvc_error_t res;
+  uvc_stream_bandwidth_t bandwidth;
+};
+
+struct camera {
+  char name[64];
+  int num_modes;
+  struct mode modes[MAX_MODES];
+  /* Usable modes, best first */
+  int num_usable;
+  int usable[MAX_MODES];
+};
+
+struct bus_speed {
+  const char *name;
+  /* Periodic share of the bus, in bytes per second */
+  uint64_t budget;
+};
+
+static const struct bus_speed speeds[] = {
+  /* 90% of 1 ms frames of 1500 bytes */
+  { "full", 1350ULL * 1000 },
+  /* 80% of 125 us microframes of 7500 bytes */
+  { "high", 6000ULL * 8000 },
+  /* 90% of 5 Gb/s after 8b/10b coding */
+  { "super", 450000000ULL },
+};
+
+static struct camera cameras[MAX_CAMERAS];
+static int num_cameras;
+
+static const char *filter_format;
+static double min_fps;
+
+static double mode_fps(const struct mode *m) {
+  return m->interval ? 1e7 / m->interval : 0;
+}
+
+/* Bandwidth a mode takes from the bus: the reservation of an isochronous
+ * altsetting, or the data rate of a bulk stream */
+static uint64_t mode_load(const struct mode *m) {
+  return m->bandwidth.isochronous ? m->bandwidth.reserved_bytes_per_second :
+    m->bandwidth.frame_bytes_per_second;
+}
+
+static void format_name(const uvc_format_desc_t *format, char *name) {
+  int i;
+
+  if (format->bDescriptorSubtype == UVC_VS_FORMAT_MJPEG) {
+    strcpy(name, "MJPG");
+    return;
+  }
+
+  for (i = 0; i < 4; i++)
+    name[i] = isprint(format->fourccFormat[i]) ? format->fourccFormat[i] : '?';
+  name[4] = '\0';
+}
+
+static void add_mode(struct camera *cam, uvc_device_handle_t *devh,
+                     const uvc_format_desc_t *format, const uvc_frame_desc_t *frame,
+                     uint32_t interval) {
+  struct mode *m;
+  uvc_stream_ctrl_t ctrl;
+
+  if (cam->num_modes == MAX_MODES)
+    return;
+
+  m = &cam->modes[cam->num_modes++];
+  memset(m, 0, sizeof(*m));
+  format_name(format, m->format);
+  m->width = frame->wWidth;
+  m->height = frame->wHeight;
+  m->interval = interval;
+
+  m->res = uvc_get_stream_ctrl_frame(devh, &ctrl, frame, interval);
+  if (m->res == UVC_SUCCESS) {
+    m->frame_bytes = ctrl.dwMaxVideoFrameSize;
+    m->res = uvc_get_stream_bandwidth(devh, &ctrl, &m->bandwidth);
+  }
+}
+
+static void list_modes(struct camera *cam, uvc_device_handle_t *devh) {
+  const uvc_format_desc_t *format;
+  const uvc_frame_desc_t *frame;
+  const uint32_t *interval;
+
+  for (format = uvc_get_format_descs(devh); format; format = format->next) {
+    for (frame = format->frame_descs; frame; frame = frame->next) {
+      if (frame->intervals) {
+        for (interval = frame->intervals; *interval; interval++)
+          add_mode(cam, devh, format, frame, *interval);
+      } else {
+        /* Continuous intervals: the fastest and the slowest */
+        add_mode(cam, devh, format, frame, frame->dwMinFrameInterval);
+        if (frame->dwMaxFrameInterval != frame->dwMinFrameInterval)
+          add_mode(cam, devh, format, frame, frame->dwMaxFrameInterval);
+      }
+    }
+  }
+}
+
+static int usable(const struct mode *m) {
+  if (m->res != UVC_SUCCESS)
+    return 0;
+  if (filter_format && strcasecmp(filter_format, m->format))
+    return 0;
+  return mode_fps(m) + 0.005 >= min_fps;
+}
+
+/* Best first: most pixels, then most frames, then least bandwidth */
+static const struct camera *sort_camera;
+
+static int compare_modes(const void *a, const void *b) {
+  const struct mode *ma = &sort_camera->modes[*(const int *) a];
+  const struct mode *mb = &sort_camera->modes[*(const int *) b];
+  uint32_t pa = (uint32_t) ma->width * ma->height, pb = (uint32_t) mb->width * mb->height;
+
+  if (pa != pb)
+    return pa > pb ? -1 : 1;
+  if (ma->interval != mb->interval)
+    return ma->interval < mb->interval ? -1 : 1;
+  if (mode_load(ma) != mode_load(mb))
+    return mode_load(ma) < mode_load(mb) ? -1 : 1;
+  return *(const int *) a - *(const int *) b;
+}
+
+static void print_camera(struct camera *cam) {
+  int i;
+
+  printf("%s\n", cam->name);
+  printf("  %-4s  %9s  %7s  %9s  %8s  %3s  %6s  %13s  %10s\n", "fmt", "size", "fps",
+         "frame KB", "MB/s", "alt", "packet", "reserved MB/s", "buffers KB");
+
+  for (i = 0; i < cam->num_modes; i++) {
+    const struct mode *m = &cam->modes[i];
+    char size[16];
+
+    snprintf(size, sizeof(size), "%ux%u", m->width, m->height);
+    printf("  %-4s  %9s  %7.2f  ", m->format, size, mode_fps(m));
+
+    if (m->res != UVC_SUCCESS) {
+      printf("%s\n", m->res == UVC_ERROR_INVALID_MODE ? "no altsetting is large enough" :
+             uvc_strerror(m->res));
+      continue;
+    }
+
+    printf("%9.1f  %8.2f  ", m->frame_bytes / 1024.0,
+           m->bandwidth.frame_bytes_per_second / 1e6);
+    if (m->bandwidth.isochronous)
+      printf("%3u  %6u  %13.2f", m->bandwidth.bAlternateSetting,
+             m->bandwidth.bytes_per_packet, m->bandwidth.reserved_bytes_per_second / 1e6);
+    else
+      printf("%3s  %6u  %13s", "-", m->bandwidth.bytes_per_packet, "bulk");
+    printf("  %10.1f\n", m->bandwidth.transfer_memory / 1024.0);
+
+    if (usable(m))
+      cam->usable[cam->num_usable++] = i;
+  }
+
+  sort_camera = cam;
+  qsort(cam->usable, cam->num_usable, sizeof(cam->usable[0]), compare_modes);
+  printf("\n");
+}
+
+/* Pick a mode for each of copies * num_cameras streams; returns 0 if they fit */
+static int recommend(int copies, const struct bus_speed *speed) {
+  int streams = copies * num_cameras;
+  /* Position in the camera's usable list, per stream */
+  int *choice = calloc(streams, sizeof(*choice));
+  uint64_t total = 0;
+  int s;
+
+  if (!choice)
+    return 2;
+
+  for (s = 0; s < streams; s++) {
+    const struct camera *cam = &cameras[s % num_cameras];
+
+    if (!cam->num_usable) {
+      printf("%s has no usable mode\n", cam->name);
+      free(choice);
+      return 1;
+    }
+    total += mode_load(&cam->modes[cam->usable[0]]);
+  }
+
+  /* Step down the stream that takes the most until the set fits */
+  while (total > speed->budget) {
+    int worst = -1, next = 0;
+    uint64_t worst_load = 0;
+
+    for (s = 0; s < streams; s++) {
+      const struct camera *cam = &cameras[s % num_cameras];
+      uint64_t load = mode_load(&cam->modes[cam->usable[choice[s]]]);
+      int n;
+
+      if (load <= worst_load)
+        continue;
+
+      /* Next mode down that takes less */
+      for (n = choice[s] + 1; n < cam->num_usable; n++)
+        if (mode_load(&cam->modes[cam->usable[n]]) < load)
+          break;
+      if (n == cam->num_usable)
+        continue;
+
+      worst = s;
+      worst_load = load;
+      next = n;
+    }
+
+    if (worst < 0)
+      break;
+
+    total -= worst_load;
+    choice[worst] = next;
+    total += mode_load(&cameras[worst % num_cameras].modes[cameras[worst % num_cameras].usable[next]]);
+  }
+
+  printf("%d camera%s on a %s speed bus, %.1f MB/s available:\n", streams,
+         streams == 1 ? "" : "s", speed->name, speed->budget / 1e6);
+
+  for (s = 0; s < streams; s++) {
+    const struct camera *cam = &cameras[s % num_cameras];
+    const struct mode *m = &cam->modes[cam->usable[choice[s]]];
+
+    printf("  %2d  %-32.32s  %-4s %4ux%-4u %6.2f fps  ", s + 1, cam->name, m->format,
+           m->width, m->height, mode_fps(m));
+    if (m->bandwidth.isochronous)
+      printf("alt %-2u %8.2f MB/s\n", m->bandwidth.bAlternateSetting, mode_load(m) / 1e6);
+    else
+      printf("bulk   %8.2f MB/s\n", mode_load(m) / 1e6);
+  }
+
+  free(choice);
+
+  printf("  total %.2f of %.1f MB/s: %s\n", total / 1e6, speed->budget / 1e6,
+         total <= speed->budget ? "fits" : "does not fit");
+  return total <= speed->budget ? 0 : 1;
+}
+
+#ifdef UVC_MODES_VIRTUAL
+static uint8_t *read_file(const char *path, size_t *length) {
+  FILE *f = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long size;
+
+  if (!f)
+    return NULL;
+
+  if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+    data = malloc(size);
+    if (data && fread(data, 1, size, f) != (size_t) size) {
+      free(data);
+      data = NULL;
+    }
+    *length = size;
+  }
+
+  fclose(f);
+  return data;
+}
+
+static int load_cameras(int argc, char **argv) {
+  int i;
+
+  for (i = 0; i < argc && num_cameras < MAX_CAMERAS; i++) {
+    uvc_virtual_config_t config;
+    uvc_context_t *ctx;
+    uvc_device_t *dev;
+    uvc_device_handle_t *devh;
+    struct camera *cam = &cameras[num_cameras];
+    const char *base = strrchr(argv[i], '/');
+    size_t length;
+    uint8_t *data;
+    uvc_error_t res;
+
+    data = read_file(argv[i], &length);
+    if (!data) {
+      perror(argv[i]);
+      return 2;
+    }
+
+    uvc_virtual_default_config(&config);
+    config.descriptors = data;
+    config.descriptors_length = length;
+    res = uvc_virtual_set_config(&config);
+    free(data);
+    if (res < 0) {
+      uvc_perror(res, argv[i]);
+      return 2;
+    }
+
+    res = uvc_init(&ctx, NULL);
+    if (res < 0) {
+      uvc_perror(res, "uvc_init");
+      return 2;
+    }
+
+    res = uvc_find_device(ctx, &dev, 0, 0, NULL);
+    if (res == UVC_SUCCESS) {
+      res = uvc_open(dev, &devh);
+      if (res == UVC_SUCCESS) {
+        snprintf(cam->name, sizeof(cam->name), "%s", base ? base + 1 : argv[i]);
+        list_modes(cam, devh);
+        num_cameras++;
+        uvc_close(devh);
+      }
+      uvc_unref_device(dev);
+    }
+    uvc_exit(ctx);
+
+    if (res < 0) {
+      uvc_perror(res, argv[i]);
+      return 2;
+    }
+  }
+
+  return 0;
+}
+#else
+static int load_cameras(uvc_context_t *ctx) {
+  uvc_device_t **list;
+  uvc_error_t res;
+  int i;
+
+  res = uvc_get_device_list(ctx, &list);
+  if (res < 0) {
+    uvc_perror(res, "uvc_get_device_list");
+    return 2;
+  }
+
+  for (i = 0; list[i] && num_cameras < MAX_CAMERAS; i++) {
+    struct camera *cam = &cameras[num_cameras];
+    uvc_device_descriptor_t *desc;
+    uvc_device_handle_t *devh;
+
+    if (uvc_get_device_descriptor(list[i], &desc) == UVC_SUCCESS) {
+      snprintf(cam->name, sizeof(cam->name), "%04x:%04x %s", desc->idVendor, desc->idProduct,
+               desc->product ? desc->product : "");
+      uvc_free_device_descriptor(desc);
+    }
+
+    res = uvc_open(list[i], &devh);
+    if (res < 0) {
+      uvc_perror(res, cam->name);
+      continue;
+    }
+    list_modes(cam, devh);
+    num_cameras++;
+    uvc_close(devh);
+  }
+
+  uvc_free_device_list(list, 1);
+  return 0;
+}
+#endif
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-n cameras_per_model] [-S full|high|super] [-f format] [-r min_fps]"
+#ifdef UVC_MODES_VIRTUAL
+          " descriptors..."
+#endif
+          "\n"
+          "  -n  how many of each camera share the bus (default 1)\n"
+          "  -S  bus speed (default super if a mode needs it, else high)\n"
+          "  -f  only recommend modes in this format, e.g. MJPG or YUY2\n"
+          "  -r  only recommend modes with at least this many frames per second\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  const struct bus_speed *speed = NULL;
+  int copies = 1, opt, i, j, status;
+#ifndef UVC_MODES_VIRTUAL
+  uvc_context_t *ctx;
+  uvc_error_t res;
+#endif
+
+  while ((opt = getopt(argc, argv, "n:S:f:r:")) != -1) {
+    switch (opt) {
+    case 'n':
+      copies = atoi(optarg);
+      break;
+    case 'S':
+      for (i = 0; i < (int) (sizeof(speeds) / sizeof(speeds[0])); i++)
+        if (!strcmp(optarg, speeds[i].name))
+          speed = &speeds[i];
+      if (!speed) {
+        usage(argv[0]);
+        return 2;
+      }
+      break;
+    case 'f':
+      filter_format = optarg;
+      break;
+    case 'r':
+      min_fps = atof(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (copies < 1) {
+    usage(argv[0]);
+    return 2;
+  }
+
+#ifdef UVC_MODES_VIRTUAL
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 2;
+  }
+  status = load_cameras(argc - optind, argv + optind);
+#else
+  res = uvc_init(&ctx, NULL);
+  if (res < 0) {
+    uvc_perror(res, "uvc_init");
+    return 2;
+  }
+  status = load_cameras(ctx);
+  uvc_exit(ctx);
+#endif
+  if (status)
+    return status;
+
+  if (!num_cameras) {
+    fprintf(stderr, "no cameras\n");
+    return 2;
+  }
+
+  for (i = 0; i < num_cameras; i++)
+    print_camera(&cameras[i]);
+
+  if (!speed) {
+    speed = &speeds[1];
+    for (i = 0; i < num_cameras; i++)
+      for (j = 0; j < cameras[i].num_modes; j++)
+        if (cameras[i].modes[j].bandwidth.bytes_per_packet > HS_ISO_MAX &&
+            cameras[i].modes[j].bandwidth.isochronous)
+          speed = &speeds[2];
+  }
+
+  return recommend(copies, speed);
+}
@@ -0,0 +1,844 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @defgroup pipeline Frame processing pipelines
+ * @brief Multi-threaded integrity/decode/convert/scale/sink chains fed by a stream
+ *
+ * A pipeline is an ordered list of stages. Each stage owns a bounded input
+ * queue, one or more worker threads and a pool of output frames that are
+ * recycled once the next stage is done with them, so a running pipeline
+ * does not allocate per frame.
+ *
+ * Frames enter the pipeline from the stream's callback thread. If the first
+ * stage's queue is full or its pool is exhausted, the frame is dropped and
+ * counted instead of stalling the stream. Stages with several worker threads
+ * may reorder frames; use uvc_frame_t::sequence to restore the order.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+#define LIBUVC_PIPELINE_MAX_STAGES 8
+#define LIBUVC_PIPELINE_DEFAULT_QUEUE_DEPTH 4
+
+struct uvc_pipeline_pool;
+
+/** @internal A frame in flight, tagged with the pool it must return to */
+typedef struct uvc_pipeline_buffer {
+  uvc_frame_t *frame;
+  struct uvc_pipeline_pool *pool;
+} uvc_pipeline_buffer_t;
+
+/** @internal Fixed set of recyclable frames */
+typedef struct uvc_pipeline_pool {
+  pthread_mutex_t mutex;
+  uvc_pipeline_buffer_t *buffers;
+  uvc_pipeline_buffer_t **free_list;
+  int size;
+  int num_free;
+} uvc_pipeline_pool_t;
+
+/** @internal Bounded FIFO of buffers between two stages */
+typedef struct uvc_pipeline_queue {
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  uvc_pipeline_buffer_t **items;
+  int capacity;
+  int head;
+  int count;
+  int closed;
+} uvc_pipeline_queue_t;
+
+struct uvc_pipeline;
+
+typedef struct uvc_pipeline_stage {
+  struct uvc_pipeline *pipe;
+  int index;
+  uvc_pipeline_stage_config_t config;
+  uvc_pipeline_queue_t queue;
+  /** Output frames; unused by stages that forward or consume their input */
+  uvc_pipeline_pool_t pool;
+  pthread_t *threads;
+  int num_threads;
+  uvc_pipeline_stage_stats_t stats;
+  pthread_mutex_t stats_mutex;
+} uvc_pipeline_stage_t;
+
+struct uvc_pipeline {
+  uvc_pipeline_stage_t stages[LIBUVC_PIPELINE_MAX_STAGES];
+  int num_stages;
+  /** Copies of the stream's frames enter the pipeline from here */
+  uvc_pipeline_pool_t input_pool;
+  uint8_t running;
+};
+
+static uvc_error_t _uvc_pipeline_pool_init(uvc_pipeline_pool_t *pool, int size) {
+  int i;
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pool->size = 0;
+  pool->num_free = 0;
+  pool->buffers = calloc(size, sizeof(*pool->buffers));
+  pool->free_list = calloc(size, sizeof(*pool->free_list));
+
+  if (!pool->buffers || !pool->free_list)
+    return UVC_ERROR_NO_MEM;
+
+  for (i = 0; i < size; ++i) {
+    pool->buffers[i].frame = uvc_allocate_frame(0);
+    if (!pool->buffers[i].frame)
+      return UVC_ERROR_NO_MEM;
+    pool->buffers[i].pool = pool;
+    pool->free_list[pool->num_free++] = &pool->buffers[i];
+    pool->size++;
+  }
+
+  return UVC_SUCCESS;
+}
+
+static void _uvc_pipeline_pool_destroy(uvc_pipeline_pool_t *pool) {
+  int i;
+
+  for (i = 0; i < pool->size; ++i)
+    uvc_free_frame(pool->buffers[i].frame);
+
+  free(pool->buffers);
+  free(pool->free_list);
+  pthread_mutex_destroy(&pool->mutex);
+}
+
+static uvc_pipeline_buffer_t *_uvc_pipeline_pool_get(uvc_pipeline_pool_t *pool) {
+  uvc_pipeline_buffer_t *buf = NULL;
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->num_free > 0)
+    buf = pool->free_list[--pool->num_free];
+  pthread_mutex_unlock(&pool->mutex);
+
+  return buf;
+}
+
+static void _uvc_pipeline_buffer_release(uvc_pipeline_buffer_t *buf) {
+  uvc_pipeline_pool_t *pool = buf->pool;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->free_list[pool->num_free++] = buf;
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+static uvc_error_t _uvc_pipeline_queue_init(uvc_pipeline_queue_t *queue, int capacity) {
+  pthread_mutex_init(&queue->mutex, NULL);
+  pthread_cond_init(&queue->not_empty, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+  queue->capacity = capacity;
+  queue->head = 0;
+  queue->count = 0;
+  queue->closed = 0;
+  queue->items = calloc(capacity, sizeof(*queue->items));
+
+  return queue->items ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+}
+
+static void _uvc_pipeline_queue_destroy(uvc_pipeline_queue_t *queue) {
+  free(queue->items);
+  pthread_cond_destroy(&queue->not_full);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_mutex_destroy(&queue->mutex);
+}
+
+/** @internal
+ * @brief Append a buffer to a queue
+ * @param block Wait for free space if nonzero, otherwise fail when full
+ * @return 1 if the buffer was queued
+ */
+static int _uvc_pipeline_queue_push(uvc_pipeline_queue_t *queue,
+                                    uvc_pipeline_buffer_t *buf, int block) {
+  int queued = 0;
+
+  pthread_mutex_lock(&queue->mutex);
+
+  while (block && !queue->closed && queue->count == queue->capacity)
+    pthread_cond_wait(&queue->not_full, &queue->mutex);
+
+  if (!queue->closed && queue->count < queue->capacity) {
+    queue->items[(queue->head + queue->count) % queue->capacity] = buf;
+    queue->count++;
+    queued = 1;
+    pthread_cond_signal(&queue->not_empty);
+  }
+
+  pthread_mutex_unlock(&queue->mutex);
+
+  return queued;
+}
+
+/** @internal
+ * @brief Take the oldest buffer from a queue, waiting until one is available
+ * @return NULL once the queue has been closed and drained
+ */
+static uvc_pipeline_buffer_t *_uvc_pipeline_queue_pop(uvc_pipeline_queue_t *queue) {
+  uvc_pipeline_buffer_t *buf = NULL;
+
+  pthread_mutex_lock(&queue->mutex);
+
+  while (!queue->closed && queue->count == 0)
+    pthread_cond_wait(&queue->not_empty, &queue->mutex);
+
+  if (queue->count > 0) {
+    buf = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+  }
+
+  pthread_mutex_unlock(&queue->mutex);
+
+  return buf;
+}
+
+static void _uvc_pipeline_queue_close(uvc_pipeline_queue_t *queue) {
+  pthread_mutex_lock(&queue->mutex);
+  queue->closed = 1;
+  pthread_cond_broadcast(&queue->not_empty);
+  pthread_cond_broadcast(&queue->not_full);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+/** @internal
+ * @brief Number of bytes a complete uncompressed frame must have, or 0 if unknown
+ */
+static size_t _uvc_pipeline_expected_bytes(uvc_frame_t *frame) {
+  size_t pixels = (size_t) frame->width * frame->height;
+
+  switch (frame->frame_format) {
+  case UVC_FRAME_FORMAT_YUYV:
+  case UVC_FRAME_FORMAT_UYVY:
+  case UVC_FRAME_FORMAT_GRAY16:
+    return pixels * 2;
+  case UVC_FRAME_FORMAT_RGB:
+  case UVC_FRAME_FORMAT_BGR:
+    return pixels * 3;
+  case UVC_FRAME_FORMAT_GRAY8:
+  case UVC_FRAME_FORMAT_BY8:
+  case UVC_FRAME_FORMAT_BA81:
+  case UVC_FRAME_FORMAT_SGRBG8:
+  case UVC_FRAME_FORMAT_SGBRG8:
+  case UVC_FRAME_FORMAT_SRGGB8:
+  case UVC_FRAME_FORMAT_SBGGR8:
+    return pixels;
+  case UVC_FRAME_FORMAT_NV12:
+    return pixels * 3 / 2;
+  case UVC_FRAME_FORMAT_P010:
+    return pixels * 3;
+  default:
+    return 0;
+  }
+}
+
+/** @internal
+ * @brief Check that a frame is complete enough to be worth processing
+ */
+static int _uvc_pipeline_frame_intact(uvc_frame_t *frame) {
+  uint8_t *data = frame->data;
+  size_t expected;
+  size_t tail;
+
+  if (!data || frame->data_bytes == 0)
+    return 0;
+
+  if (frame->frame_format == UVC_FRAME_FORMAT_MJPEG) {
+    /* SOI marker up front, EOI marker near the end (some cameras pad) */
+    if (frame->data_bytes < 4 || data[0] != 0xff || data[1] != 0xd8)
+      return 0;
+
+    tail = frame->data_bytes > 64 ? frame->data_bytes - 64 : 0;
+    for (expected = frame->data_bytes - 1; expected > tail; --expected) {
+      if (data[expected - 1] == 0xff && data[expected] == 0xd9)
+        return 1;
+    }
+
+    return 0;
+  }
+
+  expected = _uvc_pipeline_expected_bytes(frame);
+
+  return frame->data_bytes >= expected;
+}
+
+/** @internal
+ * @brief Bytes per pixel for formats that can be scaled pixel by pixel
+ */
+static int _uvc_pipeline_scale_bpp(enum uvc_frame_format format) {
+  switch (format) {
+  case UVC_FRAME_FORMAT_GRAY8:
+    return 1;
+  case UVC_FRAME_FORMAT_GRAY16:
+    return 2;
+  case UVC_FRAME_FORMAT_RGB:
+  case UVC_FRAME_FORMAT_BGR:
+    return 3;
+  /* Packed 4:2:2 is scaled in two-pixel macropixels */
+  case UVC_FRAME_FORMAT_YUYV:
+  case UVC_FRAME_FORMAT_UYVY:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+/** @internal
+ * @brief Nearest-neighbour resize into the stage's configured size
+ */
+static uvc_error_t _uvc_pipeline_scale(uvc_frame_t *in, uvc_frame_t *out,
+                                       uint32_t width, uint32_t height) {
+  int bpp = _uvc_pipeline_scale_bpp(in->frame_format);
+  int macropixel = (bpp == 4) ? 2 : 1;
+  size_t in_step, out_step;
+  uint32_t in_units, out_units;
+  uint32_t x, y;
+
+  if (!bpp || !width || !height)
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  if (macropixel == 2 && (width % 2))
+    return UVC_ERROR_INVALID_PARAM;
+
+  in_units = in->width / macropixel;
+  out_units = width / macropixel;
+  in_step = in->step ? in->step : (size_t) in_units * bpp;
+  out_step = (size_t) out_units * bpp;
+
+  if (in->data_bytes < in_step * in->height)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (uvc_ensure_frame_size(out, out_step * height) < 0)
+    return UVC_ERROR_NO_MEM;
+
+  out->width = width;
+  out->height = height;
+  out->frame_format = in->frame_format;
+  out->step = out_step;
+  out->sequence = in->sequence;
+  out->capture_time = in->capture_time;
+  out->capture_time_finished = in->capture_time_finished;
+  out->pts = in->pts;
+  out->scr = in->scr;
+  out->source = in->source;
+
+  for (y = 0; y < height; ++y) {
+    const uint8_t *src_row = (uint8_t *) in->data + (size_t) (y * in->height / height) * in_step;
+    uint8_t *dst = (uint8_t *) out->data + (size_t) y * out_step;
+
+    for (x = 0; x < out_units; ++x) {
+      memcpy(dst, src_row + (size_t) (x * in_units / out_units) * bpp, bpp);
+      dst += bpp;
+    }
+  }
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Resize a frame by nearest neighbour
+ * @ingroup frame
+ *
+ * Works on GRAY8, GRAY16, RGB, BGR, YUYV and UYVY frames; YUYV and UYVY
+ * need an even width. The same scaler backs UVC_PIPELINE_STAGE_SCALE.
+ *
+ * @param in Frame to resize
+ * @param out Resized frame, in the input's format
+ * @param width Output width
+ * @param height Output height
+ */
+uvc_error_t uvc_scale_frame(uvc_frame_t *in, uvc_frame_t *out,
+                            uint32_t width, uint32_t height) {
+  return _uvc_pipeline_scale(in, out, width, height);
+}
+
+/** @internal
+ * @brief Convert a frame into the requested output format
+ */
+static uvc_error_t _uvc_pipeline_convert(uvc_frame_t *in, uvc_frame_t *out,
+                                         enum uvc_frame_format format) {
+  switch (format) {
+  case UVC_FRAME_FORMAT_RGB:
+    return uvc_any2rgb(in, out);
+  case UVC_FRAME_FORMAT_BGR:
+    return uvc_any2bgr(in, out);
+  case UVC_FRAME_FORMAT_GRAY8:
+    switch (in->frame_format) {
+#ifdef LIBUVC_HAS_JPEG
+    case UVC_FRAME_FORMAT_MJPEG:
+      return uvc_mjpeg2gray(in, out);
+#endif
+    case UVC_FRAME_FORMAT_YUYV:
+      return uvc_yuyv2y(in, out);
+    case UVC_FRAME_FORMAT_GRAY8:
+      return uvc_duplicate_frame(in, out);
+    default:
+      return UVC_ERROR_NOT_SUPPORTED;
+    }
+  default:
+    return UVC_ERROR_NOT_SUPPORTED;
+  }
+}
+
+static void _uvc_pipeline_count(uvc_pipeline_stage_t *stage, int processed, int dropped, int failed) {
+  pthread_mutex_lock(&stage->stats_mutex);
+  stage->stats.frames_processed += processed;
+  stage->stats.frames_dropped += dropped;
+  stage->stats.frames_failed += failed;
+  pthread_mutex_unlock(&stage->stats_mutex);
+}
+
+/** @internal
+ * @brief Run one stage on one buffer
+ * @return The buffer to hand to the next stage, or NULL if the input was
+ * consumed or dropped. The input buffer is released if it isn't returned.
+ */
+static uvc_pipeline_buffer_t *_uvc_pipeline_run_stage(uvc_pipeline_stage_t *stage,
+                                                      uvc_pipeline_buffer_t *in) {
+  uvc_pipeline_stage_config_t *config = &stage->config;
+  uvc_pipeline_buffer_t *out;
+  uvc_error_t ret;
+
+  switch (config->type) {
+  case UVC_PIPELINE_STAGE_INTEGRITY:
+    if (!_uvc_pipeline_frame_intact(in->frame)) {
+      _uvc_pipeline_count(stage, 0, 1, 0);
+      _uvc_pipeline_buffer_release(in);
+      return NULL;
+    }
+    _uvc_pipeline_count(stage, 1, 0, 0);
+    return in;
+  case UVC_PIPELINE_STAGE_SINK:
+    if (config->cb)
+      config->cb(in->frame, config->user_ptr);
+    _uvc_pipeline_count(stage, 1, 0, 0);
+    _uvc_pipeline_buffer_release(in);
+    return NULL;
+  case UVC_PIPELINE_STAGE_MJPEG_DECODE:
+    /* Frames that aren't MJPEG pass straight through */
+    if (in->frame->frame_format != UVC_FRAME_FORMAT_MJPEG) {
+      _uvc_pipeline_count(stage, 1, 0, 0);
+      return in;
+    }
+    break;
+  case UVC_PIPELINE_STAGE_CONVERT:
+  case UVC_PIPELINE_STAGE_SCALE:
+    break;
+  }
+
+  out = _uvc_pipeline_pool_get(&stage->pool);
+  if (!out) {
+    _uvc_pipeline_count(stage, 0, 1, 0);
+    _uvc_pipeline_buffer_release(in);
+    return NULL;
+  }
+
+  switch (config->type) {
+  case UVC_PIPELINE_STAGE_MJPEG_DECODE:
+#ifdef LIBUVC_HAS_JPEG
+    if (config->format == UVC_FRAME_FORMAT_GRAY8)
+      ret = uvc_mjpeg2gray(in->frame, out->frame);
+    else
+      ret = uvc_mjpeg2rgb(in->frame, out->frame);
+#else
+    ret = UVC_ERROR_NOT_SUPPORTED;
+#endif
+    break;
+  case UVC_PIPELINE_STAGE_CONVERT:
+    ret = _uvc_pipeline_convert(in->frame, out->frame, config->format);
+    break;
+  case UVC_PIPELINE_STAGE_SCALE:
+    ret = _uvc_pipeline_scale(in->frame, out->frame, config->width, config->height);
+    break;
+  default:
+    ret = UVC_ERROR_OTHER;
+    break;
+  }
+
+  _uvc_pipeline_buffer_release(in);
+
+  if (ret != UVC_SUCCESS) {
+    UVC_DEBUG("pipeline stage %d failed: %d", stage->index, ret);
+    _uvc_pipeline_count(stage, 0, 0, 1);
+    _uvc_pipeline_buffer_release(out);
+    return NULL;
+  }
+
+  _uvc_pipeline_count(stage, 1, 0, 0);
+  return out;
+}
+
+/** @internal
+ * @brief Stage worker thread
+ */
+static void *_uvc_pipeline_worker(void *arg) {
+  uvc_pipeline_stage_t *stage = (uvc_pipeline_stage_t *) arg;
+  uvc_pipeline_t *pipe = stage->pipe;
+  uvc_pipeline_buffer_t *buf;
+
+  while ((buf = _uvc_pipeline_queue_pop(&stage->queue)) != NULL) {
+    buf = _uvc_pipeline_run_stage(stage, buf);
+
+    if (!buf)
+      continue;
+
+    if (stage->index + 1 < pipe->num_stages) {
+      /* Wait for the next stage: backpressure ends up at the pipeline input */
+      if (!_uvc_pipeline_queue_push(&pipe->stages[stage->index + 1].queue, buf, 1))
+        _uvc_pipeline_buffer_release(buf);
+    } else {
+      /* No sink at the end of the chain: nothing else wants the frame */
+      _uvc_pipeline_buffer_release(buf);
+    }
+  }
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Stream callback that copies each frame into the pipeline
+ */
+static void _uvc_pipeline_feed(uvc_frame_t *frame, void *ptr) {
+  uvc_pipeline_t *pipe = (uvc_pipeline_t *) ptr;
+  uvc_pipeline_stage_t *first = &pipe->stages[0];
+  uvc_pipeline_buffer_t *buf;
+
+  buf = _uvc_pipeline_pool_get(&pipe->input_pool);
+  if (!buf) {
+    _uvc_pipeline_count(first, 0, 1, 0);
+    return;
+  }
+
+  if (uvc_duplicate_frame(frame, buf->frame) != UVC_SUCCESS) {
+    _uvc_pipeline_count(first, 0, 0, 1);
+    _uvc_pipeline_buffer_release(buf);
+    return;
+  }
+
+  if (!_uvc_pipeline_queue_push(&first->queue, buf, 0)) {
+    _uvc_pipeline_count(first, 0, 1, 0);
+    _uvc_pipeline_buffer_release(buf);
+  }
+}
+
+/** @brief Create an empty frame processing pipeline
+ * @ingroup pipeline
+ *
+ * Add stages with uvc_pipeline_add_stage(), then attach the pipeline to a
+ * stream with uvc_stream_start_pipeline().
+ *
+ * @param[out] pipe New pipeline
+ */
+uvc_error_t uvc_pipeline_create(uvc_pipeline_t **pipe) {
+  uvc_pipeline_t *new_pipe = calloc(1, sizeof(*new_pipe));
+
+  if (!new_pipe)
+    return UVC_ERROR_NO_MEM;
+
+  *pipe = new_pipe;
+  return UVC_SUCCESS;
+}
+
+/** @brief Append a stage to a pipeline
+ * @ingroup pipeline
+ *
+ * Stages run in the order they were added. The pipeline must not be running.
+ *
+ * @param pipe Pipeline
+ * @param config Stage type and parameters; copied into the pipeline
+ */
+uvc_error_t uvc_pipeline_add_stage(uvc_pipeline_t *pipe,
+                                   const uvc_pipeline_stage_config_t *config) {
+  uvc_pipeline_stage_t *stage;
+
+  if (pipe->running)
+    return UVC_ERROR_BUSY;
+
+  if (pipe->num_stages == LIBUVC_PIPELINE_MAX_STAGES)
+    return UVC_ERROR_NO_MEM;
+
+  switch (config->type) {
+  case UVC_PIPELINE_STAGE_INTEGRITY:
+    break;
+  case UVC_PIPELINE_STAGE_MJPEG_DECODE:
+#ifndef LIBUVC_HAS_JPEG
+    return UVC_ERROR_NOT_SUPPORTED;
+#else
+    break;
+#endif
+  case UVC_PIPELINE_STAGE_CONVERT:
+    if (config->format != UVC_FRAME_FORMAT_RGB &&
+        config->format != UVC_FRAME_FORMAT_BGR &&
+        config->format != UVC_FRAME_FORMAT_GRAY8)
+      return UVC_ERROR_INVALID_PARAM;
+    break;
+  case UVC_PIPELINE_STAGE_SCALE:
+    if (!config->width || !config->height)
+      return UVC_ERROR_INVALID_PARAM;
+    break;
+  case UVC_PIPELINE_STAGE_SINK:
+    if (!config->cb)
+      return UVC_ERROR_INVALID_PARAM;
+    break;
+  default:
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  stage = &pipe->stages[pipe->num_stages];
+  memset(stage, 0, sizeof(*stage));
+  stage->pipe = pipe;
+  stage->index = pipe->num_stages;
+  stage->config = *config;
+
+  if (stage->config.num_threads <= 0)
+    stage->config.num_threads = 1;
+  if (stage->config.queue_depth <= 0)
+    stage->config.queue_depth = LIBUVC_PIPELINE_DEFAULT_QUEUE_DEPTH;
+
+  pthread_mutex_init(&stage->stats_mutex, NULL);
+
+  pipe->num_stages++;
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Stop the workers and release the queues and pools of a pipeline
+ */
+static void _uvc_pipeline_teardown(uvc_pipeline_t *pipe) {
+  uvc_pipeline_stage_t *stage;
+  int stage_idx, thread_idx;
+
+  /* Close front to back so that each stage drains into a live successor */
+  for (stage_idx = 0; stage_idx < pipe->num_stages; ++stage_idx) {
+    stage = &pipe->stages[stage_idx];
+
+    if (stage->queue.items)
+      _uvc_pipeline_queue_close(&stage->queue);
+
+    for (thread_idx = 0; thread_idx < stage->num_threads; ++thread_idx)
+      pthread_join(stage->threads[thread_idx], NULL);
+
+    free(stage->threads);
+    stage->threads = NULL;
+    stage->num_threads = 0;
+  }
+
+  for (stage_idx = 0; stage_idx < pipe->num_stages; ++stage_idx) {
+    stage = &pipe->stages[stage_idx];
+
+    if (stage->queue.items) {
+      _uvc_pipeline_queue_destroy(&stage->queue);
+      stage->queue.items = NULL;
+    }
+
+    if (stage->pool.buffers) {
+      _uvc_pipeline_pool_destroy(&stage->pool);
+      stage->pool.buffers = NULL;
+    }
+  }
+
+  if (pipe->input_pool.buffers) {
+    _uvc_pipeline_pool_destroy(&pipe->input_pool);
+    pipe->input_pool.buffers = NULL;
+  }
+
+  pipe->running = 0;
+}
+
+/** @internal
+ * @brief Allocate queues and pools and spawn the stage workers
+ */
+static uvc_error_t _uvc_pipeline_setup(uvc_pipeline_t *pipe) {
+  uvc_pipeline_stage_t *stage;
+  uvc_error_t ret;
+  int stage_idx, thread_idx;
+  int next_depth;
+
+  if (pipe->num_stages == 0)
+    return UVC_ERROR_INVALID_PARAM;
+
+  pipe->running = 1;
+
+  /* Enough input frames to fill the first queue and keep its workers busy */
+  ret = _uvc_pipeline_pool_init(&pipe->input_pool,
+      pipe->stages[0].config.queue_depth + pipe->stages[0].config.num_threads + 1);
+  if (ret != UVC_SUCCESS)
+    goto fail;
+
+  for (stage_idx = 0; stage_idx < pipe->num_stages; ++stage_idx) {
+    stage = &pipe->stages[stage_idx];
+    memset(&stage->stats, 0, sizeof(stage->stats));
+
+    ret = _uvc_pipeline_queue_init(&stage->queue, stage->config.queue_depth);
+    if (ret != UVC_SUCCESS)
+      goto fail;
+
+    switch (stage->config.type) {
+    case UVC_PIPELINE_STAGE_MJPEG_DECODE:
+    case UVC_PIPELINE_STAGE_CONVERT:
+    case UVC_PIPELINE_STAGE_SCALE:
+      /* An output frame may sit in the next queue, be worked on by each of
+       * the next stage's threads, or be held by one of our own threads */
+      next_depth = (stage_idx + 1 < pipe->num_stages)
+        ? pipe->stages[stage_idx + 1].config.queue_depth
+          + pipe->stages[stage_idx + 1].config.num_threads
+        : 0;
+      ret = _uvc_pipeline_pool_init(&stage->pool,
+          next_depth + stage->config.num_threads + 1);
+      if (ret != UVC_SUCCESS)
+        goto fail;
+      break;
+    default:
+      break;
+    }
+  }
+
+  for (stage_idx = 0; stage_idx < pipe->num_stages; ++stage_idx) {
+    stage = &pipe->stages[stage_idx];
+
+    stage->threads = calloc(stage->config.num_threads, sizeof(*stage->threads));
+    if (!stage->threads) {
+      ret = UVC_ERROR_NO_MEM;
+      goto fail;
+    }
+
+    for (thread_idx = 0; thread_idx < stage->config.num_threads; ++thread_idx) {
+      if (pthread_create(&stage->threads[thread_idx], NULL,
+                         _uvc_pipeline_worker, (void *) stage) != 0) {
+        ret = UVC_ERROR_OTHER;
+        goto fail;
+      }
+      stage->num_threads++;
+    }
+  }
+
+  return UVC_SUCCESS;
+
+fail:
+  _uvc_pipeline_teardown(pipe);
+  return ret;
+}
+
+/** @brief Begin streaming video from the stream into a pipeline.
+ * @ingroup pipeline
+ *
+ * Starts the pipeline's workers and the stream. Each frame assembled by the
+ * stream is copied into the pipeline's first stage. Stop the stream with
+ * uvc_stream_stop() (or close it) before calling uvc_pipeline_stop() or
+ * uvc_pipeline_destroy().
+ *
+ * @param strmh UVC stream
+ * @param pipe Pipeline with at least one stage; may only feed one stream
+ * @param flags Stream setup flags, passed to uvc_stream_start()
+ */
+uvc_error_t uvc_stream_start_pipeline(uvc_stream_handle_t *strmh,
+                                      uvc_pipeline_t *pipe,
+                                      uint8_t flags) {
+  uvc_error_t ret;
+
+  if (pipe->running)
+    return UVC_ERROR_BUSY;
+
+  ret = _uvc_pipeline_setup(pipe);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  ret = uvc_stream_start(strmh, _uvc_pipeline_feed, pipe, flags);
+  if (ret != UVC_SUCCESS)
+    _uvc_pipeline_teardown(pipe);
+
+  return ret;
+}
+
+/** @brief Get the counters of one pipeline stage
+ * @ingroup pipeline
+ *
+ * Frames dropped at the pipeline input are counted on stage 0.
+ *
+ * @param pipe Pipeline
+ * @param stage_idx Stage index, in the order stages were added
+ * @param[out] stats Counters since the pipeline was started
+ */
+uvc_error_t uvc_pipeline_get_stage_stats(uvc_pipeline_t *pipe, int stage_idx,
+                                         uvc_pipeline_stage_stats_t *stats) {
+  uvc_pipeline_stage_t *stage;
+
+  if (stage_idx < 0 || stage_idx >= pipe->num_stages)
+    return UVC_ERROR_INVALID_PARAM;
+
+  stage = &pipe->stages[stage_idx];
+
+  pthread_mutex_lock(&stage->stats_mutex);
+  *stats = stage->stats;
+  pthread_mutex_unlock(&stage->stats_mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Stop a pipeline's workers so that it can be started again
+ * @ingroup pipeline
+ *
+ * Frames still queued are run through the remaining stages first. The stream
+ * feeding the pipeline must already be stopped. Stages and their counters
+ * are kept; the counters restart on the next uvc_stream_start_pipeline().
+ *
+ * @param pipe Pipeline to stop
+ */
+void uvc_pipeline_stop(uvc_pipeline_t *pipe) {
+  if (pipe->running)
+    _uvc_pipeline_teardown(pipe);
+}
+
+/** @brief Stop a pipeline's workers and free it
+ * @ingroup pipeline
+ *
+ * Frames still queued are run through the remaining stages first. The stream
+ * feeding the pipeline must already be stopped.
+ *
+ * @param pipe Pipeline to destroy
+ */
+void uvc_pipeline_destroy(uvc_pipeline_t *pipe) {
+  int stage_idx;
+
+  uvc_pipeline_stop(pipe);
+
+  for (stage_idx = 0; stage_idx < pipe->num_stages; ++stage_idx)
+    pthread_mutex_destroy(&pipe->stages[stage_idx].stats_mutex);
+
+  free(pipe);
+}
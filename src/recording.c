@@ -0,0 +1,1007 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @ingroup streaming
+ * @brief Frame recordings: recorder and playback
+ *
+ * A recording holds assembled frames of any format with their metadata,
+ * sequence numbers and timestamps. Unlike a transfer trace it doesn't need
+ * the recorded mode to play back: a stream playing a recording hands out
+ * the recorded frames as they are, through its callback or
+ * uvc_stream_get_frame(), as fast as they are taken or at the recorded pace.
+ *
+ * The file is a uvc_recording_header in the first page, an index of
+ * uvc_recording_entry, then from the next page boundary the frames' bytes,
+ * each frame's image followed by its metadata and padded to 8 bytes. The
+ * recorder reserves the whole file up front and maps the header and index.
+ * Frame bytes are copied into page-aligned chunks which a writer thread
+ * writes one whole chunk at a time, so the file is written sequentially in
+ * large blocks, with O_DIRECT if asked. The header counts the frames whose
+ * bytes are on disk, so a recording cut short plays back up to its last
+ * chunk. Fields are in host byte order.
+ */
+/* O_DIRECT */
+#define _GNU_SOURCE
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LIBUVC_RECORDING_MAGIC "UVCFRAME"
+#define LIBUVC_RECORDING_VERSION 1
+/* Alignment of the index, the frame data and every write, as O_DIRECT needs */
+#define LIBUVC_RECORDING_PAGE 4096
+#define LIBUVC_RECORDING_PAGE_UP(x) \
+  (((x) + LIBUVC_RECORDING_PAGE - 1) & ~(uint64_t) (LIBUVC_RECORDING_PAGE - 1))
+/* Frames are copied into chunks of this size, each written in one go */
+#define LIBUVC_RECORDING_CHUNK_SIZE (4 * 1024 * 1024)
+#define LIBUVC_RECORDING_CHUNKS 4
+
+struct uvc_recording_header {
+  char magic[8];
+  uint32_t version;
+  /** Offset of the index */
+  uint32_t header_size;
+  uint32_t entry_size;
+  /** Entries the index has room for */
+  uint32_t index_capacity;
+  /** Offset of the frame data */
+  uint64_t data_offset;
+  /** Frames whose bytes are on disk */
+  uint64_t frames;
+  /** Bytes of frame data on disk */
+  uint64_t data_bytes;
+};
+
+struct uvc_recording_entry {
+  /** Offset of the image from data_offset; the metadata follows it */
+  uint64_t offset;
+  uint32_t data_bytes;
+  uint32_t metadata_bytes;
+  uint32_t frame_format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t step;
+  uint32_t sequence;
+  uint32_t pts;
+  uint32_t scr;
+  uint32_t reserved;
+  /** capture_time, in microseconds */
+  int64_t capture_time_us;
+  /** capture_time_finished, in nanoseconds */
+  uint64_t capture_time_finished_ns;
+};
+
+#ifndef _WIN32
+
+struct uvc_recorder {
+  int fd;
+  uint8_t direct;
+  /** Mapped header and index */
+  struct uvc_recording_header *hdr;
+  struct uvc_recording_entry *index;
+  size_t map_size;
+  /** Bytes of frame data the file has room for */
+  uint64_t capacity;
+
+  /* Filled by uvc_recorder_write() only */
+  uint8_t *chunks[LIBUVC_RECORDING_CHUNKS];
+  size_t fill_bytes;
+  uint64_t appended;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pthread_t writer;
+  /* Guarded by mutex. chunks[fill] is being filled and the queued chunks
+   * before it wait for the writer thread, which writes the oldest first */
+  uint32_t fill;
+  uint32_t queued;
+  uint32_t frames_appended;
+  uint64_t frames_written;
+  uint64_t written;
+  uint8_t stop;
+  /** First write error, after which nothing more is recorded */
+  uvc_error_t error;
+  uvc_recorder_stats_t stats;
+};
+
+/* A recording mapped for reading */
+struct uvc_recording_map {
+  uint8_t *data;
+  size_t size;
+  const struct uvc_recording_entry *index;
+  const uint8_t *frame_data;
+  uint64_t frames;
+};
+
+struct uvc_playback {
+  struct uvc_recording_map map;
+  uint8_t flags;
+  pthread_t thread;
+  /* Guarded by the stream's cb_mutex */
+  const struct uvc_recording_entry *hold;
+  uint8_t stop;
+  uint8_t done;
+  /** Set once the playback thread has joined the callback thread */
+  uint8_t cb_joined;
+};
+
+static uint64_t _uvc_recording_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uvc_error_t _uvc_recorder_pwrite(uvc_recorder_t *rec, const uint8_t *buf,
+                                        size_t len, uint64_t offset) {
+  ssize_t n;
+
+  while (len) {
+    n = pwrite(rec->fd, buf, len, rec->hdr->data_offset + offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return UVC_ERROR_IO;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Count the frames whose bytes are all written in the header
+ * @note Must be called with the recorder's mutex held
+ */
+static void _uvc_recorder_commit(uvc_recorder_t *rec) {
+  uint64_t frames = rec->frames_written;
+
+  while (frames < rec->frames_appended) {
+    const struct uvc_recording_entry *e = &rec->index[frames];
+
+    if (e->offset + e->data_bytes + e->metadata_bytes > rec->written)
+      break;
+    frames++;
+  }
+
+  rec->frames_written = frames;
+  rec->stats.bytes_written = rec->written;
+  rec->hdr->data_bytes = rec->written;
+  __atomic_store_n(&rec->hdr->frames, frames, __ATOMIC_RELEASE);
+}
+
+/** @internal
+ * @brief Write full chunks as they are queued
+ */
+static void *_uvc_recorder_writer(void *arg) {
+  uvc_recorder_t *rec = arg;
+  uvc_error_t ret;
+  uint32_t idx;
+
+  pthread_mutex_lock(&rec->mutex);
+
+  for (;;) {
+    while (!rec->queued && !rec->stop)
+      pthread_cond_wait(&rec->cond, &rec->mutex);
+    if (!rec->queued)
+      break;
+
+    idx = (rec->fill + LIBUVC_RECORDING_CHUNKS - rec->queued) % LIBUVC_RECORDING_CHUNKS;
+    ret = rec->error;
+    pthread_mutex_unlock(&rec->mutex);
+
+    if (ret == UVC_SUCCESS)
+      ret = _uvc_recorder_pwrite(rec, rec->chunks[idx], LIBUVC_RECORDING_CHUNK_SIZE,
+                                 rec->written);
+
+    pthread_mutex_lock(&rec->mutex);
+    if (ret == UVC_SUCCESS) {
+      rec->written += LIBUVC_RECORDING_CHUNK_SIZE;
+      _uvc_recorder_commit(rec);
+    } else {
+      rec->error = ret;
+    }
+    rec->queued--;
+    pthread_cond_broadcast(&rec->cond);
+  }
+
+  pthread_mutex_unlock(&rec->mutex);
+  return NULL;
+}
+
+/** @internal
+ * @brief Hand the full chunk to the writer and start filling the next
+ *
+ * Waits for the writer if every other chunk is still queued.
+ */
+static void _uvc_recorder_queue(uvc_recorder_t *rec) {
+  pthread_mutex_lock(&rec->mutex);
+
+  if (rec->queued == LIBUVC_RECORDING_CHUNKS - 1) {
+    rec->stats.stalls++;
+    while (rec->queued == LIBUVC_RECORDING_CHUNKS - 1)
+      pthread_cond_wait(&rec->cond, &rec->mutex);
+  }
+
+  rec->queued++;
+  rec->fill = (rec->fill + 1) % LIBUVC_RECORDING_CHUNKS;
+  rec->fill_bytes = 0;
+  pthread_cond_broadcast(&rec->cond);
+
+  pthread_mutex_unlock(&rec->mutex);
+}
+
+static void _uvc_recorder_append(uvc_recorder_t *rec, const void *data, size_t len) {
+  const uint8_t *src = data;
+  size_t n;
+
+  while (len) {
+    n = LIBUVC_RECORDING_CHUNK_SIZE - rec->fill_bytes;
+    if (n > len)
+      n = len;
+    /* Only the writer reads the other chunks; this one is ours */
+    memcpy(rec->chunks[rec->fill] + rec->fill_bytes, src, n);
+    rec->fill_bytes += n;
+    src += n;
+    len -= n;
+
+    if (rec->fill_bytes == LIBUVC_RECORDING_CHUNK_SIZE)
+      _uvc_recorder_queue(rec);
+  }
+}
+
+/** @brief Create a frame recording
+ * @ingroup streaming
+ *
+ * The file is reserved at its full size up front, so a recording can't run
+ * out of disk part way, and is cut down to what was recorded on
+ * uvc_recorder_close(). Frames are added with uvc_recorder_write(), or by
+ * passing uvc_recorder_callback() to uvc_stream_start(), and played back
+ * with uvc_stream_start_playback().
+ *
+ * @param[out] rec New recorder
+ * @param path File to create or truncate
+ * @param capacity Bytes of frames and metadata the file holds
+ * @param max_frames Frames the file's index holds
+ * @param flags UVC_RECORDER_DIRECT to write with O_DIRECT, bypassing the page
+ *              cache (Linux; not every file system supports it)
+ * @return UVC_ERROR_NOT_SUPPORTED if O_DIRECT was asked for and isn't available
+ */
+uvc_error_t uvc_recorder_create(
+    uvc_recorder_t **rec,
+    const char *path,
+    uint64_t capacity,
+    uint32_t max_frames,
+    uint8_t flags) {
+  struct uvc_recording_header *hdr;
+  uvc_recorder_t *r;
+  uint64_t data_offset;
+  uvc_error_t ret;
+  int open_flags = O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC;
+  int i, err;
+
+  if (!rec || !path || !capacity || !max_frames)
+    return UVC_ERROR_INVALID_PARAM;
+
+  /* Room to pad the last write to a whole page */
+  capacity = LIBUVC_RECORDING_PAGE_UP(capacity);
+  data_offset = LIBUVC_RECORDING_PAGE +
+    LIBUVC_RECORDING_PAGE_UP((uint64_t) max_frames * sizeof(struct uvc_recording_entry));
+
+  r = calloc(1, sizeof(*r));
+  if (!r)
+    return UVC_ERROR_NO_MEM;
+  r->fd = -1;
+
+  if (flags & UVC_RECORDER_DIRECT) {
+#ifdef O_DIRECT
+    open_flags |= O_DIRECT;
+    r->direct = 1;
+#else
+    ret = UVC_ERROR_NOT_SUPPORTED;
+    goto fail;
+#endif
+  }
+
+  r->fd = open(path, open_flags, 0644);
+  if (r->fd < 0) {
+    ret = errno == EINVAL && r->direct ? UVC_ERROR_NOT_SUPPORTED :
+      errno == EACCES ? UVC_ERROR_ACCESS : UVC_ERROR_IO;
+    goto fail;
+  }
+
+#ifndef __APPLE__
+  err = posix_fallocate(r->fd, 0, data_offset + capacity);
+  /* File systems that can't reserve space still take a sparse file */
+  if (err == EINVAL || err == EOPNOTSUPP)
+    err = ftruncate(r->fd, data_offset + capacity) < 0 ? errno : 0;
+#else
+  err = ftruncate(r->fd, data_offset + capacity) < 0 ? errno : 0;
+#endif
+  if (err) {
+    ret = UVC_ERROR_IO;
+    goto fail;
+  }
+
+  hdr = mmap(NULL, data_offset, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+  if (hdr == MAP_FAILED) {
+    ret = UVC_ERROR_NO_MEM;
+    goto fail;
+  }
+  r->hdr = hdr;
+  r->index = (struct uvc_recording_entry *) ((uint8_t *) hdr + LIBUVC_RECORDING_PAGE);
+  r->map_size = data_offset;
+  r->capacity = capacity;
+
+  for (i = 0; i < LIBUVC_RECORDING_CHUNKS; i++) {
+    if (posix_memalign((void **) &r->chunks[i], LIBUVC_RECORDING_PAGE,
+                       LIBUVC_RECORDING_CHUNK_SIZE)) {
+      r->chunks[i] = NULL;
+      ret = UVC_ERROR_NO_MEM;
+      goto fail;
+    }
+  }
+
+  /* The reserved pages read as zero: no frames yet */
+  hdr->version = LIBUVC_RECORDING_VERSION;
+  hdr->header_size = LIBUVC_RECORDING_PAGE;
+  hdr->entry_size = sizeof(struct uvc_recording_entry);
+  hdr->index_capacity = max_frames;
+  hdr->data_offset = data_offset;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(hdr->magic, LIBUVC_RECORDING_MAGIC, sizeof(hdr->magic));
+
+  pthread_mutex_init(&r->mutex, NULL);
+  pthread_cond_init(&r->cond, NULL);
+  if (pthread_create(&r->writer, NULL, _uvc_recorder_writer, r)) {
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->mutex);
+    ret = UVC_ERROR_OTHER;
+    goto fail;
+  }
+
+  *rec = r;
+  return UVC_SUCCESS;
+
+fail:
+  for (i = 0; i < LIBUVC_RECORDING_CHUNKS; i++)
+    free(r->chunks[i]);
+  if (r->hdr)
+    munmap(r->hdr, r->map_size);
+  if (r->fd >= 0)
+    close(r->fd);
+  free(r);
+  return ret;
+}
+
+/** @brief Append a frame to a recording
+ * @ingroup streaming
+ *
+ * Copies the frame's image, metadata, format, size, sequence number and
+ * timestamps. Writing to disk happens on the recorder's own thread; this
+ * only waits for it when it falls a few megabytes behind. Call from one
+ * thread at a time.
+ *
+ * @return UVC_ERROR_OVERFLOW if the recording is full, or the error that
+ * stopped writing
+ */
+uvc_error_t uvc_recorder_write(uvc_recorder_t *rec, const uvc_frame_t *frame) {
+  static const uint8_t pad[8];
+  struct uvc_recording_entry *e;
+  size_t metadata_bytes = frame->metadata ? frame->metadata_bytes : 0;
+  uint64_t size = (uint64_t) frame->data_bytes + metadata_bytes;
+  uint64_t padded = (size + 7) & ~(uint64_t) 7;
+  uvc_error_t ret;
+
+  pthread_mutex_lock(&rec->mutex);
+  ret = rec->error;
+  if (ret == UVC_SUCCESS &&
+      (rec->frames_appended == rec->hdr->index_capacity ||
+       padded > rec->capacity - rec->appended ||
+       frame->data_bytes > UINT32_MAX || metadata_bytes > UINT32_MAX)) {
+    rec->stats.dropped++;
+    ret = UVC_ERROR_OVERFLOW;
+  }
+  pthread_mutex_unlock(&rec->mutex);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  e = &rec->index[rec->frames_appended];
+  e->offset = rec->appended;
+  e->data_bytes = frame->data_bytes;
+  e->metadata_bytes = metadata_bytes;
+  e->frame_format = frame->frame_format;
+  e->width = frame->width;
+  e->height = frame->height;
+  e->step = frame->step;
+  e->sequence = frame->sequence;
+  e->pts = frame->pts;
+  e->scr = frame->scr;
+  e->capture_time_us = (int64_t) frame->capture_time.tv_sec * 1000000 +
+    frame->capture_time.tv_usec;
+  e->capture_time_finished_ns = (uint64_t) frame->capture_time_finished.tv_sec * 1000000000ULL +
+    frame->capture_time_finished.tv_nsec;
+
+  _uvc_recorder_append(rec, frame->data, frame->data_bytes);
+  _uvc_recorder_append(rec, frame->metadata, metadata_bytes);
+  _uvc_recorder_append(rec, pad, padded - size);
+  rec->appended += padded;
+
+  pthread_mutex_lock(&rec->mutex);
+  rec->frames_appended++;
+  rec->stats.frames++;
+  rec->stats.bytes += size;
+  pthread_mutex_unlock(&rec->mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Frame callback that appends every frame to a recording
+ * @ingroup streaming
+ *
+ * Pass to uvc_stream_start() with the recorder as the user pointer.
+ */
+void uvc_recorder_callback(uvc_frame_t *frame, void *rec) {
+  uvc_recorder_write(rec, frame);
+}
+
+/** @brief Get the counters of a recorder
+ * @ingroup streaming
+ */
+void uvc_recorder_get_stats(uvc_recorder_t *rec, uvc_recorder_stats_t *stats) {
+  pthread_mutex_lock(&rec->mutex);
+  *stats = rec->stats;
+  pthread_mutex_unlock(&rec->mutex);
+}
+
+/** @brief Finish a recording
+ * @ingroup streaming
+ *
+ * Writes what is left, cuts the file down to the frames recorded and frees
+ * the recorder. Stop the stream first if it records through
+ * uvc_recorder_callback().
+ *
+ * @return The first error writing the file
+ */
+uvc_error_t uvc_recorder_close(uvc_recorder_t *rec) {
+  uvc_error_t ret;
+  size_t len;
+  int i;
+
+  pthread_mutex_lock(&rec->mutex);
+  rec->stop = 1;
+  pthread_cond_broadcast(&rec->cond);
+  pthread_mutex_unlock(&rec->mutex);
+  /* The writer drains the queue before it exits */
+  pthread_join(rec->writer, NULL);
+
+  ret = rec->error;
+  if (ret == UVC_SUCCESS && rec->fill_bytes) {
+    len = rec->fill_bytes;
+    if (rec->direct) {
+      len = LIBUVC_RECORDING_PAGE_UP(len);
+      memset(rec->chunks[rec->fill] + rec->fill_bytes, 0, len - rec->fill_bytes);
+    }
+    ret = _uvc_recorder_pwrite(rec, rec->chunks[rec->fill], len, rec->written);
+    if (ret == UVC_SUCCESS)
+      rec->written += rec->fill_bytes;
+  }
+  _uvc_recorder_commit(rec);
+
+  if (ftruncate(rec->fd, rec->hdr->data_offset + rec->written) < 0 && ret == UVC_SUCCESS)
+    ret = UVC_ERROR_IO;
+  if (msync(rec->hdr, rec->map_size, MS_SYNC) < 0 && ret == UVC_SUCCESS)
+    ret = UVC_ERROR_IO;
+  munmap(rec->hdr, rec->map_size);
+  if (close(rec->fd) < 0 && ret == UVC_SUCCESS)
+    ret = UVC_ERROR_IO;
+
+  for (i = 0; i < LIBUVC_RECORDING_CHUNKS; i++)
+    free(rec->chunks[i]);
+  pthread_cond_destroy(&rec->cond);
+  pthread_mutex_destroy(&rec->mutex);
+  free(rec);
+
+  return ret;
+}
+
+/** @internal
+ * @brief Map a recording and find the frames that can be played
+ *
+ * Frames that run past the end of the file, as they may in a recording
+ * still being made, end the recording.
+ */
+static uvc_error_t _uvc_recording_map(const char *path, struct uvc_recording_map *map) {
+  const struct uvc_recording_header *hdr;
+  struct stat st;
+  uint64_t frames, avail, i;
+  void *data;
+  int fd;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return errno == EACCES ? UVC_ERROR_ACCESS : UVC_ERROR_IO;
+
+  if (fstat(fd, &st) < 0 || st.st_size < LIBUVC_RECORDING_PAGE) {
+    close(fd);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return UVC_ERROR_NO_MEM;
+
+  map->data = data;
+  map->size = st.st_size;
+  hdr = data;
+
+  if (memcmp(hdr->magic, LIBUVC_RECORDING_MAGIC, sizeof(hdr->magic)) ||
+      hdr->version != LIBUVC_RECORDING_VERSION ||
+      hdr->header_size < sizeof(*hdr) || hdr->header_size % 8 ||
+      hdr->entry_size != sizeof(struct uvc_recording_entry) ||
+      hdr->data_offset > map->size || hdr->header_size > hdr->data_offset ||
+      (uint64_t) hdr->index_capacity * hdr->entry_size > hdr->data_offset - hdr->header_size) {
+    munmap(map->data, map->size);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  map->index = (const struct uvc_recording_entry *) (map->data + hdr->header_size);
+  map->frame_data = map->data + hdr->data_offset;
+
+  frames = __atomic_load_n(&hdr->frames, __ATOMIC_ACQUIRE);
+  if (frames > hdr->index_capacity)
+    frames = hdr->index_capacity;
+  avail = map->size - hdr->data_offset;
+  for (i = 0; i < frames; i++) {
+    const struct uvc_recording_entry *e = &map->index[i];
+
+    if (e->offset > avail ||
+        (uint64_t) e->data_bytes + e->metadata_bytes > avail - e->offset)
+      break;
+  }
+  map->frames = i;
+
+  madvise(map->data, map->size, MADV_SEQUENTIAL);
+  return UVC_SUCCESS;
+}
+
+/** @brief Describe a frame recording
+ * @ingroup streaming
+ *
+ * Works on a recording still being made, counting the frames written so far.
+ *
+ * @param path File written by a uvc_recorder_t
+ * @param[out] info Frames, size and duration of the recording
+ */
+uvc_error_t uvc_recording_get_info(const char *path, uvc_recording_info_t *info) {
+  struct uvc_recording_map map;
+  const struct uvc_recording_entry *first, *last;
+  uint64_t i;
+  uvc_error_t ret;
+
+  ret = _uvc_recording_map(path, &map);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  memset(info, 0, sizeof(*info));
+  info->frames = map.frames;
+  for (i = 0; i < map.frames; i++)
+    info->bytes += (uint64_t) map.index[i].data_bytes + map.index[i].metadata_bytes;
+
+  if (map.frames) {
+    first = &map.index[0];
+    last = &map.index[map.frames - 1];
+    info->frame_format = first->frame_format;
+    info->width = first->width;
+    info->height = first->height;
+    if (last->capture_time_finished_ns > first->capture_time_finished_ns)
+      info->duration_ns = last->capture_time_finished_ns - first->capture_time_finished_ns;
+  }
+
+  munmap(map.data, map.size);
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Wait until the consumer has taken the frame being held
+ * @return 0 if playback was stopped
+ */
+static int _uvc_playback_wait_taken(uvc_stream_handle_t *strmh, struct uvc_playback *pb) {
+  int stopped;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  while (!pb->stop &&
+         (strmh->user_cb ? strmh->user_seq : strmh->last_polled_seq) != strmh->hold_seq)
+    pthread_cond_wait(&strmh->cb_cond, &strmh->cb_mutex);
+  stopped = pb->stop;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return !stopped;
+}
+
+/** @internal
+ * @brief Sleep until CLOCK_MONOTONIC reaches @a when_ns
+ * @return 0 if playback was stopped
+ */
+static int _uvc_playback_wait_until(uvc_stream_handle_t *strmh, struct uvc_playback *pb,
+                                    uint64_t when_ns) {
+  struct timespec deadline;
+  uint64_t now = _uvc_recording_now_ns(), wait_ns;
+  int stopped;
+
+  if (now < when_ns) {
+    wait_ns = when_ns - now;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    wait_ns += deadline.tv_nsec;
+    deadline.tv_sec += wait_ns / 1000000000ULL;
+    deadline.tv_nsec = wait_ns % 1000000000ULL;
+  }
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  while (!pb->stop && _uvc_recording_now_ns() < when_ns) {
+    if (pthread_cond_timedwait(&strmh->cb_cond, &strmh->cb_mutex, &deadline))
+      break;
+  }
+  stopped = pb->stop;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return !stopped;
+}
+
+/** @internal
+ * @brief Hand the recorded frames to the stream's consumer in turn
+ */
+static void *_uvc_playback_thread(void *arg) {
+  uvc_stream_handle_t *strmh = arg;
+  struct uvc_playback *pb = strmh->playback;
+  const struct uvc_recording_entry *e;
+  uint64_t i = 0, start_ns, base_ns;
+
+  start_ns = _uvc_recording_now_ns();
+  base_ns = pb->map.frames ? pb->map.index[0].capture_time_finished_ns : 0;
+
+  while (i < pb->map.frames) {
+    e = &pb->map.index[i];
+
+    if (pb->flags & UVC_PLAYBACK_REALTIME) {
+      uint64_t offset = e->capture_time_finished_ns > base_ns ?
+        e->capture_time_finished_ns - base_ns : 0;
+
+      if (!_uvc_playback_wait_until(strmh, pb, start_ns + offset))
+        break;
+    } else if (!_uvc_playback_wait_taken(strmh, pb)) {
+      break;
+    }
+
+    pthread_mutex_lock(&strmh->cb_mutex);
+    pb->hold = e;
+    strmh->frames_assembled++;
+    /* Recorded sequence numbers, as long as they keep increasing */
+    strmh->hold_seq = e->sequence > strmh->hold_seq ? e->sequence : strmh->hold_seq + 1;
+    strmh->hold_bytes = e->data_bytes;
+    strmh->hold_has_image = 1;
+    strmh->hold_roi = 0;
+    pthread_cond_broadcast(&strmh->cb_cond);
+    pthread_mutex_unlock(&strmh->cb_mutex);
+
+    if (++i == pb->map.frames && (pb->flags & UVC_PLAYBACK_LOOP)) {
+      i = 0;
+      start_ns = _uvc_recording_now_ns();
+    }
+  }
+
+  /* Once the last frame is taken the stream stops by itself */
+  _uvc_playback_wait_taken(strmh, pb);
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->running = 0;
+  pthread_cond_broadcast(&strmh->cb_cond);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  /* Done means the callback has returned from the last frame too */
+  if (strmh->user_cb) {
+    pthread_join(strmh->cb_thread, NULL);
+    pb->cb_joined = 1;
+  }
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  pb->done = 1;
+  pthread_cond_broadcast(&strmh->cb_cond);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Populate the stream's frame from the recorded frame being held
+ * @note Must be called with cb_mutex held
+ */
+void _uvc_playback_populate_frame(uvc_stream_handle_t *strmh) {
+  struct uvc_playback *pb = strmh->playback;
+  const struct uvc_recording_entry *e = pb->hold;
+  const uint8_t *data = pb->map.frame_data + e->offset;
+  uvc_frame_t *frame = &strmh->frame;
+
+  frame->frame_format = e->frame_format;
+  frame->width = e->width;
+  frame->height = e->height;
+  frame->step = e->step;
+  frame->sequence = strmh->hold_seq;
+  frame->pts = e->pts;
+  frame->scr = e->scr;
+  frame->capture_time.tv_sec = e->capture_time_us / 1000000;
+  frame->capture_time.tv_usec = e->capture_time_us % 1000000;
+  frame->capture_time_finished.tv_sec = e->capture_time_finished_ns / 1000000000ULL;
+  frame->capture_time_finished.tv_nsec = e->capture_time_finished_ns % 1000000000ULL;
+
+  /* The frame's buffer rotates with the stream's assembly buffers */
+  if (strmh->frame_buf_size < e->data_bytes) {
+    void *buf = _uvc_buf_realloc(strmh->devh->dev->ctx, frame->data, e->data_bytes);
+
+    if (!buf) {
+      frame->data_bytes = 0;
+      frame->metadata_bytes = 0;
+      return;
+    }
+    frame->data = buf;
+    strmh->frame_buf_size = e->data_bytes;
+  }
+  frame->data_bytes = e->data_bytes;
+  memcpy(frame->data, data, e->data_bytes);
+
+  /* Sized for the largest recorded metadata when playback started */
+  frame->metadata_bytes = e->metadata_bytes;
+  memcpy(frame->metadata, data + e->data_bytes, e->metadata_bytes);
+}
+
+/** @brief Play a frame recording through a stream
+ * @ingroup streaming
+ *
+ * The stream runs from the recording instead of the device: the recorded
+ * frames go to @a cb from the usual callback thread or, with no callback, to
+ * uvc_stream_get_frame(), each with its recorded format, size, metadata and
+ * timestamps. By default a frame is handed over once the last one has been
+ * taken, so playback runs as fast as the consumer and drops nothing. Once
+ * the last frame is taken the stream stops by itself: the callback isn't
+ * called again and uvc_stream_get_frame() fails as on any stopped stream.
+ * uvc_stream_wait_playback() waits for that, and uvc_stream_stop() ends
+ * playback early; one of uvc_stream_stop() and uvc_stream_close() is still
+ * needed after the end. Any mode the device has will do, as the stream's
+ * mode isn't used, so the simulated camera can stand in for the one that
+ * was recorded.
+ *
+ * @param strmh Stream handle that isn't running
+ * @param path File written by a uvc_recorder_t
+ * @param cb User callback function, or NULL to poll with uvc_stream_get_frame()
+ * @param user_ptr User data for @a cb
+ * @param flags UVC_PLAYBACK_REALTIME to keep the recorded timing, dropping
+ *              frames the consumer is too slow for as a live stream does;
+ *              UVC_PLAYBACK_LOOP to start over at the end until stopped
+ * @return Error if the recording is unreadable or the stream is running
+ */
+uvc_error_t uvc_stream_start_playback(
+    uvc_stream_handle_t *strmh,
+    const char *path,
+    uvc_frame_callback_t *cb,
+    void *user_ptr,
+    uint8_t flags) {
+  struct uvc_playback *pb;
+  size_t metadata_size = 0;
+  uint64_t i;
+  uvc_error_t ret;
+
+  if (strmh->running || strmh->playback)
+    return UVC_ERROR_BUSY;
+
+  pb = calloc(1, sizeof(*pb));
+  if (!pb)
+    return UVC_ERROR_NO_MEM;
+  pb->flags = flags;
+
+  ret = _uvc_recording_map(path, &pb->map);
+  if (ret != UVC_SUCCESS) {
+    free(pb);
+    return ret;
+  }
+
+  for (i = 0; i < pb->map.frames; i++)
+    if (pb->map.index[i].metadata_bytes > metadata_size)
+      metadata_size = pb->map.index[i].metadata_bytes;
+  ret = _uvc_grow_meta_bufs(strmh, metadata_size);
+  if (ret != UVC_SUCCESS)
+    goto fail;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->hold_seq = 0;
+  strmh->user_seq = 0;
+  strmh->last_polled_seq = 0;
+  strmh->hold_bytes = 0;
+  strmh->hold_has_image = 0;
+  strmh->playback = pb;
+  strmh->running = 1;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  strmh->user_cb = cb;
+  strmh->user_ptr = user_ptr;
+  if (cb && pthread_create(&strmh->cb_thread, NULL, _uvc_user_caller, (void*) strmh)) {
+    ret = UVC_ERROR_OTHER;
+    goto detach;
+  }
+  if (pthread_create(&pb->thread, NULL, _uvc_playback_thread, (void*) strmh)) {
+    ret = UVC_ERROR_OTHER;
+    if (cb) {
+      pthread_mutex_lock(&strmh->cb_mutex);
+      strmh->running = 0;
+      pthread_cond_broadcast(&strmh->cb_cond);
+      pthread_mutex_unlock(&strmh->cb_mutex);
+      pthread_join(strmh->cb_thread, NULL);
+    }
+    goto detach;
+  }
+
+  return UVC_SUCCESS;
+
+detach:
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->running = 0;
+  strmh->playback = NULL;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+fail:
+  munmap(pb->map.data, pb->map.size);
+  free(pb);
+  return ret;
+}
+
+/** @brief Wait for a recording to play out
+ * @ingroup streaming
+ *
+ * @param strmh Stream started with uvc_stream_start_playback()
+ * @param timeout_us >0: Wait at most N microseconds; 0: Wait indefinitely;
+ *                   -1: return immediately
+ * @return UVC_SUCCESS once the last frame has been taken, UVC_ERROR_TIMEOUT
+ * before then, UVC_ERROR_INVALID_PARAM if the stream isn't playing a
+ * recording
+ */
+uvc_error_t uvc_stream_wait_playback(uvc_stream_handle_t *strmh, int32_t timeout_us) {
+  struct uvc_playback *pb = strmh->playback;
+  struct timespec deadline;
+  uint64_t wait_ns;
+  int done;
+
+  if (!pb)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (timeout_us > 0) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    wait_ns = (uint64_t) timeout_us * 1000 + deadline.tv_nsec;
+    deadline.tv_sec += wait_ns / 1000000000ULL;
+    deadline.tv_nsec = wait_ns % 1000000000ULL;
+  }
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  while (!pb->done && timeout_us != -1) {
+    if (timeout_us == 0)
+      pthread_cond_wait(&strmh->cb_cond, &strmh->cb_mutex);
+    else if (pthread_cond_timedwait(&strmh->cb_cond, &strmh->cb_mutex, &deadline))
+      break;
+  }
+  done = pb->done;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return done ? UVC_SUCCESS : UVC_ERROR_TIMEOUT;
+}
+
+/** @internal
+ * @brief End playback and detach the recording from the stream
+ */
+uvc_error_t _uvc_playback_stop(uvc_stream_handle_t *strmh) {
+  struct uvc_playback *pb = strmh->playback;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  pb->stop = 1;
+  strmh->running = 0;
+  pthread_cond_broadcast(&strmh->cb_cond);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  pthread_join(pb->thread, NULL);
+  if (strmh->user_cb && !pb->cb_joined)
+    pthread_join(strmh->cb_thread, NULL);
+
+  /* Nothing the device's buffers could be mistaken for is left held */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->playback = NULL;
+  strmh->hold_bytes = 0;
+  strmh->hold_has_image = 0;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  munmap(pb->map.data, pb->map.size);
+  free(pb);
+  return UVC_SUCCESS;
+}
+
+#else /* _WIN32 */
+
+uvc_error_t uvc_recorder_create(uvc_recorder_t **rec, const char *path, uint64_t capacity,
+                                uint32_t max_frames, uint8_t flags) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_recorder_write(uvc_recorder_t *rec, const uvc_frame_t *frame) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+void uvc_recorder_callback(uvc_frame_t *frame, void *rec) {
+}
+
+void uvc_recorder_get_stats(uvc_recorder_t *rec, uvc_recorder_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+}
+
+uvc_error_t uvc_recorder_close(uvc_recorder_t *rec) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_recording_get_info(const char *path, uvc_recording_info_t *info) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_stream_start_playback(uvc_stream_handle_t *strmh, const char *path,
+                                      uvc_frame_callback_t *cb, void *user_ptr,
+                                      uint8_t flags) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_stream_wait_playback(uvc_stream_handle_t *strmh, int32_t timeout_us) {
+  return UVC_ERROR_INVALID_PARAM;
+}
+
+void _uvc_playback_populate_frame(uvc_stream_handle_t *strmh) {
+}
+
+uvc_error_t _uvc_playback_stop(uvc_stream_handle_t *strmh) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+#endif /* _WIN32 */
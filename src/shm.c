@@ -0,0 +1,739 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @defgroup shm Shared-memory frame rings
+ * @brief Sharing one camera's frames with other processes
+ *
+ * A publisher copies each frame it is given into the next slot of a ring
+ * in POSIX shared memory, named (shm_open) or anonymous (memfd, Linux).
+ * Readers in any process map the ring and read frames in place. Each slot
+ * is guarded by a sequence lock: the publisher never waits for readers, and
+ * a reader finds out on release whether the slot was overwritten while it
+ * held it. Readers pick their own drop policy, so a slow consumer only
+ * loses its own frames.
+ *
+ * The ring is a uvc_shm_ring_header followed by num_slots slots, each a
+ * uvc_shm_slot_header and slot_bytes of frame data. Fields are fixed-size,
+ * in host byte order, so publisher and readers needn't be the same build.
+ *
+ * Readers map the ring read-only and never write to it. Neither side trusts
+ * the layout in the shared header after setting it up or checking it: each
+ * keeps its own copy, so a reader that scribbles on the ring can garble
+ * frames but can't steer the publisher's copies. Anonymous rings are sealed
+ * against resizing, and readers are handed a read-only descriptor where the
+ * system allows it.
+ */
+/* memfd_create */
+#define _GNU_SOURCE
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define LIBUVC_SHM_MAGIC "UVCRING"
+#define LIBUVC_SHM_VERSION 2
+#define LIBUVC_SHM_ALIGN 64
+#define LIBUVC_SHM_ALIGN_UP(x) (((x) + LIBUVC_SHM_ALIGN - 1) & ~(uint64_t) (LIBUVC_SHM_ALIGN - 1))
+
+struct uvc_shm_ring_header {
+  char magic[8];
+  uint32_t version;
+  /** Offset of the first slot */
+  uint32_t header_size;
+  uint32_t num_slots;
+  /** Offset of the data within a slot */
+  uint32_t slot_header_size;
+  /** Distance between slots */
+  uint64_t slot_stride;
+  /** Frame data capacity of a slot */
+  uint64_t slot_bytes;
+  /** Frames published; frame i is in slot i % num_slots */
+  uint64_t write_count;
+  /** Bumped after every frame, for readers to sleep on */
+  uint32_t wake;
+  uint32_t reserved1;
+  /** Set when the publisher is destroyed */
+  uint32_t closed;
+  uint32_t reserved0;
+};
+
+struct uvc_shm_slot_header {
+  /** Odd while the publisher writes the slot */
+  uint32_t seq;
+  uint32_t frame_format;
+  /** Publication index of the frame in the slot */
+  uint64_t index;
+  uint64_t data_bytes;
+  uint64_t step;
+  uint32_t width;
+  uint32_t height;
+  uint32_t sequence;
+  uint32_t pts;
+  uint32_t scr;
+  uint32_t reserved0;
+  int64_t capture_sec;
+  int64_t capture_usec;
+  int64_t finished_sec;
+  int64_t finished_nsec;
+};
+
+#ifndef _WIN32
+
+/* Private copy of a ring's layout */
+struct uvc_shm_layout {
+  uint64_t header_size;
+  uint64_t slot_header_size;
+  uint64_t slot_stride;
+  uint64_t slot_bytes;
+  uint32_t num_slots;
+};
+
+struct uvc_shm_publisher {
+  /** Serializes publishers, e.g. the workers of a pipeline sink stage */
+  pthread_mutex_t mutex;
+  struct uvc_shm_ring_header *ring;
+  struct uvc_shm_layout layout;
+  /** Frames published, mirrored to ring->write_count */
+  uint64_t write_count;
+  size_t size;
+  int fd;
+  /** Read-only descriptor of the same ring for readers, or -1 */
+  int reader_fd;
+  /** shm_open name, unlinked on destroy; NULL for a memfd */
+  char *name;
+};
+
+struct uvc_shm_reader {
+  const struct uvc_shm_ring_header *ring;
+  struct uvc_shm_layout layout;
+  size_t size;
+  enum uvc_shm_read_policy policy;
+  /** Publication index of the next frame to read */
+  uint64_t next;
+  /** Slot held between acquire and release, and its sequence then */
+  const struct uvc_shm_slot_header *held;
+  uint32_t held_seq;
+  uvc_shm_reader_stats_t stats;
+};
+
+static struct uvc_shm_slot_header *_uvc_shm_slot(const void *ring,
+                                                 const struct uvc_shm_layout *layout,
+                                                 uint64_t index) {
+  return (struct uvc_shm_slot_header *) ((uint8_t *) ring + layout->header_size +
+                                         (index % layout->num_slots) * layout->slot_stride);
+}
+
+static void _uvc_shm_wake(struct uvc_shm_ring_header *ring) {
+  __atomic_add_fetch(&ring->wake, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+  /* Readers can't write to the ring to say they are waiting */
+  syscall(SYS_futex, &ring->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/** @internal
+ * @brief Sleep until the ring's wake counter moves past @p seen or the
+ * deadline (NULL: none) passes
+ */
+static void _uvc_shm_wait(const struct uvc_shm_ring_header *ring, uint32_t seen,
+                          const struct timespec *deadline) {
+  struct timespec now, rel = { 0, 1000000 };
+
+  if (deadline) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    rel.tv_sec = deadline->tv_sec - now.tv_sec;
+    rel.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (rel.tv_nsec < 0) {
+      rel.tv_nsec += 1000000000;
+      rel.tv_sec--;
+    }
+    if (rel.tv_sec < 0)
+      return;
+  }
+
+#ifdef __linux__
+  /* Not a private futex: the waiters are in other processes. Waiting only
+   * reads the word, so the read-only mapping will do. */
+  syscall(SYS_futex, &ring->wake, FUTEX_WAIT, seen, deadline ? &rel : NULL, NULL, 0);
+#else
+  (void) seen;
+  if (!deadline || rel.tv_sec > 0 || rel.tv_nsec > 1000000) {
+    rel.tv_sec = 0;
+    rel.tv_nsec = 1000000;
+  }
+  nanosleep(&rel, NULL);
+#endif
+}
+
+/** @brief Create a shared-memory ring and become its publisher
+ * @ingroup shm
+ *
+ * A named ring is only as safe as its permissions: a process that may
+ * write to it can truncate it under the publisher. Anonymous rings are
+ * sealed against that.
+ *
+ * @param[out] pub New publisher
+ * @param name shm_open() name such as "/camera0", replacing any ring of that
+ *             name; NULL for an anonymous ring whose descriptor
+ *             (uvc_shm_publisher_get_fd()) is passed to readers, e.g. over a
+ *             UNIX socket (Linux only)
+ * @param num_slots Frames the ring holds, at least 2. More slots give slow
+ *                  readers longer before their frames are overwritten.
+ * @param slot_bytes Largest frame, e.g. the stream's dwMaxVideoFrameSize
+ */
+uvc_error_t uvc_shm_publisher_create(
+    uvc_shm_publisher_t **pub,
+    const char *name,
+    uint32_t num_slots,
+    size_t slot_bytes) {
+  uvc_shm_publisher_t *p;
+  struct uvc_shm_ring_header *ring;
+  uint64_t header_size, slot_header_size, stride, size;
+  uvc_error_t ret;
+
+  if (!pub || num_slots < 2 || !slot_bytes)
+    return UVC_ERROR_INVALID_PARAM;
+
+  header_size = LIBUVC_SHM_ALIGN_UP(sizeof(struct uvc_shm_ring_header));
+  slot_header_size = LIBUVC_SHM_ALIGN_UP(sizeof(struct uvc_shm_slot_header));
+  stride = LIBUVC_SHM_ALIGN_UP(slot_header_size + slot_bytes);
+  if (stride > (SIZE_MAX - header_size) / num_slots)
+    return UVC_ERROR_INVALID_PARAM;
+  size = header_size + stride * num_slots;
+
+  p = calloc(1, sizeof(*p));
+  if (!p)
+    return UVC_ERROR_NO_MEM;
+  p->fd = -1;
+  p->reader_fd = -1;
+
+  if (name) {
+    p->name = strdup(name);
+    if (!p->name) {
+      ret = UVC_ERROR_NO_MEM;
+      goto fail;
+    }
+    p->fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+  } else {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#ifdef MFD_ALLOW_SEALING
+    p->fd = memfd_create("libuvc-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    p->fd = memfd_create("libuvc-ring", MFD_CLOEXEC);
+#endif
+#else
+    ret = UVC_ERROR_NOT_SUPPORTED;
+    goto fail;
+#endif
+  }
+  if (p->fd < 0) {
+    ret = errno == EACCES ? UVC_ERROR_ACCESS : UVC_ERROR_IO;
+    goto fail;
+  }
+
+  if (ftruncate(p->fd, size) < 0) {
+    ret = UVC_ERROR_NO_MEM;
+    goto fail;
+  }
+
+  if (!name) {
+#ifdef F_ADD_SEALS
+    /* Readers get the same file: none of them may resize it under us */
+    if (fcntl(p->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+      ret = UVC_ERROR_IO;
+      goto fail;
+    }
+#endif
+#ifdef __linux__
+    {
+      /* A descriptor opened read-only can't be mapped writable */
+      char path[32];
+
+      snprintf(path, sizeof(path), "/proc/self/fd/%d", p->fd);
+      p->reader_fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+#endif
+  }
+
+  ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, 0);
+  if (ring == MAP_FAILED) {
+    ret = UVC_ERROR_NO_MEM;
+    goto fail;
+  }
+
+  p->layout.header_size = header_size;
+  p->layout.slot_header_size = slot_header_size;
+  p->layout.slot_stride = stride;
+  p->layout.slot_bytes = slot_bytes;
+  p->layout.num_slots = num_slots;
+
+  /* Fresh pages are zero: every slot is empty and unlocked */
+  ring->version = LIBUVC_SHM_VERSION;
+  ring->header_size = header_size;
+  ring->num_slots = num_slots;
+  ring->slot_header_size = slot_header_size;
+  ring->slot_stride = stride;
+  ring->slot_bytes = slot_bytes;
+  /* Readers check the magic first, so it goes in last */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(ring->magic, LIBUVC_SHM_MAGIC, sizeof(ring->magic));
+
+  pthread_mutex_init(&p->mutex, NULL);
+  p->ring = ring;
+  p->size = size;
+  *pub = p;
+  return UVC_SUCCESS;
+
+fail:
+  if (p->reader_fd >= 0)
+    close(p->reader_fd);
+  if (p->fd >= 0) {
+    close(p->fd);
+    if (p->name)
+      shm_unlink(p->name);
+  }
+  free(p->name);
+  free(p);
+  return ret;
+}
+
+/** @brief Descriptor of the ring, for passing an anonymous ring to readers
+ * @ingroup shm
+ *
+ * Opened read-only where the system allows it. That keeps well-behaved
+ * readers from writing to the ring, though on Linux a process can reopen
+ * it writable through /proc; the publisher's own copy of the layout and the
+ * seals are what protect it. Stays owned by the publisher.
+ */
+int uvc_shm_publisher_get_fd(uvc_shm_publisher_t *pub) {
+  return pub->reader_fd >= 0 ? pub->reader_fd : pub->fd;
+}
+
+/** @brief Copy a frame into the next slot of the ring
+ * @ingroup shm
+ *
+ * Overwrites the oldest frame whether or not every reader has read it.
+ * Safe to call from several threads.
+ *
+ * @return UVC_ERROR_OVERFLOW if the frame is larger than the slots
+ */
+uvc_error_t uvc_shm_publish(uvc_shm_publisher_t *pub, const uvc_frame_t *frame) {
+  struct uvc_shm_ring_header *ring = pub->ring;
+  struct uvc_shm_slot_header *slot;
+  uint64_t index;
+  uint32_t seq;
+
+  if (frame->data_bytes > pub->layout.slot_bytes)
+    return UVC_ERROR_OVERFLOW;
+
+  pthread_mutex_lock(&pub->mutex);
+
+  index = pub->write_count;
+  slot = _uvc_shm_slot(ring, &pub->layout, index);
+
+  /* Odd sequence first, so readers of the frame being replaced notice */
+  seq = slot->seq;
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->frame_format = frame->frame_format;
+  slot->index = index;
+  slot->data_bytes = frame->data_bytes;
+  slot->step = frame->step;
+  slot->width = frame->width;
+  slot->height = frame->height;
+  slot->sequence = frame->sequence;
+  slot->pts = frame->pts;
+  slot->scr = frame->scr;
+  slot->capture_sec = frame->capture_time.tv_sec;
+  slot->capture_usec = frame->capture_time.tv_usec;
+  slot->finished_sec = frame->capture_time_finished.tv_sec;
+  slot->finished_nsec = frame->capture_time_finished.tv_nsec;
+  if (frame->data_bytes)
+    memcpy((uint8_t *) slot + pub->layout.slot_header_size, frame->data, frame->data_bytes);
+
+  __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+  pub->write_count = index + 1;
+  __atomic_store_n(&ring->write_count, index + 1, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&pub->mutex);
+
+  _uvc_shm_wake(ring);
+  return UVC_SUCCESS;
+}
+
+/** @brief Frame callback that publishes each frame to a ring
+ * @ingroup shm
+ *
+ * Pass to uvc_stream_start() or a pipeline sink stage with the publisher
+ * as user_ptr, so frames go from the stream to the ring without another
+ * copy. Frames too large for the slots are dropped.
+ */
+void uvc_shm_publish_callback(uvc_frame_t *frame, void *pub) {
+  uvc_shm_publish((uvc_shm_publisher_t *) pub, frame);
+}
+
+/** @brief Close the ring
+ * @ingroup shm
+ *
+ * Readers are woken and, once they have read what is left, told the
+ * publisher is gone. A named ring is unlinked; readers that have it open
+ * keep their mapping.
+ */
+void uvc_shm_publisher_destroy(uvc_shm_publisher_t *pub) {
+  if (!pub)
+    return;
+
+  __atomic_store_n(&pub->ring->closed, 1, __ATOMIC_RELEASE);
+  _uvc_shm_wake(pub->ring);
+
+  munmap(pub->ring, pub->size);
+  if (pub->reader_fd >= 0)
+    close(pub->reader_fd);
+  close(pub->fd);
+  if (pub->name)
+    shm_unlink(pub->name);
+  pthread_mutex_destroy(&pub->mutex);
+  free(pub->name);
+  free(pub);
+}
+
+/** @brief Map a ring from its descriptor
+ * @ingroup shm
+ *
+ * The descriptor stays owned by the caller and may be closed once this
+ * returns.
+ *
+ * @param[out] reader New reader, starting with the next frame published
+ * @param fd Descriptor of the ring, from shm_open() or a publisher
+ * @param policy Which frames to read
+ */
+uvc_error_t uvc_shm_reader_open_fd(
+    uvc_shm_reader_t **reader,
+    int fd,
+    enum uvc_shm_read_policy policy) {
+  struct uvc_shm_ring_header *ring;
+  struct uvc_shm_layout layout;
+  uvc_shm_reader_t *r;
+  struct stat st;
+
+  if (!reader)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (fstat(fd, &st) < 0)
+    return UVC_ERROR_IO;
+  if (st.st_size < (off_t) sizeof(struct uvc_shm_ring_header))
+    return UVC_ERROR_INVALID_PARAM;
+
+  ring = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (ring == MAP_FAILED)
+    return errno == EACCES ? UVC_ERROR_ACCESS : UVC_ERROR_NO_MEM;
+
+  if (memcmp(ring->magic, LIBUVC_SHM_MAGIC, sizeof(ring->magic))) {
+    munmap(ring, st.st_size);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  /* Checked once and kept, whatever happens to the header later */
+  layout.header_size = ring->header_size;
+  layout.slot_header_size = ring->slot_header_size;
+  layout.slot_stride = ring->slot_stride;
+  layout.slot_bytes = ring->slot_bytes;
+  layout.num_slots = ring->num_slots;
+
+  if (ring->version != LIBUVC_SHM_VERSION || layout.num_slots < 2 ||
+      layout.header_size < sizeof(struct uvc_shm_ring_header) ||
+      layout.slot_header_size < sizeof(struct uvc_shm_slot_header) ||
+      layout.header_size % LIBUVC_SHM_ALIGN || layout.slot_stride % LIBUVC_SHM_ALIGN ||
+      layout.slot_bytes > (uint64_t) st.st_size ||
+      layout.slot_stride < layout.slot_header_size + layout.slot_bytes ||
+      layout.header_size > (uint64_t) st.st_size ||
+      layout.slot_stride > ((uint64_t) st.st_size - layout.header_size) / layout.num_slots) {
+    munmap(ring, st.st_size);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  r = calloc(1, sizeof(*r));
+  if (!r) {
+    munmap(ring, st.st_size);
+    return UVC_ERROR_NO_MEM;
+  }
+
+  r->ring = ring;
+  r->layout = layout;
+  r->size = st.st_size;
+  r->policy = policy;
+  r->next = __atomic_load_n(&ring->write_count, __ATOMIC_ACQUIRE);
+  *reader = r;
+  return UVC_SUCCESS;
+}
+
+/** @brief Map a named ring
+ * @ingroup shm
+ *
+ * @param[out] reader New reader, starting with the next frame published
+ * @param name Name the publisher was created with
+ * @param policy Which frames to read
+ */
+uvc_error_t uvc_shm_reader_open(
+    uvc_shm_reader_t **reader,
+    const char *name,
+    enum uvc_shm_read_policy policy) {
+  uvc_error_t ret;
+  int fd;
+
+  if (!name)
+    return UVC_ERROR_INVALID_PARAM;
+
+  fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0)
+    return errno == ENOENT ? UVC_ERROR_NOT_FOUND :
+      errno == EACCES ? UVC_ERROR_ACCESS : UVC_ERROR_IO;
+
+  ret = uvc_shm_reader_open_fd(reader, fd, policy);
+  close(fd);
+  return ret;
+}
+
+/** @brief Take the next frame from the ring, in place
+ * @ingroup shm
+ *
+ * The frame's data points into the ring. Release it with
+ * uvc_shm_reader_release() before acquiring the next one, and only trust
+ * what was read from it if the release succeeds.
+ *
+ * @param reader Ring reader
+ * @param[out] frame The frame
+ * @param timeout_us >0: Wait at most N microseconds; 0: Wait indefinitely; -1: return immediately
+ * @return UVC_ERROR_TIMEOUT if no frame came in time, UVC_ERROR_NO_DEVICE
+ * once the publisher is gone and every frame has been read
+ */
+uvc_error_t uvc_shm_reader_acquire(
+    uvc_shm_reader_t *reader,
+    uvc_shm_frame_t *frame,
+    int32_t timeout_us) {
+  const struct uvc_shm_ring_header *ring = reader->ring;
+  const struct uvc_shm_layout *layout = &reader->layout;
+  struct timespec deadline;
+
+  if (reader->held)
+    return UVC_ERROR_BUSY;
+
+  if (timeout_us > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_nsec -= 1000000000;
+      deadline.tv_sec++;
+    }
+  }
+
+  for (;;) {
+    uint32_t seen = __atomic_load_n(&ring->wake, __ATOMIC_ACQUIRE);
+    uint64_t published = __atomic_load_n(&ring->write_count, __ATOMIC_ACQUIRE);
+    const struct uvc_shm_slot_header *slot;
+    uint64_t target, index;
+    uint32_t seq;
+
+    if (reader->next >= published) {
+      struct timespec now;
+
+      if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE))
+        return UVC_ERROR_NO_DEVICE;
+      if (timeout_us < 0)
+        return UVC_ERROR_TIMEOUT;
+      if (timeout_us > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline.tv_sec ||
+            (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))
+          return UVC_ERROR_TIMEOUT;
+      }
+      _uvc_shm_wait(ring, seen, timeout_us > 0 ? &deadline : NULL);
+      continue;
+    }
+
+    /* Frames older than a ring's worth are gone */
+    if (reader->policy == UVC_SHM_READ_LATEST)
+      target = published - 1;
+    else if (published - reader->next > layout->num_slots)
+      target = published - layout->num_slots;
+    else
+      target = reader->next;
+
+    reader->stats.dropped += target - reader->next;
+    reader->next = target;
+
+    slot = _uvc_shm_slot(ring, layout, target);
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    index = slot->index;
+
+    frame->data = (const uint8_t *) slot + layout->slot_header_size;
+    frame->data_bytes = slot->data_bytes;
+    frame->width = slot->width;
+    frame->height = slot->height;
+    frame->frame_format = (enum uvc_frame_format) slot->frame_format;
+    frame->step = slot->step;
+    frame->sequence = slot->sequence;
+    frame->capture_time.tv_sec = slot->capture_sec;
+    frame->capture_time.tv_usec = slot->capture_usec;
+    frame->capture_time_finished.tv_sec = slot->finished_sec;
+    frame->capture_time_finished.tv_nsec = slot->finished_nsec;
+    frame->pts = slot->pts;
+    frame->scr = slot->scr;
+    frame->index = target;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if ((seq & 1) || index != target ||
+        __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq ||
+        frame->data_bytes > layout->slot_bytes) {
+      /* Overwritten under us: the frame is lost */
+      reader->stats.dropped++;
+      reader->next = target + 1;
+      continue;
+    }
+
+    reader->held = slot;
+    reader->held_seq = seq;
+    reader->next = target + 1;
+    return UVC_SUCCESS;
+  }
+}
+
+/** @brief Give back a frame taken with uvc_shm_reader_acquire()
+ * @ingroup shm
+ *
+ * @return UVC_ERROR_OVERFLOW if the publisher overwrote the frame while it
+ * was held, in which case anything read from it must be discarded
+ */
+uvc_error_t uvc_shm_reader_release(uvc_shm_reader_t *reader, uvc_shm_frame_t *frame) {
+  uint32_t seq;
+
+  if (!reader->held)
+    return UVC_ERROR_INVALID_PARAM;
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  seq = __atomic_load_n(&reader->held->seq, __ATOMIC_RELAXED);
+  reader->held = NULL;
+  frame->data = NULL;
+
+  if (seq != reader->held_seq) {
+    reader->stats.torn++;
+    return UVC_ERROR_OVERFLOW;
+  }
+
+  reader->stats.frames++;
+  return UVC_SUCCESS;
+}
+
+/** @brief Get the counters of a ring reader
+ * @ingroup shm
+ */
+void uvc_shm_reader_get_stats(uvc_shm_reader_t *reader, uvc_shm_reader_stats_t *stats) {
+  *stats = reader->stats;
+}
+
+/** @brief Unmap a ring
+ * @ingroup shm
+ */
+void uvc_shm_reader_close(uvc_shm_reader_t *reader) {
+  if (!reader)
+    return;
+
+  munmap((void *) reader->ring, reader->size);
+  free(reader);
+}
+
+#else /* _WIN32 */
+
+uvc_error_t uvc_shm_publisher_create(uvc_shm_publisher_t **pub, const char *name,
+                                     uint32_t num_slots, size_t slot_bytes) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+int uvc_shm_publisher_get_fd(uvc_shm_publisher_t *pub) {
+  return -1;
+}
+
+uvc_error_t uvc_shm_publish(uvc_shm_publisher_t *pub, const uvc_frame_t *frame) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+void uvc_shm_publish_callback(uvc_frame_t *frame, void *pub) {
+}
+
+void uvc_shm_publisher_destroy(uvc_shm_publisher_t *pub) {
+}
+
+uvc_error_t uvc_shm_reader_open(uvc_shm_reader_t **reader, const char *name,
+                                enum uvc_shm_read_policy policy) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_shm_reader_open_fd(uvc_shm_reader_t **reader, int fd,
+                                   enum uvc_shm_read_policy policy) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_shm_reader_acquire(uvc_shm_reader_t *reader, uvc_shm_frame_t *frame,
+                                   int32_t timeout_us) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+uvc_error_t uvc_shm_reader_release(uvc_shm_reader_t *reader, uvc_shm_frame_t *frame) {
+  return UVC_ERROR_NOT_SUPPORTED;
+}
+
+void uvc_shm_reader_get_stats(uvc_shm_reader_t *reader, uvc_shm_reader_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+}
+
+void uvc_shm_reader_close(uvc_shm_reader_t *reader) {
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,553 @@
+/* Streaming soak test.
+ *
+ * Streams every camera it finds for hours, or the simulated camera in
+ * virtual_usb.c in the uvc_virtual_soak build, and prints a CSV row per
+ * camera at every report interval: frames, sequence gaps, frames that failed
+ * the integrity check, latency percentiles, memory and CPU use. At the end
+ * it checks the service-level objectives given on the command line and exits
+ * non-zero if any was missed.
+ *
+ * Latency is the device's own, from the start of capture (PTS) to the
+ * sending of the frame's last timestamped payload (SCR), plus the host's,
+ * from the frame being complete to the callback. Frames without PTS and SCR
+ * only count the host's part.
+ */
+#include "libuvc/libuvc.h"
+#ifdef UVC_SOAK_VIRTUAL
+#include "libuvc/libuvc_virtual.h"
+#endif
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#define MAX_CAMERAS 16
+
+/* Latency histogram: 100 us buckets up to 2 s, then one overflow bucket */
+#define LATENCY_BUCKET_US 100
+#define LATENCY_BUCKETS 20001
+
+struct soak_counters {
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t sequence_gaps;
+  uint64_t incomplete;
+  /* Frames without both PTS and SCR */
+  uint64_t untimed;
+  uint64_t latency_max_us;
+  uint32_t latency[LATENCY_BUCKETS];
+};
+
+struct soak_camera {
+  char name[64];
+  uvc_device_t *dev;
+  uvc_device_handle_t *devh;
+  uvc_stream_handle_t *strmh;
+  uvc_stream_ctrl_t ctrl;
+  /* Exact size of uncompressed frames; zero for MJPEG */
+  size_t expected_bytes;
+  int mjpeg;
+
+  pthread_mutex_t mutex;
+  int started;
+  uint32_t last_sequence;
+  /* Since the start, and since the last report */
+  struct soak_counters total;
+  struct soak_counters window;
+};
+
+struct soak_slo {
+  double max_drop_rate;
+  double max_p99_ms;
+  double min_fps;
+  double max_rss_growth_mb;
+  double max_cpu_pct;
+};
+
+static volatile sig_atomic_t stop_requested;
+
+static void handle_signal(int sig) {
+  (void) sig;
+  stop_requested = 1;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t timespec_ns(const struct timespec *ts) {
+  return (uint64_t) ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* Resident set size in kB, or the peak if the current one is unknown */
+static long rss_kb(void) {
+  FILE *f = fopen("/proc/self/statm", "r");
+  long pages;
+
+  if (f) {
+    if (fscanf(f, "%*d %ld", &pages) == 1) {
+      fclose(f);
+      return pages * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    fclose(f);
+  }
+
+  {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+  }
+}
+
+static uint64_t cpu_ns(void) {
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+    (uint64_t) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+}
+
+/* SOI up front and EOI near the end; some cameras pad after the EOI */
+static int mjpeg_intact(const uint8_t *data, size_t bytes) {
+  size_t pos, tail;
+
+  if (bytes < 4 || data[0] != 0xff || data[1] != 0xd8)
+    return 0;
+
+  tail = bytes > 64 ? bytes - 64 : 0;
+  for (pos = bytes - 1; pos > tail; pos--) {
+    if (data[pos - 1] == 0xff && data[pos] == 0xd9)
+      return 1;
+  }
+
+  return 0;
+}
+
+static void count_latency(struct soak_counters *c, uint64_t latency_us) {
+  uint64_t bucket = latency_us / LATENCY_BUCKET_US;
+
+  c->latency[bucket < LATENCY_BUCKETS - 1 ? bucket : LATENCY_BUCKETS - 1]++;
+  if (latency_us > c->latency_max_us)
+    c->latency_max_us = latency_us;
+}
+
+/* Upper edge of the bucket holding the given percentile, in ms */
+static double latency_percentile_ms(const struct soak_counters *c, double pct) {
+  uint64_t count = 0, wanted;
+  int i;
+
+  if (!c->frames)
+    return 0;
+
+  wanted = (uint64_t) (c->frames * pct / 100);
+  if (wanted < 1)
+    wanted = 1;
+
+  for (i = 0; i < LATENCY_BUCKETS - 1; i++) {
+    count += c->latency[i];
+    if (count >= wanted)
+      return (i + 1) * LATENCY_BUCKET_US / 1e3;
+  }
+
+  return c->latency_max_us / 1e3;
+}
+
+static void count_frame(struct soak_counters *c, const uvc_frame_t *frame, uint32_t gap,
+                        int incomplete, int untimed, uint64_t latency_us) {
+  c->frames++;
+  c->bytes += frame->data_bytes;
+  c->sequence_gaps += gap;
+  c->incomplete += incomplete;
+  c->untimed += untimed;
+  count_latency(c, latency_us);
+}
+
+static void cb(uvc_frame_t *frame, void *ptr) {
+  struct soak_camera *cam = ptr;
+  uint64_t latency_ns = now_ns() - timespec_ns(&frame->capture_time_finished);
+  uint32_t gap = 0;
+  int incomplete, untimed = !frame->pts || !frame->scr;
+
+  if (!untimed && cam->ctrl.dwClockFrequency) {
+    uint32_t ticks = frame->scr - frame->pts;
+
+    latency_ns += (uint64_t) ticks * 1000000000ULL / cam->ctrl.dwClockFrequency;
+  }
+
+  if (cam->mjpeg)
+    incomplete = !mjpeg_intact(frame->data, frame->data_bytes);
+  else
+    incomplete = frame->data_bytes < cam->expected_bytes;
+
+  pthread_mutex_lock(&cam->mutex);
+  if (cam->started && frame->sequence != cam->last_sequence + 1)
+    gap = frame->sequence - cam->last_sequence - 1;
+  cam->started = 1;
+  cam->last_sequence = frame->sequence;
+  count_frame(&cam->total, frame, gap, incomplete, untimed, latency_ns / 1000);
+  count_frame(&cam->window, frame, gap, incomplete, untimed, latency_ns / 1000);
+  pthread_mutex_unlock(&cam->mutex);
+}
+
+static double drop_rate(const struct soak_counters *c) {
+  uint64_t expected = c->frames + c->sequence_gaps;
+
+  return expected ? (double) (c->sequence_gaps + c->incomplete) / expected : 0;
+}
+
+static void print_row(const char *kind, double elapsed_s, double span_s,
+                      struct soak_camera *cam, const struct soak_counters *c,
+                      long rss, double cpu_pct) {
+  uvc_stream_transfer_stats_t xstats;
+
+  memset(&xstats, 0, sizeof(xstats));
+  uvc_stream_get_transfer_stats(cam->strmh, &xstats);
+
+  printf("%s,%.0f,%s,%llu,%.2f,%.2f,%llu,%llu,%llu,%.6f,%.1f,%.1f,%.1f,%u,%ld,%.1f\n",
+         kind, elapsed_s, cam->name, (unsigned long long) c->frames,
+         span_s > 0 ? c->frames / span_s : 0.0,
+         span_s > 0 ? c->bytes / 1e6 / span_s : 0.0,
+         (unsigned long long) c->sequence_gaps, (unsigned long long) c->incomplete,
+         (unsigned long long) c->untimed, drop_rate(c),
+         latency_percentile_ms(c, 50), latency_percentile_ms(c, 99),
+         c->latency_max_us / 1e3, xstats.transfer_errors, rss, cpu_pct);
+  fflush(stdout);
+}
+
+static int check_slo(const char *name, const char *what, double value, double limit,
+                     int upper) {
+  int pass = upper ? value <= limit : value >= limit;
+
+  fprintf(stderr, "%s %s: %s %g %s %g\n", pass ? "PASS" : "FAIL", name, what, value,
+          upper ? "<=" : ">=", limit);
+  return pass;
+}
+
+/* Negotiate the mode and start streaming; the camera is opened already */
+static uvc_error_t start_camera(struct soak_camera *cam, enum uvc_frame_format format,
+                                int width, int height, int fps) {
+  const uvc_format_desc_t *fmt;
+  uvc_error_t res;
+
+  res = uvc_get_stream_ctrl_format_size(cam->devh, &cam->ctrl, format, width, height, fps);
+  if (res < 0) {
+    uvc_perror(res, cam->name);
+    return res;
+  }
+
+  cam->mjpeg = 0;
+  for (fmt = uvc_get_format_descs(cam->devh); fmt; fmt = fmt->next) {
+    if (fmt->bFormatIndex == cam->ctrl.bFormatIndex)
+      cam->mjpeg = fmt->bDescriptorSubtype == UVC_VS_FORMAT_MJPEG;
+  }
+  cam->expected_bytes = cam->mjpeg ? 0 : cam->ctrl.dwMaxVideoFrameSize;
+
+  res = uvc_stream_open_ctrl(cam->devh, &cam->strmh, &cam->ctrl);
+  if (res < 0) {
+    uvc_perror(res, cam->name);
+    return res;
+  }
+
+  res = uvc_stream_start(cam->strmh, cb, cam, 0);
+  if (res < 0) {
+    uvc_perror(res, cam->name);
+    uvc_stream_close(cam->strmh);
+    cam->strmh = NULL;
+  }
+
+  return res;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-f any|yuyv|mjpeg|nv12|gray8] [-w width] [-h height] [-r fps]\n"
+#ifdef UVC_SOAK_VIRTUAL
+          "          [-b] [-l loss_rate] [-s seed]\n"
+#else
+          "          [-n max_cameras]\n"
+#endif
+          "          [-t seconds] [-i report_seconds]\n"
+          "          [-D max_drop_rate] [-L max_p99_ms] [-F min_fps]\n"
+          "          [-M max_rss_growth_mb] [-C max_cpu_percent]\n"
+#ifdef UVC_SOAK_VIRTUAL
+          "  -b  bulk endpoint instead of isochronous\n"
+          "  -l  fraction of payloads the simulated camera loses\n"
+#else
+          "  -n  stream at most this many of the cameras found (default all)\n"
+#endif
+          "  -t  how long to run (default 3600); SIGINT ends the run early\n"
+          "  -i  seconds between report rows (default 60)\n"
+          "  -D  fail if more than this fraction of frames is missing or incomplete\n"
+          "  -L  fail if the 99th percentile latency exceeds this many ms\n"
+          "  -F  fail if a camera delivers fewer frames per second on average\n"
+          "  -M  fail if memory grows by more than this many MB after the first report\n"
+          "  -C  fail if the process uses more CPU on average (100 is one core)\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  static struct soak_camera cameras[MAX_CAMERAS];
+  struct soak_slo slo = { -1, -1, -1, -1, -1 };
+  enum uvc_frame_format format = UVC_FRAME_FORMAT_ANY;
+  int width = 640, height = 480, fps = 30;
+  int seconds = 3600, report_seconds = 60, max_cameras = MAX_CAMERAS;
+  int num_cameras = 0, pass = 1, opt, i;
+  uvc_context_t *ctx;
+  uvc_error_t res;
+  uint64_t start, last_report, next_report, end, cpu_start;
+  long rss_baseline = -1, rss = 0;
+#ifdef UVC_SOAK_VIRTUAL
+  uvc_virtual_config_t config;
+
+  uvc_virtual_default_config(&config);
+  format = config.format;
+#endif
+
+  while ((opt = getopt(argc, argv, "f:w:h:r:bl:s:n:t:i:D:L:F:M:C:")) != -1) {
+    switch (opt) {
+    case 'f':
+      if (!strcmp(optarg, "any"))
+        format = UVC_FRAME_FORMAT_ANY;
+      else if (!strcmp(optarg, "yuyv"))
+        format = UVC_FRAME_FORMAT_YUYV;
+      else if (!strcmp(optarg, "mjpeg"))
+        format = UVC_FRAME_FORMAT_MJPEG;
+      else if (!strcmp(optarg, "nv12"))
+        format = UVC_FRAME_FORMAT_NV12;
+      else if (!strcmp(optarg, "gray8"))
+        format = UVC_FRAME_FORMAT_GRAY8;
+      else {
+        usage(argv[0]);
+        return 2;
+      }
+      break;
+    case 'w':
+      width = atoi(optarg);
+      break;
+    case 'h':
+      height = atoi(optarg);
+      break;
+    case 'r':
+      fps = atoi(optarg);
+      break;
+#ifdef UVC_SOAK_VIRTUAL
+    case 'b':
+      config.transport = UVC_VIRTUAL_BULK;
+      break;
+    case 'l':
+      config.loss_rate = atof(optarg);
+      break;
+    case 's':
+      config.seed = strtoul(optarg, NULL, 0);
+      break;
+#else
+    case 'n':
+      max_cameras = atoi(optarg);
+      if (max_cameras < 1 || max_cameras > MAX_CAMERAS)
+        max_cameras = MAX_CAMERAS;
+      break;
+#endif
+    case 't':
+      seconds = atoi(optarg);
+      break;
+    case 'i':
+      report_seconds = atoi(optarg);
+      break;
+    case 'D':
+      slo.max_drop_rate = atof(optarg);
+      break;
+    case 'L':
+      slo.max_p99_ms = atof(optarg);
+      break;
+    case 'F':
+      slo.min_fps = atof(optarg);
+      break;
+    case 'M':
+      slo.max_rss_growth_mb = atof(optarg);
+      break;
+    case 'C':
+      slo.max_cpu_pct = atof(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (seconds <= 0 || report_seconds <= 0 || width <= 0 || height <= 0 || fps <= 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+#ifdef UVC_SOAK_VIRTUAL
+  if (format == UVC_FRAME_FORMAT_ANY) {
+    fprintf(stderr, "the simulated camera needs a format\n");
+    return 2;
+  }
+  config.format = format;
+  config.width = width;
+  config.height = height;
+  config.fps = fps;
+  res = uvc_virtual_set_config(&config);
+  if (res < 0) {
+    uvc_perror(res, "uvc_virtual_set_config");
+    return 2;
+  }
+#endif
+
+  res = uvc_init(&ctx, NULL);
+  if (res < 0) {
+    uvc_perror(res, "uvc_init");
+    return 2;
+  }
+
+  {
+    uvc_device_t **list;
+
+    res = uvc_get_device_list(ctx, &list);
+    if (res < 0) {
+      uvc_perror(res, "uvc_get_device_list");
+      uvc_exit(ctx);
+      return 2;
+    }
+
+    for (i = 0; list[i] && num_cameras < max_cameras; i++) {
+      struct soak_camera *cam = &cameras[num_cameras];
+      uvc_device_descriptor_t *desc;
+
+      if (uvc_get_device_descriptor(list[i], &desc) < 0)
+        continue;
+      snprintf(cam->name, sizeof(cam->name), "%03u-%03u %04x:%04x",
+               uvc_get_bus_number(list[i]), uvc_get_device_address(list[i]),
+               desc->idVendor, desc->idProduct);
+      uvc_free_device_descriptor(desc);
+
+      res = uvc_open(list[i], &cam->devh);
+      if (res < 0) {
+        uvc_perror(res, cam->name);
+        continue;
+      }
+
+      pthread_mutex_init(&cam->mutex, NULL);
+      if (start_camera(cam, format, width, height, fps) < 0) {
+        pthread_mutex_destroy(&cam->mutex);
+        uvc_close(cam->devh);
+        continue;
+      }
+
+      uvc_ref_device(list[i]);
+      cam->dev = list[i];
+      num_cameras++;
+    }
+
+    uvc_free_device_list(list, 1);
+  }
+
+  if (!num_cameras) {
+    fprintf(stderr, "no camera could be streamed\n");
+    uvc_exit(ctx);
+    return 2;
+  }
+
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  printf("kind,elapsed_s,camera,frames,fps,mb_per_s,sequence_gaps,incomplete,untimed,"
+         "drop_rate,latency_p50_ms,latency_p99_ms,latency_max_ms,transfer_errors,"
+         "rss_kb,cpu_pct\n");
+
+  start = last_report = now_ns();
+  cpu_start = cpu_ns();
+  end = start + (uint64_t) seconds * 1000000000ULL;
+  next_report = start + (uint64_t) report_seconds * 1000000000ULL;
+  {
+    uint64_t last_cpu = cpu_start;
+
+    while (!stop_requested) {
+      uint64_t now = now_ns(), cpu;
+      struct timespec nap = { 0, 100000000 };
+
+      if (now < next_report && now < end) {
+        nanosleep(&nap, NULL);
+        continue;
+      }
+
+      cpu = cpu_ns();
+      rss = rss_kb();
+      if (rss_baseline < 0)
+        rss_baseline = rss;
+
+      for (i = 0; i < num_cameras; i++) {
+        struct soak_camera *cam = &cameras[i];
+        struct soak_counters *window = malloc(sizeof(*window));
+
+        if (!window)
+          continue;
+        pthread_mutex_lock(&cam->mutex);
+        *window = cam->window;
+        memset(&cam->window, 0, sizeof(cam->window));
+        pthread_mutex_unlock(&cam->mutex);
+
+        print_row("interval", (now - start) / 1e9, (now - last_report) / 1e9, cam, window,
+                  rss, (cpu - last_cpu) * 100.0 / (now - last_report));
+        free(window);
+      }
+
+      last_report = now;
+      last_cpu = cpu;
+      next_report += (uint64_t) report_seconds * 1000000000ULL;
+      if (now >= end)
+        break;
+    }
+  }
+
+  {
+    uint64_t now = now_ns();
+    double elapsed = (now - start) / 1e9;
+    double cpu_pct = (cpu_ns() - cpu_start) * 100.0 / (now - start);
+
+    rss = rss_kb();
+    if (rss_baseline < 0)
+      rss_baseline = rss;
+
+    for (i = 0; i < num_cameras; i++) {
+      struct soak_camera *cam = &cameras[i];
+
+      uvc_stream_stop(cam->strmh);
+      print_row("total", elapsed, elapsed, cam, &cam->total, rss, cpu_pct);
+
+      if (slo.max_drop_rate >= 0)
+        pass &= check_slo(cam->name, "drop rate", drop_rate(&cam->total),
+                          slo.max_drop_rate, 1);
+      if (slo.max_p99_ms >= 0)
+        pass &= check_slo(cam->name, "p99 latency ms",
+                          latency_percentile_ms(&cam->total, 99), slo.max_p99_ms, 1);
+      if (slo.min_fps >= 0)
+        pass &= check_slo(cam->name, "fps", cam->total.frames / elapsed, slo.min_fps, 0);
+    }
+
+    if (slo.max_rss_growth_mb >= 0)
+      pass &= check_slo("process", "rss growth MB", (rss - rss_baseline) / 1024.0,
+                        slo.max_rss_growth_mb, 1);
+    if (slo.max_cpu_pct >= 0)
+      pass &= check_slo("process", "cpu %", cpu_pct, slo.max_cpu_pct, 1);
+  }
+
+  for (i = 0; i < num_cameras; i++) {
+    uvc_stream_close(cameras[i].strmh);
+    uvc_close(cameras[i].devh);
+    uvc_unref_device(cameras[i].dev);
+    pthread_mutex_destroy(&cameras[i].mutex);
+  }
+  uvc_exit(ctx);
+
+  return pass ? 0 : 1;
+}
@@ -70,11 +70,16 @@ uvc_frame_desc_t *uvc_find_frame_desc_stream(uvc_stream_handle_t *strmh,
     uint16_t format_id, uint16_t frame_id);
 uvc_frame_desc_t *uvc_find_frame_desc(uvc_device_handle_t *devh,
     uint16_t format_id, uint16_t frame_id);
-void *_uvc_user_caller(void *arg);
 void _uvc_populate_frame(uvc_stream_handle_t *strmh);
 
 static uvc_streaming_interface_t *_uvc_get_stream_if(uvc_device_handle_t *devh, int interface_idx);
 static uvc_stream_handle_t *_uvc_get_stream_by_interface(uvc_device_handle_t *devh, int interface_idx);
+static void _uvc_process_still_payload(uvc_stream_handle_t *strmh,
+    uint8_t header_info, uint8_t *data, size_t data_len);
+static void _uvc_copy_frame_still(uvc_stream_handle_t *strmh);
+static uvc_error_t _uvc_setup_rows(uvc_stream_handle_t *strmh,
+    uvc_frame_desc_t *frame_desc);
+static uvc_error_t _uvc_size_frame_bufs(uvc_stream_handle_t *strmh);
 
 struct format_table_entry {
   enum uvc_frame_format format;
@@ -337,9 +342,229 @@ uvc_error_t uvc_query_still_ctrl(
   return UVC_SUCCESS;
 }
 
-/** Initiate a method 2 (in stream) still capture
+/** @internal
+ * @brief Size the still buffers and record the still image's format
+ *
+ * Runs on the caller's thread so the USB event thread never allocates.
+ */
+static uvc_error_t _uvc_prepare_still(uvc_stream_handle_t *strmh,
+                                      uvc_still_ctrl_t *still_ctrl) {
+  uvc_format_desc_t *format;
+  uvc_still_frame_desc_t *still;
+  uvc_still_frame_res_t *res;
+  size_t size;
+
+  size = still_ctrl->dwMaxVideoFrameSize;
+  if (size == 0)
+    size = strmh->cur_ctrl.dwMaxVideoFrameSize;
+
+  pthread_mutex_lock(&strmh->still_mutex);
+
+  if (size > strmh->still_buf_size) {
+    uint8_t *outbuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->still_outbuf, size);
+    uint8_t *holdbuf;
+
+    if (!outbuf) {
+      pthread_mutex_unlock(&strmh->still_mutex);
+      return UVC_ERROR_NO_MEM;
+    }
+    strmh->still_outbuf = outbuf;
+
+    holdbuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->still_holdbuf, size);
+    if (!holdbuf) {
+      pthread_mutex_unlock(&strmh->still_mutex);
+      return UVC_ERROR_NO_MEM;
+    }
+    strmh->still_holdbuf = holdbuf;
+
+    strmh->still_buf_size = size;
+    strmh->still_got_bytes = 0;
+  }
+
+  strmh->still_ctrl = *still_ctrl;
+  strmh->still_format = strmh->frame_format;
+  strmh->still_width = 0;
+  strmh->still_height = 0;
+
+  DL_FOREACH(strmh->stream_if->format_descs, format) {
+    if (format->bFormatIndex != still_ctrl->bFormatIndex)
+      continue;
+
+    strmh->still_format = uvc_frame_format_for_guid(format->guidFormat);
+
+    DL_FOREACH(format->still_frame_desc, still) {
+      DL_FOREACH(still->imageSizePatterns, res) {
+        if (res->bResolutionIndex == still_ctrl->bFrameIndex) {
+          strmh->still_width = res->wWidth;
+          strmh->still_height = res->wHeight;
+        }
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Method 3 still transfer callback
+ *
+ * Payloads on the still endpoint carry the usual payload header.
+ */
+void LIBUSB_CALL _uvc_still_transfer_callback(struct libusb_transfer *transfer) {
+  uvc_stream_handle_t *strmh = transfer->user_data;
+  int i;
+
+  switch (transfer->status) {
+  case LIBUSB_TRANSFER_COMPLETED:
+    if (transfer->actual_length >= 2 && transfer->buffer[0] >= 2 &&
+        transfer->buffer[0] <= transfer->actual_length) {
+      size_t header_len = transfer->buffer[0];
+
+      _uvc_process_still_payload(strmh, transfer->buffer[1] | UVC_STREAM_STI,
+                                 transfer->buffer + header_len,
+                                 transfer->actual_length - header_len);
+    }
+    break;
+  case LIBUSB_TRANSFER_TIMED_OUT:
+  case LIBUSB_TRANSFER_STALL:
+  case LIBUSB_TRANSFER_OVERFLOW:
+    UVC_DEBUG("retrying still transfer, status = %d", transfer->status);
+    break;
+  default:
+    pthread_mutex_lock(&strmh->still_mutex);
+    goto drop;
+  }
+
+  /* Under the lock, so a stop either cancels the resubmitted transfer or
+   * sees it dropped */
+  pthread_mutex_lock(&strmh->still_mutex);
+  if (strmh->running && libusb_submit_transfer(transfer) == LIBUSB_SUCCESS) {
+    pthread_mutex_unlock(&strmh->still_mutex);
+    return;
+  }
+
+drop:
+  UVC_DEBUG("not retrying still transfer, status = %d", transfer->status);
+  for (i = 0; i < LIBUVC_NUM_STILL_XFERS; i++) {
+    if (strmh->still_transfers[i] == transfer) {
+      _uvc_buf_free(strmh->devh->dev->ctx, transfer->buffer);
+      libusb_free_transfer(transfer);
+      strmh->still_transfers[i] = NULL;
+      break;
+    }
+  }
+  pthread_cond_broadcast(&strmh->still_cond);
+  pthread_mutex_unlock(&strmh->still_mutex);
+}
+
+/** @internal
+ * @brief Make sure transfers are pending on the method 3 still endpoint
+ *
+ * They stay submitted until the stream is stopped, so a trigger only has to
+ * wait for the device.
+ */
+static uvc_error_t _uvc_start_still_transfers(uvc_stream_handle_t *strmh) {
+  uvc_format_desc_t *format;
+  uint8_t endpoint = 0;
+  size_t size;
+  uvc_error_t ret = UVC_SUCCESS;
+  int i;
+
+  DL_FOREACH(strmh->stream_if->format_descs, format) {
+    if (format->bFormatIndex == strmh->still_ctrl.bFormatIndex &&
+        format->still_frame_desc) {
+      endpoint = format->still_frame_desc->bEndPointAddress;
+      break;
+    }
+  }
+
+  if (!endpoint)
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  size = strmh->still_ctrl.dwMaxPayloadTransferSize;
+  if (size == 0)
+    size = LIBUVC_STILL_XFER_SIZE;
+
+  pthread_mutex_lock(&strmh->still_mutex);
+
+  /* The stream may have been stopped since the trigger checked */
+  if (!strmh->running) {
+    pthread_mutex_unlock(&strmh->still_mutex);
+    return UVC_ERROR_NOT_SUPPORTED;
+  }
+
+  for (i = 0; i < LIBUVC_NUM_STILL_XFERS; i++) {
+    struct libusb_transfer *transfer;
+    uint8_t *buf;
+
+    if (strmh->still_transfers[i])
+      continue;
+
+    transfer = libusb_alloc_transfer(0);
+    buf = _uvc_buf_alloc(strmh->devh->dev->ctx, size);
+    if (!transfer || !buf) {
+      libusb_free_transfer(transfer);
+      _uvc_buf_free(strmh->devh->dev->ctx, buf);
+      ret = UVC_ERROR_NO_MEM;
+      break;
+    }
+
+    libusb_fill_bulk_transfer(transfer, strmh->devh->usb_devh, endpoint,
+                              buf, size, _uvc_still_transfer_callback,
+                              (void*) strmh, 0);
+
+    ret = libusb_submit_transfer(transfer);
+    if (ret != UVC_SUCCESS) {
+      UVC_DEBUG("libusb_submit_transfer (still) failed: %d", ret);
+      libusb_free_transfer(transfer);
+      _uvc_buf_free(strmh->devh->dev->ctx, buf);
+      break;
+    }
+
+    strmh->still_transfers[i] = transfer;
+  }
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+
+  return ret;
+}
+
+/** @internal
+ * @brief Cancel the method 3 still transfers and wait until they are freed
+ */
+static void _uvc_stop_still_transfers(uvc_stream_handle_t *strmh) {
+  int i;
+
+  pthread_mutex_lock(&strmh->still_mutex);
+
+  for (i = 0; i < LIBUVC_NUM_STILL_XFERS; i++) {
+    if (strmh->still_transfers[i])
+      libusb_cancel_transfer(strmh->still_transfers[i]);
+  }
+
+  do {
+    for (i = 0; i < LIBUVC_NUM_STILL_XFERS; i++) {
+      if (strmh->still_transfers[i])
+        break;
+    }
+    if (i == LIBUVC_NUM_STILL_XFERS)
+      break;
+    pthread_cond_wait(&strmh->still_cond, &strmh->still_mutex);
+  } while (1);
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+}
+
+/** Initiate a still capture
  * @ingroup streaming
  *
+ * Method 1 delivers the next video frame as a still. Method 2 has the
+ * device send the still in the video stream, method 3 on its dedicated
+ * bulk endpoint. Stills are delivered through uvc_stream_set_still_callback()
+ * or uvc_stream_get_still().
+ *
  * @param[in] devh Device handle
  * @param[in] still_ctrl Still capture control block
  */
@@ -348,21 +573,49 @@ uvc_error_t uvc_trigger_still(
     uvc_still_ctrl_t *still_ctrl) {
   uvc_stream_handle_t* stream;
   uvc_streaming_interface_t* stream_if;
+  uvc_frame_desc_t *frame_desc;
   uint8_t buf;
   uvc_error_t err;
 
-  /* Stream must be running for method 2 to work */
+  /* Stream must be running for any method to work */
   stream = _uvc_get_stream_by_interface(devh, still_ctrl->bInterfaceNumber);
   if (!stream || !stream->running)
     return UVC_ERROR_NOT_SUPPORTED;
 
-  /* Only method 2 is supported */
   stream_if = _uvc_get_stream_if(devh, still_ctrl->bInterfaceNumber);
-  if(!stream_if || stream_if->bStillCaptureMethod != 2)
+  if (!stream_if || stream_if->bStillCaptureMethod < 1 || stream_if->bStillCaptureMethod > 3)
       return UVC_ERROR_NOT_SUPPORTED;
 
-  /* prepare for a SET transfer */
-  buf = 1;
+  err = _uvc_prepare_still(stream, still_ctrl);
+  if (err != UVC_SUCCESS)
+    return err;
+
+  if (stream_if->bStillCaptureMethod == 1) {
+    frame_desc = uvc_find_frame_desc_stream(stream, stream->cur_ctrl.bFormatIndex,
+                                            stream->cur_ctrl.bFrameIndex);
+
+    pthread_mutex_lock(&stream->still_mutex);
+    stream->still_format = stream->frame_format;
+    if (frame_desc) {
+      stream->still_width = frame_desc->wWidth;
+      stream->still_height = frame_desc->wHeight;
+    }
+    /* read without the lock by the event thread at each frame start */
+    UVC_ATOMIC_STORE(&stream->still_frame_pending, stream->still_frame_pending + 1);
+    pthread_mutex_unlock(&stream->still_mutex);
+
+    return UVC_SUCCESS;
+  }
+
+  if (stream_if->bStillCaptureMethod == 3) {
+    err = _uvc_start_still_transfers(stream);
+    if (err != UVC_SUCCESS)
+      return err;
+  }
+
+  /* prepare for a SET transfer: 1 sends the still in the video stream,
+   * 2 on the dedicated still endpoint */
+  buf = stream_if->bStillCaptureMethod == 3 ? 2 : 1;
 
   /* do the transfer */
   err = libusb_control_transfer(
@@ -380,6 +633,79 @@ uvc_error_t uvc_trigger_still(
   return UVC_SUCCESS;
 }
 
+/** Capture several stills back to back
+ * @ingroup streaming
+ *
+ * Triggers @p count stills, each one as soon as the previous one has been
+ * delivered, so none is lost to a slow consumer. For method 3 the still
+ * endpoint's transfers stay submitted for the whole burst.
+ *
+ * A burst of more than one still needs a still callback
+ * (uvc_stream_set_still_callback()); it's called once per still.
+ *
+ * @param[in] devh Device handle
+ * @param[in] still_ctrl Still capture control block
+ * @param[in] count Number of stills to capture
+ * @param[in] timeout_us Maximum wait for each still, 0 to wait indefinitely
+ */
+uvc_error_t uvc_trigger_still_burst(
+    uvc_device_handle_t *devh,
+    uvc_still_ctrl_t *still_ctrl,
+    int count,
+    int32_t timeout_us) {
+  uvc_stream_handle_t *stream;
+  uvc_error_t ret;
+  int i;
+
+  stream = _uvc_get_stream_by_interface(devh, still_ctrl->bInterfaceNumber);
+  if (!stream || count < 1)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (count > 1 && !stream->still_cb)
+    return UVC_ERROR_INVALID_PARAM;
+
+  for (i = 0; i < count; i++) {
+    struct timespec ts;
+    uint32_t seq;
+    uint32_t *watched;
+    int err = 0;
+
+    /* with a callback, wait until it's done with the still */
+    watched = stream->still_cb ? &stream->still_consumed_seq : &stream->still_hold_seq;
+
+    pthread_mutex_lock(&stream->still_mutex);
+    seq = *watched;
+    pthread_mutex_unlock(&stream->still_mutex);
+
+    ret = uvc_trigger_still(devh, still_ctrl);
+    if (ret != UVC_SUCCESS)
+      return ret;
+
+    if (timeout_us > 0) {
+      uint64_t nsec;
+
+      clock_gettime(CLOCK_REALTIME, &ts);
+      nsec = ts.tv_nsec + (uint64_t) timeout_us * 1000;
+      ts.tv_sec += nsec / 1000000000;
+      ts.tv_nsec = nsec % 1000000000;
+    }
+
+    pthread_mutex_lock(&stream->still_mutex);
+    while (*watched == seq && !err) {
+      if (timeout_us > 0)
+        err = pthread_cond_timedwait(&stream->still_cond, &stream->still_mutex, &ts);
+      else
+        pthread_cond_wait(&stream->still_cond, &stream->still_mutex);
+    }
+    pthread_mutex_unlock(&stream->still_mutex);
+
+    if (err)
+      return err == ETIMEDOUT ? UVC_ERROR_TIMEOUT : UVC_ERROR_OTHER;
+  }
+
+  return UVC_SUCCESS;
+}
+
 /** @brief Reconfigure stream with a new stream format.
  * @ingroup streaming
  *
@@ -512,13 +838,15 @@ uvc_error_t uvc_get_stream_ctrl_format_size(
             }
           }
         } else {
-          uint32_t interval_100ns = 10000000 / fps;
+          /* A rate of zero takes the fastest one */
+          uint32_t interval_100ns = fps ? 10000000 / fps : frame->dwMinFrameInterval;
           uint32_t interval_offset = interval_100ns - frame->dwMinFrameInterval;
 
           if (interval_100ns >= frame->dwMinFrameInterval
               && interval_100ns <= frame->dwMaxFrameInterval
               && !(interval_offset
-                   && (interval_offset % frame->dwFrameIntervalStep))) {
+                   && (!frame->dwFrameIntervalStep
+                       || interval_offset % frame->dwFrameIntervalStep))) {
 
             ctrl->bmHint = (1 << 0);
             ctrl->bFormatIndex = format->bFormatIndex;
@@ -538,6 +866,45 @@ found:
   return uvc_probe_stream_ctrl(devh, ctrl);
 }
 
+/** Get a negotiated streaming control block for a frame descriptor.
+ * @ingroup streaming
+ *
+ * Negotiates exactly the given format, frame size and interval, where
+ * uvc_get_stream_ctrl_format_size() takes the first format that matches.
+ *
+ * @param[in] devh Device handle
+ * @param[out] ctrl Control block
+ * @param[in] frame Frame descriptor from uvc_get_format_descs()
+ * @param[in] interval Frame interval in 100ns units; 0 for the frame's default
+ */
+uvc_error_t uvc_get_stream_ctrl_frame(
+    uvc_device_handle_t *devh,
+    uvc_stream_ctrl_t *ctrl,
+    const uvc_frame_desc_t *frame,
+    uint32_t interval) {
+  uvc_format_desc_t *format;
+
+  if (!ctrl || !frame || !frame->parent || !frame->parent->parent)
+    return UVC_ERROR_INVALID_PARAM;
+
+  format = frame->parent;
+  if (!interval)
+    interval = frame->dwDefaultFrameInterval;
+
+  memset(ctrl, 0, sizeof(*ctrl));
+  ctrl->bInterfaceNumber = format->parent->bInterfaceNumber;
+  uvc_claim_if(devh, ctrl->bInterfaceNumber);
+  /* get the max values */
+  uvc_query_stream_ctrl(devh, ctrl, 1, UVC_GET_MAX);
+
+  ctrl->bmHint = (1 << 0); /* don't negotiate interval */
+  ctrl->bFormatIndex = format->bFormatIndex;
+  ctrl->bFrameIndex = frame->bFrameIndex;
+  ctrl->dwFrameInterval = interval;
+
+  return uvc_probe_stream_ctrl(devh, ctrl);
+}
+
 /** Get a negotiated still control block for some common parameters.
  * @ingroup streaming
  *
@@ -559,8 +926,28 @@ uvc_error_t uvc_get_still_ctrl_format_size(
 
   stream_if = _uvc_get_stream_if(devh, ctrl->bInterfaceNumber);
 
-  /* Only method 2 is supported */
-  if(!stream_if || stream_if->bStillCaptureMethod != 2)
+  if (!stream_if)
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  if (stream_if->bStillCaptureMethod == 1) {
+    /* Method 1 stills are video frames: there is nothing to negotiate, but
+     * the size has to be the one being streamed */
+    uvc_frame_desc_t *frame = uvc_find_frame_desc(devh, ctrl->bFormatIndex, ctrl->bFrameIndex);
+
+    if (!frame || frame->wWidth != width || frame->wHeight != height)
+      return UVC_ERROR_INVALID_MODE;
+
+    still_ctrl->bInterfaceNumber = ctrl->bInterfaceNumber;
+    still_ctrl->bFormatIndex = ctrl->bFormatIndex;
+    still_ctrl->bFrameIndex = ctrl->bFrameIndex;
+    still_ctrl->bCompressionIndex = 0;
+    still_ctrl->dwMaxVideoFrameSize = ctrl->dwMaxVideoFrameSize;
+    still_ctrl->dwMaxPayloadTransferSize = ctrl->dwMaxPayloadTransferSize;
+    return UVC_SUCCESS;
+  }
+
+  /* Methods 2 and 3 negotiate the still image separately */
+  if (stream_if->bStillCaptureMethod != 2 && stream_if->bStillCaptureMethod != 3)
     return UVC_ERROR_NOT_SUPPORTED;
 
   DL_FOREACH(stream_if->format_descs, format) {
@@ -652,24 +1039,218 @@ uvc_error_t uvc_probe_still_ctrl(
   return res;
 }
 
+/** @internal
+ * @brief Decide how much of the frame about to be assembled to keep
+ *
+ * Decimation drops whole frames: one in decimate_n is kept, or, with a
+ * minimum period, the first frame starting once the period has elapsed since
+ * the last kept one (half a source frame interval early counts as on time).
+ * Of the frames kept, 1, 1 + N, 1 + 2N, ... by sequence number keep their
+ * image data under an image interval of N. A pending method 1 still always
+ * needs the whole image, so that frame also ignores the ROI.
+ */
+static void _uvc_update_frame_skip(uvc_stream_handle_t *strmh) {
+  /* set from other threads while streaming */
+  uint32_t interval = UVC_ATOMIC_LOAD(&strmh->image_interval);
+  uint32_t decimate_n = UVC_ATOMIC_LOAD(&strmh->decimate_n);
+  uint64_t period_ns = (uint64_t) UVC_ATOMIC_LOAD(&strmh->decimate_interval) * 100;
+
+  strmh->skip_frame = 0;
+  /* a still asked for mid-frame waits for the next whole frame */
+  strmh->frame_is_still = UVC_ATOMIC_LOAD(&strmh->still_frame_pending) != 0;
+  if (strmh->frame_is_still) {
+    /* the still is the full frame */
+    strmh->skip_image = 0;
+    strmh->roi_frame = 0;
+    return;
+  }
+
+  strmh->roi_frame = strmh->roi_step != 0;
+
+  if (period_ns) {
+    struct timespec ts;
+    uint64_t now_ns, slack_ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now_ns = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    /* dwFrameInterval is in 100ns units */
+    slack_ns = (uint64_t) strmh->cur_ctrl.dwFrameInterval * 50;
+
+    if (now_ns + slack_ns < strmh->decimate_due_ns) {
+      strmh->skip_frame = 1;
+    } else {
+      strmh->decimate_due_ns += period_ns;
+      /* after a gap, schedule from now rather than catching up */
+      if (strmh->decimate_due_ns < now_ns)
+        strmh->decimate_due_ns = now_ns + period_ns;
+    }
+  } else if (decimate_n > 1) {
+    strmh->skip_frame = (strmh->seq - 1) % decimate_n != 0;
+  }
+
+  if (strmh->skip_frame || interval == 0)
+    strmh->skip_image = 1;
+  else if (interval == 1)
+    strmh->skip_image = 0;
+  else
+    strmh->skip_image = (strmh->seq - 1) % interval != 0;
+}
+
+/** @internal
+ * @brief Grow the assembly buffer mid-frame
+ *
+ * Used by compressed streams, and by whole frames of a stream sized to its
+ * ROI.
+ * Doubles it, or more if @p needed calls for it, up to dwMaxVideoFrameSize.
+ * Runs on the event thread, but only until the buffers have caught up with
+ * the largest frames the device sends.
+ *
+ * @return 1 if the buffer now holds @p needed bytes
+ */
+static int _uvc_grow_outbuf(uvc_stream_handle_t *strmh, size_t needed) {
+  size_t size = strmh->outbuf_size * 2;
+  uint8_t *buf;
+
+  if (size < needed)
+    size = needed;
+  if (size > strmh->cur_ctrl.dwMaxVideoFrameSize)
+    size = strmh->cur_ctrl.dwMaxVideoFrameSize;
+
+  buf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->outbuf, size);
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  if (buf) {
+    strmh->outbuf = buf;
+    strmh->outbuf_size = size;
+    strmh->buffer_stats.grows++;
+  } else {
+    strmh->buffer_stats.truncated++;
+  }
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return buf != NULL;
+}
+
+/** @internal
+ * @brief Copy the part of a payload that falls inside the ROI
+ *
+ * The payload starts got_bytes into the frame. Each ROI row lands roi_step
+ * bytes after the previous one in outbuf.
+ */
+static void _uvc_copy_roi(uvc_stream_handle_t *strmh, const uint8_t *src,
+                          size_t len) {
+  size_t pos = strmh->got_bytes;
+  size_t end = pos + len;
+  size_t row = pos / strmh->row_step;
+  size_t end_row = strmh->roi_y + strmh->roi_h;
+
+  if (row < strmh->roi_y)
+    row = strmh->roi_y;
+
+  for (; row < end_row; row++) {
+    size_t row_start = row * strmh->row_step;
+    size_t from = row_start + strmh->roi_offset;
+    size_t to = from + strmh->roi_step;
+    size_t dst;
+
+    if (from >= end)
+      break;
+    if (from < pos)
+      from = pos;
+    if (to > end)
+      to = end;
+    if (to <= from)
+      continue;
+
+    dst = (row - strmh->roi_y) * strmh->roi_step +
+          (from - row_start - strmh->roi_offset);
+    memcpy(strmh->outbuf + dst, src + (from - pos), to - from);
+    if (dst + (to - from) > strmh->roi_got_bytes)
+      strmh->roi_got_bytes = dst + (to - from);
+  }
+}
+
+/** @internal
+ * @brief Report the rows completed since the last slice
+ *
+ * Without a row count, every payload that completes a row produces a slice.
+ *
+ * @param last Whether the frame is finished
+ */
+static void _uvc_emit_slice(uvc_stream_handle_t *strmh, int last) {
+  uvc_frame_slice_t slice;
+  size_t step = strmh->roi_frame ? strmh->roi_step : strmh->row_step;
+  size_t got = strmh->roi_frame ? strmh->roi_got_bytes : strmh->got_bytes;
+  uint32_t height = strmh->roi_frame ? strmh->roi_h : strmh->row_height;
+  size_t rows = got / step;
+
+  if (rows > height)
+    rows = height;
+
+  if (rows <= strmh->slice_row)
+    return;
+
+  if (!last && strmh->slice_rows && rows < strmh->slice_row + strmh->slice_rows
+      && rows < height)
+    return;
+
+  slice.data = strmh->outbuf;
+  slice.step = step;
+  slice.width = strmh->roi_frame ? strmh->roi_w : strmh->row_width;
+  slice.height = height;
+  slice.frame_format = strmh->frame_format;
+  slice.first_row = strmh->slice_row;
+  slice.end_row = (uint32_t) rows;
+  slice.sequence = strmh->seq;
+  slice.last = last || rows == height;
+
+  strmh->slice_row = (uint32_t) rows;
+
+  strmh->slice_cb(&slice, strmh->slice_user_ptr);
+}
+
 /** @internal
  * @brief Swap the working buffer with the presented buffer and notify consumers
  */
 void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
   uint8_t *tmp_buf;
+  size_t tmp_size;
+
+  if (strmh->slice_cb && strmh->row_step && !strmh->skip_image)
+    _uvc_emit_slice(strmh, 1);
+
+  if (strmh->skip_frame) {
+    /* decimated: nothing was copied and nobody is told */
+    pthread_mutex_lock(&strmh->cb_mutex);
+    strmh->frames_assembled++;
+    pthread_mutex_unlock(&strmh->cb_mutex);
+    goto next_frame;
+  }
+
+  if (strmh->frame_is_still)
+    _uvc_copy_frame_still(strmh);
 
   pthread_mutex_lock(&strmh->cb_mutex);
 
+  strmh->frames_assembled++;
+
   (void)clock_gettime(CLOCK_MONOTONIC, &strmh->capture_time_finished);
 
   /* swap the buffers */
   tmp_buf = strmh->holdbuf;
-  strmh->hold_bytes = strmh->got_bytes;
+  strmh->hold_bytes = strmh->roi_frame ? strmh->roi_got_bytes : strmh->got_bytes;
+  strmh->hold_roi = strmh->roi_frame;
   strmh->holdbuf = strmh->outbuf;
   strmh->outbuf = tmp_buf;
+  tmp_size = strmh->holdbuf_size;
+  strmh->holdbuf_size = strmh->outbuf_size;
+  strmh->outbuf_size = tmp_size;
+  if (strmh->got_bytes > strmh->buffer_stats.high_water)
+    strmh->buffer_stats.high_water = strmh->got_bytes;
   strmh->hold_last_scr = strmh->last_scr;
   strmh->hold_pts = strmh->pts;
   strmh->hold_seq = strmh->seq;
+  strmh->hold_has_image = !strmh->skip_image;
   
   /* swap metadata buffer */
   tmp_buf = strmh->meta_holdbuf;
@@ -680,44 +1261,132 @@ void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
   pthread_cond_broadcast(&strmh->cb_cond);
   pthread_mutex_unlock(&strmh->cb_mutex);
 
+next_frame:
   strmh->seq++;
   strmh->got_bytes = 0;
+  strmh->slice_row = 0;
+  strmh->roi_got_bytes = 0;
   strmh->meta_got_bytes = 0;
   strmh->last_scr = 0;
   strmh->pts = 0;
+
+  _uvc_update_frame_skip(strmh);
 }
 
 /** @internal
- * @brief Process a payload transfer
- * 
- * Processes stream, places frames into buffer, signals listeners
- * (such as user callback thread and any polling thread) on new frame
- *
- * @param payload Contents of the payload transfer, either a packet (isochronous) or a full
- * transfer (bulk mode)
- * @param payload_len Length of the payload transfer
+ * @brief Publish the still image being assembled and notify consumers
+ * @note Must be called with still_mutex held
  */
-void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t payload_len) {
-  size_t header_len;
-  uint8_t header_info;
-  size_t data_len;
+static void _uvc_swap_still_buffers(uvc_stream_handle_t *strmh) {
+  uint8_t *tmp_buf;
 
-  /* magic numbers for identifying header packets from some iSight cameras */
-  static uint8_t isight_tag[] = {
-    0x11, 0x22, 0x33, 0x44,
-    0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xfa, 0xce
-  };
+  (void)clock_gettime(CLOCK_MONOTONIC, &strmh->still_capture_time);
 
-  /* ignore empty payload transfers */
-  if (payload_len == 0)
-    return;
+  tmp_buf = strmh->still_holdbuf;
+  strmh->still_holdbuf = strmh->still_outbuf;
+  strmh->still_outbuf = tmp_buf;
+  strmh->still_hold_bytes = strmh->still_got_bytes;
+  strmh->still_hold_seq++;
 
-  /* Certain iSight cameras have strange behavior: They send header
-   * information in a packet with no image data, and then the following
-   * packets have only image data, with no more headers until the next frame.
-   *
-   * The iSight header: len(1), flags(1 or 2), 0x11223344(4),
-   * 0xdeadbeefdeadface(8), ??(16)
+  strmh->still_got_bytes = 0;
+
+  pthread_cond_broadcast(&strmh->still_cond);
+}
+
+/** @internal
+ * @brief Deliver the completed video frame as a method 1 still
+ *
+ * Only for frames that started with a still pending, which are assembled
+ * whole, so got_bytes is the image's length.
+ */
+static void _uvc_copy_frame_still(uvc_stream_handle_t *strmh) {
+  size_t len;
+
+  pthread_mutex_lock(&strmh->still_mutex);
+
+  if (strmh->still_frame_pending && strmh->still_outbuf) {
+    len = strmh->got_bytes;
+    if (len > strmh->still_buf_size)
+      len = strmh->still_buf_size;
+    memcpy(strmh->still_outbuf, strmh->outbuf, len);
+    strmh->still_got_bytes = len;
+    _uvc_swap_still_buffers(strmh);
+    UVC_ATOMIC_STORE(&strmh->still_frame_pending, strmh->still_frame_pending - 1);
+  }
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+}
+
+/** @internal
+ * @brief Collect the data of a payload that has the STI bit set
+ *
+ * Still images go to their own buffers, sized from the still commit by
+ * uvc_trigger_still, so a high-resolution capture neither overflows nor
+ * replaces the video frame being assembled.
+ */
+static void _uvc_process_still_payload(uvc_stream_handle_t *strmh,
+                                       uint8_t header_info,
+                                       uint8_t *data, size_t data_len) {
+  pthread_mutex_lock(&strmh->still_mutex);
+
+  if (!strmh->still_outbuf) {
+    strmh->still_dropped++;
+    pthread_mutex_unlock(&strmh->still_mutex);
+    return;
+  }
+
+  if (strmh->still_got_bytes != 0 && strmh->still_fid != (header_info & 1)) {
+    /* a new still began without an EOF on the previous one */
+    _uvc_swap_still_buffers(strmh);
+  }
+
+  strmh->still_fid = header_info & 1;
+
+  if (data_len > 0) {
+    if (strmh->still_got_bytes + data_len > strmh->still_buf_size)
+      data_len = strmh->still_buf_size - strmh->still_got_bytes; /* Avoid overflow. */
+    memcpy(strmh->still_outbuf + strmh->still_got_bytes, data, data_len);
+    strmh->still_got_bytes += data_len;
+  }
+
+  if (strmh->still_got_bytes != 0 &&
+      (header_info & UVC_STREAM_EOF || strmh->still_got_bytes == strmh->still_buf_size))
+    _uvc_swap_still_buffers(strmh);
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+}
+
+/** @internal
+ * @brief Process a payload transfer
+ * 
+ * Processes stream, places frames into buffer, signals listeners
+ * (such as user callback thread and any polling thread) on new frame
+ *
+ * @param payload Contents of the payload transfer, either a packet (isochronous) or a full
+ * transfer (bulk mode)
+ * @param payload_len Length of the payload transfer
+ */
+void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t payload_len) {
+  size_t header_len;
+  uint8_t header_info;
+  size_t data_len;
+
+  /* magic numbers for identifying header packets from some iSight cameras */
+  static uint8_t isight_tag[] = {
+    0x11, 0x22, 0x33, 0x44,
+    0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xfa, 0xce
+  };
+
+  /* ignore empty payload transfers */
+  if (payload_len == 0)
+    return;
+
+  /* Certain iSight cameras have strange behavior: They send header
+   * information in a packet with no image data, and then the following
+   * packets have only image data, with no more headers until the next frame.
+   *
+   * The iSight header: len(1), flags(1 or 2), 0x11223344(4),
+   * 0xdeadbeefdeadface(8), ??(16)
    */
 
   if (strmh->devh->is_isight &&
@@ -762,6 +1431,19 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
 
     strmh->fid = header_info & 1;
 
+    if (header_info & UVC_STREAM_STI) {
+      /* Method 2 still image: keep it out of the video buffers */
+      _uvc_process_still_payload(strmh, header_info, payload + header_len, data_len);
+      return;
+    }
+
+    if (strmh->still_got_bytes != 0) {
+      /* video resumed before the still's EOF */
+      pthread_mutex_lock(&strmh->still_mutex);
+      _uvc_swap_still_buffers(strmh);
+      pthread_mutex_unlock(&strmh->still_mutex);
+    }
+
     if (header_info & (1 << 2)) {
       strmh->pts = DW_TO_INT(payload + variable_offset);
       variable_offset += 4;
@@ -773,11 +1455,11 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
       variable_offset += 6;
     }
 
-    if (header_len > variable_offset) {
+    if (header_len > variable_offset && !strmh->skip_frame) {
         // Metadata is attached to header
         size_t meta_len = header_len - variable_offset;
-        if (strmh->meta_got_bytes + meta_len > LIBUVC_XFER_META_BUF_SIZE)
-          meta_len = LIBUVC_XFER_META_BUF_SIZE - strmh->meta_got_bytes; /* Avoid overflow. */
+        if (strmh->meta_got_bytes + meta_len > strmh->meta_buf_size)
+          meta_len = strmh->meta_buf_size - strmh->meta_got_bytes; /* Avoid overflow. */
         memcpy(strmh->meta_outbuf + strmh->meta_got_bytes, payload + variable_offset, meta_len);
         strmh->meta_got_bytes += meta_len;
     }
@@ -786,13 +1468,194 @@ void _uvc_process_payload(uvc_stream_handle_t *strmh, uint8_t *payload, size_t p
   if (data_len > 0) {
     if (strmh->got_bytes + data_len > strmh->cur_ctrl.dwMaxVideoFrameSize)
       data_len = strmh->cur_ctrl.dwMaxVideoFrameSize - strmh->got_bytes; /* Avoid overflow. */
-    memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
+    if (strmh->got_bytes + data_len > strmh->outbuf_size && !strmh->skip_image
+        && !strmh->roi_frame && !_uvc_grow_outbuf(strmh, strmh->got_bytes + data_len))
+      data_len = strmh->outbuf_size - strmh->got_bytes;
+    /* sampled-out frames only count their bytes, for the EOF logic */
+    if (!strmh->skip_image) {
+      if (strmh->roi_frame)
+        _uvc_copy_roi(strmh, payload + header_len, data_len);
+      else
+        memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
+    }
     strmh->got_bytes += data_len;
     if (header_info & (1 << 1) || strmh->got_bytes == strmh->cur_ctrl.dwMaxVideoFrameSize) {
       /* The EOF bit is set, so publish the complete frame */
       _uvc_swap_buffers(strmh);
+    } else if (strmh->slice_cb && strmh->row_step && !strmh->skip_image) {
+      _uvc_emit_slice(strmh, 0);
+    }
+  }
+}
+
+/** @internal
+ * @brief Index of a transfer in the stream's transfer table, or -1
+ * @note Must be called with cb_mutex held
+ */
+static int _uvc_transfer_slot(uvc_stream_handle_t *strmh,
+                              struct libusb_transfer *transfer) {
+  int i;
+
+  for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
+    if (strmh->transfers[i] == transfer)
+      return i;
+  }
+
+  return -1;
+}
+
+/** @internal
+ * @brief Free a transfer for good and clear its slot
+ * @note Must be called with cb_mutex held
+ */
+static void _uvc_drop_transfer(uvc_stream_handle_t *strmh, int slot) {
+  struct libusb_transfer *transfer = strmh->transfers[slot];
+
+  _uvc_buf_free(strmh->devh->dev->ctx, transfer->buffer);
+  libusb_free_transfer(transfer);
+  strmh->transfers[slot] = NULL;
+
+  if (strmh->transfer_failures[slot])
+    strmh->transfer_failing--;
+  strmh->transfer_parked[slot] = 0;
+  strmh->transfer_failures[slot] = 0;
+}
+
+/** @internal
+ * @brief Park a failed transfer until the resubmit thread retries it
+ *
+ * The retry delay doubles with every consecutive failure of the slot.
+ * @note Must be called with cb_mutex held
+ */
+static void _uvc_park_transfer(uvc_stream_handle_t *strmh, int slot) {
+  struct timespec *ts = &strmh->transfer_retry_at[slot];
+  unsigned int shift;
+  uint64_t nsec;
+
+  if (strmh->transfer_failures[slot] == 0)
+    strmh->transfer_failing++;
+  if (strmh->transfer_failures[slot] < UINT8_MAX)
+    strmh->transfer_failures[slot]++;
+
+  shift = strmh->transfer_failures[slot] - 1;
+  if (shift > LIBUVC_TRANSFER_MAX_BACKOFF_SHIFT)
+    shift = LIBUVC_TRANSFER_MAX_BACKOFF_SHIFT;
+
+  clock_gettime(CLOCK_REALTIME, ts);
+  nsec = ts->tv_nsec + (1000000ULL << shift);
+  ts->tv_sec += nsec / 1000000000;
+  ts->tv_nsec = nsec % 1000000000;
+
+  strmh->transfer_parked[slot] = 1;
+  pthread_cond_signal(&strmh->resubmit_cond);
+}
+
+/** @internal
+ * @brief Replace a transfer that keeps failing with a fresh one
+ *
+ * The new transfer reuses the old one's buffer and settings.
+ * @note Must be called with cb_mutex held
+ */
+static void _uvc_realloc_transfer(uvc_stream_handle_t *strmh, int slot) {
+  struct libusb_transfer *old = strmh->transfers[slot];
+  struct libusb_transfer *transfer;
+  int i;
+
+  transfer = libusb_alloc_transfer(old->num_iso_packets);
+  if (!transfer)
+    return;
+
+  transfer->dev_handle = old->dev_handle;
+  transfer->flags = old->flags;
+  transfer->endpoint = old->endpoint;
+  transfer->type = old->type;
+  transfer->timeout = old->timeout;
+  transfer->length = old->length;
+  transfer->callback = old->callback;
+  transfer->user_data = old->user_data;
+  transfer->buffer = old->buffer;
+  transfer->num_iso_packets = old->num_iso_packets;
+  for (i = 0; i < old->num_iso_packets; i++)
+    transfer->iso_packet_desc[i].length = old->iso_packet_desc[i].length;
+
+  libusb_free_transfer(old);
+  strmh->transfers[slot] = transfer;
+  strmh->transfer_stats.reallocations++;
+}
+
+/** @internal
+ * @brief Try to get a parked transfer back on the bus
+ * @note Must be called with cb_mutex held
+ */
+static void _uvc_resubmit_transfer(uvc_stream_handle_t *strmh, int slot) {
+  int ret;
+
+  if (strmh->transfer_failures[slot] % LIBUVC_TRANSFER_REALLOC_AFTER == 0)
+    _uvc_realloc_transfer(strmh, slot);
+
+  ret = libusb_submit_transfer(strmh->transfers[slot]);
+  if (ret == LIBUSB_SUCCESS) {
+    strmh->transfer_parked[slot] = 0;
+    strmh->transfer_stats.resubmits++;
+  } else if (ret == LIBUSB_ERROR_NO_DEVICE) {
+    UVC_DEBUG("device gone, dropping transfer %d", slot);
+    strmh->transfer_stats.lost++;
+    _uvc_drop_transfer(strmh, slot);
+    pthread_cond_broadcast(&strmh->cb_cond);
+  } else {
+    UVC_DEBUG("resubmitting transfer %d failed: %d", slot, ret);
+    strmh->transfer_stats.submit_failures++;
+    _uvc_park_transfer(strmh, slot);
+  }
+}
+
+/** @internal
+ * @brief Resubmits parked transfers once their backoff has expired
+ *
+ * Runs for as long as the stream does, so the in-flight depth recovers even
+ * if every transfer failed and no completion is left to drive a retry.
+ */
+void *_uvc_resubmit_thread(void *arg) {
+  uvc_stream_handle_t *strmh = (uvc_stream_handle_t *) arg;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+
+  while (strmh->running) {
+    struct timespec now, next;
+    int have_next = 0;
+    int i;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
+      struct timespec *at = &strmh->transfer_retry_at[i];
+
+      if (!strmh->transfer_parked[i])
+        continue;
+
+      if (at->tv_sec < now.tv_sec ||
+          (at->tv_sec == now.tv_sec && at->tv_nsec <= now.tv_nsec)) {
+        _uvc_resubmit_transfer(strmh, i);
+        if (!strmh->transfer_parked[i])
+          continue;
+      }
+
+      if (!have_next || at->tv_sec < next.tv_sec ||
+          (at->tv_sec == next.tv_sec && at->tv_nsec < next.tv_nsec)) {
+        next = *at;
+        have_next = 1;
+      }
     }
+
+    if (have_next)
+      pthread_cond_timedwait(&strmh->resubmit_cond, &strmh->cb_mutex, &next);
+    else
+      pthread_cond_wait(&strmh->resubmit_cond, &strmh->cb_mutex);
   }
+
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return NULL;
 }
 
 /** @internal
@@ -807,6 +1670,11 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
   uvc_stream_handle_t *strmh = transfer->user_data;
 
   int resubmit = 1;
+  /* read up front: the transfer may be freed or resubmitted below */
+  int completed = transfer->status == LIBUSB_TRANSFER_COMPLETED;
+
+  if (strmh->trace)
+    _uvc_trace_record(strmh, transfer);
 
   switch (transfer->status) {
   case LIBUSB_TRANSFER_COMPLETED:
@@ -835,24 +1703,45 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
       }
     }
     break;
-  case LIBUSB_TRANSFER_CANCELLED: 
   case LIBUSB_TRANSFER_ERROR:
+    if (strmh->running) {
+      int slot;
+
+      pthread_mutex_lock(&strmh->cb_mutex);
+      strmh->transfer_stats.transfer_errors++;
+      slot = _uvc_transfer_slot(strmh, transfer);
+      if (slot < 0) {
+        UVC_DEBUG("transfer %p not found; not freeing!", transfer);
+      } else if (strmh->running) {
+        UVC_DEBUG("transfer error, parking for resubmission");
+        _uvc_park_transfer(strmh, slot);
+      } else {
+        /* The stream stopped meanwhile and nothing would retry it */
+        UVC_DEBUG("Freeing failed transfer %d (%p)", slot, transfer);
+        _uvc_drop_transfer(strmh, slot);
+        pthread_cond_broadcast(&strmh->cb_cond);
+      }
+      pthread_mutex_unlock(&strmh->cb_mutex);
+
+      resubmit = 0;
+      break;
+    }
+    /* fall through */
+  case LIBUSB_TRANSFER_CANCELLED: 
   case LIBUSB_TRANSFER_NO_DEVICE: {
     int i;
     UVC_DEBUG("not retrying transfer, status = %d", transfer->status);
     pthread_mutex_lock(&strmh->cb_mutex);
 
+    if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+      strmh->transfer_stats.lost++;
+
     /* Mark transfer as deleted. */
-    for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
-      if(strmh->transfers[i] == transfer) {
-        UVC_DEBUG("Freeing transfer %d (%p)", i, transfer);
-        free(transfer->buffer);
-        libusb_free_transfer(transfer);
-        strmh->transfers[i] = NULL;
-        break;
-      }
-    }
-    if(i == LIBUVC_NUM_TRANSFER_BUFS ) {
+    i = _uvc_transfer_slot(strmh, transfer);
+    if (i >= 0) {
+      UVC_DEBUG("Freeing transfer %d (%p)", i, transfer);
+      _uvc_drop_transfer(strmh, i);
+    } else {
       UVC_DEBUG("transfer %p not found; not freeing!", transfer);
     }
 
@@ -869,6 +1758,19 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
     UVC_DEBUG("retrying transfer, status = %d", transfer->status);
     break;
   }
+
+  /* A completion ends the backoff of a transfer that failed before */
+  if (completed && strmh->transfer_failing) {
+    int i;
+
+    pthread_mutex_lock(&strmh->cb_mutex);
+    i = _uvc_transfer_slot(strmh, transfer);
+    if (i >= 0 && strmh->transfer_failures[i]) {
+      strmh->transfer_failures[i] = 0;
+      strmh->transfer_failing--;
+    }
+    pthread_mutex_unlock(&strmh->cb_mutex);
+  }
   
   if ( resubmit ) {
     if ( strmh->running ) {
@@ -878,18 +1780,19 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
         int i;
         pthread_mutex_lock(&strmh->cb_mutex);
 
-        /* Mark transfer as deleted. */
-        for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
-          if (strmh->transfers[i] == transfer) {
-            UVC_DEBUG("Freeing failed transfer %d (%p)", i, transfer);
-            free(transfer->buffer);
-            libusb_free_transfer(transfer);
-            strmh->transfers[i] = NULL;
-            break;
-          }
-        }
-        if (i == LIBUVC_NUM_TRANSFER_BUFS) {
+        i = _uvc_transfer_slot(strmh, transfer);
+        if (i < 0) {
           UVC_DEBUG("failed transfer %p not found; not freeing!", transfer);
+        } else if (libusbRet == LIBUSB_ERROR_NO_DEVICE || !strmh->running) {
+          /* Mark transfer as deleted; a stopping stream won't retry it */
+          UVC_DEBUG("Freeing failed transfer %d (%p)", i, transfer);
+          if (libusbRet == LIBUSB_ERROR_NO_DEVICE)
+            strmh->transfer_stats.lost++;
+          _uvc_drop_transfer(strmh, i);
+        } else {
+          UVC_DEBUG("Parking failed transfer %d (%p)", i, transfer);
+          strmh->transfer_stats.submit_failures++;
+          _uvc_park_transfer(strmh, i);
         }
 
         pthread_cond_broadcast(&strmh->cb_cond);
@@ -900,16 +1803,11 @@ void LIBUSB_CALL _uvc_stream_callback(struct libusb_transfer *transfer) {
       pthread_mutex_lock(&strmh->cb_mutex);
 
       /* Mark transfer as deleted. */
-      for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
-        if(strmh->transfers[i] == transfer) {
-          UVC_DEBUG("Freeing orphan transfer %d (%p)", i, transfer);
-          free(transfer->buffer);
-          libusb_free_transfer(transfer);
-          strmh->transfers[i] = NULL;
-          break;
-        }
-      }
-      if(i == LIBUVC_NUM_TRANSFER_BUFS ) {
+      i = _uvc_transfer_slot(strmh, transfer);
+      if (i >= 0) {
+        UVC_DEBUG("Freeing orphan transfer %d (%p)", i, transfer);
+        _uvc_drop_transfer(strmh, i);
+      } else {
         UVC_DEBUG("orphan transfer %p not found; not freeing!", transfer);
       }
 
@@ -1030,6 +1928,7 @@ uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t
   strmh->devh = devh;
   strmh->stream_if = stream_if;
   strmh->frame.library_owns_data = 1;
+  strmh->image_interval = 1;
 
   ret = uvc_claim_if(strmh->devh, strmh->stream_if->bInterfaceNumber);
   if (ret != UVC_SUCCESS)
@@ -1042,16 +1941,27 @@ uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, uvc_stream_handle_t
   // Set up the streaming status and data space
   strmh->running = 0;
 
-  strmh->outbuf = malloc( ctrl->dwMaxVideoFrameSize );
-  strmh->holdbuf = malloc( ctrl->dwMaxVideoFrameSize );
+  /* the frame buffers are sized when the stream starts */
 
-  strmh->meta_outbuf = malloc( LIBUVC_XFER_META_BUF_SIZE );
-  strmh->meta_holdbuf = malloc( LIBUVC_XFER_META_BUF_SIZE );
+  strmh->meta_buf_size = LIBUVC_XFER_META_BUF_SIZE;
+  strmh->meta_outbuf = _uvc_buf_alloc(devh->dev->ctx, strmh->meta_buf_size);
+  strmh->meta_holdbuf = _uvc_buf_alloc(devh->dev->ctx, strmh->meta_buf_size);
+  strmh->frame.metadata = _uvc_buf_alloc(devh->dev->ctx, strmh->meta_buf_size);
    
   pthread_mutex_init(&strmh->cb_mutex, NULL);
   pthread_cond_init(&strmh->cb_cond, NULL);
-
+  pthread_mutex_init(&strmh->wd_mutex, NULL);
+  pthread_cond_init(&strmh->wd_cond, NULL);
+  pthread_cond_init(&strmh->resubmit_cond, NULL);
+  pthread_mutex_init(&strmh->still_mutex, NULL);
+  pthread_cond_init(&strmh->still_cond, NULL);
+  pthread_mutex_init(&strmh->trace_mutex, NULL);
+  strmh->still_frame.library_owns_data = 1;
+
+  /* the status thread walks the stream list to count stream errors */
+  pthread_mutex_lock(&devh->status_mutex);
   DL_APPEND(devh->streams, strmh);
+  pthread_mutex_unlock(&devh->status_mutex);
 
   *strmhp = strmh;
 
@@ -1079,124 +1989,359 @@ uvc_error_t uvc_stream_start(
     void *user_ptr,
     uint8_t flags
 ) {
-  /* USB interface we'll be using */
-  const struct libusb_interface *interface;
-  int interface_id;
-  char isochronous;
-  uvc_frame_desc_t *frame_desc;
-  uvc_format_desc_t *format_desc;
-  uvc_stream_ctrl_t *ctrl;
   uvc_error_t ret;
-  /* Total amount of data per transfer */
-  size_t total_transfer_size = 0;
-  struct libusb_transfer *transfer;
-  int transfer_id;
 
-  ctrl = &strmh->cur_ctrl;
+  if (strmh->running || strmh->playback)
+    return UVC_ERROR_BUSY;
 
-  UVC_ENTER();
+  _uvc_stream_reset_counters(strmh);
 
-  if (strmh->running) {
-    UVC_EXIT(UVC_ERROR_BUSY);
-    return UVC_ERROR_BUSY;
-  }
+  ret = _uvc_stream_start(strmh, cb, user_ptr, flags);
+  if (ret == UVC_SUCCESS)
+    _uvc_watchdog_start(strmh);
 
-  strmh->running = 1;
+  return ret;
+}
+
+/** @internal
+ * @brief Number frames from 1 again, forget the last delivered frame and
+ * clear the transfer counters
+ *
+ * Called when the user starts the stream, not when the watchdog restarts
+ * it, so sequence numbers keep increasing and the counters keep the
+ * failures that led to a recovery.
+ */
+void _uvc_stream_reset_counters(uvc_stream_handle_t *strmh) {
+  pthread_mutex_lock(&strmh->cb_mutex);
+  memset(&strmh->transfer_stats, 0, sizeof(strmh->transfer_stats));
   strmh->seq = 1;
+  strmh->hold_seq = 0;
+  strmh->user_seq = 0;
+  strmh->last_polled_seq = 0;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+}
+
+/** @internal
+ * @brief Reset the assembly state and size the frame buffers for the
+ * negotiated mode
+ *
+ * Shared by stream start and trace replay.
+ */
+uvc_error_t _uvc_stream_prepare(uvc_stream_handle_t *strmh, uint8_t flags) {
+  uvc_stream_ctrl_t *ctrl = &strmh->cur_ctrl;
+  uvc_frame_desc_t *frame_desc;
+  uvc_error_t ret;
+
+  strmh->start_flags = flags;
+  strmh->decimate_due_ns = 0;
   strmh->fid = 0;
   strmh->pts = 0;
   strmh->last_scr = 0;
 
   frame_desc = uvc_find_frame_desc_stream(strmh, ctrl->bFormatIndex, ctrl->bFrameIndex);
-  if (!frame_desc) {
-    ret = UVC_ERROR_INVALID_PARAM;
-    goto fail;
-  }
-  format_desc = frame_desc->parent;
+  if (!frame_desc)
+    return UVC_ERROR_INVALID_PARAM;
 
-  strmh->frame_format = uvc_frame_format_for_guid(format_desc->guidFormat);
-  if (strmh->frame_format == UVC_FRAME_FORMAT_UNKNOWN) {
-    ret = UVC_ERROR_NOT_SUPPORTED;
-    goto fail;
-  }
+  strmh->frame_format = uvc_frame_format_for_guid(frame_desc->parent->guidFormat);
+  if (strmh->frame_format == UVC_FRAME_FORMAT_UNKNOWN)
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  ret = _uvc_setup_rows(strmh, frame_desc);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  ret = _uvc_size_frame_bufs(strmh);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  /* once _uvc_setup_rows has decided whether the ROI applies */
+  _uvc_update_frame_skip(strmh);
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Size the metadata buffers for payloads of up to @a payload_size bytes
+ */
+void _uvc_size_meta_bufs(uvc_stream_handle_t *strmh, size_t payload_size) {
+  uvc_stream_ctrl_t *ctrl = &strmh->cur_ctrl;
+  size_t meta_size;
+
+  /* Every payload of a frame may carry a full header's worth of metadata,
+   * though never more than the frame itself */
+  meta_size = LIBUVC_META_MAX_PER_PAYLOAD;
+  if (payload_size > 0)
+    meta_size *= ctrl->dwMaxVideoFrameSize / payload_size + 2;
+  if (meta_size > ctrl->dwMaxVideoFrameSize)
+    meta_size = ctrl->dwMaxVideoFrameSize;
+  _uvc_grow_meta_bufs(strmh, meta_size);
+  strmh->meta_got_bytes = 0;
+  strmh->meta_hold_bytes = 0;
+}
+
+/** @internal
+ * @brief Make the metadata buffers hold at least @a size bytes
+ */
+uvc_error_t _uvc_grow_meta_bufs(uvc_stream_handle_t *strmh, size_t size) {
+  uint8_t *outbuf, *holdbuf, *framebuf;
+
+  if (size <= strmh->meta_buf_size)
+    return UVC_SUCCESS;
+
+  outbuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->meta_outbuf, size);
+  if (outbuf)
+    strmh->meta_outbuf = outbuf;
+  holdbuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->meta_holdbuf, size);
+  if (holdbuf)
+    strmh->meta_holdbuf = holdbuf;
+  framebuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->frame.metadata, size);
+  if (framebuf)
+    strmh->frame.metadata = framebuf;
+
+  /* the buffers rotate, so they must all have the new size */
+  if (!outbuf || !holdbuf || !framebuf)
+    return UVC_ERROR_NO_MEM;
+
+  strmh->meta_buf_size = size;
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Service intervals per second of a periodic endpoint
+ */
+static uint32_t _uvc_packets_per_second(uvc_device_handle_t *devh, uint8_t bInterval) {
+  int speed = libusb_get_device_speed(devh->dev->usb_dev);
+  /* Frames at full speed, microframes from high speed up */
+  uint32_t bus_intervals = speed == LIBUSB_SPEED_LOW || speed == LIBUSB_SPEED_FULL ?
+    1000 : 8000;
+
+  /* Isochronous endpoints are serviced every 2^(bInterval-1) bus intervals */
+  if (bInterval < 1)
+    bInterval = 1;
+  if (bInterval > 16)
+    bInterval = 16;
+
+  return bus_intervals >> (bInterval - 1) ? bus_intervals >> (bInterval - 1) : 1;
+}
+
+/** @internal
+ * @brief Lay out the transfers of a negotiated mode
+ *
+ * An isochronous stream gets the first altsetting whose packets can carry
+ * the negotiated payload size, and transfers of at most one frame. A bulk
+ * stream transfers one payload at a time. Used by uvc_stream_start() and
+ * uvc_get_stream_bandwidth().
+ *
+ * @param[out] plan Transfer layout and bandwidth
+ * @param[out] altsetting Altsetting to select for an isochronous stream
+ */
+static uvc_error_t _uvc_plan_transfers(uvc_device_handle_t *devh,
+                                       const uvc_stream_ctrl_t *ctrl,
+                                       uvc_stream_bandwidth_t *plan,
+                                       const struct libusb_interface_descriptor **altsetting) {
+  uvc_streaming_interface_t *stream_if;
+  /* USB interface we'll be using */
+  const struct libusb_interface *interface;
+  /* The greatest number of bytes that the device might provide, per packet, in this
+   * configuration */
+  size_t config_bytes_per_packet;
+  /* Index of the altsetting */
+  int alt_idx, ep_idx;
+  /* Whether config_bytes_per_packet is our guess rather than the camera's */
+  int estimated = 0;
+
+  memset(plan, 0, sizeof(*plan));
+  *altsetting = NULL;
 
   // Get the interface that provides the chosen format and frame configuration
-  interface_id = strmh->stream_if->bInterfaceNumber;
-  interface = &strmh->devh->info->config->interface[interface_id];
+  stream_if = _uvc_get_stream_if(devh, ctrl->bInterfaceNumber);
+  if (!stream_if || stream_if->bInterfaceNumber >= devh->info->config->bNumInterfaces)
+    return UVC_ERROR_INVALID_PARAM;
+  interface = &devh->info->config->interface[stream_if->bInterfaceNumber];
+
+  plan->num_transfers = LIBUVC_NUM_TRANSFER_BUFS;
+  if (ctrl->dwFrameInterval)
+    plan->frame_bytes_per_second = (uint64_t) ctrl->dwMaxVideoFrameSize * 10000000 /
+      ctrl->dwFrameInterval;
 
   /* A VS interface uses isochronous transfers iff it has multiple altsettings.
    * (UVC 1.5: 2.4.3. VideoStreaming Interface) */
-  isochronous = interface->num_altsetting > 1;
-
-  if (isochronous) {
-    /* For isochronous streaming, we choose an appropriate altsetting for the endpoint
-     * and set up several transfers */
-    const struct libusb_interface_descriptor *altsetting = 0;
-    const struct libusb_endpoint_descriptor *endpoint = 0;
-    /* The greatest number of bytes that the device might provide, per packet, in this
-     * configuration */
-    size_t config_bytes_per_packet;
-    /* Number of packets per transfer */
-    size_t packets_per_transfer = 0;
+  if (interface->num_altsetting <= 1) {
+    plan->bytes_per_packet = ctrl->dwMaxPayloadTransferSize;
+    /* Without a payload size, read a whole frame at a time */
+    if (!plan->bytes_per_packet)
+      plan->bytes_per_packet = ctrl->dwMaxVideoFrameSize;
+    plan->transfer_size = plan->bytes_per_packet;
+    plan->transfer_memory = (size_t) plan->transfer_size * plan->num_transfers;
+    return UVC_SUCCESS;
+  }
+
+  plan->isochronous = 1;
+  config_bytes_per_packet = ctrl->dwMaxPayloadTransferSize;
+
+  /* Cameras that don't report a payload size get one that keeps up with the
+   * frame rate, header included. Uncompressed frames are often much smaller
+   * than the buffer size their descriptors ask for. */
+  if (!config_bytes_per_packet) {
+    uvc_frame_desc_t *frame = uvc_find_frame_desc(devh, ctrl->bFormatIndex, ctrl->bFrameIndex);
+    uint32_t packets_per_second = _uvc_packets_per_second(devh, 1);
+    uint64_t bytes_per_second = plan->frame_bytes_per_second;
+
+    if (frame && frame->parent->bBitsPerPixel && ctrl->dwFrameInterval) {
+      uint64_t frame_bytes = (uint64_t) frame->wWidth * frame->wHeight *
+        frame->parent->bBitsPerPixel / 8;
+
+      if (!ctrl->dwMaxVideoFrameSize || frame_bytes < ctrl->dwMaxVideoFrameSize)
+        bytes_per_second = frame_bytes * 10000000 / ctrl->dwFrameInterval;
+    }
+
+    config_bytes_per_packet = (bytes_per_second + packets_per_second - 1) /
+      packets_per_second + 12;
+    estimated = 1;
+  }
+
+  /* Go through the altsettings and find one whose packets are at least
+   * as big as our format's maximum per-packet usage. Assume that the
+   * packet sizes are increasing. */
+  for (alt_idx = 0; alt_idx < interface->num_altsetting; alt_idx++) {
+    const struct libusb_interface_descriptor *alt = interface->altsetting + alt_idx;
+    const struct libusb_endpoint_descriptor *endpoint = NULL;
     /* Size of packet transferable from the chosen endpoint */
     size_t endpoint_bytes_per_packet = 0;
-    /* Index of the altsetting */
-    int alt_idx, ep_idx;
-    
-    config_bytes_per_packet = strmh->cur_ctrl.dwMaxPayloadTransferSize;
-
-    /* Go through the altsettings and find one whose packets are at least
-     * as big as our format's maximum per-packet usage. Assume that the
-     * packet sizes are increasing. */
-    for (alt_idx = 0; alt_idx < interface->num_altsetting; alt_idx++) {
-      altsetting = interface->altsetting + alt_idx;
-      endpoint_bytes_per_packet = 0;
-
-      /* Find the endpoint with the number specified in the VS header */
-      for (ep_idx = 0; ep_idx < altsetting->bNumEndpoints; ep_idx++) {
-        endpoint = altsetting->endpoint + ep_idx;
-
-        struct libusb_ss_endpoint_companion_descriptor *ep_comp = 0;
-        libusb_get_ss_endpoint_companion_descriptor(NULL, endpoint, &ep_comp);
-        if (ep_comp)
-        {
-          endpoint_bytes_per_packet = ep_comp->wBytesPerInterval;
-          libusb_free_ss_endpoint_companion_descriptor(ep_comp);
-          break;
-        }
-        else
-        {
-          if (endpoint->bEndpointAddress == format_desc->parent->bEndpointAddress) {
-              endpoint_bytes_per_packet = endpoint->wMaxPacketSize;
-            // wMaxPacketSize: [unused:2 (multiplier-1):3 size:11]
-            endpoint_bytes_per_packet = (endpoint_bytes_per_packet & 0x07ff) *
-              (((endpoint_bytes_per_packet >> 11) & 3) + 1);
-            break;
-          }
-        }
-      }
+    /* Number of packets per transfer */
+    size_t packets_per_transfer;
 
-      if (endpoint_bytes_per_packet >= config_bytes_per_packet) {
-        /* Transfers will be at most one frame long: Divide the maximum frame size
-         * by the size of the endpoint and round up */
-        packets_per_transfer = (ctrl->dwMaxVideoFrameSize +
-                                endpoint_bytes_per_packet - 1) / endpoint_bytes_per_packet;
-
-        /* But keep a reasonable limit: Otherwise we start dropping data */
-        if (packets_per_transfer > 32)
-          packets_per_transfer = 32;
-        
-        total_transfer_size = packets_per_transfer * endpoint_bytes_per_packet;
+    /* Find the endpoint with the number specified in the VS header */
+    for (ep_idx = 0; ep_idx < alt->bNumEndpoints; ep_idx++) {
+      struct libusb_ss_endpoint_companion_descriptor *ep_comp = 0;
+
+      endpoint = alt->endpoint + ep_idx;
+      libusb_get_ss_endpoint_companion_descriptor(NULL, endpoint, &ep_comp);
+      if (ep_comp)
+      {
+        endpoint_bytes_per_packet = ep_comp->wBytesPerInterval;
+        libusb_free_ss_endpoint_companion_descriptor(ep_comp);
         break;
       }
+      else
+      {
+        if (endpoint->bEndpointAddress == stream_if->bEndpointAddress) {
+            endpoint_bytes_per_packet = endpoint->wMaxPacketSize;
+          // wMaxPacketSize: [unused:2 (multiplier-1):3 size:11]
+          endpoint_bytes_per_packet = (endpoint_bytes_per_packet & 0x07ff) *
+            (((endpoint_bytes_per_packet >> 11) & 3) + 1);
+          break;
+        }
+      }
     }
 
-    /* If we searched through all the altsettings and found nothing usable */
-    if (alt_idx == interface->num_altsetting) {
-      ret = UVC_ERROR_INVALID_MODE;
-      goto fail;
-    }
+    /* The zero-bandwidth altsetting can't carry anything. When guessing,
+     * settle for the largest altsetting rather than none. */
+    if (!endpoint_bytes_per_packet)
+      continue;
+    if (endpoint_bytes_per_packet < config_bytes_per_packet &&
+        !(estimated && alt_idx == interface->num_altsetting - 1))
+      continue;
+
+    /* Transfers will be at most one frame long: Divide the maximum frame size
+     * by the size of the endpoint and round up */
+    packets_per_transfer = (ctrl->dwMaxVideoFrameSize +
+                            endpoint_bytes_per_packet - 1) / endpoint_bytes_per_packet;
+
+    /* But keep a reasonable limit: Otherwise we start dropping data */
+    if (packets_per_transfer > 32)
+      packets_per_transfer = 32;
+    if (packets_per_transfer < 1)
+      packets_per_transfer = 1;
+
+    plan->bAlternateSetting = alt->bAlternateSetting;
+    plan->bytes_per_packet = endpoint_bytes_per_packet;
+    plan->packets_per_second = _uvc_packets_per_second(devh, endpoint->bInterval);
+    plan->packets_per_transfer = packets_per_transfer;
+    plan->transfer_size = packets_per_transfer * endpoint_bytes_per_packet;
+    plan->transfer_memory = (size_t) plan->transfer_size * plan->num_transfers;
+    plan->reserved_bytes_per_second = (uint64_t) endpoint_bytes_per_packet *
+      plan->packets_per_second;
+    *altsetting = alt;
+    return UVC_SUCCESS;
+  }
 
+  /* If we searched through all the altsettings and found nothing usable */
+  return UVC_ERROR_INVALID_MODE;
+}
+
+/** @brief Get the bus bandwidth and transfer memory of a negotiated mode
+ * @ingroup streaming
+ *
+ * Works out the altsetting and transfers uvc_stream_start() would use for
+ * the mode, without selecting the altsetting or allocating anything.
+ *
+ * @param devh Device handle
+ * @param ctrl Control block negotiated with uvc_probe_stream_ctrl(),
+ *             uvc_get_stream_ctrl_format_size() or uvc_get_stream_ctrl_frame()
+ * @param[out] bandwidth Bandwidth and transfer layout of the mode
+ * @return UVC_ERROR_INVALID_MODE if no altsetting can carry the negotiated
+ * payload size
+ */
+uvc_error_t uvc_get_stream_bandwidth(
+    uvc_device_handle_t *devh,
+    const uvc_stream_ctrl_t *ctrl,
+    uvc_stream_bandwidth_t *bandwidth) {
+  const struct libusb_interface_descriptor *altsetting;
+
+  if (!ctrl || !bandwidth)
+    return UVC_ERROR_INVALID_PARAM;
+
+  return _uvc_plan_transfers(devh, ctrl, bandwidth, &altsetting);
+}
+
+/** @internal
+ * @brief Set up and submit the transfers of a stream
+ *
+ * Also used by the watchdog to restart a stalled stream.
+ */
+uvc_error_t _uvc_stream_start(
+    uvc_stream_handle_t *strmh,
+    uvc_frame_callback_t *cb,
+    void *user_ptr,
+    uint8_t flags
+) {
+  uvc_frame_desc_t *frame_desc;
+  uvc_format_desc_t *format_desc;
+  uvc_stream_ctrl_t *ctrl;
+  uvc_error_t ret;
+  /* Altsetting and transfer layout for the mode */
+  uvc_stream_bandwidth_t plan;
+  const struct libusb_interface_descriptor *altsetting;
+  /* Largest payload (header included) the device may send */
+  size_t payload_size = 0;
+  struct libusb_transfer *transfer;
+  int transfer_id;
+
+  ctrl = &strmh->cur_ctrl;
+
+  UVC_ENTER();
+
+  if (strmh->running || strmh->playback) {
+    UVC_EXIT(UVC_ERROR_BUSY);
+    return UVC_ERROR_BUSY;
+  }
+
+  strmh->running = 1;
+  ret = _uvc_stream_prepare(strmh, flags);
+  if (ret != UVC_SUCCESS)
+    goto fail;
+
+  frame_desc = uvc_find_frame_desc_stream(strmh, ctrl->bFormatIndex, ctrl->bFrameIndex);
+  format_desc = frame_desc->parent;
+
+  ret = _uvc_plan_transfers(strmh->devh, ctrl, &plan, &altsetting);
+  if (ret != UVC_SUCCESS)
+    goto fail;
+
+  payload_size = plan.bytes_per_packet;
+
+  if (plan.isochronous) {
     /* Select the altsetting */
     ret = libusb_set_interface_alt_setting(strmh->devh->usb_devh,
                                            altsetting->bInterfaceNumber,
@@ -1208,40 +2353,54 @@ uvc_error_t uvc_stream_start(
 
     /* Set up the transfers */
     for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; ++transfer_id) {
-      transfer = libusb_alloc_transfer(packets_per_transfer);
+      transfer = libusb_alloc_transfer(plan.packets_per_transfer);
       strmh->transfers[transfer_id] = transfer;      
-      strmh->transfer_bufs[transfer_id] = malloc(total_transfer_size);
+      strmh->transfer_bufs[transfer_id] = _uvc_buf_alloc(strmh->devh->dev->ctx,
+                                                         plan.transfer_size);
 
       libusb_fill_iso_transfer(
         transfer, strmh->devh->usb_devh, format_desc->parent->bEndpointAddress,
         strmh->transfer_bufs[transfer_id],
-        total_transfer_size, packets_per_transfer, _uvc_stream_callback, (void*) strmh, 5000);
+        plan.transfer_size, plan.packets_per_transfer, _uvc_stream_callback, (void*) strmh, 5000);
 
-      libusb_set_iso_packet_lengths(transfer, endpoint_bytes_per_packet);
+      libusb_set_iso_packet_lengths(transfer, plan.bytes_per_packet);
     }
   } else {
     for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS;
         ++transfer_id) {
       transfer = libusb_alloc_transfer(0);
       strmh->transfers[transfer_id] = transfer;
-      strmh->transfer_bufs[transfer_id] = malloc (
-          strmh->cur_ctrl.dwMaxPayloadTransferSize );
+      strmh->transfer_bufs[transfer_id] = _uvc_buf_alloc(strmh->devh->dev->ctx,
+          plan.transfer_size );
       libusb_fill_bulk_transfer ( transfer, strmh->devh->usb_devh,
           format_desc->parent->bEndpointAddress,
           strmh->transfer_bufs[transfer_id],
-          strmh->cur_ctrl.dwMaxPayloadTransferSize, _uvc_stream_callback,
+          plan.transfer_size, _uvc_stream_callback,
           ( void* ) strmh, 5000 );
     }
   }
 
+  _uvc_size_meta_bufs(strmh, payload_size);
+
   strmh->user_cb = cb;
   strmh->user_ptr = user_ptr;
 
+  /* After a watchdog restart the held frame was already handed out */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->user_seq = strmh->hold_seq;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  if (pthread_create(&strmh->resubmit_thread, NULL, _uvc_resubmit_thread, (void*) strmh)) {
+    ret = UVC_ERROR_OTHER;
+    goto fail_transfers;
+  }
+
   /* If the user wants it, set up a thread that calls the user's function
    * with the contents of each frame.
    */
-  if (cb) {
-    pthread_create(&strmh->cb_thread, NULL, _uvc_user_caller, (void*) strmh);
+  if (cb && pthread_create(&strmh->cb_thread, NULL, _uvc_user_caller, (void*) strmh)) {
+    ret = UVC_ERROR_OTHER;
+    goto fail_resubmit;
   }
 
   for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS;
@@ -1253,17 +2412,33 @@ uvc_error_t uvc_stream_start(
     }
   }
 
+  /* Transfers the bus wouldn't accept up front are dropped for good; the
+   * remaining ones form the depth the resubmit thread maintains */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->transfer_stats.target_in_flight = transfer_id;
   if ( ret != UVC_SUCCESS && transfer_id >= 0 ) {
-    for ( ; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; transfer_id++) {
-      free ( strmh->transfers[transfer_id]->buffer );
-      libusb_free_transfer ( strmh->transfers[transfer_id]);
-      strmh->transfers[transfer_id] = 0;
-    }
+    for ( ; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; transfer_id++)
+      _uvc_drop_transfer(strmh, transfer_id);
     ret = UVC_SUCCESS;
   }
+  pthread_mutex_unlock(&strmh->cb_mutex);
 
   UVC_EXIT(ret);
   return ret;
+fail_resubmit:
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->running = 0;
+  pthread_cond_broadcast(&strmh->resubmit_cond);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+  pthread_join(strmh->resubmit_thread, NULL);
+fail_transfers:
+  /* Nothing has been submitted yet */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  for (transfer_id = 0; transfer_id < LIBUVC_NUM_TRANSFER_BUFS; transfer_id++) {
+    if (strmh->transfers[transfer_id])
+      _uvc_drop_transfer(strmh, transfer_id);
+  }
+  pthread_mutex_unlock(&strmh->cb_mutex);
 fail:
   strmh->running = 0;
   UVC_EXIT(ret);
@@ -1297,7 +2472,11 @@ uvc_error_t uvc_stream_start_iso(
 void *_uvc_user_caller(void *arg) {
   uvc_stream_handle_t *strmh = (uvc_stream_handle_t *) arg;
 
-  uint32_t last_seq = 0;
+  uint32_t last_seq;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  last_seq = strmh->user_seq;
+  pthread_mutex_unlock(&strmh->cb_mutex);
 
   do {
     pthread_mutex_lock(&strmh->cb_mutex);
@@ -1313,6 +2492,10 @@ void *_uvc_user_caller(void *arg) {
     
     last_seq = strmh->hold_seq;
     _uvc_populate_frame(strmh);
+
+    /* trace replay paces itself on frames being taken */
+    strmh->user_seq = last_seq;
+    pthread_cond_broadcast(&strmh->cb_cond);
     
     pthread_mutex_unlock(&strmh->cb_mutex);
     
@@ -1329,6 +2512,13 @@ void *_uvc_user_caller(void *arg) {
 void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
   uvc_frame_t *frame = &strmh->frame;
   uvc_frame_desc_t *frame_desc;
+  uint8_t *tmp_buf;
+  size_t tmp_size;
+
+  if (strmh->playback) {
+    _uvc_playback_populate_frame(strmh);
+    return;
+  }
 
   /** @todo this stuff that hits the main config cache should really happen
    * in start() so that only one thread hits these data. all of this stuff
@@ -1367,25 +2557,42 @@ void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
     break;
   }
 
+  if (strmh->hold_roi) {
+    frame->width = strmh->roi_w;
+    frame->height = strmh->roi_h;
+    frame->step = strmh->roi_step;
+  }
+
   frame->sequence = strmh->hold_seq;
   frame->capture_time_finished = strmh->capture_time_finished;
+  frame->pts = strmh->hold_pts;
+  frame->scr = strmh->hold_last_scr;
 
-  /* copy the image data from the hold buffer to the frame (unnecessary extra buf?) */
-  if (frame->data_bytes < strmh->hold_bytes) {
-    frame->data = realloc(frame->data, strmh->hold_bytes);
+  if (!strmh->hold_has_image) {
+    /* sampled out: metadata only */
+    frame->data_bytes = 0;
+  } else {
+    /* The frame's data buffer takes part in the rotation of the stream's
+     * frame buffers, so the frame is delivered from the buffer it was
+     * assembled (and sliced) in, without a copy */
+    tmp_buf = frame->data;
+    frame->data = strmh->holdbuf;
+    strmh->holdbuf = tmp_buf;
+    tmp_size = strmh->frame_buf_size;
+    strmh->frame_buf_size = strmh->holdbuf_size;
+    strmh->holdbuf_size = tmp_size;
+    frame->data_bytes = strmh->hold_bytes;
+    /* the hold buffer now has an older frame's data */
+    strmh->hold_has_image = 0;
   }
-  frame->data_bytes = strmh->hold_bytes;
-  memcpy(frame->data, strmh->holdbuf, frame->data_bytes);
 
-  if (strmh->meta_hold_bytes > 0)
-  {
-      if (frame->metadata_bytes < strmh->meta_hold_bytes)
-      {
-          frame->metadata = realloc(frame->metadata, strmh->meta_hold_bytes);
-      }
-      frame->metadata_bytes = strmh->meta_hold_bytes;
-      memcpy(frame->metadata, strmh->meta_holdbuf, frame->metadata_bytes);
-  }
+  /* The frame's metadata buffer takes part in the rotation of the stream's
+   * metadata buffers, so handing the metadata over is a pointer swap */
+  tmp_buf = frame->metadata;
+  frame->metadata = strmh->meta_holdbuf;
+  strmh->meta_holdbuf = tmp_buf;
+  frame->metadata_bytes = strmh->meta_hold_bytes;
+  strmh->meta_hold_bytes = 0;
 }
 
 /** Poll for a frame
@@ -1463,11 +2670,423 @@ uvc_error_t uvc_stream_get_frame(uvc_stream_handle_t *strmh,
     *frame = NULL;
   }
 
+  /* playback paces itself on frames being taken */
+  if (*frame && strmh->playback)
+    pthread_cond_broadcast(&strmh->cb_cond);
+
   pthread_mutex_unlock(&strmh->cb_mutex);
 
   return UVC_SUCCESS;
 }
 
+/** @internal
+ * @brief Populate the still frame handed to user code
+ * @note Must be called with still_mutex held
+ */
+static void _uvc_populate_still_frame(uvc_stream_handle_t *strmh) {
+  uvc_frame_t *frame = &strmh->still_frame;
+
+  frame->frame_format = strmh->still_format;
+  frame->width = strmh->still_width;
+  frame->height = strmh->still_height;
+
+  switch (frame->frame_format) {
+  case UVC_FRAME_FORMAT_YUYV:
+    frame->step = frame->width * 2;
+    break;
+  case UVC_FRAME_FORMAT_NV12:
+    frame->step = frame->width;
+    break;
+  default:
+    frame->step = 0;
+    break;
+  }
+
+  frame->sequence = strmh->still_hold_seq;
+  frame->capture_time_finished = strmh->still_capture_time;
+  frame->pts = 0;
+  frame->scr = 0;
+
+  if (frame->data_bytes < strmh->still_hold_bytes) {
+    void *buf = _uvc_buf_realloc(strmh->devh->dev->ctx, frame->data,
+                                 strmh->still_hold_bytes);
+
+    if (!buf) {
+      frame->data_bytes = 0;
+      return;
+    }
+    frame->data = buf;
+  }
+  frame->data_bytes = strmh->still_hold_bytes;
+  memcpy(frame->data, strmh->still_holdbuf, frame->data_bytes);
+}
+
+/** @internal
+ * @brief Still image callback runner thread
+ *
+ * Separate from the video callback thread so a slow still consumer doesn't
+ * hold up preview frames.
+ */
+void *_uvc_still_caller(void *arg) {
+  uvc_stream_handle_t *strmh = (uvc_stream_handle_t *) arg;
+  uint32_t last_seq;
+
+  pthread_mutex_lock(&strmh->still_mutex);
+  last_seq = strmh->still_hold_seq;
+
+  do {
+    while (!strmh->kill_still_thread && last_seq == strmh->still_hold_seq)
+      pthread_cond_wait(&strmh->still_cond, &strmh->still_mutex);
+
+    if (strmh->kill_still_thread)
+      break;
+
+    last_seq = strmh->still_hold_seq;
+    _uvc_populate_still_frame(strmh);
+
+    pthread_mutex_unlock(&strmh->still_mutex);
+    strmh->still_cb(&strmh->still_frame, strmh->still_user_ptr);
+    pthread_mutex_lock(&strmh->still_mutex);
+
+    strmh->still_consumed_seq = last_seq;
+    pthread_cond_broadcast(&strmh->still_cond);
+  } while (1);
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+
+  return NULL;
+}
+
+/** @internal
+ * @brief End the still callback thread, if any
+ */
+static void _uvc_stop_still_caller(uvc_stream_handle_t *strmh) {
+  pthread_mutex_lock(&strmh->still_mutex);
+  if (!strmh->still_thread_running) {
+    pthread_mutex_unlock(&strmh->still_mutex);
+    return;
+  }
+  strmh->kill_still_thread = 1;
+  pthread_cond_broadcast(&strmh->still_cond);
+  pthread_mutex_unlock(&strmh->still_mutex);
+
+  pthread_join(strmh->still_thread, NULL);
+  strmh->still_thread_running = 0;
+  strmh->kill_still_thread = 0;
+}
+
+/** @brief Keep image data for only some frames
+ * @ingroup streaming
+ *
+ * Every frame is still delivered, with its metadata, timestamps and
+ * sequence number, but only one frame in @p interval carries image data.
+ * The others have data_bytes == 0, and their payload data is never copied
+ * out of the USB transfers. Takes effect from the next frame.
+ *
+ * @param strmh UVC stream handle
+ * @param interval 1 for every frame (the default), N for every Nth frame,
+ *   0 for metadata only
+ */
+uvc_error_t uvc_stream_set_image_interval(
+    uvc_stream_handle_t *strmh,
+    uint32_t interval) {
+  UVC_ATOMIC_STORE(&strmh->image_interval, interval);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Deliver only some of the frames the camera sends
+ * @ingroup streaming
+ *
+ * Frames that are decimated away are still tracked so that frame boundaries
+ * stay correct, but their payloads are never copied out of the USB transfers
+ * and they are neither handed to the callback nor returned by
+ * uvc_stream_get_frame. Sequence numbers keep counting them, so the gaps
+ * show in uvc_frame_t::sequence. Takes effect from the next frame.
+ *
+ * @param strmh UVC stream handle
+ * @param every_n Deliver one frame in @p every_n; 0 or 1 delivers all
+ * @param min_frame_interval Deliver at most one frame per interval, in 100ns
+ *   units like dwFrameInterval, judged by capture time; overrides @p every_n
+ *   when nonzero
+ */
+uvc_error_t uvc_stream_set_frame_decimation(
+    uvc_stream_handle_t *strmh,
+    uint32_t every_n,
+    uint32_t min_frame_interval) {
+  UVC_ATOMIC_STORE(&strmh->decimate_n, every_n);
+  UVC_ATOMIC_STORE(&strmh->decimate_interval, min_frame_interval);
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Work out the row layout of the negotiated format
+ *
+ * Uncompressed formats, and frame-based ones that give dwBytesPerLine, have
+ * one. Planar formats are described by their luma plane. Checks the ROI
+ * against it.
+ */
+static uvc_error_t _uvc_setup_rows(uvc_stream_handle_t *strmh,
+                                   uvc_frame_desc_t *frame_desc) {
+  uvc_format_desc_t *format_desc = frame_desc->parent;
+  int planar = 0;
+
+  strmh->row_step = 0;
+  strmh->roi_step = 0;
+  strmh->roi_frame = 0;
+  strmh->slice_row = 0;
+  strmh->roi_got_bytes = 0;
+
+  switch (strmh->frame_format) {
+  case UVC_FRAME_FORMAT_NV12:
+    strmh->row_step = frame_desc->wWidth;
+    planar = 1;
+    break;
+  case UVC_FRAME_FORMAT_P010:
+    strmh->row_step = frame_desc->wWidth * 2;
+    planar = 1;
+    break;
+  default:
+    if (format_desc->bDescriptorSubtype == UVC_VS_FORMAT_UNCOMPRESSED)
+      strmh->row_step = (size_t) frame_desc->wWidth * format_desc->bBitsPerPixel / 8;
+    else if (format_desc->bDescriptorSubtype == UVC_VS_FORMAT_FRAME_BASED)
+      strmh->row_step = frame_desc->dwBytesPerLine;
+    break;
+  }
+
+  strmh->row_width = frame_desc->wWidth;
+  strmh->row_height = frame_desc->wHeight;
+
+  if (!strmh->roi_w || !strmh->roi_h)
+    return UVC_SUCCESS;
+
+  /* the ROI needs whole bytes per pixel in a single plane */
+  if (!strmh->row_step || planar || format_desc->bBitsPerPixel % 8)
+    return UVC_ERROR_NOT_SUPPORTED;
+
+  if (strmh->roi_x + strmh->roi_w > frame_desc->wWidth ||
+      strmh->roi_y + strmh->roi_h > frame_desc->wHeight)
+    return UVC_ERROR_INVALID_PARAM;
+
+  /* 4:2:2 chroma is shared by pixel pairs */
+  if ((strmh->frame_format == UVC_FRAME_FORMAT_YUYV ||
+       strmh->frame_format == UVC_FRAME_FORMAT_UYVY) &&
+      (strmh->roi_x % 2 || strmh->roi_w % 2))
+    return UVC_ERROR_INVALID_PARAM;
+
+  strmh->roi_offset = (size_t) strmh->roi_x * format_desc->bBitsPerPixel / 8;
+  strmh->roi_step = (size_t) strmh->roi_w * format_desc->bBitsPerPixel / 8;
+
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Allocate the frame assembly buffers for the negotiated mode
+ *
+ * Formats with a fixed row layout fill dwMaxVideoFrameSize exactly. Many
+ * devices report a compressed format's maximum as the uncompressed size or
+ * more, though, so compressed streams start smaller and grow on demand.
+ * With an ROI the buffers only hold the ROI; a whole frame, taken for a
+ * method 1 still, grows them the same way. The delivered frame's buffer
+ * rotates with the other two, so it gets the same size. Runs after
+ * _uvc_setup_rows.
+ */
+static uvc_error_t _uvc_size_frame_bufs(uvc_stream_handle_t *strmh) {
+  size_t max_size = strmh->cur_ctrl.dwMaxVideoFrameSize;
+  size_t size = max_size;
+  uint8_t *outbuf, *holdbuf, *framebuf;
+
+  if (strmh->roi_step) {
+    size = strmh->roi_step * strmh->roi_h;
+  } else if (!strmh->row_step) {
+    size = max_size / LIBUVC_FRAME_BUF_DIVISOR;
+    if (size < LIBUVC_FRAME_BUF_MIN_SIZE)
+      size = LIBUVC_FRAME_BUF_MIN_SIZE;
+    if (size < strmh->buffer_stats.high_water + strmh->buffer_stats.high_water / 4)
+      size = strmh->buffer_stats.high_water + strmh->buffer_stats.high_water / 4;
+    if (size > max_size)
+      size = max_size;
+  }
+
+  if (size != strmh->outbuf_size) {
+    outbuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->outbuf, size);
+    if (!outbuf)
+      return UVC_ERROR_NO_MEM;
+    strmh->outbuf = outbuf;
+    strmh->outbuf_size = size;
+  }
+
+  if (size != strmh->holdbuf_size) {
+    holdbuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->holdbuf, size);
+    if (!holdbuf)
+      return UVC_ERROR_NO_MEM;
+    strmh->holdbuf = holdbuf;
+    strmh->holdbuf_size = size;
+  }
+
+  if (size != strmh->frame_buf_size) {
+    framebuf = _uvc_buf_realloc(strmh->devh->dev->ctx, strmh->frame.data, size);
+    if (!framebuf)
+      return UVC_ERROR_NO_MEM;
+    strmh->frame.data = framebuf;
+    strmh->frame_buf_size = size;
+  }
+
+  strmh->buffer_stats.buffer_size = size;
+  strmh->buffer_stats.max_frame_size = max_size;
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Report rows of uncompressed frames as soon as they arrive
+ * @ingroup streaming
+ *
+ * The callback runs on the USB event thread each time @p rows_per_slice more
+ * rows of the frame being assembled are complete, and once more with the
+ * remaining rows when the frame ends. It sees the buffer the frame is being
+ * assembled in, which is the one the finished frame is delivered from, so
+ * processing of the top of the image can start before EOF. It must return
+ * quickly and must not keep the pointer.
+ *
+ * Compressed formats produce no slices. Must be called while the stream is
+ * stopped.
+ *
+ * @param strmh UVC stream handle
+ * @param cb Slice callback, or NULL to turn slices off
+ * @param rows_per_slice Rows per slice; 0 reports whatever rows each payload
+ *   completes
+ * @param user_ptr Passed to the callback
+ */
+uvc_error_t uvc_stream_set_slice_callback(
+    uvc_stream_handle_t *strmh,
+    uvc_slice_callback_t *cb,
+    uint32_t rows_per_slice,
+    void *user_ptr) {
+  if (strmh->running)
+    return UVC_ERROR_BUSY;
+
+  strmh->slice_cb = cb;
+  strmh->slice_rows = rows_per_slice;
+  strmh->slice_user_ptr = user_ptr;
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Assemble only a rectangle of each frame
+ * @ingroup streaming
+ *
+ * Only the bytes of each payload that fall inside the rectangle are copied,
+ * packed row by row, and frames are delivered with the size and step of the
+ * rectangle. Needs an uncompressed single-plane format with whole bytes per
+ * pixel; for YUYV and UYVY, @p x and @p width must be even. Checked when the
+ * stream starts, which fails otherwise. Frames carrying a method 1 still are
+ * assembled in full. Must be called while the stream is stopped.
+ *
+ * @param strmh UVC stream handle
+ * @param x Left column of the rectangle
+ * @param y Top row of the rectangle
+ * @param width Width in pixels; 0 turns the ROI off
+ * @param height Height in rows; 0 turns the ROI off
+ */
+uvc_error_t uvc_stream_set_roi(
+    uvc_stream_handle_t *strmh,
+    uint32_t x, uint32_t y,
+    uint32_t width, uint32_t height) {
+  if (strmh->running)
+    return UVC_ERROR_BUSY;
+
+  strmh->roi_x = x;
+  strmh->roi_y = y;
+  strmh->roi_w = width;
+  strmh->roi_h = height;
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Deliver method 2 still images to a callback
+ * @ingroup streaming
+ *
+ * Still images (payloads with the STI bit set) are assembled apart from the
+ * video frames and handed to @p cb on a thread of their own, with the still
+ * resolution selected by uvc_trigger_still(). Pass NULL to collect them with
+ * uvc_stream_get_still() instead.
+ *
+ * @param strmh UVC stream handle
+ * @param cb Still image callback. See {uvc_frame_callback_t} for restrictions.
+ */
+uvc_error_t uvc_stream_set_still_callback(
+    uvc_stream_handle_t *strmh,
+    uvc_frame_callback_t *cb,
+    void *user_ptr) {
+  _uvc_stop_still_caller(strmh);
+
+  strmh->still_cb = cb;
+  strmh->still_user_ptr = user_ptr;
+
+  if (cb) {
+    if (pthread_create(&strmh->still_thread, NULL, _uvc_still_caller, (void*) strmh))
+      return UVC_ERROR_OTHER;
+    strmh->still_thread_running = 1;
+  }
+
+  return UVC_SUCCESS;
+}
+
+/** Poll for a still image
+ * @ingroup streaming
+ *
+ * @param strmh UVC stream handle
+ * @param[out] frame Location to store pointer to the still image (NULL if none)
+ * @param timeout_us >0: Wait at most N microseconds; 0: Wait indefinitely; -1: return immediately
+ */
+uvc_error_t uvc_stream_get_still(
+    uvc_stream_handle_t *strmh,
+    uvc_frame_t **frame,
+    int32_t timeout_us) {
+  struct timespec ts;
+  uint64_t nsec;
+  int err = 0;
+
+  if (strmh->still_cb)
+    return UVC_ERROR_CALLBACK_EXISTS;
+
+  *frame = NULL;
+
+  pthread_mutex_lock(&strmh->still_mutex);
+
+  if (timeout_us > 0) {
+    clock_gettime(CLOCK_REALTIME, &ts);
+    nsec = ts.tv_nsec + (uint64_t) timeout_us * 1000;
+    ts.tv_sec += nsec / 1000000000;
+    ts.tv_nsec = nsec % 1000000000;
+  }
+
+  while (strmh->still_last_polled_seq == strmh->still_hold_seq && timeout_us != -1) {
+    if (timeout_us == 0) {
+      pthread_cond_wait(&strmh->still_cond, &strmh->still_mutex);
+    } else {
+      err = pthread_cond_timedwait(&strmh->still_cond, &strmh->still_mutex, &ts);
+      if (err)
+        break;
+    }
+  }
+
+  if (strmh->still_last_polled_seq != strmh->still_hold_seq) {
+    _uvc_populate_still_frame(strmh);
+    *frame = &strmh->still_frame;
+    strmh->still_last_polled_seq = strmh->still_hold_seq;
+    err = 0;
+  }
+
+  pthread_mutex_unlock(&strmh->still_mutex);
+
+  if (err)
+    return err == ETIMEDOUT ? UVC_ERROR_TIMEOUT : UVC_ERROR_OTHER;
+
+  return UVC_SUCCESS;
+}
+
 /** @brief Stop streaming video
  * @ingroup streaming
  *
@@ -1491,8 +3110,21 @@ void uvc_stop_streaming(uvc_device_handle_t *devh) {
  * @param devh UVC device
  */
 uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
+  _uvc_watchdog_stop(strmh);
+
+  return _uvc_stream_stop(strmh);
+}
+
+/** @internal
+ * @brief Cancel the transfers of a stream and end its callback thread
+ */
+uvc_error_t _uvc_stream_stop(uvc_stream_handle_t *strmh) {
   int i;
 
+  /* a recording may have played out and stopped the stream already */
+  if (strmh->playback)
+    return _uvc_playback_stop(strmh);
+
   if (!strmh->running)
     return UVC_ERROR_INVALID_PARAM;
 
@@ -1504,12 +3136,19 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
    *   necessarily completed but they will be free'd in _uvc_stream_callback().
    */
   for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
-    if(strmh->transfers[i] != NULL)
+    if(strmh->transfers[i] != NULL && !strmh->transfer_parked[i])
       libusb_cancel_transfer(strmh->transfers[i]);
   }
 
+  pthread_cond_broadcast(&strmh->resubmit_cond);
+
   /* Wait for transfers to complete/cancel */
   do {
+    /* Parked transfers aren't on the bus, so nothing else will free them */
+    for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
+      if(strmh->transfers[i] != NULL && strmh->transfer_parked[i])
+        _uvc_drop_transfer(strmh, i);
+    }
     for(i=0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
       if(strmh->transfers[i] != NULL)
         break;
@@ -1522,6 +3161,11 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
   pthread_cond_broadcast(&strmh->cb_cond);
   pthread_mutex_unlock(&strmh->cb_mutex);
 
+  pthread_join(strmh->resubmit_thread, NULL);
+
+  /* Method 3 stills are only pending while the stream runs */
+  _uvc_stop_still_transfers(strmh);
+
   /** @todo stop the actual stream, camera side? */
 
   if (strmh->user_cb) {
@@ -1533,6 +3177,86 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
   return UVC_SUCCESS;
 }
 
+/** @brief Get the frame buffer usage of a stream
+ * @ingroup streaming
+ *
+ * The high water mark carries over between runs, and later starts size the
+ * buffers of compressed streams from it.
+ *
+ * @param strmh UVC stream handle
+ * @param[out] stats Buffer usage
+ */
+uvc_error_t uvc_stream_get_buffer_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_stream_buffer_stats_t *stats) {
+  if (!stats)
+    return UVC_ERROR_INVALID_PARAM;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  *stats = strmh->buffer_stats;
+  stats->buffer_size = strmh->outbuf_size > strmh->holdbuf_size ?
+                       strmh->outbuf_size : strmh->holdbuf_size;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Get the transfer health counters of a stream
+ * @ingroup streaming
+ *
+ * Counters cover the current (or last) run of the stream, including any
+ * restarts by the watchdog.
+ *
+ * @param strmh UVC stream handle
+ * @param[out] stats Counters
+ */
+uvc_error_t uvc_stream_get_transfer_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_stream_transfer_stats_t *stats) {
+  int i;
+
+  if (!stats)
+    return UVC_ERROR_INVALID_PARAM;
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  *stats = strmh->transfer_stats;
+  stats->in_flight = 0;
+  for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
+    if (strmh->transfers[i] && !strmh->transfer_parked[i])
+      stats->in_flight++;
+  }
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Get the status events the device reported for a stream
+ * @ingroup streaming
+ *
+ * Stream errors are counted from the moment the stream was opened, so they
+ * can be lined up with dropped or corrupted frames.
+ *
+ * @param strmh UVC stream handle
+ * @param[out] stats Counters
+ */
+uvc_error_t uvc_stream_get_status_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_stream_status_stats_t *stats) {
+  uvc_device_handle_t *devh = strmh->devh;
+
+  if (!stats)
+    return UVC_ERROR_INVALID_PARAM;
+
+  pthread_mutex_lock(&devh->status_mutex);
+  stats->stream_errors = strmh->status_stream_errors;
+  stats->button_events = strmh->status_button_events;
+  stats->last_stream_error_code = strmh->last_stream_error_code;
+  stats->status_dropped = devh->status_dropped;
+  pthread_mutex_unlock(&devh->status_mutex);
+
+  return UVC_SUCCESS;
+}
+
 /** @brief Close stream.
  * @ingroup streaming
  *
@@ -1541,23 +3265,44 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
  * @param strmh UVC stream handle
  */
 void uvc_stream_close(uvc_stream_handle_t *strmh) {
-  if (strmh->running)
-    uvc_stream_stop(strmh);
+  /* the watchdog may have left a stream it couldn't recover stopped */
+  _uvc_watchdog_stop(strmh);
+
+  if (strmh->running || strmh->playback)
+    _uvc_stream_stop(strmh);
+
+  uvc_stream_stop_trace(strmh);
+
+  /* Still transfers use the interface, so they go before it is released */
+  _uvc_stop_still_transfers(strmh);
+  _uvc_stop_still_caller(strmh);
 
   uvc_release_if(strmh->devh, strmh->stream_if->bInterfaceNumber);
 
-  if (strmh->frame.data)
-    free(strmh->frame.data);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->frame.data);
 
-  free(strmh->outbuf);
-  free(strmh->holdbuf);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->still_frame.data);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->still_outbuf);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->still_holdbuf);
 
-  free(strmh->meta_outbuf);
-  free(strmh->meta_holdbuf);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->outbuf);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->holdbuf);
+
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->meta_outbuf);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->meta_holdbuf);
+  _uvc_buf_free(strmh->devh->dev->ctx, strmh->frame.metadata);
 
   pthread_cond_destroy(&strmh->cb_cond);
   pthread_mutex_destroy(&strmh->cb_mutex);
-
+  pthread_cond_destroy(&strmh->wd_cond);
+  pthread_cond_destroy(&strmh->resubmit_cond);
+  pthread_cond_destroy(&strmh->still_cond);
+  pthread_mutex_destroy(&strmh->still_mutex);
+  pthread_mutex_destroy(&strmh->wd_mutex);
+  pthread_mutex_destroy(&strmh->trace_mutex);
+
+  pthread_mutex_lock(&strmh->devh->status_mutex);
   DL_DELETE(strmh->devh->streams, strmh);
+  pthread_mutex_unlock(&strmh->devh->status_mutex);
   free(strmh);
 }
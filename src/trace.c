@@ -0,0 +1,608 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @ingroup streaming
+ * @brief Transfer traces: recording and replay
+ *
+ * A trace holds every transfer a stream completed, as the event thread saw
+ * it: the transfer status, the isochronous packet descriptors, the payload
+ * bytes and the host time of completion. Replaying a trace runs the payloads
+ * through the same assembly code as a live stream, so corrupt frames and FID
+ * glitches seen in the field can be reproduced, and assembly throughput
+ * measured, without the camera.
+ *
+ * The file is a uvc_trace_file_header followed by records, each a
+ * uvc_trace_record, its packet descriptors and the packets' bytes, padded to
+ * 8 bytes. Fields are in host byte order and naturally aligned so a mapped
+ * file can be walked in place.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define LIBUVC_TRACE_MAGIC "UVCTRACE"
+#define LIBUVC_TRACE_VERSION 1
+/* stdio buffer of the recorder, so the event thread rarely waits on a write */
+#define LIBUVC_TRACE_BUF_SIZE (4 * 1024 * 1024)
+
+struct uvc_trace_file_header {
+  char magic[8];
+  uint32_t version;
+  /** Offset of the first record */
+  uint32_t header_size;
+  uint32_t frame_format;
+  uint16_t width;
+  uint16_t height;
+  uint8_t bFormatIndex;
+  uint8_t bFrameIndex;
+  uint8_t isochronous;
+  uint8_t reserved0;
+  uint32_t dwFrameInterval;
+  uint32_t dwMaxVideoFrameSize;
+  uint32_t dwMaxPayloadTransferSize;
+  uint32_t dwClockFrequency;
+  uint32_t reserved1;
+  /** CLOCK_MONOTONIC time of the first record */
+  uint64_t start_ns;
+  uint8_t reserved2[8];
+};
+
+struct uvc_trace_record {
+  /** Bytes up to the next record */
+  uint32_t record_size;
+  /** libusb_transfer_status of the transfer */
+  int32_t status;
+  /** Completion time since the first record */
+  uint64_t timestamp_ns;
+  /** Packet descriptors that follow; 0 for a bulk transfer */
+  uint32_t num_packets;
+  /** Payload bytes that follow the descriptors */
+  uint32_t data_bytes;
+};
+
+struct uvc_trace_packet {
+  uint32_t length;
+  uint32_t actual_length;
+  int32_t status;
+};
+
+struct uvc_trace {
+  FILE *file;
+  uint8_t header_written;
+  uint64_t start_ns;
+  /** First write error, after which nothing more is recorded */
+  uvc_error_t error;
+};
+
+/* A trace file mapped (or, without mmap, read) into memory */
+struct uvc_trace_map {
+  uint8_t *data;
+  size_t size;
+};
+
+uvc_frame_desc_t *uvc_find_frame_desc_stream(uvc_stream_handle_t *strmh,
+    uint16_t format_id, uint16_t frame_id);
+
+static uint64_t _uvc_trace_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _uvc_trace_write(struct uvc_trace *trace, const void *data, size_t size) {
+  if (size && !trace->error && fwrite(data, 1, size, trace->file) != size)
+    trace->error = UVC_ERROR_IO;
+}
+
+/** @internal
+ * @brief Write the file header from the stream's negotiated mode
+ */
+static void _uvc_trace_write_header(uvc_stream_handle_t *strmh, struct uvc_trace *trace,
+                                    uint8_t isochronous, uint64_t now) {
+  struct uvc_trace_file_header hdr;
+  uvc_frame_desc_t *frame_desc;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, LIBUVC_TRACE_MAGIC, sizeof(hdr.magic));
+  hdr.version = LIBUVC_TRACE_VERSION;
+  hdr.header_size = sizeof(hdr);
+  hdr.frame_format = strmh->frame_format;
+  frame_desc = uvc_find_frame_desc_stream(strmh, strmh->cur_ctrl.bFormatIndex,
+                                          strmh->cur_ctrl.bFrameIndex);
+  if (frame_desc) {
+    hdr.width = frame_desc->wWidth;
+    hdr.height = frame_desc->wHeight;
+  }
+  hdr.bFormatIndex = strmh->cur_ctrl.bFormatIndex;
+  hdr.bFrameIndex = strmh->cur_ctrl.bFrameIndex;
+  hdr.isochronous = isochronous;
+  hdr.dwFrameInterval = strmh->cur_ctrl.dwFrameInterval;
+  hdr.dwMaxVideoFrameSize = strmh->cur_ctrl.dwMaxVideoFrameSize;
+  hdr.dwMaxPayloadTransferSize = strmh->cur_ctrl.dwMaxPayloadTransferSize;
+  hdr.dwClockFrequency = strmh->cur_ctrl.dwClockFrequency;
+  hdr.start_ns = now;
+
+  _uvc_trace_write(trace, &hdr, sizeof(hdr));
+  trace->start_ns = now;
+  trace->header_written = 1;
+}
+
+/** @internal
+ * @brief Append a completed transfer to the stream's trace
+ *
+ * Called from the event thread before the transfer is processed.
+ */
+void _uvc_trace_record(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer) {
+  static const uint8_t pad[8];
+  struct uvc_trace *trace;
+  struct uvc_trace_record rec;
+  uint64_t now = _uvc_trace_now_ns();
+  size_t size;
+  int i;
+
+  pthread_mutex_lock(&strmh->trace_mutex);
+
+  trace = strmh->trace;
+  if (!trace || trace->error)
+    goto out;
+
+  if (!trace->header_written)
+    _uvc_trace_write_header(strmh, trace, transfer->num_iso_packets > 0, now);
+
+  rec.status = transfer->status;
+  rec.timestamp_ns = now - trace->start_ns;
+  rec.num_packets = transfer->num_iso_packets;
+  if (rec.num_packets) {
+    rec.data_bytes = 0;
+    for (i = 0; i < transfer->num_iso_packets; i++)
+      rec.data_bytes += transfer->iso_packet_desc[i].actual_length;
+  } else {
+    rec.data_bytes = transfer->actual_length > 0 ? transfer->actual_length : 0;
+  }
+  size = sizeof(rec) + rec.num_packets * sizeof(struct uvc_trace_packet) + rec.data_bytes;
+  rec.record_size = (size + 7) & ~(size_t) 7;
+
+  _uvc_trace_write(trace, &rec, sizeof(rec));
+  for (i = 0; i < transfer->num_iso_packets; i++) {
+    struct uvc_trace_packet pkt;
+
+    pkt.length = transfer->iso_packet_desc[i].length;
+    pkt.actual_length = transfer->iso_packet_desc[i].actual_length;
+    pkt.status = transfer->iso_packet_desc[i].status;
+    _uvc_trace_write(trace, &pkt, sizeof(pkt));
+  }
+
+  if (rec.num_packets) {
+    for (i = 0; i < transfer->num_iso_packets; i++)
+      _uvc_trace_write(trace, libusb_get_iso_packet_buffer_simple(transfer, i),
+                       transfer->iso_packet_desc[i].actual_length);
+  } else {
+    _uvc_trace_write(trace, transfer->buffer, rec.data_bytes);
+  }
+
+  _uvc_trace_write(trace, pad, rec.record_size - size);
+
+out:
+  pthread_mutex_unlock(&strmh->trace_mutex);
+}
+
+/** @brief Record the stream's transfers to a file
+ * @ingroup streaming
+ *
+ * Every transfer the stream completes from now on is appended to the file,
+ * which uvc_stream_replay() can later feed back through frame assembly.
+ * Recording may start before or while streaming and lasts until
+ * uvc_stream_stop_trace() or uvc_stream_close().
+ *
+ * @param strmh UVC stream handle
+ * @param path File to create or truncate
+ * @return Error if the stream is already recording or the file can't be created
+ */
+uvc_error_t uvc_stream_start_trace(uvc_stream_handle_t *strmh, const char *path) {
+  struct uvc_trace *trace;
+
+  trace = calloc(1, sizeof(*trace));
+  if (!trace)
+    return UVC_ERROR_NO_MEM;
+
+  pthread_mutex_lock(&strmh->trace_mutex);
+
+  if (strmh->trace) {
+    pthread_mutex_unlock(&strmh->trace_mutex);
+    free(trace);
+    return UVC_ERROR_BUSY;
+  }
+
+  trace->file = fopen(path, "wb");
+  if (!trace->file) {
+    pthread_mutex_unlock(&strmh->trace_mutex);
+    free(trace);
+    return UVC_ERROR_IO;
+  }
+  setvbuf(trace->file, NULL, _IOFBF, LIBUVC_TRACE_BUF_SIZE);
+
+  strmh->trace = trace;
+  pthread_mutex_unlock(&strmh->trace_mutex);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Stop recording the stream's transfers
+ * @ingroup streaming
+ *
+ * @param strmh UVC stream handle
+ * @return Error if the stream wasn't recording, or if writing the file failed
+ */
+uvc_error_t uvc_stream_stop_trace(uvc_stream_handle_t *strmh) {
+  struct uvc_trace *trace;
+  uvc_error_t ret;
+
+  pthread_mutex_lock(&strmh->trace_mutex);
+  trace = strmh->trace;
+  strmh->trace = NULL;
+  pthread_mutex_unlock(&strmh->trace_mutex);
+
+  if (!trace)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (!trace->header_written)
+    _uvc_trace_write_header(strmh, trace, 0, _uvc_trace_now_ns());
+
+  ret = trace->error;
+  if (fclose(trace->file) != 0 && ret == UVC_SUCCESS)
+    ret = UVC_ERROR_IO;
+  free(trace);
+
+  return ret;
+}
+
+static uvc_error_t _uvc_trace_map(const char *path, struct uvc_trace_map *map) {
+#ifndef _WIN32
+  struct stat st;
+  void *data;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return UVC_ERROR_IO;
+
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(struct uvc_trace_file_header)) {
+    close(fd);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  /* Private and writable, since payload processing takes non-const buffers */
+  data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return UVC_ERROR_NO_MEM;
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  map->data = data;
+  map->size = st.st_size;
+  return UVC_SUCCESS;
+#else
+  FILE *file;
+  long size;
+
+  file = fopen(path, "rb");
+  if (!file)
+    return UVC_ERROR_IO;
+
+  if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < (long) sizeof(struct uvc_trace_file_header) ||
+      fseek(file, 0, SEEK_SET) != 0) {
+    fclose(file);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  map->data = malloc(size);
+  if (!map->data) {
+    fclose(file);
+    return UVC_ERROR_NO_MEM;
+  }
+  if (fread(map->data, 1, size, file) != (size_t) size) {
+    fclose(file);
+    free(map->data);
+    return UVC_ERROR_IO;
+  }
+  fclose(file);
+
+  map->size = size;
+  return UVC_SUCCESS;
+#endif
+}
+
+static void _uvc_trace_unmap(struct uvc_trace_map *map) {
+#ifndef _WIN32
+  munmap(map->data, map->size);
+#else
+  free(map->data);
+#endif
+}
+
+/** @internal
+ * @brief Check the header of a mapped trace
+ */
+static const struct uvc_trace_file_header *_uvc_trace_header(const struct uvc_trace_map *map) {
+  const struct uvc_trace_file_header *hdr = (const void *) map->data;
+
+  if (memcmp(hdr->magic, LIBUVC_TRACE_MAGIC, sizeof(hdr->magic)) ||
+      hdr->version != LIBUVC_TRACE_VERSION ||
+      hdr->header_size < sizeof(*hdr) || hdr->header_size % 8 ||
+      hdr->header_size > map->size)
+    return NULL;
+
+  return hdr;
+}
+
+/** @internal
+ * @brief Find the record at @a offset
+ *
+ * A record that runs past the end of the file, as the last one does when
+ * recording was cut short, ends the trace.
+ *
+ * @return The record, or NULL at the end of the trace
+ */
+static struct uvc_trace_record *_uvc_trace_next(const struct uvc_trace_map *map,
+                                                size_t offset) {
+  struct uvc_trace_record *rec;
+  uint64_t size;
+
+  if (offset + sizeof(*rec) > map->size)
+    return NULL;
+
+  rec = (struct uvc_trace_record *) (map->data + offset);
+  size = sizeof(*rec) + (uint64_t) rec->num_packets * sizeof(struct uvc_trace_packet) +
+    rec->data_bytes;
+  if (rec->record_size < size || rec->record_size % 8 ||
+      rec->record_size > map->size - offset)
+    return NULL;
+
+  return rec;
+}
+
+/** @brief Describe a transfer trace
+ * @ingroup streaming
+ *
+ * @param path Trace file written by uvc_stream_start_trace()
+ * @param[out] info Recorded mode and length of the trace
+ */
+uvc_error_t uvc_trace_get_info(const char *path, uvc_trace_info_t *info) {
+  const struct uvc_trace_file_header *hdr;
+  struct uvc_trace_record *rec;
+  struct uvc_trace_map map;
+  size_t offset;
+  uvc_error_t ret;
+
+  ret = _uvc_trace_map(path, &map);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  hdr = _uvc_trace_header(&map);
+  if (!hdr) {
+    _uvc_trace_unmap(&map);
+    return UVC_ERROR_INVALID_PARAM;
+  }
+
+  memset(info, 0, sizeof(*info));
+  info->frame_format = hdr->frame_format;
+  info->width = hdr->width;
+  info->height = hdr->height;
+  info->frame_interval = hdr->dwFrameInterval;
+  info->max_frame_size = hdr->dwMaxVideoFrameSize;
+  info->max_payload_size = hdr->dwMaxPayloadTransferSize;
+  info->isochronous = hdr->isochronous;
+
+  for (offset = hdr->header_size; (rec = _uvc_trace_next(&map, offset));
+       offset += rec->record_size) {
+    info->transfers++;
+    info->duration_ns = rec->timestamp_ns;
+  }
+
+  _uvc_trace_unmap(&map);
+  return UVC_SUCCESS;
+}
+
+/** @internal
+ * @brief Wait until the callback thread has taken the latest frame
+ */
+static void _uvc_replay_wait_frame(uvc_stream_handle_t *strmh) {
+  pthread_mutex_lock(&strmh->cb_mutex);
+  while (strmh->user_seq != strmh->hold_seq)
+    pthread_cond_wait(&strmh->cb_cond, &strmh->cb_mutex);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+}
+
+/** @internal
+ * @brief Sleep until CLOCK_MONOTONIC reaches @a when_ns
+ */
+static void _uvc_replay_wait_until(uvc_stream_handle_t *strmh, uint64_t when_ns) {
+  struct timespec deadline;
+  uint64_t now = _uvc_trace_now_ns(), wait_ns;
+
+  if (now >= when_ns)
+    return;
+
+  wait_ns = when_ns - now;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  wait_ns += deadline.tv_nsec;
+  deadline.tv_sec += wait_ns / 1000000000ULL;
+  deadline.tv_nsec = wait_ns % 1000000000ULL;
+
+  /* Nothing signals this wait except frames being taken; those wake it
+   * early and the loop sleeps again */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  while (_uvc_trace_now_ns() < when_ns) {
+    if (pthread_cond_timedwait(&strmh->cb_cond, &strmh->cb_mutex, &deadline))
+      break;
+  }
+  pthread_mutex_unlock(&strmh->cb_mutex);
+}
+
+/** @brief Feed a recorded trace through frame assembly
+ * @ingroup streaming
+ *
+ * Runs every completed transfer in the trace through the same payload
+ * processing as a live stream, delivering the assembled frames to @a cb from
+ * the usual callback thread, and returns once the trace is exhausted and the
+ * last frame has been taken. The stream's negotiated format and frame size
+ * must match the trace; sampling, decimation, slices and regions of interest
+ * set on the stream apply as they would live. A device opened only for this,
+ * such as the simulated camera, is enough.
+ *
+ * @param strmh Stream handle that isn't running
+ * @param path Trace file written by uvc_stream_start_trace()
+ * @param cb User callback function
+ * @param user_ptr User data for @a cb
+ * @param flags UVC_REPLAY_REALTIME to keep the recorded timing
+ * @return Error if the trace is unreadable, doesn't match the stream, or the
+ * stream is running
+ */
+uvc_error_t uvc_stream_replay(
+    uvc_stream_handle_t *strmh,
+    const char *path,
+    uvc_frame_callback_t *cb,
+    void *user_ptr,
+    uint8_t flags) {
+  const struct uvc_trace_file_header *hdr;
+  struct uvc_trace_record *rec;
+  struct uvc_trace_map map;
+  uvc_frame_desc_t *frame_desc;
+  uint64_t start_ns;
+  size_t offset;
+  uvc_error_t ret;
+
+  if (!cb)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (strmh->running || strmh->playback)
+    return UVC_ERROR_BUSY;
+
+  _uvc_stream_reset_counters(strmh);
+
+  ret = _uvc_trace_map(path, &map);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  hdr = _uvc_trace_header(&map);
+  if (!hdr) {
+    ret = UVC_ERROR_INVALID_PARAM;
+    goto fail;
+  }
+
+  strmh->running = 1;
+  ret = _uvc_stream_prepare(strmh, 0);
+  if (ret != UVC_SUCCESS)
+    goto fail;
+
+  frame_desc = uvc_find_frame_desc_stream(strmh, strmh->cur_ctrl.bFormatIndex,
+                                          strmh->cur_ctrl.bFrameIndex);
+  if (hdr->frame_format != (uint32_t) strmh->frame_format ||
+      hdr->width != frame_desc->wWidth || hdr->height != frame_desc->wHeight) {
+    ret = UVC_ERROR_INVALID_MODE;
+    goto fail;
+  }
+
+  _uvc_size_meta_bufs(strmh, hdr->dwMaxPayloadTransferSize);
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->user_seq = strmh->hold_seq;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  strmh->user_cb = cb;
+  strmh->user_ptr = user_ptr;
+  if (pthread_create(&strmh->cb_thread, NULL, _uvc_user_caller, (void*) strmh)) {
+    ret = UVC_ERROR_OTHER;
+    goto fail;
+  }
+
+  start_ns = _uvc_trace_now_ns();
+
+  for (offset = hdr->header_size; (rec = _uvc_trace_next(&map, offset));
+       offset += rec->record_size) {
+    struct uvc_trace_packet *pkts = (struct uvc_trace_packet *) (rec + 1);
+    uint8_t *payload = (uint8_t *) (pkts + rec->num_packets);
+    uint32_t remaining = rec->data_bytes;
+    uint32_t i;
+
+    if (flags & UVC_REPLAY_REALTIME)
+      _uvc_replay_wait_until(strmh, start_ns + rec->timestamp_ns);
+
+    /* Transfers the live stream didn't process aren't processed here */
+    if (rec->status != LIBUSB_TRANSFER_COMPLETED)
+      continue;
+
+    if (rec->num_packets == 0) {
+      _uvc_process_payload(strmh, payload, rec->data_bytes);
+    } else {
+      for (i = 0; i < rec->num_packets; i++) {
+        if (pkts[i].actual_length > remaining)
+          break;
+        if (pkts[i].status == 0)
+          _uvc_process_payload(strmh, payload, pkts[i].actual_length);
+        payload += pkts[i].actual_length;
+        remaining -= pkts[i].actual_length;
+      }
+    }
+
+    if (!(flags & UVC_REPLAY_REALTIME))
+      _uvc_replay_wait_frame(strmh);
+  }
+
+  _uvc_replay_wait_frame(strmh);
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->running = 0;
+  pthread_cond_broadcast(&strmh->cb_cond);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+  pthread_join(strmh->cb_thread, NULL);
+
+  _uvc_trace_unmap(&map);
+  return UVC_SUCCESS;
+
+fail:
+  pthread_mutex_lock(&strmh->cb_mutex);
+  strmh->running = 0;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+  _uvc_trace_unmap(&map);
+  return ret;
+}
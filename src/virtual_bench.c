@@ -0,0 +1,375 @@
+/* Streaming benchmark against the simulated camera in virtual_usb.c.
+ *
+ * Runs the real device, negotiation and streaming code with the camera
+ * described on the command line and reports frame rate, throughput,
+ * incomplete frames and callback latency. It can also record the stream's
+ * transfers to a trace, or replay a trace through frame assembly instead of
+ * streaming, and likewise record the assembled frames or play them back. */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_virtual.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+struct bench_counters {
+  uvc_recorder_t *recorder;
+  pthread_mutex_t mutex;
+  size_t expected_bytes;
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t short_frames;
+  uint64_t sequence_gaps;
+  uint32_t last_sequence;
+  uint64_t latency_sum_ns;
+  uint64_t latency_max_ns;
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void cb(uvc_frame_t *frame, void *ptr) {
+  struct bench_counters *c = ptr;
+  uint64_t finished = (uint64_t) frame->capture_time_finished.tv_sec * 1000000000ULL +
+    frame->capture_time_finished.tv_nsec;
+  uint64_t latency = now_ns() - finished;
+
+  if (c->recorder)
+    uvc_recorder_write(c->recorder, frame);
+
+  pthread_mutex_lock(&c->mutex);
+  if (c->frames && frame->sequence != c->last_sequence + 1)
+    c->sequence_gaps += frame->sequence - c->last_sequence - 1;
+  c->last_sequence = frame->sequence;
+  c->frames++;
+  c->bytes += frame->data_bytes;
+  if (c->expected_bytes && frame->data_bytes < c->expected_bytes)
+    c->short_frames++;
+  c->latency_sum_ns += latency;
+  if (latency > c->latency_max_ns)
+    c->latency_max_ns = latency;
+  pthread_mutex_unlock(&c->mutex);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-f yuyv|nv12|gray8|mjpeg] [-w width] [-h height] [-r fps]\n"
+          "          [-b] [-p payload_bytes] [-l loss_rate] [-s seed] [-u] [-t seconds]\n"
+          "          [-o trace] [-i trace [-R]] [-O recording [-D]] [-I recording [-R]]\n"
+          "  -b  bulk endpoint instead of isochronous\n"
+          "  -u  unpaced: produce frames as fast as they are consumed\n"
+          "  -o  record the stream's transfers to a trace file\n"
+          "  -i  replay a trace file instead of streaming; -R keeps its timing\n"
+          "  -O  record the assembled frames; -D writes with O_DIRECT\n"
+          "  -I  play a frame recording instead of streaming; -R keeps its timing\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  uvc_virtual_config_t config;
+  uvc_virtual_stats_t vstats;
+  uvc_stream_transfer_stats_t xstats;
+  uvc_context_t *ctx;
+  uvc_device_t *dev;
+  uvc_device_handle_t *devh;
+  uvc_stream_ctrl_t ctrl;
+  uvc_stream_handle_t *strmh;
+  uvc_error_t res;
+  struct bench_counters c;
+  uint64_t start, elapsed, last_frames = 0, last_bytes = 0;
+  const char *record_path = NULL, *replay_path = NULL;
+  const char *recording_path = NULL, *playback_path = NULL;
+  uint8_t replay_flags = 0, playback_flags = 0, recorder_flags = 0;
+  int seconds = 10, opt, i;
+
+  uvc_virtual_default_config(&config);
+
+  while ((opt = getopt(argc, argv, "f:w:h:r:bp:l:s:ut:o:i:RO:DI:")) != -1) {
+    switch (opt) {
+    case 'f':
+      if (!strcmp(optarg, "yuyv"))
+        config.format = UVC_FRAME_FORMAT_YUYV;
+      else if (!strcmp(optarg, "nv12"))
+        config.format = UVC_FRAME_FORMAT_NV12;
+      else if (!strcmp(optarg, "gray8"))
+        config.format = UVC_FRAME_FORMAT_GRAY8;
+      else if (!strcmp(optarg, "mjpeg"))
+        config.format = UVC_FRAME_FORMAT_MJPEG;
+      else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'w':
+      config.width = atoi(optarg);
+      break;
+    case 'h':
+      config.height = atoi(optarg);
+      break;
+    case 'r':
+      config.fps = atoi(optarg);
+      break;
+    case 'b':
+      config.transport = UVC_VIRTUAL_BULK;
+      break;
+    case 'p':
+      config.payload_size = atoi(optarg);
+      break;
+    case 'l':
+      config.loss_rate = atof(optarg);
+      break;
+    case 's':
+      config.seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'u':
+      config.unpaced = 1;
+      break;
+    case 't':
+      seconds = atoi(optarg);
+      break;
+    case 'o':
+      record_path = optarg;
+      break;
+    case 'i':
+      replay_path = optarg;
+      break;
+    case 'R':
+      replay_flags |= UVC_REPLAY_REALTIME;
+      playback_flags |= UVC_PLAYBACK_REALTIME;
+      break;
+    case 'O':
+      recording_path = optarg;
+      break;
+    case 'D':
+      recorder_flags |= UVC_RECORDER_DIRECT;
+      break;
+    case 'I':
+      playback_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  /* A replayed trace needs a camera offering its mode */
+  if (replay_path) {
+    uvc_trace_info_t info;
+
+    res = uvc_trace_get_info(replay_path, &info);
+    if (res < 0) {
+      uvc_perror(res, "uvc_trace_get_info");
+      return 1;
+    }
+    config.format = info.frame_format;
+    config.width = info.width;
+    config.height = info.height;
+    config.fps = info.frame_interval ? 10000000 / info.frame_interval : 30;
+    config.transport = info.isochronous ? UVC_VIRTUAL_ISOCHRONOUS : UVC_VIRTUAL_BULK;
+    printf("replaying %llu transfers (%.2f s) of %ux%u\n",
+           (unsigned long long) info.transfers, info.duration_ns / 1e9,
+           info.width, info.height);
+  }
+
+  /* A frame recording plays through a stream in any mode */
+  if (playback_path) {
+    uvc_recording_info_t info;
+
+    res = uvc_recording_get_info(playback_path, &info);
+    if (res < 0) {
+      uvc_perror(res, "uvc_recording_get_info");
+      return 1;
+    }
+    printf("playing %llu frames (%.2f s, %.1f MB) of %ux%u\n",
+           (unsigned long long) info.frames, info.duration_ns / 1e9, info.bytes / 1e6,
+           info.width, info.height);
+  }
+
+  res = uvc_virtual_set_config(&config);
+  if (res < 0) {
+    uvc_perror(res, "uvc_virtual_set_config");
+    return 1;
+  }
+
+  res = uvc_init(&ctx, NULL);
+  if (res < 0) {
+    uvc_perror(res, "uvc_init");
+    return 1;
+  }
+
+  res = uvc_find_device(ctx, &dev, 0, 0, NULL);
+  if (res < 0) {
+    uvc_perror(res, "uvc_find_device");
+    goto exit_ctx;
+  }
+
+  res = uvc_open(dev, &devh);
+  if (res < 0) {
+    uvc_perror(res, "uvc_open");
+    uvc_unref_device(dev);
+    goto exit_ctx;
+  }
+
+  res = uvc_get_stream_ctrl_format_size(devh, &ctrl, config.format,
+                                        config.width, config.height, config.fps);
+  if (res < 0) {
+    uvc_perror(res, "uvc_get_stream_ctrl_format_size");
+    goto exit_dev;
+  }
+
+  res = uvc_stream_open_ctrl(devh, &strmh, &ctrl);
+  if (res < 0) {
+    uvc_perror(res, "uvc_stream_open_ctrl");
+    goto exit_dev;
+  }
+
+  memset(&c, 0, sizeof(c));
+  pthread_mutex_init(&c.mutex, NULL);
+  if (config.format != UVC_FRAME_FORMAT_MJPEG)
+    c.expected_bytes = ctrl.dwMaxVideoFrameSize;
+
+  if (replay_path) {
+    start = now_ns();
+    res = uvc_stream_replay(strmh, replay_path, cb, &c, replay_flags);
+    elapsed = now_ns() - start;
+    uvc_stream_close(strmh);
+    if (res < 0) {
+      uvc_perror(res, "uvc_stream_replay");
+    } else {
+      printf("frames assembled  %llu in %.3f s (%.1f fps, %.1f MB/s)\n",
+             (unsigned long long) c.frames, elapsed / 1e9, c.frames * 1e9 / elapsed,
+             c.bytes * 1e3 / elapsed);
+      printf("short frames      %llu\n", (unsigned long long) c.short_frames);
+      printf("sequence gaps     %llu\n", (unsigned long long) c.sequence_gaps);
+    }
+    pthread_mutex_destroy(&c.mutex);
+    goto exit_dev;
+  }
+
+  if (playback_path) {
+    start = now_ns();
+    res = uvc_stream_start_playback(strmh, playback_path, cb, &c, playback_flags);
+    if (res == UVC_SUCCESS)
+      uvc_stream_wait_playback(strmh, 0);
+    elapsed = now_ns() - start;
+    uvc_stream_close(strmh);
+    if (res < 0) {
+      uvc_perror(res, "uvc_stream_start_playback");
+    } else {
+      printf("frames played     %llu in %.3f s (%.1f fps, %.1f MB/s)\n",
+             (unsigned long long) c.frames, elapsed / 1e9, c.frames * 1e9 / elapsed,
+             c.bytes * 1e3 / elapsed);
+      printf("sequence gaps     %llu\n", (unsigned long long) c.sequence_gaps);
+    }
+    pthread_mutex_destroy(&c.mutex);
+    goto exit_dev;
+  }
+
+  if (recording_path) {
+    /* Room for the whole run at the configured rate */
+    uint32_t max_frames = (seconds + 1) * config.fps;
+
+    res = uvc_recorder_create(&c.recorder, recording_path,
+                              (uint64_t) max_frames * ctrl.dwMaxVideoFrameSize,
+                              max_frames, recorder_flags);
+    if (res < 0) {
+      uvc_perror(res, "uvc_recorder_create");
+      uvc_stream_close(strmh);
+      goto exit_dev;
+    }
+  }
+
+  if (record_path) {
+    res = uvc_stream_start_trace(strmh, record_path);
+    if (res < 0) {
+      uvc_perror(res, "uvc_stream_start_trace");
+      uvc_stream_close(strmh);
+      goto exit_dev;
+    }
+  }
+
+  res = uvc_stream_start(strmh, cb, &c, 0);
+  if (res < 0) {
+    uvc_perror(res, "uvc_stream_start");
+    uvc_stream_close(strmh);
+    goto exit_dev;
+  }
+
+  printf("%ux%u %s at %u fps over %s, payload %u bytes, loss %g%s\n",
+         config.width, config.height,
+         config.format == UVC_FRAME_FORMAT_MJPEG ? "MJPEG" :
+         config.format == UVC_FRAME_FORMAT_NV12 ? "NV12" :
+         config.format == UVC_FRAME_FORMAT_GRAY8 ? "GRAY8" : "YUYV",
+         config.fps, config.transport == UVC_VIRTUAL_BULK ? "bulk" : "isochronous",
+         ctrl.dwMaxPayloadTransferSize, config.loss_rate,
+         config.unpaced ? ", unpaced" : "");
+
+  start = now_ns();
+  for (i = 0; i < seconds; i++) {
+    uint64_t frames, bytes;
+
+    sleep(1);
+    pthread_mutex_lock(&c.mutex);
+    frames = c.frames;
+    bytes = c.bytes;
+    pthread_mutex_unlock(&c.mutex);
+
+    printf("%3d s: %6llu fps %9.1f MB/s\n", i + 1,
+           (unsigned long long) (frames - last_frames),
+           (bytes - last_bytes) / 1e6);
+    last_frames = frames;
+    last_bytes = bytes;
+  }
+  elapsed = now_ns() - start;
+
+  uvc_stream_get_transfer_stats(strmh, &xstats);
+  uvc_stream_stop(strmh);
+  if (record_path) {
+    res = uvc_stream_stop_trace(strmh);
+    if (res < 0)
+      uvc_perror(res, "uvc_stream_stop_trace");
+  }
+  uvc_stream_close(strmh);
+  uvc_virtual_get_stats(&vstats);
+
+  if (c.recorder) {
+    uvc_recorder_stats_t rstats;
+
+    uvc_recorder_get_stats(c.recorder, &rstats);
+    res = uvc_recorder_close(c.recorder);
+    if (res < 0)
+      uvc_perror(res, "uvc_recorder_close");
+    printf("frames recorded   %llu (%.1f MB), %llu dropped, %llu waits for the disk\n",
+           (unsigned long long) rstats.frames, rstats.bytes / 1e6,
+           (unsigned long long) rstats.dropped, (unsigned long long) rstats.stalls);
+  }
+
+  printf("frames delivered  %llu (%.1f fps, %.1f MB/s)\n",
+         (unsigned long long) c.frames, c.frames * 1e9 / elapsed,
+         c.bytes * 1e3 / elapsed);
+  printf("frames sent       %llu\n", (unsigned long long) vstats.frames_sent);
+  printf("short frames      %llu\n", (unsigned long long) c.short_frames);
+  printf("sequence gaps     %llu\n", (unsigned long long) c.sequence_gaps);
+  printf("payloads lost     %llu of %llu\n",
+         (unsigned long long) vstats.payloads_lost,
+         (unsigned long long) vstats.payloads_sent);
+  printf("transfer errors   %u\n", xstats.transfer_errors);
+  if (c.frames)
+    printf("callback latency  avg %.1f us, max %.1f us\n",
+           c.latency_sum_ns / 1e3 / c.frames, c.latency_max_ns / 1e3);
+
+  pthread_mutex_destroy(&c.mutex);
+
+exit_dev:
+  uvc_close(devh);
+  uvc_unref_device(dev);
+exit_ctx:
+  uvc_exit(ctx);
+  return res < 0;
+}
@@ -0,0 +1,1478 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @defgroup virtual Virtual device
+ * @brief Simulated UVC camera behind the libusb API
+ *
+ * This file implements the subset of libusb that libuvc uses, backed by a
+ * single simulated camera instead of a USB bus. Linking it in place of
+ * libusb lets the unmodified device, control and streaming code run without
+ * hardware: the camera presents the descriptors described by
+ * uvc_virtual_config_t, answers probe/commit and unit control requests, and
+ * fills streaming transfers with payloads carrying the usual headers, FID/EOF
+ * framing, PTS/SCR timestamps and an optional pattern of lost payloads.
+ *
+ * The camera can also present the descriptors of a real device, given as raw
+ * bytes and parsed here the way libusb parses them. Such a camera enumerates,
+ * opens and negotiates like the original, which makes descriptor parsing
+ * measurable and fuzzable without hardware, but it has no frames to stream.
+ *
+ * Transfers complete from libusb_handle_events(), one per call, with their
+ * callbacks invoked outside the simulator's lock just as libusb does.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+#include "libuvc/libuvc_virtual.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define VIRTUAL_VC_INTERFACE 0
+#define VIRTUAL_VS_INTERFACE 1
+#define VIRTUAL_STREAM_EP 0x81
+#define VIRTUAL_STATUS_EP 0x83
+#define VIRTUAL_CAMERA_ID 1
+#define VIRTUAL_PU_ID 2
+#define VIRTUAL_OT_ID 3
+
+/** Probe/commit block length for UVC 1.1 */
+#define VIRTUAL_CTRL_LEN 34
+/** Largest control value kept for the camera terminal and processing unit */
+#define VIRTUAL_UNIT_CTRL_MAX 16
+#define VIRTUAL_HEADER_LEN 12
+/** Largest isochronous payload a high-speed endpoint can describe */
+#define VIRTUAL_HS_ISO_MAX 3072
+#define VIRTUAL_SS_ISO_MAX 49152
+#define VIRTUAL_BULK_MAX (512 * 1024)
+/** Longest time libusb_handle_events() sleeps without an event */
+#define VIRTUAL_EVENT_WAIT_NS 10000000ULL
+
+enum virtual_xfer_state {
+  VIRTUAL_XFER_IDLE,
+  VIRTUAL_XFER_PENDING,
+  VIRTUAL_XFER_CANCELLING
+};
+
+/** libusb transfer with the simulator's bookkeeping in front of it */
+struct virtual_transfer {
+  struct virtual_transfer *prev, *next;
+  enum virtual_xfer_state state;
+  /* Must be last: the isochronous packet descriptors follow it */
+  struct libusb_transfer transfer;
+};
+
+#define VIRTUAL_XFER(t) \
+  ((struct virtual_transfer *) ((char *) (t) - offsetof(struct virtual_transfer, transfer)))
+
+struct libusb_device {
+  struct libusb_context *ctx;
+  int refcount;
+
+  struct libusb_device_descriptor desc;
+  struct libusb_config_descriptor config;
+  struct libusb_interface interfaces[2];
+  struct libusb_interface_descriptor vc_alt;
+  struct libusb_interface_descriptor vs_alts[2];
+  struct libusb_endpoint_descriptor status_ep;
+  struct libusb_endpoint_descriptor stream_ep;
+  uint8_t vc_extra[64];
+  uint8_t vs_extra[96];
+  int superspeed;
+
+  /* Parsed from uvc_virtual_config_t.descriptors when those are given */
+  struct libusb_interface *described_ifs;
+  struct libusb_interface_descriptor *described_alts;
+  struct libusb_endpoint_descriptor *described_eps;
+  int described_error;
+
+  /* Negotiated stream */
+  uint8_t probe[VIRTUAL_CTRL_LEN];
+  uint8_t commit[VIRTUAL_CTRL_LEN];
+  int alt_setting;
+  int committed;
+  uint8_t unit_ctrls[2][32][VIRTUAL_UNIT_CTRL_MAX];
+
+  /* Frame generator */
+  uint8_t *pattern;
+  uint32_t max_frame_size;
+  uint32_t payload_size;
+  uint32_t interval;
+  uint64_t interval_ns;
+  uint64_t origin_ns;
+  uint64_t start_ns;
+  uint64_t frame_count;
+  int in_frame;
+  uint32_t frame_bytes;
+  uint32_t frame_offset;
+  uint8_t fid;
+  uint32_t pts;
+  uint32_t rng;
+  uint32_t loss_threshold;
+};
+
+struct libusb_device_handle {
+  struct libusb_device *dev;
+};
+
+struct libusb_context {
+  struct libusb_device device;
+  struct virtual_transfer *pending;
+  pthread_cond_t cond;
+};
+
+/* One lock covers the configuration, the counters and every context, which
+ * keeps the simulated bus as simple as the single camera on it */
+static pthread_mutex_t virtual_lock = PTHREAD_MUTEX_INITIALIZER;
+static uvc_virtual_config_t virtual_config;
+static uint8_t *virtual_descriptors;
+static int virtual_config_set;
+static int virtual_contexts;
+static uvc_virtual_stats_t virtual_stats;
+
+static const uint8_t virtual_guids[][16] = {
+  {'Y',  'U',  'Y',  '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71},
+  {'N',  'V',  '1',  '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71},
+  {'Y',  '8',  '0',  '0', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71},
+};
+
+static uint64_t virtual_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t virtual_rand(struct libusb_device *dev) {
+  uint32_t x = dev->rng;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  dev->rng = x;
+  return x;
+}
+
+/** @brief Fill a configuration with the simulator's defaults
+ * @ingroup virtual
+ *
+ * The default camera streams 640x480 YUYV at 30 fps over an isochronous
+ * endpoint with no loss.
+ *
+ * @param[out] config Configuration to fill
+ */
+void uvc_virtual_default_config(uvc_virtual_config_t *config) {
+  memset(config, 0, sizeof(*config));
+  config->vendor_id = 0x1d6b;
+  config->product_id = 0x0102;
+  config->format = UVC_FRAME_FORMAT_YUYV;
+  config->width = 640;
+  config->height = 480;
+  config->fps = 30;
+  config->transport = UVC_VIRTUAL_ISOCHRONOUS;
+  config->clock_frequency = 48000000;
+  config->seed = 1;
+}
+
+/** @brief Describe the camera that the next libusb context will present
+ * @ingroup virtual
+ *
+ * Call this before uvc_init(). Contexts that already exist keep the camera
+ * they were created with.
+ *
+ * @param config Camera description
+ * @return Error if the description can't be simulated or a context is open
+ */
+uvc_error_t uvc_virtual_set_config(const uvc_virtual_config_t *config) {
+  uint8_t *descriptors = NULL;
+
+  if (!config->width || !config->height || !config->fps ||
+      config->fps > 10000000 || !config->clock_frequency ||
+      config->loss_rate < 0 || config->loss_rate > 1)
+    return UVC_ERROR_INVALID_PARAM;
+
+  switch (config->format) {
+  case UVC_FRAME_FORMAT_YUYV:
+  case UVC_FRAME_FORMAT_NV12:
+  case UVC_FRAME_FORMAT_GRAY8:
+  case UVC_FRAME_FORMAT_MJPEG:
+    break;
+  default:
+    return UVC_ERROR_NOT_SUPPORTED;
+  }
+
+  /* Keep uncompressed frames addressable by the 32-bit descriptor fields */
+  if ((uint64_t) config->width * config->height * 2 > 0x7fffffff)
+    return UVC_ERROR_INVALID_PARAM;
+
+  if (config->descriptors) {
+    if (!config->descriptors_length)
+      return UVC_ERROR_INVALID_PARAM;
+    descriptors = malloc(config->descriptors_length);
+    if (!descriptors)
+      return UVC_ERROR_NO_MEM;
+    memcpy(descriptors, config->descriptors, config->descriptors_length);
+  }
+
+  pthread_mutex_lock(&virtual_lock);
+  if (virtual_contexts) {
+    pthread_mutex_unlock(&virtual_lock);
+    free(descriptors);
+    return UVC_ERROR_BUSY;
+  }
+  /* Parsed configurations point into the copy, so it can only be replaced
+   * while no context exists */
+  free(virtual_descriptors);
+  virtual_descriptors = descriptors;
+  virtual_config = *config;
+  virtual_config.descriptors = descriptors;
+  virtual_config_set = 1;
+  pthread_mutex_unlock(&virtual_lock);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Read the simulator's counters
+ * @ingroup virtual
+ *
+ * The counters cover every context since the program started.
+ *
+ * @param[out] stats Counters
+ */
+void uvc_virtual_get_stats(uvc_virtual_stats_t *stats) {
+  pthread_mutex_lock(&virtual_lock);
+  *stats = virtual_stats;
+  pthread_mutex_unlock(&virtual_lock);
+}
+
+/** @internal
+ * @brief Build the device, configuration and class-specific descriptors
+ */
+static void virtual_build_descriptors(struct libusb_device *dev,
+                                      const uvc_virtual_config_t *cfg) {
+  uint8_t *p;
+  uint32_t bitrate;
+  uint64_t bits;
+  int compressed = cfg->format == UVC_FRAME_FORMAT_MJPEG;
+  int bpp;
+
+  switch (cfg->format) {
+  case UVC_FRAME_FORMAT_NV12:
+    bpp = 12;
+    break;
+  case UVC_FRAME_FORMAT_GRAY8:
+    bpp = 8;
+    break;
+  default:
+    bpp = 16;
+    break;
+  }
+
+  dev->max_frame_size = (uint32_t) cfg->width * cfg->height * bpp / 8;
+  dev->interval = 10000000 / cfg->fps;
+  dev->interval_ns = (uint64_t) dev->interval * 100;
+
+  dev->payload_size = cfg->payload_size;
+  if (cfg->transport == UVC_VIRTUAL_BULK) {
+    if (!dev->payload_size)
+      dev->payload_size = dev->max_frame_size + VIRTUAL_HEADER_LEN;
+    if (dev->payload_size > VIRTUAL_BULK_MAX)
+      dev->payload_size = VIRTUAL_BULK_MAX;
+  } else {
+    if (!dev->payload_size)
+      dev->payload_size = (uint64_t) dev->max_frame_size * cfg->fps >
+        (uint64_t) VIRTUAL_HS_ISO_MAX * 8000 ? VIRTUAL_SS_ISO_MAX : VIRTUAL_HS_ISO_MAX;
+    if (dev->payload_size > VIRTUAL_SS_ISO_MAX)
+      dev->payload_size = VIRTUAL_SS_ISO_MAX;
+    dev->superspeed = dev->payload_size > VIRTUAL_HS_ISO_MAX;
+  }
+  if (dev->payload_size <= VIRTUAL_HEADER_LEN)
+    dev->payload_size = VIRTUAL_HEADER_LEN + 1;
+
+  bits = (uint64_t) dev->max_frame_size * 8 * cfg->fps;
+  bitrate = bits > 0xffffffff ? 0xffffffff : (uint32_t) bits;
+
+  /* Device */
+  dev->desc.bLength = LIBUSB_DT_DEVICE_SIZE;
+  dev->desc.bDescriptorType = LIBUSB_DT_DEVICE;
+  dev->desc.bcdUSB = dev->superspeed ? 0x0300 : 0x0200;
+  dev->desc.bDeviceClass = 0xef;
+  dev->desc.bDeviceSubClass = 0x02;
+  dev->desc.bDeviceProtocol = 0x01;
+  dev->desc.bMaxPacketSize0 = dev->superspeed ? 9 : 64;
+  dev->desc.idVendor = cfg->vendor_id;
+  dev->desc.idProduct = cfg->product_id;
+  dev->desc.bcdDevice = 0x0100;
+  dev->desc.iManufacturer = 1;
+  dev->desc.iProduct = 2;
+  dev->desc.iSerialNumber = 3;
+  dev->desc.bNumConfigurations = 1;
+
+  /* VideoControl: header, camera terminal, processing unit, output terminal */
+  p = dev->vc_extra;
+  p[0] = 13;
+  p[1] = 36;
+  p[2] = UVC_VC_HEADER;
+  p[3] = 0x10; /* bcdUVC 1.1 */
+  p[4] = 0x01;
+  SHORT_TO_SW(13 + 18 + 13 + 9, p + 5);
+  INT_TO_DW(cfg->clock_frequency, p + 7);
+  p[11] = 1;
+  p[12] = VIRTUAL_VS_INTERFACE;
+  p += 13;
+
+  p[0] = 18;
+  p[1] = 36;
+  p[2] = UVC_VC_INPUT_TERMINAL;
+  p[3] = VIRTUAL_CAMERA_ID;
+  p[4] = UVC_ITT_CAMERA & 0xff;
+  p[5] = UVC_ITT_CAMERA >> 8;
+  p[14] = 3;
+  p[15] = (1 << 1) | (1 << 3); /* AE mode, exposure time (absolute) */
+  p += 18;
+
+  p[0] = 13;
+  p[1] = 36;
+  p[2] = UVC_VC_PROCESSING_UNIT;
+  p[3] = VIRTUAL_PU_ID;
+  p[4] = VIRTUAL_CAMERA_ID;
+  p[7] = 2;
+  p[8] = (1 << 0) | (1 << 1); /* brightness, contrast */
+  p += 13;
+
+  p[0] = 9;
+  p[1] = 36;
+  p[2] = UVC_VC_OUTPUT_TERMINAL;
+  p[3] = VIRTUAL_OT_ID;
+  p[4] = UVC_TT_STREAMING & 0xff;
+  p[5] = UVC_TT_STREAMING >> 8;
+  p[7] = VIRTUAL_PU_ID;
+  p += 9;
+
+  dev->status_ep.bLength = LIBUSB_DT_ENDPOINT_SIZE;
+  dev->status_ep.bDescriptorType = LIBUSB_DT_ENDPOINT;
+  dev->status_ep.bEndpointAddress = VIRTUAL_STATUS_EP;
+  dev->status_ep.bmAttributes = LIBUSB_TRANSFER_TYPE_INTERRUPT;
+  dev->status_ep.wMaxPacketSize = 16;
+  dev->status_ep.bInterval = 8;
+
+  dev->vc_alt.bLength = LIBUSB_DT_INTERFACE_SIZE;
+  dev->vc_alt.bDescriptorType = LIBUSB_DT_INTERFACE;
+  dev->vc_alt.bInterfaceNumber = VIRTUAL_VC_INTERFACE;
+  dev->vc_alt.bNumEndpoints = 1;
+  dev->vc_alt.bInterfaceClass = 14;
+  dev->vc_alt.bInterfaceSubClass = 1;
+  dev->vc_alt.endpoint = &dev->status_ep;
+  dev->vc_alt.extra = dev->vc_extra;
+  dev->vc_alt.extra_length = p - dev->vc_extra;
+
+  /* VideoStreaming: input header, one format, one frame */
+  p = dev->vs_extra;
+  p[0] = 14;
+  p[1] = 36;
+  p[2] = UVC_VS_INPUT_HEADER;
+  p[3] = 1;
+  p[6] = VIRTUAL_STREAM_EP;
+  p[8] = VIRTUAL_OT_ID;
+  p[12] = 1;
+  p += 14;
+
+  if (compressed) {
+    /* Compressed frames are sized per frame, up to the uncompressed size */
+    p[0] = 11;
+    p[1] = 36;
+    p[2] = UVC_VS_FORMAT_MJPEG;
+    p[3] = 1;
+    p[4] = 1;
+    p[5] = 1;
+    p[6] = 1;
+    p += 11;
+  } else {
+    p[0] = 27;
+    p[1] = 36;
+    p[2] = UVC_VS_FORMAT_UNCOMPRESSED;
+    p[3] = 1;
+    p[4] = 1;
+    memcpy(p + 5, virtual_guids[cfg->format == UVC_FRAME_FORMAT_NV12 ? 1 :
+           cfg->format == UVC_FRAME_FORMAT_GRAY8 ? 2 : 0], 16);
+    p[21] = bpp;
+    p[22] = 1;
+    p += 27;
+  }
+
+  p[0] = 30;
+  p[1] = 36;
+  p[2] = compressed ? UVC_VS_FRAME_MJPEG : UVC_VS_FRAME_UNCOMPRESSED;
+  p[3] = 1;
+  SHORT_TO_SW(cfg->width, p + 5);
+  SHORT_TO_SW(cfg->height, p + 7);
+  INT_TO_DW(bitrate, p + 9);
+  INT_TO_DW(bitrate, p + 13);
+  INT_TO_DW(dev->max_frame_size, p + 17);
+  INT_TO_DW(dev->interval, p + 21);
+  p[25] = 1;
+  INT_TO_DW(dev->interval, p + 26);
+  p += 30;
+
+  SHORT_TO_SW(p - dev->vs_extra, dev->vs_extra + 4);
+
+  dev->stream_ep.bLength = LIBUSB_DT_ENDPOINT_SIZE;
+  dev->stream_ep.bDescriptorType = LIBUSB_DT_ENDPOINT;
+  dev->stream_ep.bEndpointAddress = VIRTUAL_STREAM_EP;
+
+  dev->vs_alts[0].bLength = LIBUSB_DT_INTERFACE_SIZE;
+  dev->vs_alts[0].bDescriptorType = LIBUSB_DT_INTERFACE;
+  dev->vs_alts[0].bInterfaceNumber = VIRTUAL_VS_INTERFACE;
+  dev->vs_alts[0].bInterfaceClass = 14;
+  dev->vs_alts[0].bInterfaceSubClass = 2;
+  dev->vs_alts[0].extra = dev->vs_extra;
+  dev->vs_alts[0].extra_length = p - dev->vs_extra;
+
+  dev->interfaces[1].altsetting = dev->vs_alts;
+
+  if (cfg->transport == UVC_VIRTUAL_BULK) {
+    dev->stream_ep.bmAttributes = LIBUSB_TRANSFER_TYPE_BULK;
+    dev->stream_ep.wMaxPacketSize = 512;
+    dev->vs_alts[0].bNumEndpoints = 1;
+    dev->vs_alts[0].endpoint = &dev->stream_ep;
+    dev->interfaces[1].num_altsetting = 1;
+  } else {
+    /* Asynchronous isochronous endpoint on altsetting 1. High-speed sizes
+     * are encoded as up to three transactions per microframe; larger sizes
+     * come from the SuperSpeed companion descriptor. */
+    dev->stream_ep.bmAttributes = LIBUSB_TRANSFER_TYPE_ISOCHRONOUS | (1 << 2);
+    if (dev->superspeed) {
+      dev->stream_ep.wMaxPacketSize = 1024;
+    } else {
+      int mult = (dev->payload_size + 1023) / 1024;
+      int size = (dev->payload_size + mult - 1) / mult;
+
+      dev->stream_ep.wMaxPacketSize = ((mult - 1) << 11) | size;
+      dev->payload_size = mult * size;
+    }
+    dev->stream_ep.bInterval = 1;
+
+    dev->vs_alts[1] = dev->vs_alts[0];
+    dev->vs_alts[1].bAlternateSetting = 1;
+    dev->vs_alts[1].bNumEndpoints = 1;
+    dev->vs_alts[1].endpoint = &dev->stream_ep;
+    dev->vs_alts[1].extra = NULL;
+    dev->vs_alts[1].extra_length = 0;
+    dev->interfaces[1].num_altsetting = 2;
+  }
+
+  dev->interfaces[0].altsetting = &dev->vc_alt;
+  dev->interfaces[0].num_altsetting = 1;
+
+  dev->config.bLength = LIBUSB_DT_CONFIG_SIZE;
+  dev->config.bDescriptorType = LIBUSB_DT_CONFIG;
+  dev->config.bNumInterfaces = 2;
+  dev->config.bConfigurationValue = 1;
+  dev->config.bmAttributes = 0x80;
+  dev->config.MaxPower = 250;
+  dev->config.interface = dev->interfaces;
+}
+
+/** @internal
+ * @brief Replace the generated descriptors with uvc_virtual_config_t.descriptors
+ *
+ * As in libusb, each class-specific descriptor lands in the extra bytes of
+ * the configuration, interface or endpoint it follows, and consecutive
+ * interface descriptors with the same number become altsettings of one
+ * interface. Descriptors that run past the end of the data or the
+ * configuration's wTotalLength end the parse. A configuration that can't be
+ * parsed at all makes libusb_get_config_descriptor() fail.
+ */
+static void virtual_parse_descriptors(struct libusb_device *dev,
+                                      const uint8_t *data, size_t length) {
+  const uint8_t *p = data, *end = data + length, *q;
+  struct libusb_config_descriptor *config = &dev->config;
+  struct libusb_interface *intf = NULL;
+  struct libusb_interface_descriptor *alt = NULL;
+  struct libusb_endpoint_descriptor *ep;
+  const unsigned char **extra;
+  int *extra_length;
+  int num_alts = 0, num_eps = 0, num_ifs = 0;
+  size_t total;
+
+  if (end - p >= LIBUSB_DT_DEVICE_SIZE && p[0] == LIBUSB_DT_DEVICE_SIZE &&
+      p[1] == LIBUSB_DT_DEVICE) {
+    dev->desc.bcdUSB = SW_TO_SHORT(p + 2);
+    dev->desc.bDeviceClass = p[4];
+    dev->desc.bDeviceSubClass = p[5];
+    dev->desc.bDeviceProtocol = p[6];
+    dev->desc.bMaxPacketSize0 = p[7];
+    dev->desc.idVendor = SW_TO_SHORT(p + 8);
+    dev->desc.idProduct = SW_TO_SHORT(p + 10);
+    dev->desc.bcdDevice = SW_TO_SHORT(p + 12);
+    dev->desc.iManufacturer = p[14];
+    dev->desc.iProduct = p[15];
+    dev->desc.iSerialNumber = p[16];
+    dev->desc.bNumConfigurations = p[17];
+    p += LIBUSB_DT_DEVICE_SIZE;
+  }
+
+  if (end - p < LIBUSB_DT_CONFIG_SIZE || p[0] < LIBUSB_DT_CONFIG_SIZE ||
+      p[1] != LIBUSB_DT_CONFIG) {
+    dev->described_error = 1;
+    return;
+  }
+
+  total = SW_TO_SHORT(p + 2);
+  if (total < p[0])
+    total = p[0];
+  if (total < (size_t) (end - p))
+    end = p + total;
+
+  /* Size the arrays before pointing into them */
+  for (q = p + p[0]; end - q >= 2 && q[0] >= 2 && q[0] <= end - q; q += q[0]) {
+    if (q[1] == LIBUSB_DT_INTERFACE && q[0] >= LIBUSB_DT_INTERFACE_SIZE)
+      num_alts++;
+    else if (q[1] == LIBUSB_DT_ENDPOINT && q[0] >= LIBUSB_DT_ENDPOINT_SIZE)
+      num_eps++;
+  }
+
+  dev->described_ifs = calloc(num_alts + 1, sizeof(*dev->described_ifs));
+  dev->described_alts = calloc(num_alts + 1, sizeof(*dev->described_alts));
+  dev->described_eps = calloc(num_eps + 1, sizeof(*dev->described_eps));
+  if (!dev->described_ifs || !dev->described_alts || !dev->described_eps) {
+    dev->described_error = 1;
+    return;
+  }
+
+  memset(config, 0, sizeof(*config));
+  config->bLength = p[0];
+  config->bDescriptorType = p[1];
+  config->wTotalLength = SW_TO_SHORT(p + 2);
+  config->bConfigurationValue = p[5];
+  config->iConfiguration = p[6];
+  config->bmAttributes = p[7];
+  config->MaxPower = p[8];
+  config->interface = dev->described_ifs;
+
+  extra = &config->extra;
+  extra_length = &config->extra_length;
+  num_alts = num_eps = 0;
+
+  for (q = p + p[0]; end - q >= 2 && q[0] >= 2 && q[0] <= end - q; q += q[0]) {
+    if (q[1] == LIBUSB_DT_INTERFACE && q[0] >= LIBUSB_DT_INTERFACE_SIZE) {
+      alt = &dev->described_alts[num_alts++];
+      if (!intf || intf->altsetting->bInterfaceNumber != q[2]) {
+        intf = &dev->described_ifs[num_ifs++];
+        intf->altsetting = alt;
+      }
+      intf->num_altsetting++;
+
+      alt->bLength = q[0];
+      alt->bDescriptorType = q[1];
+      alt->bInterfaceNumber = q[2];
+      alt->bAlternateSetting = q[3];
+      alt->bInterfaceClass = q[5];
+      alt->bInterfaceSubClass = q[6];
+      alt->bInterfaceProtocol = q[7];
+      alt->iInterface = q[8];
+      /* Its endpoints follow it, so they are consecutive in the array */
+      alt->endpoint = &dev->described_eps[num_eps];
+
+      extra = &alt->extra;
+      extra_length = &alt->extra_length;
+    } else if (q[1] == LIBUSB_DT_ENDPOINT && q[0] >= LIBUSB_DT_ENDPOINT_SIZE && alt) {
+      /* bNumEndpoints counts what is actually there */
+      ep = &dev->described_eps[num_eps++];
+      alt->bNumEndpoints++;
+      ep->bLength = q[0];
+      ep->bDescriptorType = q[1];
+      ep->bEndpointAddress = q[2];
+      ep->bmAttributes = q[3];
+      ep->wMaxPacketSize = SW_TO_SHORT(q + 4);
+      ep->bInterval = q[6];
+      if (q[0] >= LIBUSB_DT_ENDPOINT_AUDIO_SIZE) {
+        ep->bRefresh = q[7];
+        ep->bSynchAddress = q[8];
+      }
+
+      extra = &ep->extra;
+      extra_length = &ep->extra_length;
+    } else {
+      if (!*extra)
+        *extra = q;
+      *extra_length = q + q[0] - *extra;
+    }
+  }
+
+  config->bNumInterfaces = num_ifs;
+}
+
+/** @internal
+ * @brief Find an interface of the camera by number
+ */
+static const struct libusb_interface *virtual_find_interface(struct libusb_device *dev,
+                                                             int number) {
+  int i;
+
+  for (i = 0; i < dev->config.bNumInterfaces; i++) {
+    if (dev->config.interface[i].altsetting->bInterfaceNumber == number)
+      return &dev->config.interface[i];
+  }
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Fill a probe/commit block with the only mode the camera has
+ */
+static void virtual_fill_ctrl(struct libusb_device *dev, uint8_t *ctrl) {
+  ctrl[2] = 1;
+  ctrl[3] = 1;
+  INT_TO_DW(dev->interval, ctrl + 4);
+  INT_TO_DW(dev->max_frame_size, ctrl + 18);
+  INT_TO_DW(dev->payload_size, ctrl + 22);
+  INT_TO_DW(virtual_config.clock_frequency, ctrl + 26);
+  ctrl[30] = 0x03; /* FID required, EOF present */
+}
+
+/** @internal
+ * @brief Forget the frame in progress, as a camera does when (re)started
+ */
+static void virtual_reset_stream(struct libusb_device *dev) {
+  dev->start_ns = 0;
+  dev->frame_count = 0;
+  dev->in_frame = 0;
+  dev->frame_offset = 0;
+}
+
+/** @internal
+ * @brief Handle a class request to the VideoControl or VideoStreaming interface
+ * @return Bytes transferred or a libusb error
+ */
+static int virtual_class_request(struct libusb_device *dev, uint8_t request,
+                                 uint16_t value, uint16_t index,
+                                 unsigned char *data, uint16_t length) {
+  const struct libusb_interface *intf = virtual_find_interface(dev, index & 0xff);
+  int entity = index >> 8;
+  int selector = value >> 8;
+  uint8_t *block;
+  int n;
+
+  if (!intf || intf->altsetting->bInterfaceClass != 14)
+    return LIBUSB_ERROR_PIPE;
+
+  if (intf->altsetting->bInterfaceSubClass == 2) {
+    if (selector != UVC_VS_PROBE_CONTROL && selector != UVC_VS_COMMIT_CONTROL)
+      return LIBUSB_ERROR_PIPE;
+
+    block = selector == UVC_VS_PROBE_CONTROL ? dev->probe : dev->commit;
+    n = length < VIRTUAL_CTRL_LEN ? length : VIRTUAL_CTRL_LEN;
+
+    switch (request) {
+    case UVC_SET_CUR:
+      memset(block, 0, VIRTUAL_CTRL_LEN);
+      memcpy(block, data, n);
+      /* A described camera accepts whatever it is asked for, and leaves
+       * dwMaxVideoFrameSize and dwMaxPayloadTransferSize to the host */
+      if (!virtual_config.descriptors)
+        virtual_fill_ctrl(dev, block);
+      else
+        memset(block + 18, 0, 8);
+      if (selector == UVC_VS_COMMIT_CONTROL) {
+        dev->committed = 1;
+        virtual_reset_stream(dev);
+      }
+      return length;
+    case UVC_GET_CUR:
+      memcpy(data, block, n);
+      return n;
+    case UVC_GET_MIN:
+    case UVC_GET_MAX:
+    case UVC_GET_DEF:
+      memset(data, 0, n);
+      if (virtual_config.descriptors) {
+        memcpy(data, dev->probe, n);
+        if (n >= 26)
+          memset(data + 18, 0, 8);
+      } else if (n >= 26) {
+        SHORT_TO_SW(1, data);
+        virtual_fill_ctrl(dev, data);
+      }
+      return n;
+    case UVC_GET_LEN:
+      if (length < 2)
+        return LIBUSB_ERROR_OVERFLOW;
+      SHORT_TO_SW(VIRTUAL_CTRL_LEN, data);
+      return 2;
+    case UVC_GET_INFO:
+      if (length < 1)
+        return LIBUSB_ERROR_OVERFLOW;
+      data[0] = UVC_CONTROL_CAP_GET | UVC_CONTROL_CAP_SET;
+      return 1;
+    default:
+      return LIBUSB_ERROR_PIPE;
+    }
+  }
+
+  if (intf->altsetting->bInterfaceSubClass != 1)
+    return LIBUSB_ERROR_PIPE;
+
+  if (entity == 0) {
+    /* The simulated camera never fails a request */
+    if (selector == UVC_VC_REQUEST_ERROR_CODE_CONTROL && request == UVC_GET_CUR &&
+        length >= 1) {
+      data[0] = 0;
+      return 1;
+    }
+    return LIBUSB_ERROR_PIPE;
+  }
+
+  if ((entity != VIRTUAL_CAMERA_ID && entity != VIRTUAL_PU_ID) || selector >= 32 ||
+      length > VIRTUAL_UNIT_CTRL_MAX)
+    return LIBUSB_ERROR_PIPE;
+
+  block = dev->unit_ctrls[entity - VIRTUAL_CAMERA_ID][selector];
+
+  switch (request) {
+  case UVC_SET_CUR:
+    memcpy(block, data, length);
+    return length;
+  case UVC_GET_CUR:
+    memcpy(data, block, length);
+    return length;
+  case UVC_GET_MIN:
+  case UVC_GET_DEF:
+    memset(data, 0, length);
+    return length;
+  case UVC_GET_MAX:
+    memset(data, 0xff, length);
+    return length;
+  case UVC_GET_RES:
+    memset(data, 0, length);
+    if (length)
+      data[0] = 1;
+    return length;
+  case UVC_GET_LEN:
+    if (length < 2)
+      return LIBUSB_ERROR_OVERFLOW;
+    SHORT_TO_SW(VIRTUAL_UNIT_CTRL_MAX, data);
+    return 2;
+  case UVC_GET_INFO:
+    if (length < 1)
+      return LIBUSB_ERROR_OVERFLOW;
+    data[0] = UVC_CONTROL_CAP_GET | UVC_CONTROL_CAP_SET;
+    return 1;
+  default:
+    return LIBUSB_ERROR_PIPE;
+  }
+}
+
+/** @internal
+ * @brief Whether the host has started the stream the way libuvc does
+ */
+static int virtual_streaming(struct libusb_device *dev) {
+  if (virtual_config.transport == UVC_VIRTUAL_BULK)
+    return dev->committed;
+  return dev->alt_setting == 1;
+}
+
+/** @internal
+ * @brief Time at which the next frame leaves the sensor
+ */
+static uint64_t virtual_frame_due(struct libusb_device *dev) {
+  return dev->start_ns + dev->frame_count * dev->interval_ns;
+}
+
+/** @internal
+ * @brief Start a frame if one is due
+ * @return Whether a frame is in progress
+ */
+static int virtual_begin_frame(struct libusb_device *dev, uint64_t now) {
+  uint64_t slot, ticks;
+  uint32_t base;
+
+  if (dev->in_frame)
+    return 1;
+
+  if (!dev->start_ns)
+    dev->start_ns = now;
+
+  if (!virtual_config.unpaced) {
+    if (now < virtual_frame_due(dev))
+      return 0;
+
+    /* The sensor runs on its own clock; frames nobody had buffers for are
+     * simply gone */
+    slot = (now - dev->start_ns) / dev->interval_ns;
+    if (slot > dev->frame_count)
+      dev->frame_count = slot;
+  }
+
+  if (virtual_config.format == UVC_FRAME_FORMAT_MJPEG) {
+    /* Compressed frames vary between 3/16 and 5/16 of the raw size */
+    base = dev->max_frame_size / 4;
+    dev->frame_bytes = base - base / 4 + virtual_rand(dev) % (base / 2 + 1);
+    if (dev->frame_bytes < 4)
+      dev->frame_bytes = 4;
+  } else {
+    dev->frame_bytes = dev->max_frame_size;
+  }
+
+  ticks = virtual_config.unpaced ? now : virtual_frame_due(dev);
+  ticks = (ticks - dev->origin_ns) / 1000 * (virtual_config.clock_frequency / 1000) / 1000;
+  dev->pts = (uint32_t) ticks;
+  dev->frame_offset = 0;
+  dev->in_frame = 1;
+
+  return 1;
+}
+
+/** @internal
+ * @brief Produce the next payload of the stream
+ *
+ * @param buf Payload buffer
+ * @param size Buffer size; the payload fills as much of it as it can
+ * @param[out] length Payload length, header included
+ * @param[out] lost Whether the loss model dropped this payload
+ * @return Whether a payload was produced
+ */
+static int virtual_next_payload(struct libusb_device *dev, uint8_t *buf, uint32_t size,
+                                uint64_t now, uint32_t *length, int *lost) {
+  uint32_t chunk, stc, pos;
+  int eof;
+
+  if (size <= VIRTUAL_HEADER_LEN || !virtual_begin_frame(dev, now))
+    return 0;
+
+  chunk = size - VIRTUAL_HEADER_LEN;
+  if (chunk > dev->frame_bytes - dev->frame_offset)
+    chunk = dev->frame_bytes - dev->frame_offset;
+  eof = dev->frame_offset + chunk == dev->frame_bytes;
+
+  *lost = dev->loss_threshold && virtual_rand(dev) < dev->loss_threshold;
+  *length = VIRTUAL_HEADER_LEN + chunk;
+
+  if (!*lost) {
+    stc = (uint32_t) ((now - dev->origin_ns) / 1000 *
+                      (virtual_config.clock_frequency / 1000) / 1000);
+
+    buf[0] = VIRTUAL_HEADER_LEN;
+    buf[1] = UVC_STREAM_EOH | UVC_STREAM_SCR | UVC_STREAM_PTS | dev->fid;
+    if (eof)
+      buf[1] |= UVC_STREAM_EOF;
+    INT_TO_DW(dev->pts, buf + 2);
+    INT_TO_DW(stc, buf + 6);
+    SHORT_TO_SW(((now - dev->origin_ns) / 1000000) & 0x7ff, buf + 10);
+
+    memcpy(buf + VIRTUAL_HEADER_LEN, dev->pattern + dev->frame_offset, chunk);
+
+    /* Compressed frames end in an EOI marker wherever the frame ends */
+    if (virtual_config.format == UVC_FRAME_FORMAT_MJPEG) {
+      for (pos = dev->frame_bytes - 2; pos < dev->frame_bytes; pos++) {
+        if (pos >= dev->frame_offset && pos < dev->frame_offset + chunk)
+          buf[VIRTUAL_HEADER_LEN + pos - dev->frame_offset] =
+            pos == dev->frame_bytes - 2 ? 0xff : 0xd9;
+      }
+    }
+
+    virtual_stats.bytes_sent += chunk;
+  } else {
+    virtual_stats.payloads_lost++;
+  }
+  virtual_stats.payloads_sent++;
+
+  dev->frame_offset += chunk;
+  if (eof) {
+    dev->in_frame = 0;
+    dev->fid ^= UVC_STREAM_FID;
+    dev->frame_count++;
+    virtual_stats.frames_sent++;
+  }
+
+  return 1;
+}
+
+/** @internal
+ * @brief Fill a streaming transfer
+ * @return Whether the transfer is complete
+ */
+static int virtual_fill_transfer(struct libusb_device *dev, struct libusb_transfer *transfer,
+                                 uint64_t now) {
+  uint8_t *buf = transfer->buffer;
+  uint32_t length;
+  int lost, i;
+
+  if (!virtual_begin_frame(dev, now))
+    return 0;
+
+  if (transfer->type == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS) {
+    /* Packets after the end of a frame stay empty, like the idle
+     * microframes between frames */
+    transfer->actual_length = 0;
+    for (i = 0; i < transfer->num_iso_packets; i++) {
+      struct libusb_iso_packet_descriptor *pkt = transfer->iso_packet_desc + i;
+
+      pkt->status = LIBUSB_TRANSFER_COMPLETED;
+      pkt->actual_length = 0;
+      if (virtual_next_payload(dev, buf, pkt->length, now, &length, &lost)) {
+        if (lost) {
+          pkt->status = LIBUSB_TRANSFER_ERROR;
+        } else {
+          pkt->actual_length = length;
+          transfer->actual_length += length;
+        }
+      }
+      buf += pkt->length;
+    }
+    transfer->status = LIBUSB_TRANSFER_COMPLETED;
+    return 1;
+  }
+
+  /* A lost bulk payload never reaches the host, so keep generating */
+  while (virtual_next_payload(dev, buf, transfer->length, now, &length, &lost)) {
+    if (!lost) {
+      transfer->actual_length = length;
+      transfer->status = LIBUSB_TRANSFER_COMPLETED;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/** @internal
+ * @brief Pick the next transfer to complete
+ * @pre virtual_lock is held
+ */
+static struct virtual_transfer *virtual_next_completion(struct libusb_context *ctx,
+                                                        uint64_t now) {
+  struct libusb_device *dev = &ctx->device;
+  struct virtual_transfer *vt;
+
+  DL_FOREACH(ctx->pending, vt) {
+    if (vt->state == VIRTUAL_XFER_CANCELLING) {
+      vt->transfer.status = LIBUSB_TRANSFER_CANCELLED;
+      vt->transfer.actual_length = 0;
+      goto done;
+    }
+  }
+
+  if (!virtual_streaming(dev))
+    return NULL;
+
+  /* Streaming transfers complete in submission order */
+  DL_FOREACH(ctx->pending, vt) {
+    if (vt->transfer.endpoint != VIRTUAL_STREAM_EP)
+      continue;
+    if (virtual_fill_transfer(dev, &vt->transfer, now))
+      goto done;
+    break;
+  }
+
+  return NULL;
+
+done:
+  DL_DELETE(ctx->pending, vt);
+  vt->state = VIRTUAL_XFER_IDLE;
+  return vt;
+}
+
+int LIBUSB_CALL libusb_init(libusb_context **ctx) {
+  struct libusb_context *new_ctx;
+  struct libusb_device *dev;
+  uint32_t i;
+
+  new_ctx = calloc(1, sizeof(*new_ctx));
+  if (!new_ctx)
+    return LIBUSB_ERROR_NO_MEM;
+
+  pthread_mutex_lock(&virtual_lock);
+  if (!virtual_config_set) {
+    uvc_virtual_default_config(&virtual_config);
+    virtual_config_set = 1;
+  }
+
+  dev = &new_ctx->device;
+  dev->ctx = new_ctx;
+  dev->refcount = 1;
+  virtual_build_descriptors(dev, &virtual_config);
+  if (virtual_config.descriptors)
+    virtual_parse_descriptors(dev, virtual_config.descriptors,
+                              virtual_config.descriptors_length);
+  dev->origin_ns = virtual_now_ns();
+  dev->rng = virtual_config.seed ? virtual_config.seed : 1;
+  dev->loss_threshold = (uint32_t) (virtual_config.loss_rate * 4294967295.0);
+  virtual_fill_ctrl(dev, dev->probe);
+  virtual_fill_ctrl(dev, dev->commit);
+
+  /* Frame contents never change; compressed ones carry a JPEG SOI and
+   * avoid 0xff so the only markers are the ones added per frame. A
+   * described camera never streams and needs none. */
+  if (!virtual_config.descriptors) {
+    dev->pattern = malloc(dev->max_frame_size);
+    if (!dev->pattern) {
+      pthread_mutex_unlock(&virtual_lock);
+      free(new_ctx);
+      return LIBUSB_ERROR_NO_MEM;
+    }
+    for (i = 0; i < dev->max_frame_size; i++) {
+      uint8_t v = (uint8_t) (i * 13 + (i >> 11));
+
+      dev->pattern[i] = v == 0xff ? 0xfe : v;
+    }
+    if (virtual_config.format == UVC_FRAME_FORMAT_MJPEG) {
+      dev->pattern[0] = 0xff;
+      dev->pattern[1] = 0xd8;
+    }
+  }
+
+  virtual_contexts++;
+  pthread_mutex_unlock(&virtual_lock);
+
+  pthread_cond_init(&new_ctx->cond, NULL);
+  *ctx = new_ctx;
+  return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_exit(libusb_context *ctx) {
+  pthread_mutex_lock(&virtual_lock);
+  virtual_contexts--;
+  pthread_mutex_unlock(&virtual_lock);
+
+  pthread_cond_destroy(&ctx->cond);
+  free(ctx->device.described_ifs);
+  free(ctx->device.described_alts);
+  free(ctx->device.described_eps);
+  free(ctx->device.pattern);
+  free(ctx);
+}
+
+ssize_t LIBUSB_CALL libusb_get_device_list(libusb_context *ctx, libusb_device ***list) {
+  libusb_device **devs = calloc(2, sizeof(*devs));
+
+  if (!devs)
+    return LIBUSB_ERROR_NO_MEM;
+
+  devs[0] = libusb_ref_device(&ctx->device);
+  *list = devs;
+  return 1;
+}
+
+void LIBUSB_CALL libusb_free_device_list(libusb_device **list, int unref_devices) {
+  libusb_device **dev;
+
+  if (!list)
+    return;
+
+  if (unref_devices) {
+    for (dev = list; *dev; dev++)
+      libusb_unref_device(*dev);
+  }
+  free(list);
+}
+
+libusb_device * LIBUSB_CALL libusb_ref_device(libusb_device *dev) {
+  pthread_mutex_lock(&virtual_lock);
+  dev->refcount++;
+  pthread_mutex_unlock(&virtual_lock);
+  return dev;
+}
+
+void LIBUSB_CALL libusb_unref_device(libusb_device *dev) {
+  /* The camera lives as long as its context */
+  pthread_mutex_lock(&virtual_lock);
+  dev->refcount--;
+  pthread_mutex_unlock(&virtual_lock);
+}
+
+int LIBUSB_CALL libusb_get_device_descriptor(libusb_device *dev,
+                                             struct libusb_device_descriptor *desc) {
+  *desc = dev->desc;
+  return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_get_config_descriptor(libusb_device *dev, uint8_t config_index,
+                                             struct libusb_config_descriptor **config) {
+  if (config_index != 0)
+    return LIBUSB_ERROR_NOT_FOUND;
+  if (dev->described_error)
+    return LIBUSB_ERROR_IO;
+
+  *config = &dev->config;
+  return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_free_config_descriptor(struct libusb_config_descriptor *config) {
+  /* Owned by the device */
+  (void) config;
+}
+
+int LIBUSB_CALL libusb_get_ss_endpoint_companion_descriptor(libusb_context *ctx,
+    const struct libusb_endpoint_descriptor *endpoint,
+    struct libusb_ss_endpoint_companion_descriptor **ep_comp) {
+  struct libusb_device *dev;
+  struct libusb_ss_endpoint_companion_descriptor *comp;
+
+  (void) ctx;
+  *ep_comp = NULL;
+
+  /* A described camera carries its companions in the endpoints' extra bytes */
+  if (virtual_config.descriptors) {
+    const unsigned char *p = endpoint->extra;
+    const unsigned char *end = p + endpoint->extra_length;
+
+    for (; end - p >= 2 && p[0] >= 2 && p[0] <= end - p; p += p[0]) {
+      if (p[1] != LIBUSB_DT_SS_ENDPOINT_COMPANION ||
+          p[0] < LIBUSB_DT_SS_ENDPOINT_COMPANION_SIZE)
+        continue;
+
+      comp = calloc(1, sizeof(*comp));
+      if (!comp)
+        return LIBUSB_ERROR_NO_MEM;
+
+      comp->bLength = p[0];
+      comp->bDescriptorType = p[1];
+      comp->bMaxBurst = p[2];
+      comp->bmAttributes = p[3];
+      comp->wBytesPerInterval = SW_TO_SHORT(p + 4);
+
+      *ep_comp = comp;
+      return LIBUSB_SUCCESS;
+    }
+
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+
+  /* Only the isochronous endpoint of a SuperSpeed camera has one, and it
+   * lives inside the device, so find the device from the endpoint */
+  if (endpoint->bEndpointAddress != VIRTUAL_STREAM_EP ||
+      (endpoint->bmAttributes & 3) != LIBUSB_TRANSFER_TYPE_ISOCHRONOUS)
+    return LIBUSB_ERROR_NOT_FOUND;
+
+  dev = (struct libusb_device *) ((char *) endpoint - offsetof(struct libusb_device, stream_ep));
+  if (!dev->superspeed)
+    return LIBUSB_ERROR_NOT_FOUND;
+
+  comp = calloc(1, sizeof(*comp));
+  if (!comp)
+    return LIBUSB_ERROR_NO_MEM;
+
+  comp->bLength = LIBUSB_DT_SS_ENDPOINT_COMPANION_SIZE;
+  comp->bDescriptorType = LIBUSB_DT_SS_ENDPOINT_COMPANION;
+  comp->bMaxBurst = 15;
+  comp->bmAttributes = (dev->payload_size + 16 * 1024 - 1) / (16 * 1024) - 1;
+  comp->wBytesPerInterval = dev->payload_size;
+
+  *ep_comp = comp;
+  return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_free_ss_endpoint_companion_descriptor(
+    struct libusb_ss_endpoint_companion_descriptor *ep_comp) {
+  free(ep_comp);
+}
+
+int LIBUSB_CALL libusb_get_device_speed(libusb_device *dev) {
+  return dev->desc.bcdUSB >= 0x0300 ? LIBUSB_SPEED_SUPER : LIBUSB_SPEED_HIGH;
+}
+
+uint8_t LIBUSB_CALL libusb_get_bus_number(libusb_device *dev) {
+  (void) dev;
+  return 1;
+}
+
+uint8_t LIBUSB_CALL libusb_get_device_address(libusb_device *dev) {
+  (void) dev;
+  return 1;
+}
+
+int LIBUSB_CALL libusb_open(libusb_device *dev, libusb_device_handle **dev_handle) {
+  struct libusb_device_handle *handle = calloc(1, sizeof(*handle));
+
+  if (!handle)
+    return LIBUSB_ERROR_NO_MEM;
+
+  handle->dev = libusb_ref_device(dev);
+  *dev_handle = handle;
+  return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_close(libusb_device_handle *dev_handle) {
+  struct libusb_device *dev = dev_handle->dev;
+  struct libusb_context *ctx = dev->ctx;
+  struct virtual_transfer *vt, *tmp;
+
+  /* Transfers still queued on the handle die with it */
+  pthread_mutex_lock(&virtual_lock);
+  DL_FOREACH_SAFE(ctx->pending, vt, tmp) {
+    if (vt->transfer.dev_handle == dev_handle) {
+      DL_DELETE(ctx->pending, vt);
+      vt->state = VIRTUAL_XFER_IDLE;
+    }
+  }
+  dev->alt_setting = 0;
+  dev->committed = 0;
+  virtual_reset_stream(dev);
+  pthread_cond_broadcast(&ctx->cond);
+  pthread_mutex_unlock(&virtual_lock);
+
+  libusb_unref_device(dev);
+  free(dev_handle);
+}
+
+libusb_device * LIBUSB_CALL libusb_get_device(libusb_device_handle *dev_handle) {
+  return dev_handle->dev;
+}
+
+int LIBUSB_CALL libusb_wrap_sys_device(libusb_context *ctx, intptr_t sys_dev,
+                                       libusb_device_handle **dev_handle) {
+  (void) ctx;
+  (void) sys_dev;
+  (void) dev_handle;
+  return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+
+int LIBUSB_CALL libusb_claim_interface(libusb_device_handle *dev_handle, int interface_number) {
+  return virtual_find_interface(dev_handle->dev, interface_number) ?
+    LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+}
+
+int LIBUSB_CALL libusb_release_interface(libusb_device_handle *dev_handle, int interface_number) {
+  return virtual_find_interface(dev_handle->dev, interface_number) ?
+    LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+}
+
+int LIBUSB_CALL libusb_detach_kernel_driver(libusb_device_handle *dev_handle, int interface_number) {
+  (void) dev_handle;
+  (void) interface_number;
+  return LIBUSB_ERROR_NOT_FOUND;
+}
+
+int LIBUSB_CALL libusb_attach_kernel_driver(libusb_device_handle *dev_handle, int interface_number) {
+  (void) dev_handle;
+  (void) interface_number;
+  return LIBUSB_ERROR_NOT_FOUND;
+}
+
+int LIBUSB_CALL libusb_set_interface_alt_setting(libusb_device_handle *dev_handle,
+                                                 int interface_number, int alternate_setting) {
+  struct libusb_device *dev = dev_handle->dev;
+  const struct libusb_interface *intf = virtual_find_interface(dev, interface_number);
+
+  if (!intf || alternate_setting < 0 || alternate_setting >= intf->num_altsetting)
+    return LIBUSB_ERROR_NOT_FOUND;
+  if (intf->altsetting->bInterfaceSubClass != 2)
+    return LIBUSB_SUCCESS;
+
+  pthread_mutex_lock(&virtual_lock);
+  if (alternate_setting != dev->alt_setting)
+    virtual_reset_stream(dev);
+  dev->alt_setting = alternate_setting;
+  pthread_cond_broadcast(&dev->ctx->cond);
+  pthread_mutex_unlock(&virtual_lock);
+
+  return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_clear_halt(libusb_device_handle *dev_handle, unsigned char endpoint) {
+  (void) dev_handle;
+  (void) endpoint;
+  return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_reset_device(libusb_device_handle *dev_handle) {
+  struct libusb_device *dev = dev_handle->dev;
+
+  pthread_mutex_lock(&virtual_lock);
+  dev->alt_setting = 0;
+  dev->committed = 0;
+  virtual_reset_stream(dev);
+  pthread_mutex_unlock(&virtual_lock);
+
+  return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_get_string_descriptor_ascii(libusb_device_handle *dev_handle,
+                                                   uint8_t desc_index, unsigned char *data,
+                                                   int length) {
+  static const char *strings[] = { NULL, "libuvc", "Virtual Camera", "VIRTUAL0001" };
+  int len;
+
+  (void) dev_handle;
+  if (desc_index == 0 || desc_index > 3)
+    return LIBUSB_ERROR_INVALID_PARAM;
+  if (length <= 0)
+    return LIBUSB_ERROR_OVERFLOW;
+
+  len = strlen(strings[desc_index]);
+  if (len > length - 1)
+    len = length - 1;
+  memcpy(data, strings[desc_index], len);
+  data[len] = '\0';
+  return len;
+}
+
+int LIBUSB_CALL libusb_control_transfer(libusb_device_handle *dev_handle,
+                                        uint8_t request_type, uint8_t bRequest,
+                                        uint16_t wValue, uint16_t wIndex,
+                                        unsigned char *data, uint16_t wLength,
+                                        unsigned int timeout) {
+  int ret;
+
+  (void) timeout;
+
+  if ((request_type & 0x60) != LIBUSB_REQUEST_TYPE_CLASS ||
+      (request_type & 0x1f) != LIBUSB_RECIPIENT_INTERFACE)
+    return LIBUSB_ERROR_PIPE;
+
+  /* Direction has to match the request */
+  if (!!(request_type & LIBUSB_ENDPOINT_IN) != (bRequest != UVC_SET_CUR))
+    return LIBUSB_ERROR_PIPE;
+
+  pthread_mutex_lock(&virtual_lock);
+  ret = virtual_class_request(dev_handle->dev, bRequest, wValue, wIndex, data, wLength);
+  pthread_mutex_unlock(&virtual_lock);
+
+  return ret;
+}
+
+struct libusb_transfer * LIBUSB_CALL libusb_alloc_transfer(int iso_packets) {
+  struct virtual_transfer *vt;
+
+  if (iso_packets < 0)
+    return NULL;
+
+  vt = calloc(1, sizeof(*vt) + iso_packets * sizeof(struct libusb_iso_packet_descriptor));
+  if (!vt)
+    return NULL;
+
+  vt->transfer.num_iso_packets = iso_packets;
+  return &vt->transfer;
+}
+
+void LIBUSB_CALL libusb_free_transfer(struct libusb_transfer *transfer) {
+  if (!transfer)
+    return;
+
+  if (transfer->flags & LIBUSB_TRANSFER_FREE_BUFFER)
+    free(transfer->buffer);
+  free(VIRTUAL_XFER(transfer));
+}
+
+int LIBUSB_CALL libusb_submit_transfer(struct libusb_transfer *transfer) {
+  struct virtual_transfer *vt = VIRTUAL_XFER(transfer);
+  struct libusb_context *ctx;
+
+  if (!transfer->dev_handle)
+    return LIBUSB_ERROR_NO_DEVICE;
+  ctx = transfer->dev_handle->dev->ctx;
+
+  /* Only status interrupts can be waited for on a described camera */
+  if (virtual_config.descriptors && transfer->type != LIBUSB_TRANSFER_TYPE_INTERRUPT)
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+
+  pthread_mutex_lock(&virtual_lock);
+  if (vt->state != VIRTUAL_XFER_IDLE) {
+    pthread_mutex_unlock(&virtual_lock);
+    return LIBUSB_ERROR_BUSY;
+  }
+
+  transfer->actual_length = 0;
+  vt->state = VIRTUAL_XFER_PENDING;
+  DL_APPEND(ctx->pending, vt);
+  pthread_cond_broadcast(&ctx->cond);
+  pthread_mutex_unlock(&virtual_lock);
+
+  return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_cancel_transfer(struct libusb_transfer *transfer) {
+  struct virtual_transfer *vt = VIRTUAL_XFER(transfer);
+  int ret = LIBUSB_SUCCESS;
+
+  pthread_mutex_lock(&virtual_lock);
+  if (vt->state == VIRTUAL_XFER_PENDING) {
+    vt->state = VIRTUAL_XFER_CANCELLING;
+    pthread_cond_broadcast(&transfer->dev_handle->dev->ctx->cond);
+  } else {
+    ret = LIBUSB_ERROR_NOT_FOUND;
+  }
+  pthread_mutex_unlock(&virtual_lock);
+
+  return ret;
+}
+
+int LIBUSB_CALL libusb_handle_events_completed(libusb_context *ctx, int *completed) {
+  struct libusb_device *dev = &ctx->device;
+  struct virtual_transfer *vt = NULL;
+  struct libusb_transfer *transfer;
+  struct timespec deadline;
+  struct timeval tv;
+  uint64_t now, wait_ns;
+  int free_transfer;
+
+  pthread_mutex_lock(&virtual_lock);
+  now = virtual_now_ns();
+  vt = virtual_next_completion(ctx, now);
+
+  if (!vt && !(completed && *completed)) {
+    /* Sleep until the next frame is due or something is submitted,
+     * cancelled or closed */
+    wait_ns = VIRTUAL_EVENT_WAIT_NS;
+    if (virtual_streaming(dev) && !dev->in_frame && dev->start_ns &&
+        !virtual_config.unpaced && virtual_frame_due(dev) > now &&
+        virtual_frame_due(dev) - now < wait_ns)
+      wait_ns = virtual_frame_due(dev) - now;
+
+    gettimeofday(&tv, NULL);
+    wait_ns += (uint64_t) tv.tv_usec * 1000;
+    deadline.tv_sec = tv.tv_sec + wait_ns / 1000000000ULL;
+    deadline.tv_nsec = wait_ns % 1000000000ULL;
+    pthread_cond_timedwait(&ctx->cond, &virtual_lock, &deadline);
+
+    vt = virtual_next_completion(ctx, virtual_now_ns());
+  }
+  pthread_mutex_unlock(&virtual_lock);
+
+  if (vt) {
+    transfer = &vt->transfer;
+    free_transfer = transfer->flags & LIBUSB_TRANSFER_FREE_TRANSFER;
+    transfer->callback(transfer);
+    if (free_transfer)
+      libusb_free_transfer(transfer);
+  }
+
+  return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_handle_events(libusb_context *ctx) {
+  return libusb_handle_events_completed(ctx, NULL);
+}
@@ -0,0 +1,434 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (C) 2010-2012 Ken Tossell
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the author nor other contributors may be
+*     used to endorse or promote products derived from this software
+*     without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+/**
+ * @ingroup streaming
+ * @brief Per-stream stall watchdog
+ *
+ * The watchdog thread wakes once per negotiated frame interval and checks
+ * whether a new frame was published. Once the configured number of intervals
+ * pass without one, it reports a stall and, if allowed, works through a
+ * ladder of increasingly disruptive recovery steps until frames come back.
+ * Every step is timed and reported through the watchdog callback.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#define LIBUVC_WATCHDOG_DEFAULT_MISSED 10
+#define LIBUVC_WATCHDOG_DEFAULT_STEP_TIMEOUT_MS 2000
+/* used when the control block carries no frame interval */
+#define LIBUVC_WATCHDOG_DEFAULT_INTERVAL_NS 33333333ULL
+
+static uint64_t _uvc_watchdog_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** @internal
+ * @brief Absolute CLOCK_REALTIME deadline for pthread_cond_timedwait
+ */
+static void _uvc_watchdog_deadline(struct timespec *ts, uint64_t delay_ns) {
+  clock_gettime(CLOCK_REALTIME, ts);
+  delay_ns += ts->tv_nsec;
+  ts->tv_sec += delay_ns / 1000000000ULL;
+  ts->tv_nsec = delay_ns % 1000000000ULL;
+}
+
+static uint64_t _uvc_watchdog_interval_ns(uvc_stream_handle_t *strmh) {
+  /* dwFrameInterval is in 100ns units */
+  if (strmh->cur_ctrl.dwFrameInterval)
+    return (uint64_t) strmh->cur_ctrl.dwFrameInterval * 100;
+
+  return LIBUVC_WATCHDOG_DEFAULT_INTERVAL_NS;
+}
+
+static uint32_t _uvc_watchdog_seq(uvc_stream_handle_t *strmh) {
+  uint32_t seq;
+
+  /* decimated frames are not published but still show the device is alive */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  seq = strmh->frames_assembled;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  return seq;
+}
+
+/** @internal
+ * @brief Whether the calling watchdog thread has been told to exit
+ * @note Must be called with wd_mutex held
+ */
+static int _uvc_watchdog_killed(uvc_stream_handle_t *strmh) {
+  /* a thread detached by uvc_stream_set_watchdog from its own callback may
+   * still be running when a new one is started */
+  return strmh->wd_kill || !strmh->wd_running ||
+         !pthread_equal(strmh->wd_thread, pthread_self());
+}
+
+/** @internal
+ * @brief Report an event to the user
+ * @note Called with wd_mutex held; the lock is dropped around the callback
+ */
+static void _uvc_watchdog_emit(uvc_stream_handle_t *strmh,
+                               const uvc_watchdog_event_t *event) {
+  uvc_watchdog_callback_t *cb = strmh->wd_config.cb;
+  void *user_ptr = strmh->wd_config.user_ptr;
+
+  UVC_DEBUG("watchdog event %d step %d result %d (%llu us)",
+            event->type, event->step, event->result,
+            (unsigned long long) event->duration_us);
+
+  if (cb) {
+    pthread_mutex_unlock(&strmh->wd_mutex);
+    cb(strmh, event, user_ptr);
+    pthread_mutex_lock(&strmh->wd_mutex);
+  }
+}
+
+/** @internal
+ * @brief Stop the stream, apply one recovery step and start it again
+ */
+static uvc_error_t _uvc_watchdog_run_step(uvc_stream_handle_t *strmh,
+                                          enum uvc_watchdog_step step) {
+  libusb_device_handle *usb_devh = strmh->devh->usb_devh;
+  uvc_frame_callback_t *cb = strmh->user_cb;
+  void *user_ptr = strmh->user_ptr;
+  uvc_stream_ctrl_t ctrl = strmh->cur_ctrl;
+  uvc_error_t ret = UVC_SUCCESS;
+
+  if (strmh->running)
+    _uvc_stream_stop(strmh);
+
+  switch (step) {
+  case UVC_WATCHDOG_STEP_ALTSETTING:
+    ret = libusb_set_interface_alt_setting(usb_devh,
+                                           strmh->stream_if->bInterfaceNumber, 0);
+    break;
+  case UVC_WATCHDOG_STEP_CLEAR_HALT:
+    ret = libusb_clear_halt(usb_devh, strmh->stream_if->bEndpointAddress);
+    break;
+  case UVC_WATCHDOG_STEP_RESET:
+    /* libusb restores claimed interfaces after a reset. If the device
+     * re-enumerates instead, the handle is dead and this fails with
+     * UVC_ERROR_NOT_FOUND; the application has to reopen the device. */
+    ret = libusb_reset_device(usb_devh);
+    break;
+  default:
+    break;
+  }
+
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  ret = uvc_query_stream_ctrl(strmh->devh, &ctrl, 1, UVC_SET_CUR);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  ret = uvc_stream_ctrl(strmh, &ctrl);
+  if (ret != UVC_SUCCESS)
+    return ret;
+
+  return _uvc_stream_start(strmh, cb, user_ptr, strmh->start_flags);
+}
+
+/** @internal
+ * @brief Wait for a frame newer than @p seq
+ * @note Called with wd_mutex held
+ * @return 1 if a frame arrived
+ */
+static int _uvc_watchdog_wait_frame(uvc_stream_handle_t *strmh, uint32_t seq,
+                                    uint64_t timeout_ns) {
+  uint64_t interval_ns = _uvc_watchdog_interval_ns(strmh);
+  uint64_t end_ns = _uvc_watchdog_now_ns() + timeout_ns;
+  struct timespec ts;
+  int got_frame;
+
+  pthread_mutex_unlock(&strmh->wd_mutex);
+
+  pthread_mutex_lock(&strmh->cb_mutex);
+  while (strmh->running && !strmh->wd_kill && strmh->frames_assembled == seq) {
+    uint64_t now_ns = _uvc_watchdog_now_ns();
+
+    if (now_ns >= end_ns)
+      break;
+
+    /* decimated frames are not broadcast, so look again every interval */
+    _uvc_watchdog_deadline(&ts, end_ns - now_ns < interval_ns ?
+                           end_ns - now_ns : interval_ns);
+    pthread_cond_timedwait(&strmh->cb_cond, &strmh->cb_mutex, &ts);
+  }
+  got_frame = strmh->frames_assembled != seq;
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  pthread_mutex_lock(&strmh->wd_mutex);
+
+  return got_frame;
+}
+
+/** @internal
+ * @brief Work through the recovery ladder after a stall
+ * @note Called with wd_mutex held
+ */
+static void _uvc_watchdog_recover(uvc_stream_handle_t *strmh,
+                                  uint64_t stall_ns, uint32_t missed) {
+  uvc_watchdog_event_t event;
+  uvc_error_t result = UVC_ERROR_NOT_FOUND;
+  int step;
+
+  for (step = UVC_WATCHDOG_STEP_RECOMMIT;
+       step <= strmh->wd_config.max_step && !_uvc_watchdog_killed(strmh);
+       step++) {
+    uint64_t timeout_ns;
+    uint64_t t0;
+    uint32_t seq;
+
+    t0 = _uvc_watchdog_now_ns();
+    pthread_mutex_unlock(&strmh->wd_mutex);
+    seq = _uvc_watchdog_seq(strmh);
+    memset(&event, 0, sizeof(event));
+    event.result = _uvc_watchdog_run_step(strmh, step);
+    pthread_mutex_lock(&strmh->wd_mutex);
+
+    event.type = UVC_WATCHDOG_STEP_DONE;
+    event.step = step;
+    event.duration_us = (_uvc_watchdog_now_ns() - t0) / 1000;
+    event.elapsed_us = (_uvc_watchdog_now_ns() - stall_ns) / 1000;
+    event.missed_intervals = missed;
+    strmh->wd_stats.steps_run[step]++;
+    _uvc_watchdog_emit(strmh, &event);
+    result = event.result != UVC_SUCCESS ? event.result : UVC_ERROR_NOT_FOUND;
+
+    if (event.result == UVC_ERROR_NO_DEVICE || event.result == UVC_ERROR_NOT_FOUND)
+      break;
+
+    if (event.result != UVC_SUCCESS)
+      continue;
+
+    timeout_ns = (uint64_t) strmh->wd_config.step_timeout_ms * 1000000ULL;
+    if (_uvc_watchdog_wait_frame(strmh, seq, timeout_ns)) {
+      event.type = UVC_WATCHDOG_RECOVERED;
+      event.elapsed_us = (_uvc_watchdog_now_ns() - stall_ns) / 1000;
+      strmh->wd_stats.recoveries++;
+      strmh->wd_stats.last_recovery_us = event.elapsed_us;
+      _uvc_watchdog_emit(strmh, &event);
+      return;
+    }
+  }
+
+  if (_uvc_watchdog_killed(strmh))
+    return;
+
+  memset(&event, 0, sizeof(event));
+  event.type = UVC_WATCHDOG_FAILED;
+  event.result = result;
+  event.step = step > strmh->wd_config.max_step ? strmh->wd_config.max_step : step;
+  event.elapsed_us = (_uvc_watchdog_now_ns() - stall_ns) / 1000;
+  event.missed_intervals = missed;
+  strmh->wd_stats.failures++;
+  _uvc_watchdog_emit(strmh, &event);
+}
+
+/** @internal
+ * @brief Watchdog thread
+ */
+static void *_uvc_watchdog_thread(void *arg) {
+  uvc_stream_handle_t *strmh = (uvc_stream_handle_t *) arg;
+  uint32_t last_seq;
+  uint64_t last_progress_ns;
+  /* after a failed recovery, stay quiet until frames resume */
+  int gave_up = 0;
+
+  last_seq = _uvc_watchdog_seq(strmh);
+  last_progress_ns = _uvc_watchdog_now_ns();
+
+  pthread_mutex_lock(&strmh->wd_mutex);
+
+  while (!_uvc_watchdog_killed(strmh)) {
+    uint64_t interval_ns = _uvc_watchdog_interval_ns(strmh);
+    uint64_t now_ns;
+    uint32_t seq, missed;
+    struct timespec ts;
+
+    _uvc_watchdog_deadline(&ts, interval_ns);
+    pthread_cond_timedwait(&strmh->wd_cond, &strmh->wd_mutex, &ts);
+
+    if (_uvc_watchdog_killed(strmh))
+      break;
+
+    seq = _uvc_watchdog_seq(strmh);
+    now_ns = _uvc_watchdog_now_ns();
+
+    if (seq != last_seq) {
+      last_seq = seq;
+      last_progress_ns = now_ns;
+      gave_up = 0;
+      continue;
+    }
+
+    missed = (uint32_t) ((now_ns - last_progress_ns) / interval_ns);
+    if (gave_up || missed < strmh->wd_config.missed_intervals)
+      continue;
+
+    {
+      uvc_watchdog_event_t event;
+
+      memset(&event, 0, sizeof(event));
+      event.type = UVC_WATCHDOG_STALL;
+      event.missed_intervals = missed;
+      strmh->wd_stats.stalls++;
+      _uvc_watchdog_emit(strmh, &event);
+    }
+
+    if (strmh->wd_config.max_step != UVC_WATCHDOG_STEP_NONE)
+      _uvc_watchdog_recover(strmh, now_ns, missed);
+
+    last_seq = _uvc_watchdog_seq(strmh);
+    last_progress_ns = _uvc_watchdog_now_ns();
+    gave_up = seq == last_seq;
+  }
+
+  pthread_mutex_unlock(&strmh->wd_mutex);
+
+  return NULL;
+}
+
+/** @internal
+ * @brief Start the watchdog thread if a watchdog is configured
+ * @note Called once the stream is running
+ */
+void _uvc_watchdog_start(uvc_stream_handle_t *strmh) {
+  pthread_mutex_lock(&strmh->wd_mutex);
+
+  if (strmh->wd_enabled && !strmh->wd_running) {
+    strmh->wd_kill = 0;
+    if (pthread_create(&strmh->wd_thread, NULL, _uvc_watchdog_thread,
+                       (void*) strmh) == 0)
+      strmh->wd_running = 1;
+  }
+
+  pthread_mutex_unlock(&strmh->wd_mutex);
+}
+
+/** @internal
+ * @brief Stop the watchdog thread, waiting for a recovery step in progress
+ */
+void _uvc_watchdog_stop(uvc_stream_handle_t *strmh) {
+  pthread_t thread;
+
+  pthread_mutex_lock(&strmh->wd_mutex);
+
+  if (!strmh->wd_running) {
+    pthread_mutex_unlock(&strmh->wd_mutex);
+    return;
+  }
+
+  thread = strmh->wd_thread;
+  strmh->wd_kill = 1;
+  strmh->wd_running = 0;
+  pthread_cond_broadcast(&strmh->wd_cond);
+  pthread_mutex_unlock(&strmh->wd_mutex);
+
+  /* wake a recovery step waiting for its first frame */
+  pthread_mutex_lock(&strmh->cb_mutex);
+  pthread_cond_broadcast(&strmh->cb_cond);
+  pthread_mutex_unlock(&strmh->cb_mutex);
+
+  if (pthread_equal(thread, pthread_self()))
+    pthread_detach(thread);
+  else
+    pthread_join(thread, NULL);
+}
+
+/** @brief Watch a stream for stalls and optionally recover from them
+ * @ingroup streaming
+ *
+ * A stall is declared when no frame arrives for @p config->missed_intervals
+ * negotiated frame intervals. The watchdog then reports it and, up to
+ * @p config->max_step, restarts the stream with increasingly disruptive
+ * steps, waiting @p config->step_timeout_ms for a frame after each one.
+ *
+ * The callback runs on the watchdog thread. It may call
+ * uvc_stream_set_watchdog() or uvc_stream_stop(), but must not close the
+ * stream.
+ *
+ * May be called before or while streaming.
+ *
+ * @param strmh UVC stream handle
+ * @param config Watchdog settings, or NULL to turn the watchdog off
+ */
+uvc_error_t uvc_stream_set_watchdog(
+    uvc_stream_handle_t *strmh,
+    const uvc_watchdog_config_t *config) {
+  if (config && config->max_step > UVC_WATCHDOG_STEP_RESET)
+    return UVC_ERROR_INVALID_PARAM;
+
+  _uvc_watchdog_stop(strmh);
+
+  pthread_mutex_lock(&strmh->wd_mutex);
+  if (config) {
+    strmh->wd_config = *config;
+    if (!strmh->wd_config.missed_intervals)
+      strmh->wd_config.missed_intervals = LIBUVC_WATCHDOG_DEFAULT_MISSED;
+    if (!strmh->wd_config.step_timeout_ms)
+      strmh->wd_config.step_timeout_ms = LIBUVC_WATCHDOG_DEFAULT_STEP_TIMEOUT_MS;
+    strmh->wd_enabled = 1;
+  } else {
+    strmh->wd_enabled = 0;
+  }
+  pthread_mutex_unlock(&strmh->wd_mutex);
+
+  if (strmh->running)
+    _uvc_watchdog_start(strmh);
+
+  return UVC_SUCCESS;
+}
+
+/** @brief Get the stall and recovery counters of a stream
+ * @ingroup streaming
+ *
+ * @param strmh UVC stream handle
+ * @param[out] stats Counters since the stream was opened
+ */
+uvc_error_t uvc_stream_get_watchdog_stats(
+    uvc_stream_handle_t *strmh,
+    uvc_watchdog_stats_t *stats) {
+  if (!stats)
+    return UVC_ERROR_INVALID_PARAM;
+
+  pthread_mutex_lock(&strmh->wd_mutex);
+  *stats = strmh->wd_stats;
+  pthread_mutex_unlock(&strmh->wd_mutex);
+
+  return UVC_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/* Watchdog test against the simulated camera in virtual_usb.c.
+ *
+ * Streams from a camera that loses every payload, so no frame ever arrives,
+ * and checks that the watchdog reports the stall, runs every allowed
+ * recovery step and then gives up with an error in the FAILED event. */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_virtual.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+struct test_events {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int stalls;
+  int steps;
+  int failed;
+  uvc_error_t last_step_result;
+  uvc_error_t failed_result;
+};
+
+static void frame_cb(uvc_frame_t *frame, void *ptr) {
+  (void) frame;
+  (void) ptr;
+}
+
+static void watchdog_cb(uvc_stream_handle_t *strmh, const uvc_watchdog_event_t *event,
+                        void *ptr) {
+  struct test_events *ev = ptr;
+
+  (void) strmh;
+
+  pthread_mutex_lock(&ev->mutex);
+  switch (event->type) {
+  case UVC_WATCHDOG_STALL:
+    ev->stalls++;
+    break;
+  case UVC_WATCHDOG_STEP_DONE:
+    ev->steps++;
+    ev->last_step_result = event->result;
+    break;
+  case UVC_WATCHDOG_RECOVERED:
+    break;
+  case UVC_WATCHDOG_FAILED:
+    ev->failed++;
+    ev->failed_result = event->result;
+    pthread_cond_broadcast(&ev->cond);
+    break;
+  }
+  pthread_mutex_unlock(&ev->mutex);
+}
+
+#define CHECK(cond)                                              \
+  do {                                                           \
+    if (!(cond)) {                                               \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,     \
+              __LINE__, #cond);                                  \
+      failures++;                                                \
+    }                                                            \
+  } while (0)
+
+int main(void) {
+  uvc_virtual_config_t config;
+  uvc_watchdog_config_t wd;
+  uvc_watchdog_stats_t stats;
+  uvc_context_t *ctx;
+  uvc_device_t *dev;
+  uvc_device_handle_t *devh;
+  uvc_stream_ctrl_t ctrl;
+  uvc_stream_handle_t *strmh;
+  struct test_events ev = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+  };
+  struct timespec deadline;
+  uvc_error_t res;
+  int failures = 0;
+
+  uvc_virtual_default_config(&config);
+  config.width = 160;
+  config.height = 120;
+  config.fps = 100;
+  config.loss_rate = 1.0;
+  res = uvc_virtual_set_config(&config);
+  if (res == UVC_SUCCESS)
+    res = uvc_init(&ctx, NULL);
+  if (res == UVC_SUCCESS)
+    res = uvc_find_device(ctx, &dev, 0, 0, NULL);
+  if (res == UVC_SUCCESS)
+    res = uvc_open(dev, &devh);
+  if (res == UVC_SUCCESS)
+    res = uvc_get_stream_ctrl_format_size(devh, &ctrl, config.format, config.width,
+                                          config.height, config.fps);
+  if (res == UVC_SUCCESS)
+    res = uvc_stream_open_ctrl(devh, &strmh, &ctrl);
+  if (res != UVC_SUCCESS) {
+    uvc_perror(res, "setup");
+    return 1;
+  }
+
+  wd.missed_intervals = 5;
+  wd.max_step = UVC_WATCHDOG_STEP_RESET;
+  wd.step_timeout_ms = 100;
+  wd.cb = watchdog_cb;
+  wd.user_ptr = &ev;
+  CHECK(uvc_stream_set_watchdog(strmh, &wd) == UVC_SUCCESS);
+  CHECK(uvc_stream_start(strmh, frame_cb, NULL, 0) == UVC_SUCCESS);
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += 10;
+  pthread_mutex_lock(&ev.mutex);
+  while (!ev.failed &&
+         pthread_cond_timedwait(&ev.cond, &ev.mutex, &deadline) == 0)
+    ;
+  pthread_mutex_unlock(&ev.mutex);
+
+  CHECK(uvc_stream_get_watchdog_stats(strmh, &stats) == UVC_SUCCESS);
+  CHECK(stats.failures == 1);
+  uvc_stream_close(strmh);
+
+  pthread_mutex_lock(&ev.mutex);
+  CHECK(ev.stalls == 1);
+  CHECK(ev.steps == UVC_WATCHDOG_STEP_RESET);
+  CHECK(ev.failed == 1);
+  /* Every step succeeded but no frame followed */
+  CHECK(ev.last_step_result == UVC_SUCCESS);
+  CHECK(ev.failed_result == UVC_ERROR_NOT_FOUND);
+  pthread_mutex_unlock(&ev.mutex);
+
+  uvc_close(devh);
+  uvc_unref_device(dev);
+  uvc_exit(ctx);
+
+  printf("%s\n", failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}